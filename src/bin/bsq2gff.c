@@ -24,14 +24,16 @@
 #include <string.h>
 
 #include "ngs_bsq.h"
+#include "ngs_writer.h"
 
 
 typedef struct _CallbackData CallbackData;
 
 struct _CallbackData
 {
-  char *source;
-  char *input_path;
+  char      *source;
+  char      *input_path;
+  NgsWriter *output_writer;
 };
 
 static void parse_args (CallbackData      *data,
@@ -62,6 +64,13 @@ main (int    argc,
       error = NULL;
       return 1;
     }
+  if (!ngs_writer_close (data.output_writer, &error))
+    {
+      g_printerr ("[ERROR] Writing output failed: %s\n", error->message);
+      g_error_free (error);
+      error = NULL;
+      return 1;
+    }
 
   return 0;
 }
@@ -102,6 +111,13 @@ parse_args (CallbackData      *data,
 
   if (!data->source)
     data->source = "bsread";
+
+  data->output_writer = ngs_writer_new ("-", "w", &error);
+  if (error)
+    {
+      g_printerr ("[ERROR] Opening output failed: %s\n", error->message);
+      exit (1);
+    }
 }
 
 static int
@@ -121,22 +137,24 @@ iter_func (BsqRecord    *rec,
        (rec->strand == BSQ_STRAND_WC ||
         rec->strand == BSQ_STRAND_CC))))
     {
-      g_print ("%s\t"        /* Reference */
-               "%s\t"        /* Source */
-               "bsmap\t"     /* Method */
-               "%ld\t"       /* From */
-               "%ld\t"       /* To */
-               ".\t"         /* Score */
-               "%s\t"        /* Strand */
-               ".\t"         /* Phase */
-               "read %s\n",  /* Group */
-               rec->ref,
-               data->source,
-               rec->loc,
-               rec->loc + rec->size,
-               (rec->strand == BSQ_STRAND_W ||
-                rec->strand == BSQ_STRAND_C) ? "+" : "-",
-               rec->name);
+      ngs_writer_printf (data->output_writer,
+                         NULL,
+                         "%s\t"        /* Reference */
+                         "%s\t"        /* Source */
+                         "bsmap\t"     /* Method */
+                         "%ld\t"       /* From */
+                         "%ld\t"       /* To */
+                         ".\t"         /* Score */
+                         "%s\t"        /* Strand */
+                         ".\t"         /* Phase */
+                         "read %s\n",  /* Group */
+                         rec->ref,
+                         data->source,
+                         rec->loc,
+                         rec->loc + rec->size,
+                         (rec->strand == BSQ_STRAND_W ||
+                          rec->strand == BSQ_STRAND_C) ? "+" : "-",
+                         rec->name);
     }
   return 1;
 }
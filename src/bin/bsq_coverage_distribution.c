@@ -25,6 +25,7 @@
 
 #include "ngs_bsq.h"
 #include "ngs_fasta.h"
+#include "ngs_writer.h"
 
 /*********************/
 /* ReferenceHashData */
@@ -249,10 +250,19 @@ intcmp (const int *i1,
 static void
 rle_encode (CallbackData *data)
 {
+  NgsWriter        *writer;
+  GError           *error = NULL;
   unsigned long int i;
   int               current;
   int               nb;
 
+  writer = ngs_writer_new ("-", "w", &error);
+  if (error)
+    {
+      g_printerr ("[ERROR] Opening output failed: %s\n", error->message);
+      exit (1);
+    }
+
   current = -1;
   nb      = 0;
   for (i = 0; i < data->reference_size; i++)
@@ -262,15 +272,21 @@ rle_encode (CallbackData *data)
           current = data->reference_coverage[i];
           if (nb > 0)
             {
-              g_print ("%d\n", nb);
+              ngs_writer_printf (writer, NULL, "%d\n", nb);
               nb = 0;
             }
-          g_print ("%d\t", current);
+          ngs_writer_printf (writer, NULL, "%d\t", current);
         }
       nb++;
     }
   if (nb > 0)
-    g_print ("%d\n", nb);
+    ngs_writer_printf (writer, NULL, "%d\n", nb);
+
+  if (!ngs_writer_close (writer, &error))
+    {
+      g_printerr ("[ERROR] Writing output failed: %s\n", error->message);
+      g_error_free (error);
+    }
 }
 
 static void
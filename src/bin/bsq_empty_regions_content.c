@@ -25,6 +25,7 @@
 
 #include "ngs_bsq.h"
 #include "ngs_fasta.h"
+#include "ngs_writer.h"
 
 /*********************/
 /* ReferenceHashData */
@@ -251,6 +252,8 @@ get_content (CallbackData *data)
   unsigned long int n_non_covered_N   = 0;
   unsigned long int n_non_covered_tot = 0;
   unsigned long int i                 = 0;
+  NgsWriter        *writer;
+  GError           *error             = NULL;
 
   for (i = 0; i < data->reference_size; i++)
     {
@@ -315,28 +318,42 @@ get_content (CallbackData *data)
                       n_non_covered_G +
                       n_non_covered_C +
                       n_non_covered_N;
-  g_print ("Composition of covered bases:\n"
-           " A: %9ld (%6.2f)\n"
-           " T: %9ld (%6.2f)\n"
-           " G: %9ld (%6.2f)\n"
-           " C: %9ld (%6.2f)\n"
-           " N: %9ld (%6.2f)\n",
-           n_covered_A, 100. * n_covered_A / n_covered_tot,
-           n_covered_T, 100. * n_covered_T / n_covered_tot,
-           n_covered_G, 100. * n_covered_G / n_covered_tot,
-           n_covered_C, 100. * n_covered_C / n_covered_tot,
-           n_covered_N, 100. * n_covered_N / n_covered_tot);
-  g_print ("Composition of non covered bases:\n"
-           " A: %9ld (%6.2f)\n"
-           " T: %9ld (%6.2f)\n"
-           " G: %9ld (%6.2f)\n"
-           " C: %9ld (%6.2f)\n"
-           " N: %9ld (%6.2f)\n",
-           n_non_covered_A, 100. * n_non_covered_A / n_non_covered_tot,
-           n_non_covered_T, 100. * n_non_covered_T / n_non_covered_tot,
-           n_non_covered_G, 100. * n_non_covered_G / n_non_covered_tot,
-           n_non_covered_C, 100. * n_non_covered_C / n_non_covered_tot,
-           n_non_covered_N, 100. * n_non_covered_N / n_non_covered_tot);
+
+  writer = ngs_writer_new ("-", "w", &error);
+  if (error)
+    {
+      g_printerr ("[ERROR] Opening output failed: %s\n", error->message);
+      exit (1);
+    }
+
+  ngs_writer_printf (writer, NULL, "Composition of covered bases:\n"
+                     " A: %9ld (%6.2f)\n"
+                     " T: %9ld (%6.2f)\n"
+                     " G: %9ld (%6.2f)\n"
+                     " C: %9ld (%6.2f)\n"
+                     " N: %9ld (%6.2f)\n",
+                     n_covered_A, 100. * n_covered_A / n_covered_tot,
+                     n_covered_T, 100. * n_covered_T / n_covered_tot,
+                     n_covered_G, 100. * n_covered_G / n_covered_tot,
+                     n_covered_C, 100. * n_covered_C / n_covered_tot,
+                     n_covered_N, 100. * n_covered_N / n_covered_tot);
+  ngs_writer_printf (writer, NULL, "Composition of non covered bases:\n"
+                     " A: %9ld (%6.2f)\n"
+                     " T: %9ld (%6.2f)\n"
+                     " G: %9ld (%6.2f)\n"
+                     " C: %9ld (%6.2f)\n"
+                     " N: %9ld (%6.2f)\n",
+                     n_non_covered_A, 100. * n_non_covered_A / n_non_covered_tot,
+                     n_non_covered_T, 100. * n_non_covered_T / n_non_covered_tot,
+                     n_non_covered_G, 100. * n_non_covered_G / n_non_covered_tot,
+                     n_non_covered_C, 100. * n_non_covered_C / n_non_covered_tot,
+                     n_non_covered_N, 100. * n_non_covered_N / n_non_covered_tot);
+
+  if (!ngs_writer_close (writer, &error))
+    {
+      g_printerr ("[ERROR] Writing output failed: %s\n", error->message);
+      g_error_free (error);
+    }
 }
 
 static void
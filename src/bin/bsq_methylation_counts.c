@@ -31,6 +31,40 @@
 #include "ngs_seq_db.h"
 #include "ngs_utils.h"
 
+/* Number of alignments counted at once by a worker */
+#define METH_BATCH_SIZE 4096
+
+/* Reads the forward strands as they are, see count_alignment */
+static char same_table[128];
+
+typedef struct _MethAln MethAln;
+
+struct _MethAln
+{
+  SeqDBElement *ref_elem;
+  gsize         name;
+  gsize         read;
+  gsize         qual;
+  unsigned int  start_ref;
+  unsigned int  size;
+  BsqStrand     strand;
+};
+
+typedef struct _MethBatch MethBatch;
+
+struct _MethBatch
+{
+  MethAln           *alns;
+  unsigned int       n_alns;
+
+  /* Names, reads and qualities of the alignments */
+  char              *buffer;
+  gsize              buffer_used;
+  gsize              buffer_size;
+
+  unsigned long int  n_chh_filtered;
+  unsigned long int  n_nqs_filtered;
+};
 
 typedef struct _CallbackData CallbackData;
 
@@ -46,12 +80,35 @@ struct _CallbackData
   SeqDB             *ref;
   RefMethCounts     *counts;
 
+  char              *read_buffer;
+  char              *qual_buffer;
+  unsigned int       buffer_size;
+
+  /* Merge mode */
+  FastqIter         *fastq_iter;
+  char             **next_fastq_path;
+  GHashTable        *lookahead;
+  GQueue            *lookahead_queue;
+  guint64            merge_n_reads;
+  guint64            merge_n_found;
+
+  /* Counting */
+  MethBatch         *batch;
+  MethBatch         *batch_pool;
+  GThreadPool       *pool;
+  GAsyncQueue       *free_batches;
+  int                n_batches;
+
   int                min_qual;
   int                max_chh;
   int                verbose;
   int                check_strand;
   int                print_letter;
   int                print_all;
+  int                packed;
+  int                threads;
+  int                merge;
+  int                max_lookahead;
 
   unsigned long int  n_chh_filtered;
   unsigned long int  n_bad_orientation;
@@ -63,6 +120,14 @@ struct _CallbackData
   unsigned int       nqs_neighbor_qual;
 };
 
+typedef struct _LookaheadRead LookaheadRead;
+
+struct _LookaheadRead
+{
+  FastqSeq *fastq;
+  guint64   index;
+};
+
 static void parse_args    (CallbackData      *data,
                            int               *argc,
                            char            ***argv);
@@ -74,6 +139,44 @@ static void map_data      (CallbackData      *data);
 static int  iter_bsq_func (BsqRecord         *rec,
                            CallbackData      *data);
 
+static MethBatch* get_batch (CallbackData *data);
+
+static gsize batch_append (MethBatch        *batch,
+                           const char       *buffer,
+                           gsize             size);
+
+static void submit_batch  (CallbackData      *data,
+                           MethBatch         *batch);
+
+static void count_batch   (MethBatch         *batch,
+                           CallbackData      *data);
+
+static void count_alignment (CallbackData    *data,
+                             MethBatch       *batch,
+                             MethAln         *aln);
+
+static MethBatch* new_batch (void);
+
+static void free_batch    (CallbackData      *data,
+                           MethBatch         *batch);
+
+static int  fetch_read    (CallbackData      *data,
+                           const char        *name,
+                           unsigned int      *read_size);
+
+static int  merge_read    (CallbackData      *data,
+                           const char        *name,
+                           unsigned int      *read_size);
+
+static FastqSeq* merge_next_fastq (CallbackData *data);
+
+static void free_lookahead_read (LookaheadRead *read);
+
+static void copy_read     (CallbackData      *data,
+                           const char        *seq,
+                           const char        *qual,
+                           unsigned int       size);
+
 static void cleanup_data  (CallbackData      *data);
 
 
@@ -144,6 +247,10 @@ parse_args (CallbackData      *data,
       {"fastq",     'f', 0, G_OPTION_ARG_FILENAME_ARRAY, &data->fastq_paths, "Fastq file(s)", NULL},
       {"out",       'o', 0, G_OPTION_ARG_FILENAME,       &data->output_path, "Output file", NULL},
       {"add",       'a', 0, G_OPTION_ARG_FILENAME,       &data->add_path,    "Add results to this file", NULL},
+      {"packed",    'p', 0, G_OPTION_ARG_NONE,           &data->packed,      "Pack the reads in memory (qualities are binned)", NULL},
+      {"threads",   0,   0, G_OPTION_ARG_INT,            &data->threads,     "Number of threads loading the reads and counting", NULL},
+      {"merge",     0,   0, G_OPTION_ARG_NONE,           &data->merge,       "Read the fastq files along the bsq files, which must list the reads in the same order", NULL},
+      {"lookahead", 0,   0, G_OPTION_ARG_INT,            &data->max_lookahead, "Number of fastq reads kept in merge mode to match reads out of order", NULL},
 
       /* Mapping options */
       {"min_qual",     'm', 0, G_OPTION_ARG_INT,  &data->min_qual,     "Minimum base quality", NULL},
@@ -175,6 +282,24 @@ parse_args (CallbackData      *data,
   data->verbose           = 0;
   data->print_letter      = 0;
   data->print_all         = 0;
+  data->packed            = 0;
+  data->threads           = 1;
+  data->merge             = 0;
+  data->max_lookahead     = 10000;
+  data->fastq_iter        = NULL;
+  data->next_fastq_path   = NULL;
+  data->lookahead         = NULL;
+  data->lookahead_queue   = NULL;
+  data->merge_n_reads     = 0;
+  data->merge_n_found     = 0;
+  data->batch             = NULL;
+  data->batch_pool        = NULL;
+  data->pool              = NULL;
+  data->free_batches      = NULL;
+  data->n_batches         = 0;
+  data->read_buffer       = NULL;
+  data->qual_buffer       = NULL;
+  data->buffer_size       = 0;
   data->trim_tag          = 0;
   data->n_chh_filtered    = 0;
   data->n_bad_orientation = 0;
@@ -226,31 +351,45 @@ static void
 load_data (CallbackData *data)
 {
   GError         *error = NULL;
-  char          **tmp;
 
-  data->ref   = seq_db_new ();
-  data->reads = seq_db_new ();
+  data->reads = NULL;
 
   if (data->verbose)
     g_print (">>> Loading Fasta\n");
-  seq_db_load_fasta (data->ref, data->ref_path, &error);
+  data->ref = seq_db_open_reference (data->ref_path, &error);
+  if (!error)
+    seq_db_load_all (data->ref, &error);
   if (error)
     {
       g_printerr ("[ERROR] Loading reference failed: %s\n", error->message);
       exit (1);
     }
+  data->counts = ref_meth_counts_create (data->ref);
+
+  /* The reads are read along the bsq files */
+  if (data->merge)
+    {
+      data->next_fastq_path = data->fastq_paths;
+      data->lookahead       = g_hash_table_new (g_str_hash, g_str_equal);
+      data->lookahead_queue = g_queue_new ();
+      return;
+    }
+
   if (data->verbose)
     g_print (">>> Loading Fastq\n");
-  for (tmp = data->fastq_paths; *tmp; tmp++)
+  data->reads = seq_db_new ();
+  if (data->packed)
+    seq_db_set_packed (data->reads);
+  seq_db_load_fastq_files (data->reads,
+                           data->fastq_paths,
+                           data->threads,
+                           &error);
+  if (error)
     {
-      seq_db_load_fastq (data->reads, *tmp, &error);
-      if (error)
-        {
-          g_printerr ("[ERROR] Loading reads failed: %s\n", error->message);
-          exit (1);
-        }
+      g_printerr ("[ERROR] Loading reads failed: %s\n", error->message);
+      exit (1);
     }
-  data->counts = ref_meth_counts_create (data->ref);
+  seq_db_index_reads (data->reads);
 }
 
 static int
@@ -277,153 +416,271 @@ iter_bsq_func (BsqRecord    *rec,
     }
   if (strand_ok)
     {
-      SeqDBElement *read_elem;
       SeqDBElement *ref_elem;
-      char         *read;
-      char         *qual;
-      char         *ref;
-      unsigned int  start_ref;
+      MethBatch    *batch;
+      MethAln      *aln;
       unsigned int  read_size;
-      unsigned int  i;
-      int           is_ref_rev = 0;
 
-      read_elem = g_hash_table_lookup (data->reads->index, rec->name);
-      if (!read_elem)
+      if (!fetch_read (data, rec->name, &read_size))
         {
           g_printerr ("[WARNING] Read `%s' not found\n", rec->name);
           return 1;
         }
-      ref_elem = g_hash_table_lookup (data->ref->index, rec->ref);
+      ref_elem = seq_db_lookup (data->ref, rec->ref);
       if (!ref_elem)
         {
           g_printerr ("[WARNING] Reference `%s' not found\n", rec->ref);
           return 1;
         }
 
-      start_ref = ref_elem->offset + rec->loc - 1;
-      read      = data->reads->seqs + read_elem->offset + data->trim_tag;
-      qual      = data->reads->quals + read_elem->offset + data->trim_tag;
-      ref       = data->ref->seqs + start_ref;
-      read_size = read_elem->size - data->trim_tag;
-
-      switch (rec->strand)
+      /* The alignments are counted by batches, possibly in other threads */
+      if (data->batch == NULL)
+        data->batch = get_batch (data);
+      batch          = data->batch;
+      aln            = batch->alns + batch->n_alns++;
+      aln->ref_elem  = ref_elem;
+      aln->start_ref = ref_elem->offset + rec->loc - 1;
+      aln->size      = read_size;
+      aln->strand    = rec->strand;
+      aln->name      = batch_append (batch, rec->name, name_len + 1);
+      aln->read      = batch_append (batch, data->read_buffer, read_size);
+      aln->qual      = batch_append (batch, data->qual_buffer, read_size);
+      if (batch->n_alns == METH_BATCH_SIZE)
         {
-          case BSQ_STRAND_W:
-              /* Dont reverse */
-              break;
-          case BSQ_STRAND_C:
-              /* Reverse ref */
-              ref = rev_comp_in_place (ref, read_size);
-              is_ref_rev = 1;
-              break;
-          case BSQ_STRAND_WC:
-              /* Reverse read */
-              read = rev_comp_in_place (read, read_size);
-              qual = rev_in_place (qual, read_size);
-              break;
-          case BSQ_STRAND_CC:
-              /* Reverse both read and ref */
-              ref  = rev_comp_in_place (ref, read_size);
-              qual = rev_in_place (qual, read_size);
-              read = rev_comp_in_place (read, read_size);
-              is_ref_rev = 1;
-              break;
-          default:
-              break;
+          submit_batch (data, batch);
+          data->batch = NULL;
         }
+    }
+  else
+    data->n_bad_orientation++;
+
+  return 1;
+}
+
+static MethBatch*
+get_batch (CallbackData *data)
+{
+  MethBatch *batch;
+
+  if (data->pool)
+    batch = g_async_queue_pop (data->free_batches);
+  else
+    batch = data->batch_pool;
+  data->n_chh_filtered += batch->n_chh_filtered;
+  data->n_nqs_filtered += batch->n_nqs_filtered;
+  batch->n_chh_filtered = 0;
+  batch->n_nqs_filtered = 0;
+  batch->n_alns         = 0;
+  batch->buffer_used    = 0;
+
+  return batch;
+}
+
+static gsize
+batch_append (MethBatch  *batch,
+              const char *buffer,
+              gsize       size)
+{
+  const gsize offset = batch->buffer_used;
+
+  if (batch->buffer_used + size > batch->buffer_size)
+    {
+      batch->buffer_size = MAX (2 * batch->buffer_size,
+                                batch->buffer_used + size);
+      batch->buffer      = g_realloc (batch->buffer, batch->buffer_size);
+    }
+  memcpy (batch->buffer + offset, buffer, size);
+  batch->buffer_used += size;
+
+  return offset;
+}
+
+static void
+submit_batch (CallbackData *data,
+              MethBatch    *batch)
+{
+  if (data->pool)
+    g_thread_pool_push (data->pool, batch, NULL);
+  else
+    count_batch (batch, data);
+}
+
+static void
+count_batch (MethBatch    *batch,
+             CallbackData *data)
+{
+  unsigned int i;
+
+  for (i = 0; i < batch->n_alns; i++)
+    count_alignment (data, batch, batch->alns + i);
+  if (data->pool)
+    g_async_queue_push (data->free_batches, batch);
+}
+
+/**
+ * Several workers may count the same positions, the counts are then
+ * incremented atomically.
+ */
+static inline void
+add_count (CallbackData *data,
+           unsigned int *count)
+{
+  if (data->pool)
+    g_atomic_int_inc ((gint*)count);
+  else
+    (*count)++;
+}
 
-      /* Dont take into account reads that have more than three consecutive CHH
-       * See Cokus et al, Nature, 2008.
-       */
-      if (data->max_chh > 0)
+/* Base i of the read, of its quality and of the reference, on the strand of
+ * the alignment */
+#define READ_AT(i) (read_table[(int)read[(long)(i) * read_step]])
+#define QUAL_AT(i) ((unsigned char)qual[(long)(i) * read_step])
+#define REF_AT(i)  (ref_table[(int)ref[(long)(i) * ref_step]])
+
+/**
+ * The reversed strands are read backwards through the complement table, so
+ * that neither the shared reference nor the read are modified.
+ */
+static void
+count_alignment (CallbackData *data,
+                 MethBatch    *batch,
+                 MethAln      *aln)
+{
+  MethCount         **meth_index;
+  const char         *read;
+  const char         *qual;
+  const char         *ref;
+  const char         *read_table = same_table;
+  const char         *ref_table  = same_table;
+  long                read_step  = 1;
+  long                ref_step   = 1;
+  const unsigned int  read_size  = aln->size;
+  unsigned int        i;
+  int                 is_ref_rev = 0;
+
+  meth_index = data->counts->meth_index + aln->start_ref;
+  ref        = data->ref->seqs + aln->start_ref;
+  read       = batch->buffer + aln->read;
+  qual       = batch->buffer + aln->qual;
+
+  switch (aln->strand)
+    {
+      case BSQ_STRAND_W:
+          /* Dont reverse */
+          break;
+      case BSQ_STRAND_C:
+          /* Reverse ref */
+          ref       += read_size - 1;
+          ref_step   = -1;
+          ref_table  = rev_table;
+          is_ref_rev = 1;
+          break;
+      case BSQ_STRAND_WC:
+          /* Reverse read */
+          read       += read_size - 1;
+          qual       += read_size - 1;
+          read_step   = -1;
+          read_table  = rev_table;
+          break;
+      case BSQ_STRAND_CC:
+          /* Reverse both read and ref */
+          ref        += read_size - 1;
+          ref_step    = -1;
+          ref_table   = rev_table;
+          read       += read_size - 1;
+          qual       += read_size - 1;
+          read_step   = -1;
+          read_table  = rev_table;
+          is_ref_rev  = 1;
+          break;
+      default:
+          break;
+    }
+
+  /* Dont take into account reads that have more than three consecutive CHH
+   * See Cokus et al, Nature, 2008.
+   */
+  if (data->max_chh > 0)
+    {
+      const unsigned int maxi = read_size - 2;
+      unsigned int       j;
+      unsigned int       n_chh = 0;
+
+      for (i = 0; i < maxi; i++)
         {
-          const unsigned int maxi = read_size - 2;
-          unsigned int       j;
-          unsigned int       n_chh = 0;
+          const unsigned int maxj = MIN (i + 9, read_size);
 
-          for (i = 0; i < maxi; i++)
+          n_chh = 0;
+          for (j = i; j < maxj; j++)
             {
-              const unsigned int maxj = MIN (i + 9, read_size);
-
-              n_chh = 0;
-              for (j = i; j < maxj; j++)
+              if (READ_AT (j) == 'C' && QUAL_AT (j) >= data->min_qual)
                 {
-                  if (read[j] == 'C' && qual[j] >= data->min_qual)
-                    {
-                      if (read[j + 1] != 'G' && read[j + 2] != 'G')
-                        n_chh++;
-                      else
-                        n_chh = 0;
-                    }
-                  if (n_chh == data->max_chh)
-                    {
-                      if (data->verbose)
-                        g_print ("CHH-filtered %s on %s\n",
-                                 read_elem->name,
-                                 ref_elem->name);
-                      data->n_chh_filtered++;
-                      goto reverse;
-                    }
+                  /* The bases past the end of the read are unknown */
+                  if ((j + 1 >= read_size || READ_AT (j + 1) != 'G') &&
+                      (j + 2 >= read_size || READ_AT (j + 2) != 'G'))
+                    n_chh++;
+                  else
+                    n_chh = 0;
+                }
+              if (n_chh == (unsigned int)data->max_chh)
+                {
+                  if (data->verbose)
+                    g_print ("CHH-filtered %s on %s\n",
+                             batch->buffer + aln->name,
+                             aln->ref_elem->name);
+                  batch->n_chh_filtered++;
+                  return;
                 }
             }
         }
+    }
 
-      /* No NQS */
-      if (data->nqs_each_side <= 0)
-        for (i = 0; i < read_size; i++)
+  /* No NQS */
+  if (data->nqs_each_side <= 0)
+    for (i = 0; i < read_size; i++)
+      {
+        if (REF_AT (i) == 'C')
           {
-            if (ref[i] == 'C')
+            if (QUAL_AT (i) >= data->min_qual)
               {
-                if (qual[i] >= data->min_qual)
-                  {
-                    unsigned int meth_idx;
-
-                    meth_idx = i;
-                    if (is_ref_rev)
-                      meth_idx = read_size - i - 1;
-                    if (read[i] == 'C')
-                      data->counts->meth_index[start_ref + meth_idx]->n_meth++;
-                    else if (read[i] == 'T')
-                      data->counts->meth_index[start_ref + meth_idx]->n_unmeth++;
-                  }
+                unsigned int meth_idx;
+
+                meth_idx = i;
+                if (is_ref_rev)
+                  meth_idx = read_size - i - 1;
+                if (READ_AT (i) == 'C')
+                  add_count (data, &meth_index[meth_idx]->n_meth);
+                else if (READ_AT (i) == 'T')
+                  add_count (data, &meth_index[meth_idx]->n_unmeth);
               }
           }
-      /* NQS */
-      else
-        {
-          const unsigned int start = data->nqs_each_side;
-          const unsigned int end   = read_size - data->nqs_each_side;
+      }
+  /* NQS */
+  else
+    {
+      const unsigned int start = data->nqs_each_side;
+      const unsigned int end   = read_size - data->nqs_each_side;
 
-          for (i = start; i < end; i++)
+      for (i = start; i < end; i++)
+        {
+          if (REF_AT (i) == 'C')
             {
-              if (ref[i] == 'C')
-                {
-                  unsigned int j;
-                  unsigned int mismatches = 0;
-                  int          good       = 1;
+              unsigned int j;
+              unsigned int mismatches = 0;
+              int          good       = 1;
 
-                  for (j = 1; j <= data->nqs_each_side; j++)
+              for (j = 1; j <= data->nqs_each_side; j++)
+                {
+                  /* Quality */
+                  if (QUAL_AT (i - j) < data->nqs_neighbor_qual ||
+                      QUAL_AT (i + j) < data->nqs_neighbor_qual)
                     {
-                      /* Quality */
-                      if (qual[i - j] < data->nqs_neighbor_qual ||
-                          qual[i + j] < data->nqs_neighbor_qual)
-                        {
-                          good = 0;
-                          break;
-                        }
-                      if (ref[i - j] == 'C')
-                        {
-                          if (read[i - j] != 'C' && read[i - j] != 'T')
-                            {
-                              ++mismatches;
-                              if (mismatches > data->nqs_mismatches)
-                                {
-                                  good = 0;
-                                  break;
-                                }
-                            }
-                        }
-                      else if (ref[i - j] != read[i - j])
+                      good = 0;
+                      break;
+                    }
+                  if (REF_AT (i - j) == 'C')
+                    {
+                      if (READ_AT (i - j) != 'C' && READ_AT (i - j) != 'T')
                         {
                           ++mismatches;
                           if (mismatches > data->nqs_mismatches)
@@ -432,19 +689,19 @@ iter_bsq_func (BsqRecord    *rec,
                               break;
                             }
                         }
-                      if (ref[i + j] == 'C')
+                    }
+                  else if (REF_AT (i - j) != READ_AT (i - j))
+                    {
+                      ++mismatches;
+                      if (mismatches > data->nqs_mismatches)
                         {
-                          if (read[i + j] != 'C' && read[i + j] != 'T')
-                            {
-                              ++mismatches;
-                              if (mismatches > data->nqs_mismatches)
-                                {
-                                  good = 0;
-                                  break;
-                                }
-                            }
+                          good = 0;
+                          break;
                         }
-                      else if (ref[i + j] != read[i + j])
+                    }
+                  if (REF_AT (i + j) == 'C')
+                    {
+                      if (READ_AT (i + j) != 'C' && READ_AT (i + j) != 'T')
                         {
                           ++mismatches;
                           if (mismatches > data->nqs_mismatches)
@@ -454,45 +711,237 @@ iter_bsq_func (BsqRecord    *rec,
                             }
                         }
                     }
-                  if (!good)
+                  else if (REF_AT (i + j) != READ_AT (i + j))
                     {
-                      data->n_nqs_filtered++;
-                      continue;
+                      ++mismatches;
+                      if (mismatches > data->nqs_mismatches)
+                        {
+                          good = 0;
+                          break;
+                        }
                     }
+                }
+              if (!good)
+                {
+                  batch->n_nqs_filtered++;
+                  continue;
+                }
 
-                  if (qual[i] >= data->min_qual)
-                    {
-                      unsigned int meth_idx;
-
-                      meth_idx = i;
-                      if (is_ref_rev)
-                        meth_idx = read_size - i - 1;
-                      if (read[i] == 'C')
-                        data->counts->meth_index[start_ref + meth_idx]->n_meth++;
-                      else if (read[i] == 'T')
-                        data->counts->meth_index[start_ref + meth_idx]->n_unmeth++;
-                    }
+              if (QUAL_AT (i) >= data->min_qual)
+                {
+                  unsigned int meth_idx;
+
+                  meth_idx = i;
+                  if (is_ref_rev)
+                    meth_idx = read_size - i - 1;
+                  if (READ_AT (i) == 'C')
+                    add_count (data, &meth_index[meth_idx]->n_meth);
+                  else if (READ_AT (i) == 'T')
+                    add_count (data, &meth_index[meth_idx]->n_unmeth);
                 }
             }
         }
-
-      /* Put the reference back into place
-       * Should not need to have the reads back in the right orientation ...
-       */
-reverse:
-      if (is_ref_rev)
-        ref  = rev_comp_in_place (ref, read_size);
     }
-  else
-    data->n_bad_orientation++;
+}
+
+#undef READ_AT
+#undef QUAL_AT
+#undef REF_AT
+
+/**
+ * Copies the read called name (without its tag) into the buffers, as the
+ * reads may be packed, and are reversed in place.
+ */
+static int
+fetch_read (CallbackData *data,
+            const char   *name,
+            unsigned int *read_size)
+{
+  SeqDBElement *read_elem;
+
+  if (data->merge)
+    return merge_read (data, name, read_size);
+
+  read_elem = seq_db_lookup (data->reads, name);
+  if (!read_elem)
+    return 0;
+  *read_size = read_elem->size - data->trim_tag;
+  copy_read (data, NULL, NULL, *read_size);
+  seq_db_get_window (data->reads,
+                     read_elem,
+                     data->trim_tag,
+                     *read_size,
+                     data->read_buffer,
+                     data->qual_buffer);
 
   return 1;
 }
 
+/**
+ * In merge mode, the last max_lookahead reads of the fastq files (at least
+ * one) are kept, in case they come later in the bsq files, or come again for
+ * reads aligned more than once.  The fastq files are never read further than
+ * max_lookahead reads past the last read found, so that a read missing from
+ * the fastq files cannot make the following reads fall out of the lookahead.
+ */
+static int
+merge_read (CallbackData *data,
+            const char   *name,
+            unsigned int *read_size)
+{
+  LookaheadRead *read;
+  FastqSeq      *fastq;
+  GList         *link;
+  const guint    max_queued = MAX (data->max_lookahead, 1);
+  guint64        max_index;
+
+  link = g_hash_table_lookup (data->lookahead, name);
+  if (link)
+    {
+      read       = link->data;
+      fastq      = read->fastq;
+      *read_size = fastq->size - data->trim_tag;
+      copy_read (data,
+                 fastq->seq + data->trim_tag,
+                 fastq->qual + data->trim_tag,
+                 *read_size);
+      data->merge_n_found = MAX (data->merge_n_found, read->index + 1);
+      return 1;
+    }
+
+  max_index = data->merge_n_found + MAX (data->max_lookahead, 0) + 1;
+  while (data->merge_n_reads < max_index)
+    {
+      fastq = merge_next_fastq (data);
+      if (fastq == NULL)
+        break;
+      /* The oldest read falls out of the lookahead, unless a later read
+       * with the same name replaced it in the hash table */
+      if (data->lookahead_queue->length >= max_queued)
+        {
+          link = data->lookahead_queue->head;
+          read = link->data;
+          if (g_hash_table_lookup (data->lookahead, read->fastq->name) == link)
+            g_hash_table_remove (data->lookahead, read->fastq->name);
+          g_queue_pop_head (data->lookahead_queue);
+          free_lookahead_read (read);
+        }
+      read        = g_slice_new (LookaheadRead);
+      read->fastq = fastq_seq_copy (fastq);
+      read->index = data->merge_n_reads - 1;
+      g_queue_push_tail (data->lookahead_queue, read);
+      /* The key must be the name of the newest read, as the older read
+       * with the same name, and its name, are freed first */
+      g_hash_table_replace (data->lookahead,
+                            read->fastq->name,
+                            data->lookahead_queue->tail);
+      if (strcmp (fastq->name, name) == 0)
+        {
+          *read_size = fastq->size - data->trim_tag;
+          copy_read (data,
+                     fastq->seq + data->trim_tag,
+                     fastq->qual + data->trim_tag,
+                     *read_size);
+          data->merge_n_found = data->merge_n_reads;
+          return 1;
+        }
+    }
+
+  return 0;
+}
+
+static void
+free_lookahead_read (LookaheadRead *read)
+{
+  fastq_seq_free (read->fastq);
+  g_slice_free (LookaheadRead, read);
+}
+
+/* The fastq files are read one after the other */
+static FastqSeq*
+merge_next_fastq (CallbackData *data)
+{
+  GError   *error = NULL;
+  FastqSeq *fastq;
+
+  while (1)
+    {
+      if (data->fastq_iter)
+        {
+          fastq = fastq_iter_next (data->fastq_iter);
+          if (fastq)
+            {
+              data->merge_n_reads++;
+              return fastq;
+            }
+          if (fastq_iter_get_error (data->fastq_iter, &error))
+            {
+              g_printerr ("[ERROR] Reading fastq file `%s' failed: %s\n",
+                          data->next_fastq_path[-1], error->message);
+              exit (1);
+            }
+          fastq_iter_free (data->fastq_iter);
+          data->fastq_iter = NULL;
+        }
+      if (*data->next_fastq_path == NULL)
+        return NULL;
+      data->fastq_iter = fastq_iter_new (*data->next_fastq_path, &error);
+      if (error)
+        {
+          g_printerr ("[ERROR] Loading fastq file `%s' failed: %s\n",
+                      *data->next_fastq_path, error->message);
+          exit (1);
+        }
+      data->next_fastq_path++;
+    }
+}
+
+static void
+copy_read (CallbackData *data,
+           const char   *seq,
+           const char   *qual,
+           unsigned int  size)
+{
+  if (size > data->buffer_size)
+    {
+      data->buffer_size = size;
+      data->read_buffer = g_realloc (data->read_buffer, size);
+      data->qual_buffer = g_realloc (data->qual_buffer, size);
+    }
+  if (seq)
+    memcpy (data->read_buffer, seq, size);
+  if (qual)
+    memcpy (data->qual_buffer, qual, size);
+}
+
 static void
 map_data (CallbackData *data)
 {
   char  **tmp;
+  int     i;
+
+  for (i = 0; i < 128; i++)
+    same_table[i] = i;
+
+  /* The bsq files are parsed in this thread, and the alignments counted by
+   * the workers */
+  if (data->threads > 1)
+    {
+      data->pool         = g_thread_pool_new ((GFunc)count_batch,
+                                              data,
+                                              data->threads,
+                                              TRUE,
+                                              NULL);
+      data->free_batches = g_async_queue_new ();
+      data->n_batches    = 4 * data->threads;
+      for (i = 0; i < data->n_batches; i++)
+        g_async_queue_push (data->free_batches, new_batch ());
+    }
+  else
+    {
+      data->batch_pool = new_batch ();
+      data->n_batches  = 1;
+    }
 
   for (tmp = data->bsq_paths; *tmp; tmp++)
     {
@@ -509,6 +958,48 @@ map_data (CallbackData *data)
           exit (1);
         }
     }
+
+  if (data->batch)
+    {
+      submit_batch (data, data->batch);
+      data->batch = NULL;
+    }
+  if (data->pool)
+    {
+      g_thread_pool_free (data->pool, FALSE, TRUE);
+      data->pool = NULL;
+      for (i = 0; i < data->n_batches; i++)
+        free_batch (data, g_async_queue_pop (data->free_batches));
+      g_async_queue_unref (data->free_batches);
+      data->free_batches = NULL;
+    }
+  else
+    {
+      free_batch (data, data->batch_pool);
+      data->batch_pool = NULL;
+    }
+}
+
+static MethBatch*
+new_batch (void)
+{
+  MethBatch *batch;
+
+  batch       = g_slice_new0 (MethBatch);
+  batch->alns = g_new (MethAln, METH_BATCH_SIZE);
+
+  return batch;
+}
+
+static void
+free_batch (CallbackData *data,
+            MethBatch    *batch)
+{
+  data->n_chh_filtered += batch->n_chh_filtered;
+  data->n_nqs_filtered += batch->n_nqs_filtered;
+  g_free (batch->alns);
+  g_free (batch->buffer);
+  g_slice_free (MethBatch, batch);
 }
 
 static void
@@ -526,6 +1017,15 @@ cleanup_data (CallbackData *data)
     g_free (data->output_path);
   if (data->counts)
     g_free (data->counts);
+  g_free (data->read_buffer);
+  g_free (data->qual_buffer);
+  if (data->fastq_iter)
+    fastq_iter_free (data->fastq_iter);
+  if (data->lookahead)
+    g_hash_table_destroy (data->lookahead);
+  if (data->lookahead_queue)
+    g_queue_free_full (data->lookahead_queue,
+                       (GDestroyNotify)free_lookahead_read);
   seq_db_free (data->ref);
   seq_db_free (data->reads);
 }
@@ -24,6 +24,7 @@
 #include <string.h>
 
 #include "ngs_bsq.h"
+#include "ngs_writer.h"
 
 typedef struct  _CallbackData CallbackData;
 
@@ -144,57 +145,66 @@ iter_func (BsqRecord    *rec,
 static void
 print_symmary (CallbackData *data)
 {
-  int i;
-  int j;
-  int k;
+  NgsWriter *writer;
+  GError    *error = NULL;
+  int       i;
+  int       j;
+  int       k;
+
+  writer = ngs_writer_new ("-", "w", &error);
+  if (error)
+    {
+      g_printerr ("[ERROR] Opening output failed: %s\n", error->message);
+      exit (1);
+    }
 
   if (data->mate_pairs)
     {
       for (i = 0; i < 2; i++)
         {
-          g_print ("* Counts for mate pairs %d:\n", i + 1);
+          ngs_writer_printf (writer, NULL, "* Counts for mate pairs %d:\n", i + 1);
           if (data->strands)
             {
               for (j = 0; j < BSQ_STRAND_NB; j++)
                 {
-                  g_print ("  + Counts for strand %s:\n", strand_names[j]);
+                  ngs_writer_printf (writer, NULL, "  + Counts for strand %s:\n", strand_names[j]);
                   for (k = 0; k < BSQ_MAP_FLAG_NB; k++)
-                    g_print ("    %s: %ld\n",
-                             map_flag_names[k],
-                             data->counts[i][j][k]);
+                    ngs_writer_printf (writer, NULL, "    %s: %ld\n",
+                                       map_flag_names[k],
+                                       data->counts[i][j][k]);
                 }
             }
           else
             {
-              g_print ("  + Counts for all strand\n");
+              ngs_writer_printf (writer, NULL, "  + Counts for all strand\n");
               for (k = 0; k < BSQ_MAP_FLAG_NB; k++)
-                g_print ("    %s: %ld\n",
-                         map_flag_names[k],
-                         data->counts[i][0][k]);
+                ngs_writer_printf (writer, NULL, "    %s: %ld\n",
+                                   map_flag_names[k],
+                                   data->counts[i][0][k]);
             }
         }
     }
   else
     {
-      g_print ("* Counts for all mate pairs\n");
+      ngs_writer_printf (writer, NULL, "* Counts for all mate pairs\n");
       if (data->strands)
         {
           for (j = 0; j < BSQ_STRAND_NB; j++)
             {
-              g_print ("  + Counts for strand %s:\n", strand_names[j]);
+              ngs_writer_printf (writer, NULL, "  + Counts for strand %s:\n", strand_names[j]);
               for (k = 0; k < BSQ_MAP_FLAG_NB; k++)
-                g_print ("    %s: %ld\n",
-                         map_flag_names[k],
-                         data->counts[0][j][k]);
+                ngs_writer_printf (writer, NULL, "    %s: %ld\n",
+                                   map_flag_names[k],
+                                   data->counts[0][j][k]);
             }
         }
       else
         {
-          g_print ("  + Counts for all strand\n");
+          ngs_writer_printf (writer, NULL, "  + Counts for all strand\n");
           for (k = 0; k < BSQ_MAP_FLAG_NB; k++)
-            g_print ("    %s: %ld\n",
-                     map_flag_names[k],
-                     data->counts[0][0][k]);
+            ngs_writer_printf (writer, NULL, "    %s: %ld\n",
+                               map_flag_names[k],
+                               data->counts[0][0][k]);
         }
     }
   if (data->good)
@@ -218,8 +228,14 @@ print_symmary (CallbackData *data)
         for (k = 0; k < BSQ_MAP_FLAG_NB; k++)
           t2 += data->counts[1][j][k];
 
-      g_print ("* Unique good reads on strand 1: %ld / %ld (%.2f)\n", g1, t1, (100. * g1) / t1);
-      g_print ("* Unique good reads on strand 2: %ld / %ld (%.2f)\n", g2, t2, (100. * g2) / t2);
+      ngs_writer_printf (writer, NULL, "* Unique good reads on strand 1: %ld / %ld (%.2f)\n", g1, t1, (100. * g1) / t1);
+      ngs_writer_printf (writer, NULL, "* Unique good reads on strand 2: %ld / %ld (%.2f)\n", g2, t2, (100. * g2) / t2);
+    }
+
+  if (!ngs_writer_close (writer, &error))
+    {
+      g_printerr ("[ERROR] Writing output failed: %s\n", error->message);
+      g_error_free (error);
     }
 }
 
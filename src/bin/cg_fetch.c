@@ -54,6 +54,8 @@ static void parse_args     (CallbackData      *data,
 
 static void load_ref       (CallbackData      *data);
 
+static void load_ref_names (CallbackData      *data);
+
 static void cleanup_data   (CallbackData      *data);
 
 static void process_coords (CallbackData      *data);
@@ -141,18 +143,16 @@ load_ref (CallbackData *data)
 {
   GError         *error = NULL;
 
-  data->ref   = seq_db_new ();
-
   if (data->verbose)
     g_print (">>> Loading reference %s\n", data->ref_path);
-  seq_db_load_fasta (data->ref,
-                     data->ref_path,
-                     &error);
+  data->ref = seq_db_open_reference (data->ref_path, &error);
   if (error)
     {
       g_printerr ("[ERROR] Loading reference failed: %s\n", error->message);
       exit (1);
     }
+  /* Only the sequences of the regions are read, and counted */
+  load_ref_names (data);
   if (data->verbose)
     g_print (">>> Loading CG file: %s\n", data->cg_path);
   data->counts = ref_meth_counts_load (data->ref,
@@ -167,35 +167,72 @@ load_ref (CallbackData *data)
     }
 }
 
+static void
+load_ref_names (CallbackData *data)
+{
+  GIOChannel  *input_channel;
+  GError      *error = NULL;
+  char        *line;
+  gsize        length;
+  gsize        endl;
+
+  if (data->name)
+    {
+      seq_db_lookup (data->ref, data->name);
+      return;
+    }
+
+  input_channel = g_io_channel_new_file (data->input_path, "r", &error);
+  if (error)
+    {
+      g_printerr ("[ERROR] failed to open input file `%s': %s\n",
+                  data->input_path,
+                  error->message);
+      exit (1);
+    }
+  while (G_IO_STATUS_NORMAL == g_io_channel_read_line (input_channel, &line, &length, &endl, &error))
+    {
+      line[endl] = '\0';
+      line[strcspn (line, " \t")] = '\0';
+      if (*line)
+        seq_db_lookup (data->ref, line);
+      g_free (line);
+    }
+  if (error)
+    {
+      g_printerr ("[ERROR] Reading input file `%s' failed: %s\n",
+                  data->input_path,
+                  error->message);
+      exit (1);
+    }
+  g_io_channel_shutdown (input_channel, FALSE, NULL);
+  g_io_channel_unref (input_channel);
+}
 
 static void
 process_coords (CallbackData *data)
 {
-  GIOChannel *output_channel;
-  GError     *error      = NULL;
-  int         use_stdout = 1;
+  NgsWriter  *output_writer;
+  GError     *error = NULL;
 
   /* Open */
-  if (!data->output_path || !*data->output_path || (data->output_path[0] == '-' && data->output_path[1] == '\0'))
-    output_channel = g_io_channel_unix_new (STDOUT_FILENO);
+  if (!data->output_path || !*data->output_path)
+    output_writer = ngs_writer_new ("-", "w", &error);
   else
+    output_writer = ngs_writer_new (data->output_path, "w", &error);
+  if (error)
     {
-      use_stdout     = 0;
-      output_channel = g_io_channel_new_file (data->output_path, "w", &error);
-      if (error)
-        {
-          g_printerr ("[ERROR] failed to open output file `%s': %s\n",
-                      data->output_path,
-                      error->message);
-          exit (1);
-        }
+      g_printerr ("[ERROR] failed to open output file `%s': %s\n",
+                  data->output_path,
+                  error->message);
+      exit (1);
     }
 
   if (data->name)
     {
       ref_meth_counts_write_segment (data->counts,
                                      data->ref,
-                                     output_channel,
+                                     output_writer,
                                      data->name,
                                      MAX (data->from, 0),
                                      MAX (data->to, 0) ,
@@ -247,7 +284,7 @@ process_coords (CallbackData *data)
               to   = g_ascii_strtoll (fields[2], NULL, 10);
               ref_meth_counts_write_segment (data->counts,
                                              data->ref,
-                                             output_channel,
+                                             output_writer,
                                              fields[0],
                                              MAX (from, 0),
                                              MAX (to, 0) ,
@@ -272,18 +309,13 @@ process_coords (CallbackData *data)
     }
 
   /* Close */
-  if (!use_stdout)
+  if (!ngs_writer_close (output_writer, &error))
     {
-      g_io_channel_shutdown (output_channel, TRUE, &error);
-      if (error)
-        {
-          g_printerr ("[ERROR] Closing output file `%s' failed: %s\n",
-                      data->output_path,
-                      error->message);
-          g_error_free (error);
-        }
+      g_printerr ("[ERROR] Closing output file `%s' failed: %s\n",
+                  data->output_path,
+                  error->message);
+      g_error_free (error);
     }
-  g_io_channel_unref (output_channel);
 }
 
 static void
@@ -149,13 +149,11 @@ load_ref (CallbackData *data)
 {
   GError         *error = NULL;
 
-  data->ref   = seq_db_new ();
-
   if (data->verbose)
     g_print (">>> Loading reference %s\n", data->ref_path);
-  seq_db_load_fasta (data->ref,
-                     data->ref_path,
-                     &error);
+  data->ref = seq_db_open_reference (data->ref_path, &error);
+  if (!error)
+    seq_db_load_all (data->ref, &error);
   if (error)
     {
       g_printerr ("[ERROR] Loading reference failed: %s\n", error->message);
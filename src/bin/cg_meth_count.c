@@ -140,13 +140,11 @@ load_data (CallbackData *data)
 {
   GError *error = NULL;
 
-  data->ref   = seq_db_new ();
-
   if (data->verbose)
     g_print (">>> Loading reference %s\n", data->ref_path);
-  seq_db_load_fasta (data->ref,
-                     data->ref_path,
-                     &error);
+  data->ref = seq_db_open_reference (data->ref_path, &error);
+  if (!error)
+    seq_db_load_all (data->ref, &error);
   if (error)
     {
       g_printerr ("[ERROR] Loading reference `%s' failed: %s\n",
@@ -172,11 +170,9 @@ static void
 count_cgs (CallbackData *data)
 {
   GHashTableIter  iter;
-  GIOChannel     *channel;
+  NgsWriter      *writer;
   SeqDBElement   *elem;
-  char           *buffer;
-  GError         *error      = NULL;
-  int             use_stdout = 1;
+  GError         *error = NULL;
 
   if (data->verbose)
     g_print (">>> Counting Cs, Gs and CpGs\n");
@@ -260,49 +256,39 @@ count_cgs (CallbackData *data)
         }
     }
 
-  if (data->output_path[0] == '-' && data->output_path[1] == '\0')
-    channel = g_io_channel_unix_new (STDOUT_FILENO);
-  else
+  writer = ngs_writer_new (data->output_path, "w", &error);
+  if (error)
     {
-      use_stdout = 0;
-      channel    = g_io_channel_new_file (data->output_path, "w", &error);
-      if (error)
-        {
-          g_printerr ("[ERROR] Opening output file `%s' failed: %s\n",
-                      data->output_path,
-                      error->message);
-          exit (1);
-        }
+      g_printerr ("[ERROR] Opening output file `%s' failed: %s\n",
+                  data->output_path,
+                  error->message);
+      exit (1);
     }
 
-  buffer = g_strdup_printf ("Methylated and unmethylated Cs and CpGs counts (min count = %d)\n"
-                            "  C   total  : %12ld\n"
-                            "  CpG total  : %12ld\n"
-                            "  CpG meth   : %12ld\n"
-                            "  CpG un-meth: %12ld\n"
-                            "  CHG total  : %12ld\n"
-                            "  CHG meth   : %12ld\n"
-                            "  CHG un-meth: %12ld\n"
-                            "  CHH total  : %12ld\n"
-                            "  CHH meth   : %12ld\n"
-                            "  CHH un-meth: %12ld\n",
-                            data->min_count,
-                            data->n_c,
-                            data->n_cpg,
-                            data->n_cpg_meth,
-                            data->n_cpg_unmeth,
-                            data->n_chg,
-                            data->n_chg_meth,
-                            data->n_chg_unmeth,
-                            data->n_chh,
-                            data->n_chh_meth,
-                            data->n_chh_unmeth);
-
-  g_io_channel_write_chars (channel,
-                            buffer,
-                            -1,
-                            NULL,
-                            &error);
+  ngs_writer_printf (writer,
+                     &error,
+                     "Methylated and unmethylated Cs and CpGs counts (min count = %d)\n"
+                     "  C   total  : %12ld\n"
+                     "  CpG total  : %12ld\n"
+                     "  CpG meth   : %12ld\n"
+                     "  CpG un-meth: %12ld\n"
+                     "  CHG total  : %12ld\n"
+                     "  CHG meth   : %12ld\n"
+                     "  CHG un-meth: %12ld\n"
+                     "  CHH total  : %12ld\n"
+                     "  CHH meth   : %12ld\n"
+                     "  CHH un-meth: %12ld\n",
+                     data->min_count,
+                     data->n_c,
+                     data->n_cpg,
+                     data->n_cpg_meth,
+                     data->n_cpg_unmeth,
+                     data->n_chg,
+                     data->n_chg_meth,
+                     data->n_chg_unmeth,
+                     data->n_chh,
+                     data->n_chh_meth,
+                     data->n_chh_unmeth);
   if (error)
     {
       g_printerr ("[ERROR] Writing to output file `%s' failed: %s\n",
@@ -311,21 +297,15 @@ count_cgs (CallbackData *data)
       g_error_free (error);
       error = NULL;
     }
-  g_free (buffer);
 
-  if (!use_stdout)
+  if (!ngs_writer_close (writer, &error))
     {
-      g_io_channel_shutdown (channel, TRUE, &error);
-      if (error)
-        {
-          g_printerr ("[ERROR] Closing output file `%s' failed: %s\n",
-                      data->output_path,
-                      error->message);
-          g_error_free (error);
-          error = NULL;
-        }
+      g_printerr ("[ERROR] Closing output file `%s' failed: %s\n",
+                  data->output_path,
+                  error->message);
+      g_error_free (error);
+      error = NULL;
     }
-  g_io_channel_unref (channel);
 }
 
 static void
@@ -179,13 +179,11 @@ load_data (CallbackData *data)
 {
   GError *error = NULL;
 
-  data->ref   = seq_db_new ();
-
   if (data->verbose)
     g_print (">>> Loading reference %s\n", data->ref_path);
-  seq_db_load_fasta (data->ref,
-                     data->ref_path,
-                     &error);
+  data->ref = seq_db_open_reference (data->ref_path, &error);
+  if (!error)
+    seq_db_load_all (data->ref, &error);
   if (error)
     {
       g_printerr ("[ERROR] Loading reference `%s' failed: %s\n",
@@ -211,16 +209,21 @@ static void
 write_ratios (CallbackData *data)
 {
   GHashTableIter  iter;
-  GIOChannel     *channel;
+  NgsWriter      *writer;
   SeqDBElement   *elem;
-  GString        *buffer;
-  GError         *error      = NULL;
-  int             use_stdout = 1;
+  GError         *error = NULL;
 
   if (data->verbose)
     g_print (">>> Writing ratios\n");
 
-  buffer = g_string_new (NULL);
+  writer = ngs_writer_new (data->output_path, "w", &error);
+  if (error)
+    {
+      g_printerr ("[ERROR] Opening output file `%s' failed: %s\n",
+                  data->output_path,
+                  error->message);
+      exit (1);
+    }
   g_hash_table_iter_init (&iter, data->ref->index);
   while (g_hash_table_iter_next (&iter, NULL, (gpointer*)&elem))
     {
@@ -229,7 +232,7 @@ write_ratios (CallbackData *data)
       guint64 i;
 
       if (data->print_header)
-        g_string_append_printf (buffer, ">%s\n", elem->name);
+        ngs_writer_printf (writer, NULL, ">%s\n", elem->name);
 
       maxi  = elem->offset + elem->size - 2;
       start = elem->offset + 2;
@@ -303,66 +306,47 @@ write_ratios (CallbackData *data)
               data->counts->meth_index[i]->n_meth + data->counts->meth_index[i]->n_unmeth >= data->min_count_tot)
             {
               if (data->print_position)
-                g_string_append_printf (buffer, "%lu\t", i - elem->offset);
+                ngs_writer_printf (writer, NULL, "%lu\t", i - elem->offset);
               if (data->meth_type == METH_CPG && data->sidebyside)
                 {
                   if (data->ratio)
-                    g_string_append_printf (buffer, "%.3f\t%.3f\n",
-                                            ((float)data->counts->meth_index[i]->n_meth) /
-                                            (data->counts->meth_index[i]->n_meth + data->counts->meth_index[i]->n_unmeth),
-                                            ((float)data->counts->meth_index[i + 1]->n_meth) /
-                                            (data->counts->meth_index[i + 1]->n_meth + data->counts->meth_index[i + 1]->n_unmeth));
+                    ngs_writer_printf (writer, NULL, "%.3f\t%.3f\n",
+                                       ((float)data->counts->meth_index[i]->n_meth) /
+                                       (data->counts->meth_index[i]->n_meth + data->counts->meth_index[i]->n_unmeth),
+                                       ((float)data->counts->meth_index[i + 1]->n_meth) /
+                                       (data->counts->meth_index[i + 1]->n_meth + data->counts->meth_index[i + 1]->n_unmeth));
                   else
-                    g_string_append_printf (buffer, "%d\t%d\t%d\t%d\n",
-                                            data->counts->meth_index[i]->n_meth,
-                                            data->counts->meth_index[i]->n_unmeth,
-                                            data->counts->meth_index[i + 1]->n_meth,
-                                            data->counts->meth_index[i + 1]->n_unmeth);
+                    ngs_writer_printf (writer, NULL, "%d\t%d\t%d\t%d\n",
+                                       data->counts->meth_index[i]->n_meth,
+                                       data->counts->meth_index[i]->n_unmeth,
+                                       data->counts->meth_index[i + 1]->n_meth,
+                                       data->counts->meth_index[i + 1]->n_unmeth);
                 }
               else if (data->meth_type == METH_CPG && data->merge)
                 {
                   if (data->ratio)
-                    g_string_append_printf (buffer, "%.3f\n",
-                                            ((float)(data->counts->meth_index[i]->n_meth + data->counts->meth_index[i + 1]->n_meth)) /
-                                            (data->counts->meth_index[i]->n_meth + data->counts->meth_index[i]->n_unmeth +
-                                             data->counts->meth_index[i + 1]->n_meth + data->counts->meth_index[i + 1]->n_unmeth));
+                    ngs_writer_printf (writer, NULL, "%.3f\n",
+                                       ((float)(data->counts->meth_index[i]->n_meth + data->counts->meth_index[i + 1]->n_meth)) /
+                                       (data->counts->meth_index[i]->n_meth + data->counts->meth_index[i]->n_unmeth +
+                                        data->counts->meth_index[i + 1]->n_meth + data->counts->meth_index[i + 1]->n_unmeth));
                   else
-                    g_string_append_printf (buffer, "%d\t%d\n",
-                                            data->counts->meth_index[i]->n_meth + data->counts->meth_index[i + 1]->n_meth,
-                                            data->counts->meth_index[i]->n_unmeth + data->counts->meth_index[i + 1]->n_unmeth);
+                    ngs_writer_printf (writer, NULL, "%d\t%d\n",
+                                       data->counts->meth_index[i]->n_meth + data->counts->meth_index[i + 1]->n_meth,
+                                       data->counts->meth_index[i]->n_unmeth + data->counts->meth_index[i + 1]->n_unmeth);
                 }
               else if (data->ratio)
-                g_string_append_printf (buffer, "%.3f\n",
-                                        ((float)data->counts->meth_index[i]->n_meth) /
-                                        (data->counts->meth_index[i]->n_meth + data->counts->meth_index[i]->n_unmeth));
+                ngs_writer_printf (writer, NULL, "%.3f\n",
+                                   ((float)data->counts->meth_index[i]->n_meth) /
+                                   (data->counts->meth_index[i]->n_meth + data->counts->meth_index[i]->n_unmeth));
               else
-                g_string_append_printf (buffer, "%d\t%d\n",
-                                        data->counts->meth_index[i]->n_meth,
-                                        data->counts->meth_index[i]->n_unmeth);
+                ngs_writer_printf (writer, NULL, "%d\t%d\n",
+                                   data->counts->meth_index[i]->n_meth,
+                                   data->counts->meth_index[i]->n_unmeth);
             }
         }
     }
 
-  if (data->output_path[0] == '-' && data->output_path[1] == '\0')
-    channel = g_io_channel_unix_new (STDOUT_FILENO);
-  else
-    {
-      use_stdout = 0;
-      channel    = g_io_channel_new_file (data->output_path, "w", &error);
-      if (error)
-        {
-          g_printerr ("[ERROR] Opening output file `%s' failed: %s\n",
-                      data->output_path,
-                      error->message);
-          exit (1);
-        }
-    }
-  g_io_channel_write_chars (channel,
-                            buffer->str,
-                            -1,
-                            NULL,
-                            &error);
-  if (error)
+  if (!ngs_writer_close (writer, &error))
     {
       g_printerr ("[ERROR] Writing to output file `%s' failed: %s\n",
                   data->output_path,
@@ -370,21 +354,6 @@ write_ratios (CallbackData *data)
       g_error_free (error);
       error = NULL;
     }
-  g_string_free (buffer, TRUE);
-
-  if (!use_stdout)
-    {
-      g_io_channel_shutdown (channel, TRUE, &error);
-      if (error)
-        {
-          g_printerr ("[ERROR] Closing output file `%s' failed: %s\n",
-                      data->output_path,
-                      error->message);
-          g_error_free (error);
-          error = NULL;
-        }
-    }
-  g_io_channel_unref (channel);
 }
 
 static void
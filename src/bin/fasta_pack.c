@@ -0,0 +1,111 @@
+/* Copyright (C) 2010  Sylvain FORET
+ *
+ * This file is part of libngs.
+ *
+ * libngs is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *                                                                       
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *                                                                       
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ *
+ */
+
+#include <stdlib.h>
+
+#include "ngs_fasta.h"
+#include "ngs_seq_db.h"
+
+typedef struct _CallbackData CallbackData;
+
+struct _CallbackData
+{
+  char *input_path;
+  char *output_path;
+};
+
+static void parse_args (CallbackData   *data,
+                        int            *argc,
+                        char         ***argv);
+
+int
+main (int    argc,
+      char **argv)
+{
+  CallbackData data;
+  SeqDB       *db;
+  GError      *error = NULL;
+
+  parse_args (&data, &argc, &argv);
+
+  db = seq_db_new ();
+  seq_db_load_fasta (db, data.input_path, &error);
+  if (error)
+    {
+      g_printerr ("[ERROR] Loading sequences failed: %s\n", error->message);
+      g_error_free (error);
+      return 1;
+    }
+  if (!seq_db_save (db, data.output_path, &error))
+    {
+      g_printerr ("[ERROR] Writing SeqDB image failed: %s\n", error->message);
+      g_error_free (error);
+      return 1;
+    }
+  seq_db_free (db);
+  g_free (data.output_path);
+
+  return 0;
+}
+
+static void
+parse_args (CallbackData   *data,
+            int            *argc,
+            char         ***argv)
+{
+  GOptionEntry entries[] =
+    {
+      {"out", 'o', 0, G_OPTION_ARG_FILENAME, &data->output_path, "Output file (FILE" SEQ_DB_SUFFIX " by default)", NULL},
+      {NULL}
+    };
+  GError         *error = NULL;
+  GOptionContext *context;
+
+  data->output_path = NULL;
+
+  context = g_option_context_new ("FILE - Saves a fasta file as an image that the other tools map instead of parsing");
+  g_option_context_add_group (context, get_fasta_option_group ());
+  g_option_context_add_main_entries (context, entries, NULL);
+  if (!g_option_context_parse (context, argc, argv, &error))
+    {
+      g_printerr ("[ERROR] Option parsing failed: %s\n", error->message);
+      exit (1);
+    }
+  g_option_context_free (context);
+
+  if (*argc < 2)
+    {
+      g_printerr ("[ERROR] No input file provided\n");
+      exit (1);
+    }
+  data->input_path = (*argv)[1];
+
+  if (data->output_path)
+    data->output_path = g_strdup (data->output_path);
+  else if (data->input_path[0] == '-' && data->input_path[1] == '\0')
+    data->output_path = g_strdup ("-");
+  else
+    data->output_path = g_strconcat (data->input_path, SEQ_DB_SUFFIX, NULL);
+}
+
+/* vim:ft=c:expandtab:sw=4:ts=4:sts=4:cinoptions={.5s^-2n-2(0:
+ */
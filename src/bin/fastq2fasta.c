@@ -24,6 +24,7 @@
 #include <unistd.h>
 
 #include "ngs_fastq.h"
+#include "ngs_writer.h"
 
 typedef struct _CallbackData CallbackData;
 
@@ -32,14 +33,11 @@ struct _CallbackData
   char       *input_path;
   char       *out_seq_path;
   char       *out_qual_path;
-  GIOChannel *out_seq_channel;
-  GIOChannel *out_qual_channel;
+  NgsWriter  *out_seq_writer;
+  NgsWriter  *out_qual_writer;
 
   int         do_seq;
   int         do_qual;
-
-  int         seq_use_stdout: 1;
-  int         qual_use_stdout: 1;
 };
 
 static int  iter_func  (FastqSeq       *fastq,
@@ -69,33 +67,17 @@ main (int    argc,
       error = NULL;
     }
 
-  if (data.out_seq_channel)
+  if (data.out_seq_writer && !ngs_writer_close (data.out_seq_writer, &error))
     {
-      if (!data.seq_use_stdout)
-        {
-          g_io_channel_shutdown (data.out_seq_channel, TRUE, &error);
-          if (error)
-            {
-              g_printerr ("[ERROR] Closing sequence output file failed: %s\n", error->message);
-              g_error_free (error);
-              error = NULL;
-            }
-        }
-      g_io_channel_unref (data.out_seq_channel);
+      g_printerr ("[ERROR] Closing sequence output file failed: %s\n", error->message);
+      g_error_free (error);
+      error = NULL;
     }
-  if (data.out_qual_channel)
+  if (data.out_qual_writer && !ngs_writer_close (data.out_qual_writer, &error))
     {
-      if (!data.qual_use_stdout)
-        {
-          g_io_channel_shutdown (data.out_qual_channel, TRUE, &error);
-          if (error)
-            {
-              g_printerr ("[ERROR] Closing quality output file failed: %s\n", error->message);
-              g_error_free (error);
-              error = NULL;
-            }
-        }
-      g_io_channel_unref (data.out_qual_channel);
+      g_printerr ("[ERROR] Closing quality output file failed: %s\n", error->message);
+      g_error_free (error);
+      error = NULL;
     }
 
   return 0;
@@ -121,10 +103,8 @@ parse_args (CallbackData   *data,
   data->do_qual          = 0;
   data->out_seq_path     = "-";
   data->out_qual_path    = NULL;
-  data->out_seq_channel  = NULL;
-  data->out_qual_channel = NULL;
-  data->seq_use_stdout   = 1;
-  data->qual_use_stdout  = 0;
+  data->out_seq_writer   = NULL;
+  data->out_qual_writer  = NULL;
 
   context = g_option_context_new ("FILE - Converts a fastq file to a fasta file");
   g_option_context_add_group (context, get_fastq_option_group ());
@@ -157,38 +137,20 @@ parse_args (CallbackData   *data,
 
   if (data->do_seq)
     {
-      if (data->out_seq_path[0] == '-' && data->out_seq_path[1] == '\0')
-        {
-          data->seq_use_stdout  = 1;
-          data->out_seq_channel = g_io_channel_unix_new (STDOUT_FILENO);
-        }
-      else
+      data->out_seq_writer = ngs_writer_new (data->out_seq_path, "w", &error);
+      if (error)
         {
-          data->seq_use_stdout  = 0;
-          data->out_seq_channel = g_io_channel_new_file (data->out_seq_path, "w", &error);
-          if (error)
-            {
-              g_printerr ("[ERROR] Opening sequence output file failed: %s\n", error->message);
-              exit (1);
-            }
+          g_printerr ("[ERROR] Opening sequence output file failed: %s\n", error->message);
+          exit (1);
         }
     }
   if (data->do_qual)
     {
-      if (data->out_qual_path[0] == '-' && data->out_qual_path[1] == '\0')
-        {
-          data->qual_use_stdout  = 1;
-          data->out_qual_channel = g_io_channel_unix_new (STDOUT_FILENO);
-        }
-      else
+      data->out_qual_writer = ngs_writer_new (data->out_qual_path, "w", &error);
+      if (error)
         {
-          data->qual_use_stdout  = 0;
-          data->out_qual_channel = g_io_channel_new_file (data->out_qual_path, "w", &error);
-          if (error)
-            {
-              g_printerr ("[ERROR] Opening quality output file failed: %s\n", error->message);
-              exit (1);
-            }
+          g_printerr ("[ERROR] Opening quality output file failed: %s\n", error->message);
+          exit (1);
         }
     }
 }
@@ -202,20 +164,12 @@ iter_func (FastqSeq     *fastq,
 
   if (data->do_seq)
     {
-      GString *buffer;
-
-      buffer = g_string_sized_new (512);
-      buffer = g_string_append_c (buffer, '>');
-      buffer = g_string_append (buffer, fastq->name);
-      buffer = g_string_append_c (buffer, '\n');
-      buffer = g_string_append_len (buffer, fastq->seq, fastq->size);
-      buffer = g_string_append_c (buffer, '\n');
-
-      g_io_channel_write_chars (data->out_seq_channel,
-                                buffer->str,
-                                -1,
-                                NULL,
-                                &error);
+      ngs_writer_append_fasta (data->out_seq_writer,
+                               fastq->name,
+                               fastq->seq,
+                               fastq->size,
+                               0,
+                               &error);
       if (error)
         {
           g_printerr ("[ERROR] Writing sequence failed: %s\n", error->message);
@@ -223,26 +177,18 @@ iter_func (FastqSeq     *fastq,
           error = NULL;
           ret   = 0;
         }
-      g_string_free (buffer, TRUE);
     }
   if (data->do_qual)
     {
-      GString *buffer;
-      int      i;
+      NgsWriter *writer = data->out_qual_writer;
+      int        i;
 
-      buffer = g_string_sized_new (512);
-      buffer = g_string_append_c (buffer, '>');
-      buffer = g_string_append (buffer, fastq->name);
-      buffer = g_string_append_c (buffer, '\n');
+      ngs_writer_putc (writer, '>', NULL);
+      ngs_writer_write (writer, fastq->name, -1, NULL);
+      ngs_writer_putc (writer, '\n', NULL);
       for (i = 0; i < fastq->size; i++)
-        buffer = g_string_append (buffer, fastq_qual_char_2_string[(int)fastq->qual[i]]);
-      buffer = g_string_append_c (buffer, '\n');
-
-      g_io_channel_write_chars (data->out_qual_channel,
-                                buffer->str,
-                                -1,
-                                NULL,
-                                &error);
+        ngs_writer_write (writer, fastq_qual_char_2_string[(int)fastq->qual[i]], -1, NULL);
+      ngs_writer_putc (writer, '\n', &error);
       if (error)
         {
           g_printerr ("[ERROR] Writing quality failed: %s\n", error->message);
@@ -250,7 +196,6 @@ iter_func (FastqSeq     *fastq,
           error = NULL;
           ret   = 0;
         }
-      g_string_free (buffer, TRUE);
     }
 
   return ret;
@@ -32,21 +32,21 @@ struct _CallbackData
 {
   char       *input_path;
   char       *output_path;
-  GIOChannel *output_channel;
+  NgsWriter  *output_writer;
 
   char       *qual0;
   int         qual_max;
   int         delta_qual;
   int         qual_name;
   int         old_pairs;
-
-  int         use_stdout;
+  int         threads;
 
   char        qual0c;
   char        qual_maxc;
 };
 
 static int  iter_func  (FastqSeq       *fastq,
+                        GString        *buffer,
                         CallbackData   *data);
 
 static void parse_args (CallbackData   *data,
@@ -62,10 +62,13 @@ main (int    argc,
 
   parse_args (&data, &argc, &argv);
 
-  iter_fastq (data.input_path,
-              (FastqIterFunc)iter_func,
-              &data,
-              &error);
+  iter_fastq_parallel (data.input_path,
+                       (FastqParallelFunc)iter_func,
+                       &data,
+                       data.threads,
+                       1,
+                       data.output_writer,
+                       &error);
   if (error)
     {
       g_printerr ("[ERROR] Iterating sequences failed: %s\n", error->message);
@@ -73,19 +76,11 @@ main (int    argc,
       error = NULL;
     }
 
-  if (data.output_channel)
+  if (!ngs_writer_close (data.output_writer, &error))
     {
-      if (!data.use_stdout)
-        {
-          g_io_channel_shutdown (data.output_channel, TRUE, &error);
-          if (error)
-            {
-              g_printerr ("[ERROR] Closing sequence output file failed: %s\n", error->message);
-              g_error_free (error);
-              error = NULL;
-            }
-        }
-      g_io_channel_unref (data.output_channel);
+      g_printerr ("[ERROR] Closing sequence output file failed: %s\n", error->message);
+      g_error_free (error);
+      error = NULL;
     }
 
   return 0;
@@ -103,20 +98,21 @@ parse_args (CallbackData   *data,
       {"qual_max",     'Q', 0, G_OPTION_ARG_INT,      &data->qual_max,    "Maximum quality value",                       NULL},
       {"qual_name",    'n', 0, G_OPTION_ARG_NONE,     &data->qual_name,   "Write the full name before the quality line", NULL},
       {"old_pairs",    'p', 0, G_OPTION_ARG_NONE,     &data->old_pairs,   "Convert new pair format to old format",       NULL},
+      {"threads",      't', 0, G_OPTION_ARG_INT,      &data->threads,     "Number of threads",                           NULL},
       {NULL}
     };
   GError         *error = NULL;
   GOptionContext *context;
 
   data->output_path    = NULL;
-  data->output_channel = NULL;
+  data->output_writer  = NULL;
   data->qual0          = NULL;
   data->qual0c         = fastq_qual0;
   data->qual_max       = -1;
   data->qual_maxc      = fastq_qual0 + 40;
   data->qual_name      = 0;
   data->old_pairs      = 0;
-  data->use_stdout     = 0;
+  data->threads        = 1;
 
   context = g_option_context_new ("FILE - Converts between various flavours of fastq formats");
   g_option_context_add_group (context, get_fastq_option_group ());
@@ -153,30 +149,19 @@ parse_args (CallbackData   *data,
   if (!data->output_path)
     data->output_path = g_strdup ("-");
 
-  if (data->output_path[0] == '-' && data->output_path[1] == '\0')
-    {
-      data->use_stdout     = 1;
-      data->output_channel = g_io_channel_unix_new (STDOUT_FILENO);
-    }
-  else
+  data->output_writer = ngs_writer_new (data->output_path, "w", &error);
+  if (error)
     {
-      data->output_channel = g_io_channel_new_file (data->output_path, "w", &error);
-      if (error)
-        {
-          g_printerr ("[ERROR] Opening sequence output file failed: %s\n", error->message);
-          exit (1);
-        }
+      g_printerr ("[ERROR] Opening sequence output file failed: %s\n", error->message);
+      exit (1);
     }
 }
 
 static int
 iter_func (FastqSeq     *fastq,
+           GString      *buffer,
            CallbackData *data)
 {
-  GString *buffer;
-  GError  *error = NULL;
-  int      ret   = 1;
-
   /* A rather hugly hack to change the name in place */
   if (data->old_pairs)
     {
@@ -226,7 +211,6 @@ iter_func (FastqSeq     *fastq,
           fastq->qual[i] = data->qual_maxc;
     }
 
-  buffer = g_string_sized_new (512);
   buffer = g_string_append_c (buffer, '@');
   buffer = g_string_append (buffer, fastq->name);
   buffer = g_string_append_c (buffer, '\n');
@@ -238,21 +222,7 @@ iter_func (FastqSeq     *fastq,
   buffer = g_string_append (buffer, fastq->qual);
   buffer = g_string_append_c (buffer, '\n');
 
-  g_io_channel_write_chars (data->output_channel,
-                            buffer->str,
-                            -1,
-                            NULL,
-                            &error);
-  if (error)
-    {
-      g_printerr ("[ERROR] Writing sequence failed: %s\n", error->message);
-      g_error_free (error);
-      error = NULL;
-      ret   = 0;
-    }
-  g_string_free (buffer, TRUE);
-
-  return ret;
+  return 1;
 }
 
 /* vim:ft=c:expandtab:sw=4:ts=4:sts=4:cinoptions={.5s^-2n-2(0:
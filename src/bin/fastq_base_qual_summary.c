@@ -24,6 +24,7 @@
 #include <unistd.h>
 
 #include "ngs_fastq.h"
+#include "ngs_writer.h"
 
 
 /* TODO allocate this dynamically to enable qualities larger than 60 */
@@ -36,6 +37,8 @@ struct _CallbackData
   unsigned long int  qual[N_QUAL];
 
   char              *input_path;
+
+  int                threads;
 };
 
 static void parse_args (CallbackData      *data,
@@ -49,6 +52,9 @@ static void init_qual  (CallbackData      *data);
 
 static void print_qual (CallbackData      *data);
 
+static void iter_parts (CallbackData      *data,
+                        GError           **error);
+
 int
 main (int    argc,
       char **argv)
@@ -58,10 +64,7 @@ main (int    argc,
 
   parse_args (&data, &argc, &argv);
 
-  iter_fastq (data.input_path,
-              (FastqIterFunc)iter_func,
-              &data,
-              &error);
+  iter_parts (&data, &error);
 
   if (error)
     {
@@ -84,11 +87,14 @@ parse_args (CallbackData      *data,
   GOptionEntry entries[] =
     {
       /*{"fast", 'f', 0, G_OPTION_ARG_NONE, &data->fast, "Faster and less robust method (use at your own risk)", NULL},*/
+      {"threads", 't', 0, G_OPTION_ARG_INT, &data->threads, "Number of threads", NULL},
       {NULL}
     };
   GError         *error = NULL;
   GOptionContext *context;
 
+  data->threads = 1;
+
   context = g_option_context_new ("FILE - Computes distribution of the base qualities");
   g_option_context_add_group (context, get_fastq_option_group ());
   g_option_context_add_main_entries (context, entries, NULL);
@@ -130,14 +136,66 @@ init_qual (CallbackData *data)
     data->qual[i] = 0;
 }
 
+/**
+ * Each thread counts the qualities of its part of the file, the counts are
+ * then added up
+ */
+static void
+iter_parts (CallbackData  *data,
+            GError       **error)
+{
+  CallbackData  *parts;
+  void         **parts_data;
+  int            i;
+  int            j;
+
+  if (data->threads < 1)
+    data->threads = 1;
+  parts      = g_new (CallbackData, data->threads);
+  parts_data = g_new (void*, data->threads);
+  for (i = 0; i < data->threads; i++)
+    {
+      parts[i]      = *data;
+      parts_data[i] = parts + i;
+    }
+
+  iter_fastq_ranges (data->input_path,
+                     (FastqIterFunc)iter_func,
+                     parts_data,
+                     data->threads,
+                     error);
+
+  for (i = 0; i < data->threads; i++)
+    for (j = 0; j < N_QUAL; j++)
+      data->qual[j] += parts[i].qual[j];
+
+  g_free (parts_data);
+  g_free (parts);
+}
+
 static void
 print_qual (CallbackData *data)
 {
-  int i;
+  NgsWriter *writer;
+  GError    *error = NULL;
+  int       i;
+
+  writer = ngs_writer_new ("-", "w", &error);
+  if (error)
+    {
+      g_printerr ("[ERROR] Opening output failed: %s\n", error->message);
+      exit (1);
+    }
 
   for (i = 0; i < N_QUAL; i++)
-    g_print ("%d\t%ld\n",
-             i, data->qual[i]);
+    ngs_writer_printf (writer, NULL, "%d\t%ld\n",
+                       i, data->qual[i]);
+
+  if (!ngs_writer_close (writer, &error))
+    {
+      g_printerr ("[ERROR] Writing output failed: %s\n", error->message);
+      g_error_free (error);
+    }
 }
 
 /* vim:ft=c:expandtab:sw=4:ts=4:sts=4:cinoptions={.5s^-2n-2(0:
@@ -24,6 +24,8 @@
 #include <unistd.h>
 
 #include "ngs_fastq.h"
+#include "ngs_fqindex.h"
+#include "ngs_readstore.h"
 
 typedef struct _CallbackData CallbackData;
 
@@ -47,6 +49,13 @@ static void parse_args     (CallbackData   *data,
 
 static void load_queries   (CallbackData   *data);
 
+static void fetch_indexed  (CallbackData   *data,
+                            FqIndex        *index,
+                            GError        **error);
+
+static void fetch_store    (CallbackData   *data,
+                            GError        **error);
+
 static void print_querries (CallbackData   *data);
 
 static void free_querries  (CallbackData   *data);
@@ -56,14 +65,24 @@ main (int    argc,
       char **argv)
 {
   CallbackData data;
+  FqIndex     *index;
   GError      *error = NULL;
 
   parse_args (&data, &argc, &argv);
 
-  iter_fastq (data.input_path,
-              (FastqIterFunc)iter_func,
-              &data,
-              &error);
+  /* Seek to the records if the file has been indexed with fastq_fqindex */
+  if (read_store_check (data.input_path))
+    fetch_store (&data, &error);
+  else if ((index = fq_index_find (data.input_path)) != NULL)
+    {
+      fetch_indexed (&data, index, &error);
+      fq_index_free (index);
+    }
+  else
+    iter_fastq (data.input_path,
+                (FastqIterFunc)iter_func,
+                &data,
+                &error);
   if (error)
     {
       g_printerr ("[ERROR] Iterating sequences failed: %s\n", error->message);
@@ -184,33 +203,103 @@ static int
 iter_func (FastqSeq     *fastq,
            CallbackData *data)
 {
-  if (g_hash_table_lookup_extended (data->querries_hash, fastq->name, NULL, NULL))
-    g_hash_table_insert (data->querries_hash, fastq->name, fastq_seq_copy (fastq));
+  FastqSeq *seq;
+
+  if (g_hash_table_lookup_extended (data->querries_hash, fastq->name, NULL, (gpointer*)&seq))
+    {
+      /* The original key is kept, the name of fastq is only borrowed */
+      if (seq)
+        fastq_seq_detach (fastq, seq);
+      else
+        g_hash_table_insert (data->querries_hash, fastq->name, fastq_seq_detach (fastq, NULL));
+    }
 
   return 1;
 }
 
+static void
+fetch_indexed (CallbackData  *data,
+               FqIndex       *index,
+               GError       **error)
+{
+  FqIndexReader  *reader;
+  char          **tmp;
+
+  reader = fq_index_reader_new (index, data->input_path, error);
+  if (reader == NULL)
+    return;
+
+  for (tmp = data->querries_array; *tmp; tmp++)
+    {
+      FastqSeq *fastq;
+
+      if (**tmp == '\0' || g_hash_table_lookup (data->querries_hash, *tmp))
+        continue;
+      fastq = fq_index_reader_fetch (reader, *tmp, error);
+      if (fastq)
+        g_hash_table_insert (data->querries_hash, *tmp, fastq_seq_detach (fastq, NULL));
+      else if (error && *error)
+        break;
+    }
+  fq_index_reader_free (reader);
+}
+
+/**
+ * Only the names of the blocks of a read store are decoded, and the whole
+ * records only for the blocks that contain some of the querries.
+ */
+static void
+fetch_store (CallbackData  *data,
+             GError       **error)
+{
+  ReadStore *store;
+  guint      n_blocks;
+  guint      i;
+
+  store = read_store_open (data->input_path, error);
+  if (store == NULL)
+    return;
+
+  n_blocks = read_store_n_blocks (store);
+  for (i = 0; i < n_blocks; i++)
+    {
+      ReadStoreIter *iter;
+      FastqSeq      *fastq;
+      int            found = 0;
+
+      iter = read_store_iter_new (store, i, i + 1, FASTQ_COLUMN_NAME);
+      while (!found && (fastq = read_store_iter_next (iter, error)) != NULL)
+        found = g_hash_table_lookup_extended (data->querries_hash, fastq->name, NULL, NULL);
+      read_store_iter_free (iter);
+      if (error && *error)
+        break;
+      if (!found)
+        continue;
+
+      iter = read_store_iter_new (store, i, i + 1, FASTQ_COLUMN_ALL);
+      while ((fastq = read_store_iter_next (iter, error)) != NULL)
+        iter_func (fastq, data);
+      read_store_iter_free (iter);
+      if (error && *error)
+        break;
+    }
+  read_store_close (store);
+}
+
 static void
 print_querries (CallbackData *data)
 {
-  GIOChannel *channel;
+  NgsWriter  *writer;
   char      **tmp;
-  GError     *error      = NULL;
-  int         use_stdout = 1;
+  GError     *error = NULL;
 
-  if (data->output_path[0] == '-' && data->output_path[1] == '\0')
-    channel = g_io_channel_unix_new (STDOUT_FILENO);
-  else
+  writer = ngs_writer_new (data->output_path, "w", &error);
+  if (error)
     {
-      use_stdout = 0;
-      channel    = g_io_channel_new_file (data->output_path, "w", &error);
-      if (error)
-        {
-          g_printerr ("[ERROR] Opening output file `%s' failed: %s\n",
-                      data->output_path,
-                      error->message);
-          exit (1);
-        }
+      g_printerr ("[ERROR] Opening output file `%s' failed: %s\n",
+                  data->output_path,
+                  error->message);
+      exit (1);
     }
 
   for (tmp = data->querries_array; *tmp; tmp++)
@@ -220,29 +309,13 @@ print_querries (CallbackData *data)
       seq = g_hash_table_lookup (data->querries_hash, *tmp);
       if (seq)
         {
-          GString *buffer;
-
-          buffer = g_string_sized_new (512);
-          buffer = g_string_append_c (buffer, '@');
-          buffer = g_string_append (buffer, seq->name);
-          buffer = g_string_append_c (buffer, '\n');
-
-          buffer = g_string_append (buffer, seq->seq);
-          buffer = g_string_append_c (buffer, '\n');
-
-          buffer = g_string_append_c (buffer, '+');
-          buffer = g_string_append (buffer, seq->name);
-          buffer = g_string_append_c (buffer, '\n');
-
-          buffer = g_string_append (buffer, seq->qual);
-          buffer = g_string_append_c (buffer, '\n');
-
-          g_io_channel_write_chars (channel,
-                                    buffer->str,
-                                    -1,
-                                    NULL,
-                                    &error);
-          g_string_free (buffer, TRUE);
+          ngs_writer_printf (writer,
+                             &error,
+                             "@%s\n%s\n+%s\n%s\n",
+                             seq->name,
+                             seq->seq,
+                             seq->name,
+                             seq->qual);
           if (error)
             {
               g_printerr ("[ERROR] Writing sequence failed: %s\n",
@@ -254,19 +327,14 @@ print_querries (CallbackData *data)
         }
     }
 
-  if (!use_stdout)
+  if (!ngs_writer_close (writer, &error))
     {
-      g_io_channel_shutdown (channel, TRUE, &error);
-      if (error)
-        {
-          g_printerr ("[ERROR] Closing output file `%s' failed: %s\n",
-                      data->output_path,
-                      error->message);
-          g_error_free (error);
-          error = NULL;
-        }
+      g_printerr ("[ERROR] Closing output file `%s' failed: %s\n",
+                  data->output_path,
+                  error->message);
+      g_error_free (error);
+      error = NULL;
     }
-  g_io_channel_unref (channel);
 }
 
 static void
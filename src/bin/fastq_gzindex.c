@@ -0,0 +1,120 @@
+/* Copyright (C) 2010  Sylvain FORET
+ *
+ * This file is part of libngs.
+ *
+ * libngs is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *                                                                       
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *                                                                       
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ *
+ */
+
+#include <stdlib.h>
+
+#include "ngs_gzindex.h"
+
+typedef struct _CallbackData CallbackData;
+
+struct _CallbackData
+{
+  char *input_path;
+  char *output_path;
+
+  int   span;
+};
+
+static void parse_args (CallbackData   *data,
+                        int            *argc,
+                        char         ***argv);
+
+int
+main (int    argc,
+      char **argv)
+{
+  CallbackData data;
+  GzIndex     *index;
+  GError      *error = NULL;
+
+  parse_args (&data, &argc, &argv);
+
+  index = gz_index_build (data.input_path,
+                          (guint64)data.span * 1024 * 1024,
+                          &error);
+  if (error)
+    {
+      g_printerr ("[ERROR] Indexing `%s' failed: %s\n", data.input_path, error->message);
+      g_error_free (error);
+      return 1;
+    }
+
+  gz_index_save (index, data.output_path, &error);
+  if (error)
+    {
+      g_printerr ("[ERROR] Saving index failed: %s\n", error->message);
+      g_error_free (error);
+      gz_index_free (index);
+      return 1;
+    }
+  gz_index_free (index);
+  g_free (data.output_path);
+
+  return 0;
+}
+
+static void
+parse_args (CallbackData   *data,
+            int            *argc,
+            char         ***argv)
+{
+  GOptionEntry entries[] =
+    {
+      {"span", 's', 0, G_OPTION_ARG_INT,      &data->span,        "Distance between access points (MB)"          , NULL},
+      {"out" , 'o', 0, G_OPTION_ARG_FILENAME, &data->output_path, "Index file (FILE" GZ_INDEX_SUFFIX " by default)", NULL},
+      {NULL}
+    };
+  GError         *error = NULL;
+  GOptionContext *context;
+
+  data->span        = GZ_INDEX_DEFAULT_SPAN / (1024 * 1024);
+  data->output_path = NULL;
+
+  context = g_option_context_new ("FILE - Builds a seek-point index of a gzip file");
+  g_option_context_add_main_entries (context, entries, NULL);
+  if (!g_option_context_parse (context, argc, argv, &error))
+    {
+      g_printerr ("[ERROR] Option parsing failed: %s\n", error->message);
+      exit (1);
+    }
+  g_option_context_free (context);
+
+  if (*argc < 2)
+    {
+      g_printerr ("[ERROR] No input file provided\n");
+      exit (1);
+    }
+  data->input_path = (*argv)[1];
+
+  if (data->span < 1)
+    {
+      g_printerr ("[ERROR] The span must be at least 1 MB\n");
+      exit (1);
+    }
+  if (data->output_path)
+    data->output_path = g_strdup (data->output_path);
+  else
+    data->output_path = g_strconcat (data->input_path, GZ_INDEX_SUFFIX, NULL);
+}
+
+/* vim:ft=c:expandtab:sw=4:ts=4:sts=4:cinoptions={.5s^-2n-2(0:
+ */
@@ -35,14 +35,13 @@ struct _CallbackData
   char       *input_path2;
   char       *output_path;
   char       *output_single;
-  GIOChannel *output_channel;
-  GIOChannel *single_channel;
+  NgsWriter  *output_writer;
+  NgsWriter  *single_writer;
 
   int         min_size;
   int         append;
   int         append_single;
-
-  int         use_stdout: 1;
+  int         no_check;
 };
 
 static void parse_args  (CallbackData   *data,
@@ -53,51 +52,38 @@ int
 main (int    argc,
       char **argv)
 {
-  CallbackData data;
-  FastqSeq    *seq1;
-  FastqSeq    *seq2;
-  FastqIter   *iter1;
-  FastqIter   *iter2;
-  GString     *buffer;
-  GError      *error = NULL;
+  CallbackData   data;
+  FastqSeq      *seq1;
+  FastqSeq      *seq2;
+  FastqPairIter *iter;
+  GError        *error = NULL;
 
   parse_args (&data, &argc, &argv);
 
-  iter1 = fastq_iter_new (data.input_path1, &error);
+  iter = fastq_pair_iter_new (data.input_path1,
+                              data.input_path2,
+                              !data.no_check,
+                              &error);
   if (error)
     {
-      g_printerr ("[ERROR] Opening %s failed: %s\n",
-                  data.input_path1, error->message);
+      g_printerr ("[ERROR] Opening input failed: %s\n", error->message);
       exit (1);
     }
-  iter2 = fastq_iter_new (data.input_path2, &error);
-  if (error)
-    {
-      g_printerr ("[ERROR] Opening %s failed: %s\n",
-                  data.input_path2, error->message);
-      exit (1);
-    }
-
 
-  buffer = g_string_sized_new (1024);
-  seq1 = fastq_iter_next (iter1);
-  seq2 = fastq_iter_next (iter2);
-  while (seq1 != NULL && seq2 != NULL)
+  while (fastq_pair_iter_next (iter, &seq1, &seq2, &error))
     {
       if (data.min_size > 0)
         {
           if (seq1->size >= data.min_size && seq2->size >= data.min_size)
             {
-              fastq_write (data.output_channel,
-                           buffer,
+              fastq_write (data.output_writer,
                            seq1->name,
                            seq1->seq,
                            seq1->qual,
                            &error);
               if (error != NULL)
                 break;
-              fastq_write (data.output_channel,
-                           buffer,
+              fastq_write (data.output_writer,
                            seq2->name,
                            seq2->seq,
                            seq2->qual,
@@ -107,10 +93,9 @@ main (int    argc,
             }
           else
             {
-              if (seq1->size >= data.min_size && data.single_channel)
+              if (seq1->size >= data.min_size && data.single_writer)
                 {
-                  fastq_write (data.single_channel,
-                               buffer,
+                  fastq_write (data.single_writer,
                                seq1->name,
                                seq1->seq,
                                seq1->qual,
@@ -118,10 +103,9 @@ main (int    argc,
                   if (error != NULL)
                     break;
                 }
-              if (seq2->size >= data.min_size && data.single_channel)
+              if (seq2->size >= data.min_size && data.single_writer)
                 {
-                  fastq_write (data.single_channel,
-                               buffer,
+                  fastq_write (data.single_writer,
                                seq2->name,
                                seq2->seq,
                                seq2->qual,
@@ -133,16 +117,14 @@ main (int    argc,
         }
       else
         {
-          fastq_write (data.output_channel,
-                       buffer,
+          fastq_write (data.output_writer,
                        seq1->name,
                        seq1->seq,
                        seq1->qual,
                        &error);
           if (error != NULL)
             break;
-          fastq_write (data.output_channel,
-                       buffer,
+          fastq_write (data.output_writer,
                        seq2->name,
                        seq2->seq,
                        seq2->qual,
@@ -150,45 +132,28 @@ main (int    argc,
           if (error != NULL)
             break;
         }
-      seq1 = fastq_iter_next (iter1);
-      seq2 = fastq_iter_next (iter2);
     }
   if (error != NULL)
     {
-      g_printerr ("[ERROR] Writing sequence failed: %s\n", error->message);
+      g_printerr ("[ERROR] Interleaving sequences failed: %s\n", error->message);
       g_error_free (error);
       error = NULL;
     }
-  fastq_iter_free (iter1);
-  fastq_iter_free (iter2);
-  g_string_free (buffer, TRUE);
+  fastq_pair_iter_free (iter);
 
-  if (data.output_channel)
+  if (!ngs_writer_close (data.output_writer, &error))
     {
-      if (!data.use_stdout)
-        {
-          g_io_channel_shutdown (data.output_channel, TRUE, &error);
-          if (error != NULL)
-            {
-              g_printerr ("[ERROR] Closing output file failed: %s\n", error->message);
-              g_error_free (error);
-              error = NULL;
-            }
-        }
-      g_io_channel_unref (data.output_channel);
+      g_printerr ("[ERROR] Closing output file failed: %s\n", error->message);
+      g_error_free (error);
+      error = NULL;
     }
   if (data.output_path)
     g_free (data.output_path);
-  if (data.single_channel)
+  if (data.single_writer && !ngs_writer_close (data.single_writer, &error))
     {
-      g_io_channel_shutdown (data.single_channel, TRUE, &error);
-      if (error != NULL)
-        {
-          g_printerr ("[ERROR] Closing single reads output file failed: %s\n", error->message);
-          g_error_free (error);
-          error = NULL;
-        }
-      g_io_channel_unref (data.single_channel);
+      g_printerr ("[ERROR] Closing single reads output file failed: %s\n", error->message);
+      g_error_free (error);
+      error = NULL;
     }
   if (data.output_single)
     g_free (data.output_single);
@@ -208,6 +173,7 @@ parse_args (CallbackData   *data,
       {"minsize",      'm', 0, G_OPTION_ARG_INT,      &data->min_size,      "Min read size", NULL},
       {"append",       'a', 0, G_OPTION_ARG_NONE,     &data->append,        "Append to output", NULL},
       {"appendsingle", 'b', 0, G_OPTION_ARG_NONE,     &data->append_single, "Append to single reads output", NULL},
+      {"nocheck",      'n', 0, G_OPTION_ARG_NONE,     &data->no_check,      "Do not check that the names of mates match", NULL},
       {NULL}
     };
   GError         *error = NULL;
@@ -215,12 +181,12 @@ parse_args (CallbackData   *data,
 
   data->output_path    = NULL;
   data->output_single  = NULL;
-  data->output_channel = NULL;
-  data->single_channel = NULL;
+  data->output_writer  = NULL;
+  data->single_writer  = NULL;
   data->append         = 0;
   data->append_single  = 0;
-  data->use_stdout     = 1;
   data->min_size       = 0;
+  data->no_check       = 0;
 
   context = g_option_context_new ("FILE1 FILE2 - interleaves the sequences from two fastq files\n"
                                   "*** (OBSOLETE: use fastq_pairs instead) ***");
@@ -243,39 +209,24 @@ parse_args (CallbackData   *data,
 
   if (!data->output_path)
     data->output_path = g_strdup ("-");
-  if (data->output_path[0] == '-' && data->output_path[1] == '\0')
-    {
-      data->use_stdout      = 1;
-      data->output_channel = g_io_channel_unix_new (STDOUT_FILENO);
-    }
-  else
+  data->output_writer = ngs_writer_new (data->output_path,
+                                        data->append ? "a" : "w",
+                                        &error);
+  if (error)
     {
-      data->use_stdout      = 0;
-      data->output_channel = g_io_channel_new_file (data->output_path,
-                                                    data->append ? "a" : "w",
-                                                    &error);
-      if (error)
-        {
-          g_printerr ("[ERROR] Opening sequence output file failed: %s\n", error->message);
-          exit (1);
-        }
+      g_printerr ("[ERROR] Opening sequence output file failed: %s\n", error->message);
+      exit (1);
     }
-  g_io_channel_set_encoding (data->output_channel, NULL, NULL);
-  g_io_channel_set_buffered (data->output_channel, TRUE);
-  g_io_channel_set_buffer_size (data->output_channel, 4096 * 128);
   if (data->output_single)
     {
-      data->single_channel = g_io_channel_new_file (data->output_single,
-                                                    data->append_single ? "a" : "w",
-                                                    &error);
+      data->single_writer = ngs_writer_new (data->output_single,
+                                            data->append_single ? "a" : "w",
+                                            &error);
       if (error)
         {
           g_printerr ("[ERROR] Opening single reads output file failed: %s\n", error->message);
           exit (1);
         }
-      g_io_channel_set_encoding (data->single_channel, NULL, NULL);
-      g_io_channel_set_buffered (data->single_channel, TRUE);
-      g_io_channel_set_buffer_size (data->single_channel, 4096 * 128);
     }
 }
 
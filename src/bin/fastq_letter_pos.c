@@ -25,6 +25,7 @@
 #include <unistd.h>
 
 #include "ngs_fastq.h"
+#include "ngs_writer.h"
 
 
 #define N_LETTERS 5
@@ -115,6 +116,9 @@ parse_args (CallbackData      *data,
   data->input_path   = (*argv)[1];
   data->current_size = 0;
   data->ns           = NULL;
+
+  /* Only the sequences are used */
+  fastq_set_columns (FASTQ_COLUMN_SEQ);
 }
 
 static int
@@ -184,16 +188,31 @@ iter_func (FastqSeq     *fastq,
 static void
 print_letters (CallbackData *data)
 {
-  int i;
+  NgsWriter *writer;
+  GError    *error = NULL;
+  int       i;
+
+  writer = ngs_writer_new ("-", "w", &error);
+  if (error)
+    {
+      g_printerr ("[ERROR] Opening output failed: %s\n", error->message);
+      exit (1);
+    }
 
-  g_print ("A\tT\tG\tC\tN\n");
+  ngs_writer_printf (writer, NULL, "A\tT\tG\tC\tN\n");
   for (i = 0; i < data->current_size; i++)
-    g_print ("%f\t%f\t%f\t%f\t%f\n",
-             ((float)data->counts[NUC_A][i]) / data->ns[i],
-             ((float)data->counts[NUC_T][i]) / data->ns[i],
-             ((float)data->counts[NUC_G][i]) / data->ns[i],
-             ((float)data->counts[NUC_C][i]) / data->ns[i],
-             ((float)data->counts[NUC_N][i]) / data->ns[i]);
+    ngs_writer_printf (writer, NULL, "%f\t%f\t%f\t%f\t%f\n",
+                       ((float)data->counts[NUC_A][i]) / data->ns[i],
+                       ((float)data->counts[NUC_T][i]) / data->ns[i],
+                       ((float)data->counts[NUC_G][i]) / data->ns[i],
+                       ((float)data->counts[NUC_C][i]) / data->ns[i],
+                       ((float)data->counts[NUC_N][i]) / data->ns[i]);
+
+  if (!ngs_writer_close (writer, &error))
+    {
+      g_printerr ("[ERROR] Writing output failed: %s\n", error->message);
+      g_error_free (error);
+    }
 
   /* Free stuff up */
   for (i = 0; i < N_LETTERS; i++)
@@ -24,6 +24,7 @@
 #include <unistd.h>
 
 #include "ngs_fastq.h"
+#include "ngs_writer.h"
 
 /* TODO allocate this dynamically to enable qualities larger than 60 */
 #define N_QUAL 60
@@ -224,29 +225,44 @@ init_letter_qual_data (CallbackData  *data)
 static void
 print_letter_qual (CallbackData *data)
 {
-  int i;
+  NgsWriter *writer;
+  GError    *error = NULL;
+  int       i;
+
+  writer = ngs_writer_new ("-", "w", &error);
+  if (error)
+    {
+      g_printerr ("[ERROR] Opening output failed: %s\n", error->message);
+      exit (1);
+    }
 
   /* Header */
-  g_print ("qual\t"
-           "A\t"
-           "T\t"
-           "G\t"
-           "C\t"
-           "N\n");
+  ngs_writer_printf (writer, NULL, "qual\t"
+                     "A\t"
+                     "T\t"
+                     "G\t"
+                     "C\t"
+                     "N\n");
   for (i = 0; i < N_QUAL; i++)
     {
-      g_print ("%d\t"
-               "%ld\t"
-               "%ld\t"
-               "%ld\t"
-               "%ld\t"
-               "%ld\n",
-               i,
-               data->a_qual[i],
-               data->t_qual[i],
-               data->g_qual[i],
-               data->c_qual[i],
-               data->n_qual[i]);
+      ngs_writer_printf (writer, NULL, "%d\t"
+                         "%ld\t"
+                         "%ld\t"
+                         "%ld\t"
+                         "%ld\t"
+                         "%ld\n",
+                         i,
+                         data->a_qual[i],
+                         data->t_qual[i],
+                         data->g_qual[i],
+                         data->c_qual[i],
+                         data->n_qual[i]);
+    }
+
+  if (!ngs_writer_close (writer, &error))
+    {
+      g_printerr ("[ERROR] Writing output failed: %s\n", error->message);
+      g_error_free (error);
     }
 }
 
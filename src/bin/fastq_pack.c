@@ -0,0 +1,154 @@
+/* Copyright (C) 2010  Sylvain FORET
+ *
+ * This file is part of libngs.
+ *
+ * libngs is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *                                                                       
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *                                                                       
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ *
+ */
+
+#include <stdlib.h>
+
+#include "ngs_qualcodec.h"
+#include "ngs_readstore.h"
+
+typedef struct _CallbackData CallbackData;
+
+struct _CallbackData
+{
+  char            *input_path;
+  char            *output_path;
+  ReadStoreWriter *writer;
+  GError          *error;
+
+  int              bin_quals;
+  int              qual_codec;
+};
+
+static void parse_args (CallbackData   *data,
+                        int            *argc,
+                        char         ***argv);
+
+static int  iter_func  (FastqSeq       *fastq,
+                        CallbackData   *data);
+
+int
+main (int    argc,
+      char **argv)
+{
+  CallbackData data;
+  GError      *error = NULL;
+
+  parse_args (&data, &argc, &argv);
+
+  data.writer = read_store_writer_new (data.output_path, &error);
+  if (error)
+    {
+      g_printerr ("[ERROR] Opening output file failed: %s\n", error->message);
+      g_error_free (error);
+      return 1;
+    }
+  if (data.qual_codec)
+    read_store_writer_set_qual_codec (data.writer);
+
+  iter_fastq (data.input_path,
+              (FastqIterFunc)iter_func,
+              &data,
+              &error);
+  if (data.error)
+    {
+      g_printerr ("[ERROR] Writing read store failed: %s\n", data.error->message);
+      g_error_free (data.error);
+      read_store_writer_close (data.writer, NULL);
+      return 1;
+    }
+  if (error)
+    {
+      g_printerr ("[ERROR] Iterating sequences failed: %s\n", error->message);
+      g_error_free (error);
+      read_store_writer_close (data.writer, NULL);
+      return 1;
+    }
+
+  if (!read_store_writer_close (data.writer, &error))
+    {
+      g_printerr ("[ERROR] Writing read store failed: %s\n", error->message);
+      g_error_free (error);
+      return 1;
+    }
+  g_free (data.output_path);
+
+  return 0;
+}
+
+static void
+parse_args (CallbackData   *data,
+            int            *argc,
+            char         ***argv)
+{
+  GOptionEntry entries[] =
+    {
+      {"out", 'o', 0, G_OPTION_ARG_FILENAME, &data->output_path, "Output file (FILE" READ_STORE_SUFFIX " by default)", NULL},
+      {"bin", 'b', 0, G_OPTION_ARG_NONE,     &data->bin_quals,   "Bin the qualities to 8 levels (lossy)", NULL},
+      {"rans", 'r', 0, G_OPTION_ARG_NONE,    &data->qual_codec,  "Encode the qualities with rANS rather than deflate (smaller, slower to read)", NULL},
+      {NULL}
+    };
+  GError         *error = NULL;
+  GOptionContext *context;
+
+  data->output_path = NULL;
+  data->writer      = NULL;
+  data->error       = NULL;
+  data->bin_quals   = 0;
+  data->qual_codec  = 0;
+
+  context = g_option_context_new ("FILE - Packs a fastq file into a read store, which the other tools read faster");
+  g_option_context_add_group (context, get_fastq_option_group ());
+  g_option_context_add_main_entries (context, entries, NULL);
+  if (!g_option_context_parse (context, argc, argv, &error))
+    {
+      g_printerr ("[ERROR] Option parsing failed: %s\n", error->message);
+      exit (1);
+    }
+  g_option_context_free (context);
+
+  if (*argc < 2)
+    {
+      g_printerr ("[ERROR] No input file provided\n");
+      exit (1);
+    }
+  data->input_path = (*argv)[1];
+
+  if (data->output_path)
+    data->output_path = g_strdup (data->output_path);
+  else if (data->input_path[0] == '-' && data->input_path[1] == '\0')
+    data->output_path = g_strdup ("-");
+  else
+    data->output_path = g_strconcat (data->input_path, READ_STORE_SUFFIX, NULL);
+}
+
+static int
+iter_func (FastqSeq     *fastq,
+           CallbackData *data)
+{
+  if (data->bin_quals)
+    qual_bin (fastq->qual, fastq->size);
+
+  return read_store_writer_add (data->writer, fastq, &data->error);
+}
+
+/* vim:ft=c:expandtab:sw=4:ts=4:sts=4:cinoptions={.5s^-2n-2(0:
+ */
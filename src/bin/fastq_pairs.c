@@ -36,19 +36,20 @@ struct _CallbackData
   char       *output_path1;
   char       *output_path2;
   char       *output_single;
-  GIOChannel *output_channel1;
-  GIOChannel *output_channel2;
-  GIOChannel *single_channel;
+  NgsWriter  *output_writer1;
+  NgsWriter  *output_writer2;
+  NgsWriter  *single_writer;
 
   int         min_size;
   int         append;
   int         append_single;
+  int         gzip;
+  int         bgzf;
+  int         threads;
 
+  int         no_check;
   int         one_input;
   int         one_output;
-  int         use_stdout1;
-  int         use_stdout2;
-  int         use_stdout_single;
 };
 
 static void parse_args   (CallbackData   *data,
@@ -57,74 +58,51 @@ static void parse_args   (CallbackData   *data,
 
 static void cleanup      (CallbackData   *data);
 
-static void open_output  (GIOChannel **channel,
-                          int         *use_stdout,
-                          const char  *path,
-                          const char  *mode,
-                          const char  *error_message);
+static void open_output  (CallbackData   *data,
+                          NgsWriter     **writer,
+                          const char     *path,
+                          const char     *mode,
+                          const char     *error_message);
 
-static void close_output (GIOChannel **channel,
-                          int          use_stdout,
-                          const char * error_message);
+static void close_output (NgsWriter    **writer,
+                          const char     *error_message);
 
 int
 main (int    argc,
       char **argv)
 {
-  CallbackData data;
-  FastqSeq    *seq1;
-  FastqSeq    *seq2;
-  FastqSeq    *tmp;
-  FastqIter   *iter1;
-  FastqIter   *iter2;
-  GString     *buffer;
-  GError      *error = NULL;
+  CallbackData   data;
+  FastqSeq      *seq1;
+  FastqSeq      *seq2;
+  FastqPairIter *iter;
+  GError        *error = NULL;
 
   parse_args (&data, &argc, &argv);
 
-  iter1 = fastq_iter_new (data.input_path1, &error);
+  iter = fastq_pair_iter_new (data.input_path1,
+                              data.one_input ? NULL : data.input_path2,
+                              !data.no_check,
+                              &error);
   if (error)
     {
-      g_printerr ("[ERROR] Opening %s failed: %s\n",
-                  data.input_path1, error->message);
+      g_printerr ("[ERROR] Opening input failed: %s\n", error->message);
       exit (1);
     }
-  if (!data.one_input)
-    {
-      iter2 = fastq_iter_new (data.input_path2, &error);
-      if (error)
-        {
-          g_printerr ("[ERROR] Opening %s failed: %s\n",
-                      data.input_path2, error->message);
-          exit (1);
-        }
-    }
-  else
-    iter2 = iter1;
 
-  buffer = g_string_sized_new (1024);
-  tmp    = fastq_iter_next (iter1);
-  if (data.one_input)
-    seq1 = fastq_seq_copy (tmp);
-  else
-    seq1 = tmp;
-  seq2   = fastq_iter_next (iter2);
-  while (seq1 != NULL && seq2 != NULL)
+  while (fastq_pair_iter_next (iter, &seq1, &seq2, &error))
     {
       if (data.min_size > 0)
         {
           if (seq1->size >= data.min_size && seq2->size >= data.min_size)
             {
-              fastq_write (data.output_channel1,
-                           buffer,
+              fastq_write (data.output_writer1,
                            seq1->name,
                            seq1->seq,
                            seq1->qual,
                            &error);
               if (error != NULL)
                 break;
-              fastq_write (data.output_channel2,
-                           buffer,
+              fastq_write (data.output_writer2,
                            seq2->name,
                            seq2->seq,
                            seq2->qual,
@@ -132,12 +110,11 @@ main (int    argc,
               if (error != NULL)
                 break;
             }
-          else if (data.single_channel != NULL)
+          else if (data.single_writer != NULL)
             {
               if (seq1->size >= data.min_size)
                 {
-                  fastq_write (data.single_channel,
-                               buffer,
+                  fastq_write (data.single_writer,
                                seq1->name,
                                seq1->seq,
                                seq1->qual,
@@ -147,8 +124,7 @@ main (int    argc,
                 }
               if (seq2->size >= data.min_size)
                 {
-                  fastq_write (data.single_channel,
-                               buffer,
+                  fastq_write (data.single_writer,
                                seq2->name,
                                seq2->seq,
                                seq2->qual,
@@ -160,16 +136,14 @@ main (int    argc,
         }
       else
         {
-          fastq_write (data.output_channel1,
-                       buffer,
+          fastq_write (data.output_writer1,
                        seq1->name,
                        seq1->seq,
                        seq1->qual,
                        &error);
           if (error != NULL)
             break;
-          fastq_write (data.output_channel2,
-                       buffer,
+          fastq_write (data.output_writer2,
                        seq2->name,
                        seq2->seq,
                        seq2->qual,
@@ -177,29 +151,15 @@ main (int    argc,
           if (error != NULL)
             break;
         }
-      if (data.one_input)
-        fastq_seq_free (seq1);
-      tmp = fastq_iter_next (iter1);
-      if (data.one_input)
-        seq1 = fastq_seq_copy (tmp);
-      else
-        seq1 = tmp;
-      seq2 = fastq_iter_next (iter2);
     }
-  /* In case seq1 was allocated, but the loop was never called */
-  if (data.one_input)
-    fastq_seq_free (seq1);
 
   if (error != NULL)
     {
-      g_printerr ("[ERROR] Writing sequence failed: %s\n", error->message);
+      g_printerr ("[ERROR] Processing pairs failed: %s\n", error->message);
       g_error_free (error);
       error = NULL;
     }
-  g_string_free (buffer, TRUE);
-  fastq_iter_free (iter1);
-  if (!data.one_input)
-    fastq_iter_free (iter2);
+  fastq_pair_iter_free (iter);
 
   cleanup (&data);
 
@@ -218,6 +178,10 @@ parse_args (CallbackData   *data,
       {"single",  's', 0, G_OPTION_ARG_FILENAME, &data->output_single, "File for single reads",                                          NULL},
       {"minsize", 'm', 0, G_OPTION_ARG_INT,      &data->min_size,      "Min read size",                                                  NULL},
       {"append",  'a', 0, G_OPTION_ARG_NONE,     &data->append,        "Append to output",                                               NULL},
+      {"gzip",    'g', 0, G_OPTION_ARG_NONE,     &data->gzip,          "Compress the output in gzip format",                             NULL},
+      {"bgzf",    'z', 0, G_OPTION_ARG_NONE,     &data->bgzf,          "Compress the output in BGZF format",                             NULL},
+      {"threads", 't', 0, G_OPTION_ARG_INT,      &data->threads,       "Number of compression threads per output",                       NULL},
+      {"nocheck", 'n', 0, G_OPTION_ARG_NONE,     &data->no_check,      "Do not check that the names of mates match",                     NULL},
       {NULL}
     };
   GError         *error = NULL;
@@ -226,14 +190,15 @@ parse_args (CallbackData   *data,
   data->output_path1      = NULL;
   data->output_path2      = NULL;
   data->output_single     = NULL;
-  data->output_channel1   = NULL;
-  data->output_channel2   = NULL;
-  data->single_channel    = NULL;
+  data->output_writer1    = NULL;
+  data->output_writer2    = NULL;
+  data->single_writer     = NULL;
   data->append            = 0;
-  data->use_stdout1       = 0;
-  data->use_stdout2       = 0;
-  data->use_stdout_single = 0;
+  data->gzip              = 0;
+  data->bgzf              = 0;
+  data->threads           = 1;
   data->min_size          = 0;
+  data->no_check          = 0;
   data->one_input         = 0;
   data->one_output        = 0;
 
@@ -275,8 +240,8 @@ parse_args (CallbackData   *data,
   else if (!data->output_path2 || !strcmp (data->output_path1, data->output_path2))
     data->one_output = 1;
 
-  open_output (&data->output_channel1,
-               &data->use_stdout1,
+  open_output (data,
+               &data->output_writer1,
                data->output_path1,
                data->append ? "a" : "w",
                data->one_output ?
@@ -284,17 +249,17 @@ parse_args (CallbackData   *data,
                "Opening sequence output file 1 failed");
 
   if (!data->one_output)
-    open_output (&data->output_channel2,
-                 &data->use_stdout2,
+    open_output (data,
+                 &data->output_writer2,
                  data->output_path2,
                  data->append ? "a" : "w",
                  "Opening sequence output file 2 failed");
   else
-    data->output_channel2 = data->output_channel1;
+    data->output_writer2 = data->output_writer1;
 
   if (data->output_single)
-    open_output (&data->single_channel,
-                 &data->use_stdout_single,
+    open_output (data,
+                 &data->single_writer,
                  data->output_single,
                  data->append ? "a" : "w",
                  "Opening single reads output file failed");
@@ -303,19 +268,16 @@ parse_args (CallbackData   *data,
 static void
 cleanup (CallbackData *data)
 {
-  close_output (&data->output_channel1,
-                data->use_stdout1,
+  close_output (&data->output_writer1,
                 data->one_output ?
                 "Closing output file failed" :
                 "Closing output file 1 failed");
 
   if (!data->one_output)
-    close_output (&data->output_channel2,
-                  data->use_stdout2,
+    close_output (&data->output_writer2,
                   "Closing output file 2 failed");
 
-  close_output (&data->single_channel,
-                data->use_stdout_single,
+  close_output (&data->single_writer,
                 "Closing single reads output file failed");
 
   if (data->output_path1)
@@ -327,53 +289,42 @@ cleanup (CallbackData *data)
 }
 
 static void
-open_output (GIOChannel **channel,
-             int         *use_stdout,
-             const char  *path,
-             const char  *mode,
-             const char  *error_message)
+open_output (CallbackData *data,
+             NgsWriter   **writer,
+             const char   *path,
+             const char   *mode,
+             const char   *error_message)
 {
   GError *error = NULL;
 
-  if (path[0] == '-' && path[1] == '\0')
-    {
-      *use_stdout = 1;
-      *channel    = g_io_channel_unix_new (STDOUT_FILENO);
-    }
-  else
+  *writer = ngs_writer_new_compressed (path,
+                                      mode,
+                                      data->bgzf ? NGS_COMPRESSION_BGZF :
+                                      data->gzip ? NGS_COMPRESSION_GZIP :
+                                      NGS_COMPRESSION_NONE,
+                                      data->threads,
+                                      &error);
+  if (error)
     {
-      *channel = g_io_channel_new_file (path, mode, &error);
-      if (error)
-        {
-          g_printerr ("[ERROR] %s: %s\n", error_message, error->message);
-          exit (1);
-        }
+      g_printerr ("[ERROR] %s: %s\n", error_message, error->message);
+      exit (1);
     }
-  g_io_channel_set_encoding (*channel, NULL, NULL);
-  g_io_channel_set_buffered (*channel, TRUE);
-  g_io_channel_set_buffer_size (*channel, 4096 * 128);
 }
 
 static void
-close_output (GIOChannel **channel,
-              int          use_stdout,
+close_output (NgsWriter  **writer,
               const char  *error_message)
 {
   GError *error = NULL;
 
-  if (*channel == NULL)
+  if (*writer == NULL)
     return;
-  if (!use_stdout)
+  if (!ngs_writer_close (*writer, &error))
     {
-      g_io_channel_shutdown (*channel, TRUE, &error);
-      if (error != NULL)
-        {
-          g_printerr ("[ERROR] %s: %s\n", error_message, error->message);
-          g_error_free (error);
-        }
+      g_printerr ("[ERROR] %s: %s\n", error_message, error->message);
+      g_error_free (error);
     }
-  g_io_channel_unref (*channel);
-  *channel = NULL;
+  *writer = NULL;
 }
 
 /* vim:ft=c:expandtab:sw=4:ts=4:sts=4:cinoptions={.5s^-2n-2(0:
@@ -25,6 +25,7 @@
 #include <unistd.h>
 
 #include "ngs_fastq.h"
+#include "ngs_writer.h"
 
 
 #define N_QUAL 60
@@ -39,6 +40,7 @@ struct _CallbackData
   char               *input_path;
 
   unsigned int        current_size;
+  int                 threads;
 };
 
 static void parse_args (CallbackData      *data,
@@ -48,8 +50,14 @@ static void parse_args (CallbackData      *data,
 static int  iter_func  (FastqSeq          *fastq,
                         CallbackData      *data);
 
+static void resize     (CallbackData      *data,
+                        unsigned int       size);
+
 static void print_qual (CallbackData      *data);
 
+static void iter_parts (CallbackData      *data,
+                        GError           **error);
+
 int
 main (int    argc,
       char **argv)
@@ -59,10 +67,7 @@ main (int    argc,
 
   parse_args (&data, &argc, &argv);
 
-  iter_fastq (data.input_path,
-              (FastqIterFunc)iter_func,
-              &data,
-              &error);
+  iter_parts (&data, &error);
 
   if (error)
     {
@@ -84,11 +89,14 @@ parse_args (CallbackData      *data,
 {
   GOptionEntry entries[] =
     {
+      {"threads", 't', 0, G_OPTION_ARG_INT, &data->threads, "Number of threads", NULL},
       {NULL}
     };
   GError         *error = NULL;
   GOptionContext *context;
 
+  data->threads = 1;
+
   context = g_option_context_new ("FILE - Computes distribution of the base qualities depending on the position");
   g_option_context_add_group (context, get_fastq_option_group ());
   g_option_context_add_main_entries (context, entries, NULL);
@@ -116,55 +124,129 @@ iter_func (FastqSeq     *fastq,
 {
   int i;
 
+  if (data->current_size < (unsigned int)fastq->size)
+    resize (data, fastq->size);
+
+  for (i = 0; i < fastq->size; i++)
+    {
+      data->qual[i][fastq->qual[i] - fastq_qual0]++;
+      data->ns[i]++;
+    }
+
+  return 1;
+}
+
+static void
+resize (CallbackData *data,
+        unsigned int  size)
+{
+  unsigned int i;
+
   if (data->current_size == 0)
     {
-      data->qual = g_malloc (fastq->size * sizeof (*data->qual));
-      data->ns   = g_malloc (fastq->size * sizeof (*data->ns));
-      data->ns   = memset (data->ns, 0, fastq->size * sizeof (*data->ns));
-      for (i = 0; i < fastq->size; i++)
+      data->qual = g_malloc (size * sizeof (*data->qual));
+      data->ns   = g_malloc (size * sizeof (*data->ns));
+      data->ns   = memset (data->ns, 0, size * sizeof (*data->ns));
+      for (i = 0; i < size; i++)
         {
           data->qual[i] = g_malloc (N_QUAL * sizeof (**data->qual));
           data->qual[i] = memset (data->qual[i], 0, N_QUAL * sizeof (**data->qual));
         }
-      data->current_size = fastq->size;
+      data->current_size = size;
     }
-  else if (data->current_size < fastq->size)
+  else if (data->current_size < size)
     {
-      data->qual = g_realloc (data->qual, fastq->size * sizeof (*data->qual));
-      data->ns   = g_realloc (data->ns, fastq->size * sizeof (*data->ns));
-      for (i = data->current_size; i < fastq->size; i++)
+      data->qual = g_realloc (data->qual, size * sizeof (*data->qual));
+      data->ns   = g_realloc (data->ns, size * sizeof (*data->ns));
+      for (i = data->current_size; i < size; i++)
         {
           data->qual[i] = g_malloc (N_QUAL * sizeof (**data->qual));
           data->qual[i] = memset (data->qual[i], 0, N_QUAL * sizeof (**data->qual));
           data->ns[i]   = 0;
         }
-      data->current_size = fastq->size;
+      data->current_size = size;
     }
+}
 
-  for (i = 0; i < fastq->size; i++)
+/**
+ * Each thread counts the qualities of its part of the file, the counts are
+ * then added up
+ */
+static void
+iter_parts (CallbackData  *data,
+            GError       **error)
+{
+  CallbackData  *parts;
+  void         **parts_data;
+  unsigned int   i;
+  int            k;
+  int            t;
+
+  if (data->threads < 1)
+    data->threads = 1;
+  parts      = g_new (CallbackData, data->threads);
+  parts_data = g_new (void*, data->threads);
+  for (t = 0; t < data->threads; t++)
     {
-      data->qual[i][fastq->qual[i] - fastq_qual0]++;
-      data->ns[i]++;
+      parts[t]      = *data;
+      parts_data[t] = parts + t;
     }
 
-  return 1;
+  iter_fastq_ranges (data->input_path,
+                     (FastqIterFunc)iter_func,
+                     parts_data,
+                     data->threads,
+                     error);
+
+  for (t = 0; t < data->threads; t++)
+    {
+      if (data->current_size < parts[t].current_size)
+        resize (data, parts[t].current_size);
+      for (i = 0; i < parts[t].current_size; i++)
+        {
+          for (k = 0; k < N_QUAL; k++)
+            data->qual[i][k] += parts[t].qual[i][k];
+          data->ns[i] += parts[t].ns[i];
+          g_free (parts[t].qual[i]);
+        }
+      g_free (parts[t].qual);
+      g_free (parts[t].ns);
+    }
+
+  g_free (parts_data);
+  g_free (parts);
 }
 
 static void
 print_qual (CallbackData *data)
 {
-  int i;
-  int j;
+  NgsWriter *writer;
+  GError    *error = NULL;
+  int       i;
+  int       j;
+
+  writer = ngs_writer_new ("-", "w", &error);
+  if (error)
+    {
+      g_printerr ("[ERROR] Opening output failed: %s\n", error->message);
+      exit (1);
+    }
 
   for (i = 0; i < data->current_size; i++)
     {
       for (j = 0; j < N_QUAL; j++)
         {
           if (j > 0)
-            g_print (" ");
-          g_print ("%f", ((double)data->qual[i][j]) / data->ns[i]);
+            ngs_writer_putc (writer, ' ', NULL);
+          ngs_writer_printf (writer, NULL, "%f", ((double)data->qual[i][j]) / data->ns[i]);
         }
-      g_print ("\n");
+      ngs_writer_putc (writer, '\n', NULL);
+    }
+
+  if (!ngs_writer_close (writer, &error))
+    {
+      g_printerr ("[ERROR] Writing output failed: %s\n", error->message);
+      g_error_free (error);
     }
 
   /* Free stuff up */
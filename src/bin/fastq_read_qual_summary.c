@@ -35,6 +35,7 @@ struct _CallbackData
   unsigned long int  qual[128];
 
   char              *input_path;
+  NgsWriter         *output_writer;
 
   unsigned int       all;
 };
@@ -84,6 +85,14 @@ main (int    argc,
   if (!data.all)
     print_qual (&data);
 
+  if (!ngs_writer_close (data.output_writer, &error))
+    {
+      g_printerr ("[ERROR] Writing output failed: %s\n", error->message);
+      g_error_free (error);
+      error = NULL;
+      return 1;
+    }
+
   return 0;
 }
 
@@ -121,6 +130,13 @@ parse_args (CallbackData      *data,
 
   if (!data->all)
     init_qual (data);
+
+  data->output_writer = ngs_writer_new ("-", "w", &error);
+  if (error)
+    {
+      g_printerr ("[ERROR] Opening output failed: %s\n", error->message);
+      exit (1);
+    }
 }
 
 static int
@@ -133,7 +149,10 @@ iter_func_all (FastqSeq     *fastq,
   for (i = 0; i < fastq->size; i++)
     read_qual += fastq->qual[i] - fastq_qual0;
 
-  g_print ("%f\n", ((float)read_qual) / fastq->size);
+  ngs_writer_printf (data->output_writer,
+                     NULL,
+                     "%f\n",
+                     ((float)read_qual) / fastq->size);
 
   return 1;
 }
@@ -170,8 +189,10 @@ print_qual (CallbackData *data)
   int i;
 
   for (i = 0; i < N_QUAL; i++)
-    g_print ("%d\t%ld\n",
-             i, data->qual[i]);
+    ngs_writer_printf (data->output_writer,
+                       NULL,
+                       "%d\t%ld\n",
+                       i, data->qual[i]);
 }
 
 /* vim:ft=c:expandtab:sw=4:ts=4:sts=4:cinoptions={.5s^-2n-2(0:
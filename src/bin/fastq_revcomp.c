@@ -33,12 +33,15 @@ struct _CallbackData
 {
   char       *input_path;
   char       *output_path;
-  GIOChannel *output_channel;
+  NgsWriter  *output_writer;
 
-  int         use_stdout: 1;
+  int         gzip;
+  int         bgzf;
+  int         threads;
 };
 
 static int  iter_func  (FastqSeq       *fastq,
+                        GString        *buffer,
                         CallbackData   *data);
 
 static void parse_args (CallbackData   *data,
@@ -54,10 +57,13 @@ main (int    argc,
 
   parse_args (&data, &argc, &argv);
 
-  iter_fastq (data.input_path,
-              (FastqIterFunc)iter_func,
-              &data,
-              &error);
+  iter_fastq_parallel (data.input_path,
+                       (FastqParallelFunc)iter_func,
+                       &data,
+                       data.threads,
+                       1,
+                       data.output_writer,
+                       &error);
   if (error)
     {
       g_printerr ("[ERROR] Iterating sequences failed: %s\n", error->message);
@@ -65,19 +71,11 @@ main (int    argc,
       error = NULL;
     }
 
-  if (data.output_channel)
+  if (!ngs_writer_close (data.output_writer, &error))
     {
-      if (!data.use_stdout)
-        {
-          g_io_channel_shutdown (data.output_channel, TRUE, &error);
-          if (error)
-            {
-              g_printerr ("[ERROR] Closing output file failed: %s\n", error->message);
-              g_error_free (error);
-              error = NULL;
-            }
-        }
-      g_io_channel_unref (data.output_channel);
+      g_printerr ("[ERROR] Closing output file failed: %s\n", error->message);
+      g_error_free (error);
+      error = NULL;
     }
   if (data.output_path)
     g_free (data.output_path);
@@ -92,14 +90,19 @@ parse_args (CallbackData   *data,
 {
   GOptionEntry entries[] =
     {
-      {"output" , 'o', 0, G_OPTION_ARG_FILENAME, &data->output_path, "Output path", NULL},
+      {"output" , 'o', 0, G_OPTION_ARG_FILENAME, &data->output_path, "Output path"                       , NULL},
+      {"gzip"   , 'g', 0, G_OPTION_ARG_NONE,     &data->gzip,        "Compress the output in gzip format", NULL},
+      {"bgzf"   , 'z', 0, G_OPTION_ARG_NONE,     &data->bgzf,        "Compress the output in BGZF format", NULL},
+      {"threads", 't', 0, G_OPTION_ARG_INT,      &data->threads,     "Number of threads"                 , NULL},
       {NULL}
     };
   GError         *error = NULL;
   GOptionContext *context;
 
   data->output_path = NULL;
-  data->use_stdout  = 1;
+  data->gzip        = 0;
+  data->bgzf        = 0;
+  data->threads     = 1;
 
   context = g_option_context_new ("FILE - outputs the reverse complements of the sequences in a fastq file");
   g_option_context_add_group (context, get_fastq_option_group ());
@@ -120,33 +123,25 @@ parse_args (CallbackData   *data,
 
   if (!data->output_path)
     data->output_path = g_strdup ("-");
-  if (data->output_path[0] == '-' && data->output_path[1] == '\0')
-    {
-      data->use_stdout      = 1;
-      data->output_channel = g_io_channel_unix_new (STDOUT_FILENO);
-    }
-  else
+  data->output_writer = ngs_writer_new_compressed (data->output_path,
+                                                   "w",
+                                                   data->bgzf ? NGS_COMPRESSION_BGZF :
+                                                   data->gzip ? NGS_COMPRESSION_GZIP :
+                                                   NGS_COMPRESSION_NONE,
+                                                   data->threads,
+                                                   &error);
+  if (error)
     {
-      data->use_stdout      = 0;
-      data->output_channel = g_io_channel_new_file (data->output_path, "w", &error);
-      if (error)
-        {
-          g_printerr ("[ERROR] Opening sequence output file failed: %s\n", error->message);
-          exit (1);
-        }
+      g_printerr ("[ERROR] Opening sequence output file failed: %s\n", error->message);
+      exit (1);
     }
 }
 
 static int
 iter_func (FastqSeq     *fastq,
+           GString      *buffer,
            CallbackData *data)
 {
-  GError  *error = NULL;
-  GString *buffer;
-  int      ret   = 1;
-
-  buffer = g_string_sized_new (512);
-
   /* Sequence */
   buffer = g_string_append_c (buffer, '@');
   buffer = g_string_append (buffer, fastq->name);
@@ -167,21 +162,7 @@ iter_func (FastqSeq     *fastq,
                                 fastq->size);
   buffer = g_string_append_c (buffer, '\n');
 
-  g_io_channel_write_chars (data->output_channel,
-                            buffer->str,
-                            -1,
-                            NULL,
-                            &error);
-  if (error)
-    {
-      g_printerr ("[ERROR] Writing sequence failed: %s\n", error->message);
-      g_error_free (error);
-      error = NULL;
-      ret   = 0;
-    }
-  g_string_free (buffer, TRUE);
-
-  return ret;
+  return 1;
 }
 
 /* vim:ft=c:expandtab:sw=4:ts=4:sts=4:cinoptions={.5s^-2n-2(0:
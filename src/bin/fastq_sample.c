@@ -31,14 +31,12 @@ struct _CallbackData
 {
   char       *input_path;
   char       *output_path;
-  GIOChannel *output_channel;
+  NgsWriter  *output_writer;
   GRand      *rand;
   FastqSeq  **samples;
 
   int         n;
   int         t;
-
-  int         use_stdout: 1;
 };
 
 static int  iter_func     (FastqSeq       *fastq,
@@ -74,19 +72,11 @@ main (int    argc,
   else
     print_samples (&data);
 
-  if (data.output_channel)
+  if (!ngs_writer_close (data.output_writer, &error))
     {
-      if (!data.use_stdout)
-        {
-          g_io_channel_shutdown (data.output_channel, TRUE, &error);
-          if (error)
-            {
-              g_printerr ("[ERROR] Closing output file failed: %s\n", error->message);
-              g_error_free (error);
-              error = NULL;
-            }
-        }
-      g_io_channel_unref (data.output_channel);
+      g_printerr ("[ERROR] Closing output file failed: %s\n", error->message);
+      g_error_free (error);
+      error = NULL;
     }
   g_rand_free (data.rand);
   free_samples (&data);
@@ -111,9 +101,8 @@ parse_args (CallbackData   *data,
   data->n              = 1;
   data->t              = 0;
   data->output_path    = "-";
-  data->output_channel = NULL;
+  data->output_writer  = NULL;
   data->samples        = NULL;
-  data->use_stdout     = 1;
 
   context = g_option_context_new ("FILE - Samples reads from a fastq file");
   g_option_context_add_group (context, get_fastq_option_group ());
@@ -132,17 +121,11 @@ parse_args (CallbackData   *data,
     }
   data->input_path = (*argv)[1];
 
-  if (data->output_path[0] == '-' && data->output_path[1] == '\0')
-    data->output_channel = g_io_channel_unix_new (STDOUT_FILENO);
-  else
+  data->output_writer = ngs_writer_new (data->output_path, "w", &error);
+  if (error)
     {
-      data->use_stdout     = 0;
-      data->output_channel = g_io_channel_new_file (data->output_path, "w", &error);
-      if (error)
-        {
-          g_printerr ("[ERROR] Opening output file failed: %s\n", error->message);
-          exit (1);
-        }
+      g_printerr ("[ERROR] Opening output file failed: %s\n", error->message);
+      exit (1);
     }
 
   data->samples = g_malloc (data->n * sizeof (*data->samples));
@@ -154,14 +137,14 @@ iter_func (FastqSeq     *fastq,
            CallbackData *data)
 {
   if (data->t < data->n)
-    data->samples[data->t] = fastq_seq_copy (fastq);
+    data->samples[data->t] = fastq_seq_detach (fastq, NULL);
   else
     {
       const int rnd = g_rand_int_range (data->rand,
                                         0, data->t);
 
       if (rnd < data->n)
-        data->samples[rnd] = fastq_seq_copy (fastq);
+        fastq_seq_detach (fastq, data->samples[rnd]);
     }
   data->t++;
 
@@ -182,30 +165,15 @@ print_samples (CallbackData *data)
     }
   for (i = 0; i < data->n; i++)
     {
-      GError  *error = NULL;
-      GString *buffer;
-
-      buffer = g_string_sized_new (512);
-      buffer = g_string_append_c (buffer, '@');
-      buffer = g_string_append (buffer, data->samples[i]->name);
-      buffer = g_string_append_c (buffer, '\n');
-
-      buffer = g_string_append (buffer, data->samples[i]->seq);
-      buffer = g_string_append_c (buffer, '\n');
-
-      buffer = g_string_append_c (buffer, '+');
-      buffer = g_string_append (buffer, data->samples[i]->name);
-      buffer = g_string_append_c (buffer, '\n');
-
-      buffer = g_string_append (buffer, data->samples[i]->qual);
-      buffer = g_string_append_c (buffer, '\n');
-
-      g_io_channel_write_chars (data->output_channel,
-                                buffer->str,
-                                -1,
-                                NULL,
-                                &error);
-      g_string_free (buffer, TRUE);
+      GError *error = NULL;
+
+      ngs_writer_printf (data->output_writer,
+                         &error,
+                         "@%s\n%s\n+%s\n%s\n",
+                         data->samples[i]->name,
+                         data->samples[i]->seq,
+                         data->samples[i]->name,
+                         data->samples[i]->qual);
       if (error)
         {
           g_printerr ("[ERROR] Writing sampled sequence failed: %s\n",
@@ -31,15 +31,17 @@ typedef struct _CallbackData CallbackData;
 struct _CallbackData
 {
   char          *input_path;
-  GIOChannel    *output_channel;
-  GIOChannel   **output_channels;
-  GString       *buffer;
+  NgsWriter     *output_writer;
+  NgsWriter    **output_writers;
 
   char          *prefix;
   int            chunks;
   int            count;
   int            paired;
   int            reads;
+  int            gzip;
+  int            bgzf;
+  int            threads;
 };
 
 static int  iter_reads_per_chunk    (FastqSeq       *fastq,
@@ -48,6 +50,10 @@ static int  iter_reads_per_chunk    (FastqSeq       *fastq,
 static int  iter_chunks             (FastqSeq       *fastq,
                                      CallbackData   *data);
 
+static NgsWriter* open_chunk         (CallbackData   *data,
+                                     int             chunk,
+                                     GError        **error);
+
 static void parse_args              (CallbackData   *data,
                                      int            *argc,
                                      char         ***argv);
@@ -67,14 +73,10 @@ main (int    argc,
     {
       int i;
 
-      data.output_channels = g_malloc (data.chunks * sizeof (*data.output_channels));
+      data.output_writers = g_malloc (data.chunks * sizeof (*data.output_writers));
       for (i = 0; i < data.chunks; i++)
         {
-          char *path;
-
-          path = g_strdup_printf ("%s_%06d", data.prefix, i);
-          data.output_channels[i] = g_io_channel_new_file (path, "w", &error);
-          g_free (path);
+          data.output_writers[i] = open_chunk (&data, i, &error);
           if (error)
             {
               g_printerr ("[ERROR] Opening sequence output file failed: %s\n", error->message);
@@ -115,22 +117,28 @@ parse_args (CallbackData   *data,
 {
   GOptionEntry entries[] =
     {
-      {"chunks", 'c', 0, G_OPTION_ARG_INT,    &data->chunks, "Number of chunks (not compatible with -r)",          NULL},
-      {"prefix", 'f', 0, G_OPTION_ARG_STRING, &data->prefix, "Prefix for the output chunks",                       NULL},
-      {"paired", 'p', 0, G_OPTION_ARG_NONE,   &data->paired, "Output reads in pairs",                              NULL},
-      {"reads",  'r', 0, G_OPTION_ARG_INT,    &data->reads,  "Number of reads per chunk (not compatible with -c)", NULL},
+      {"chunks",  'c', 0, G_OPTION_ARG_INT,    &data->chunks,  "Number of chunks (not compatible with -r)",          NULL},
+      {"prefix",  'f', 0, G_OPTION_ARG_STRING, &data->prefix,  "Prefix for the output chunks",                       NULL},
+      {"paired",  'p', 0, G_OPTION_ARG_NONE,   &data->paired,  "Output reads in pairs",                              NULL},
+      {"reads",   'r', 0, G_OPTION_ARG_INT,    &data->reads,   "Number of reads per chunk (not compatible with -c)", NULL},
+      {"gzip",    'g', 0, G_OPTION_ARG_NONE,   &data->gzip,    "Compress the chunks in gzip format",                 NULL},
+      {"bgzf",    'z', 0, G_OPTION_ARG_NONE,   &data->bgzf,    "Compress the chunks in BGZF format",                 NULL},
+      {"threads", 't', 0, G_OPTION_ARG_INT,    &data->threads, "Number of compression threads per chunk",            NULL},
       {NULL}
     };
   GError         *error = NULL;
   GOptionContext *context;
 
-  data->output_channel  = NULL;
-  data->output_channels = NULL;
+  data->output_writer   = NULL;
+  data->output_writers  = NULL;
   data->prefix          = NULL;
   data->chunks          = 0;
   data->count           = 0;
   data->paired          = 0;
   data->reads           = G_MAXINT;
+  data->gzip            = 0;
+  data->bgzf            = 0;
+  data->threads         = 1;
 
   context = g_option_context_new ("FILE - Converts between various flavours of fastq formats");
   g_option_context_add_group (context, get_fastq_option_group ());
@@ -157,8 +165,6 @@ parse_args (CallbackData   *data,
 
   if (!data->prefix)
     data->prefix = "chunk";
-
-  data->buffer = g_string_sized_new (1024);
 }
 
 static int
@@ -170,28 +176,19 @@ iter_reads_per_chunk (FastqSeq     *fastq,
 
   if (data->count > data->reads)
     {
-      char *path;
-
       /* Close current output */
-      if (data->output_channel)
+      if (data->output_writer &&
+          !ngs_writer_close (data->output_writer, &error))
         {
-          g_io_channel_shutdown (data->output_channel, TRUE, &error);
-          if (error)
-            {
-              g_printerr ("[ERROR] Closing sequence output file failed: %s\n", error->message);
-              g_error_free (error);
-              error = NULL;
-            }
-          g_io_channel_unref (data->output_channel);
+          g_printerr ("[ERROR] Closing sequence output file failed: %s\n", error->message);
+          g_error_free (error);
+          error = NULL;
         }
 
       /* Open new output */
-      path = g_strdup_printf ("%s_%06d", data->prefix, data->chunks);
-      data->output_channel = g_io_channel_new_file (path, "w", &error);
-      g_free (path);
+      data->output_writer = open_chunk (data, data->chunks, &error);
       if (error)
         {
-          data->output_channel = NULL;
           g_printerr ("[ERROR] Opening sequence output file failed: %s\n", error->message);
           g_error_free (error);
           return 0;
@@ -202,8 +199,7 @@ iter_reads_per_chunk (FastqSeq     *fastq,
     }
 
   /* Write current read */
-  fastq_write (data->output_channel,
-               data->buffer,
+  fastq_write (data->output_writer,
                fastq->name,
                fastq->seq,
                fastq->qual,
@@ -227,16 +223,15 @@ iter_chunks (FastqSeq     *fastq,
 {
   GError *error = NULL;
   int     ret   = 1;
-  int     channel_id;
+  int     writer_id;
 
   if (data->paired)
-    channel_id = (data->count / 2) % data->chunks;
+    writer_id = (data->count / 2) % data->chunks;
   else
-    channel_id = data->count % data->chunks;
+    writer_id = data->count % data->chunks;
 
   /* Write current read */
-  fastq_write (data->output_channels[channel_id],
-               data->buffer,
+  fastq_write (data->output_writers[writer_id],
                fastq->name,
                fastq->seq,
                fastq->qual,
@@ -254,41 +249,58 @@ iter_chunks (FastqSeq     *fastq,
   return ret;
 }
 
+static NgsWriter*
+open_chunk (CallbackData  *data,
+            int            chunk,
+            GError       **error)
+{
+  NgsWriter      *writer;
+  NgsCompression  compression = NGS_COMPRESSION_NONE;
+  char           *path;
+
+  if (data->bgzf)
+    compression = NGS_COMPRESSION_BGZF;
+  else if (data->gzip)
+    compression = NGS_COMPRESSION_GZIP;
+  path   = g_strdup_printf ("%s_%06d%s",
+                            data->prefix,
+                            chunk,
+                            compression == NGS_COMPRESSION_NONE ? "" : ".gz");
+  writer = ngs_writer_new_compressed (path,
+                                      "w",
+                                      compression,
+                                      data->threads,
+                                      error);
+  g_free (path);
+
+  return writer;
+}
+
 static void
 cleanup (CallbackData *data)
 {
   GError *error = NULL;
 
-  if (data->output_channels)
+  if (data->output_writers)
     {
       int i;
 
       for (i = 0; i < data->chunks; i++)
-        {
-          g_io_channel_shutdown (data->output_channels[i], TRUE, &error);
-          if (error)
-            {
-              g_printerr ("[ERROR] Closing sequence output file failed: %s\n", error->message);
-              g_error_free (error);
-              error = NULL;
-            }
-          g_io_channel_unref (data->output_channels[i]);
-        }
-      g_free (data->output_channels);
+        if (!ngs_writer_close (data->output_writers[i], &error))
+          {
+            g_printerr ("[ERROR] Closing sequence output file failed: %s\n", error->message);
+            g_error_free (error);
+            error = NULL;
+          }
+      g_free (data->output_writers);
     }
-  if (data->output_channel)
+  if (data->output_writer &&
+      !ngs_writer_close (data->output_writer, &error))
     {
-      g_io_channel_shutdown (data->output_channel, TRUE, &error);
-      if (error)
-        {
-          g_printerr ("[ERROR] Closing sequence output file failed: %s\n", error->message);
-          g_error_free (error);
-          error = NULL;
-        }
-      g_io_channel_unref (data->output_channel);
+      g_printerr ("[ERROR] Closing sequence output file failed: %s\n", error->message);
+      g_error_free (error);
+      error = NULL;
     }
-
-  g_string_free (data->buffer, TRUE);
 }
 
 /* vim:ft=c:expandtab:sw=4:ts=4:sts=4:cinoptions={.5s^-2n-2(0:
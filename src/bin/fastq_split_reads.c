@@ -32,9 +32,7 @@ struct _CallbackData
 {
   char       *input_path;
   char       *output_path;
-  GIOChannel *output_channel;
-
-  int         use_stdout: 1;
+  NgsWriter  *output_writer;
 };
 
 static int  iter_func  (FastqSeq       *fastq,
@@ -64,19 +62,11 @@ main (int    argc,
       error = NULL;
     }
 
-  if (data.output_channel)
+  if (!ngs_writer_close (data.output_writer, &error))
     {
-      if (!data.use_stdout)
-        {
-          g_io_channel_shutdown (data.output_channel, TRUE, &error);
-          if (error)
-            {
-              g_printerr ("[ERROR] Closing output file failed: %s\n", error->message);
-              g_error_free (error);
-              error = NULL;
-            }
-        }
-      g_io_channel_unref (data.output_channel);
+      g_printerr ("[ERROR] Closing output file failed: %s\n", error->message);
+      g_error_free (error);
+      error = NULL;
     }
   if (data.output_path)
     g_free (data.output_path);
@@ -98,7 +88,6 @@ parse_args (CallbackData   *data,
   GOptionContext *context;
 
   data->output_path = NULL;
-  data->use_stdout  = 1;
 
   context = g_option_context_new ("FILE - Splits fastq files where both mate pairs are in the same sequence");
   g_option_context_add_group (context, get_fastq_option_group ());
@@ -119,20 +108,11 @@ parse_args (CallbackData   *data,
 
   if (!data->output_path)
     data->output_path = g_strdup ("-");
-  if (data->output_path[0] == '-' && data->output_path[1] == '\0')
-    {
-      data->use_stdout      = 1;
-      data->output_channel = g_io_channel_unix_new (STDOUT_FILENO);
-    }
-  else
+  data->output_writer = ngs_writer_new (data->output_path, "w", &error);
+  if (error)
     {
-      data->use_stdout      = 0;
-      data->output_channel = g_io_channel_new_file (data->output_path, "w", &error);
-      if (error)
-        {
-          g_printerr ("[ERROR] Opening sequence output file failed: %s\n", error->message);
-          exit (1);
-        }
+      g_printerr ("[ERROR] Opening sequence output file failed: %s\n", error->message);
+      exit (1);
     }
 }
 
@@ -140,42 +120,26 @@ static int
 iter_func (FastqSeq     *fastq,
            CallbackData *data)
 {
-  GError  *error = NULL;
-  GString *buffer;
-  int      ret   = 1;
-
-  buffer = g_string_sized_new (512);
-
-  buffer = g_string_append_c (buffer, '@');
-  buffer = g_string_append (buffer, fastq->name);
-  buffer = g_string_append_c (buffer, '\n');
-  buffer = g_string_append_len (buffer, fastq->seq, fastq->size / 2);
-  buffer = g_string_append_c (buffer, '\n');
-
-  buffer = g_string_append_c (buffer, '+');
-  buffer = g_string_append (buffer, fastq->name);
-  buffer = g_string_append_c (buffer, '\n');
-  buffer = g_string_append_len (buffer, fastq->qual, fastq->size / 2);
-  buffer = g_string_append_c (buffer, '\n');
+  GError    *error = NULL;
+  const int  half  = fastq->size / 2;
+  int        ret   = 1;
+
+  ngs_writer_printf (data->output_writer,
+                     NULL,
+                     "@%s\n%.*s\n+%s\n%.*s\n",
+                     fastq->name,
+                     half, fastq->seq,
+                     fastq->name,
+                     half, fastq->qual);
 
   fastq->name[strlen (fastq->name) - 1] = '2';
-  buffer = g_string_append_c (buffer, '@');
-  buffer = g_string_append (buffer, fastq->name);
-  buffer = g_string_append_c (buffer, '\n');
-  buffer = g_string_append (buffer, fastq->seq + fastq->size / 2);
-  buffer = g_string_append_c (buffer, '\n');
-
-  buffer = g_string_append_c (buffer, '+');
-  buffer = g_string_append (buffer, fastq->name);
-  buffer = g_string_append_c (buffer, '\n');
-  buffer = g_string_append (buffer, fastq->qual + fastq->size / 2);
-  buffer = g_string_append_c (buffer, '\n');
-
-  g_io_channel_write_chars (data->output_channel,
-                            buffer->str,
-                            -1,
-                            NULL,
-                            &error);
+  ngs_writer_printf (data->output_writer,
+                     &error,
+                     "@%s\n%s\n+%s\n%s\n",
+                     fastq->name,
+                     fastq->seq + half,
+                     fastq->name,
+                     fastq->qual + half);
   if (error)
     {
       g_printerr ("[ERROR] Writing sequence failed: %s\n", error->message);
@@ -183,7 +147,6 @@ iter_func (FastqSeq     *fastq,
       error = NULL;
       ret   = 0;
     }
-  g_string_free (buffer, TRUE);
 
   return ret;
 }
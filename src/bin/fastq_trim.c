@@ -31,7 +31,7 @@ struct _CallbackData
 {
   char        *input_path;
   char        *output_path;
-  GIOChannel  *output_channel;
+  NgsWriter   *output_writer;
 
   int          start;
   int          end;
@@ -42,11 +42,12 @@ struct _CallbackData
   int          qwin;
   int          non;
   int          keep;
+  int          gzip;
+  int          bgzf;
+  int          threads;
 
   char         n_char1;
   char         n_char2;
-
-  unsigned int use_stdout: 1;
 };
 
 static void parse_args  (CallbackData      *data,
@@ -54,6 +55,7 @@ static void parse_args  (CallbackData      *data,
                          char            ***argv);
 
 static int  iter_func   (FastqSeq          *fastq,
+                         GString           *output,
                          CallbackData      *data);
 
 int
@@ -65,10 +67,13 @@ main (int    argc,
 
   parse_args (&data, &argc, &argv);
 
-  iter_fastq (data.input_path,
-              (FastqIterFunc)iter_func,
-              &data,
-              &error);
+  iter_fastq_parallel (data.input_path,
+                       (FastqParallelFunc)iter_func,
+                       &data,
+                       data.threads,
+                       1,
+                       data.output_writer,
+                       &error);
 
   if (error)
     {
@@ -78,20 +83,13 @@ main (int    argc,
       error = NULL;
       return 1;
     }
-  if (data.output_channel)
+  if (!ngs_writer_close (data.output_writer, &error))
     {
-      if (!data.use_stdout)
-        {
-          g_io_channel_shutdown (data.output_channel, TRUE, &error);
-          if (error)
-            {
-              g_printerr ("[ERROR] Closing output file failed: %s\n",
-                          error->message);
-              g_error_free (error);
-              error = NULL;
-            }
-        }
-      g_io_channel_unref (data.output_channel);
+      g_printerr ("[ERROR] Closing output file failed: %s\n",
+                  error->message);
+      g_error_free (error);
+      error = NULL;
+      return 1;
     }
 
   return 0;
@@ -104,23 +102,25 @@ parse_args (CallbackData      *data,
 {
   GOptionEntry entries[] =
     {
-      {"out",    'o', 0, G_OPTION_ARG_FILENAME, &data->output_path, "Output file",                              NULL},
-      {"start",  's', 0, G_OPTION_ARG_INT,      &data->start,       "Number of positions to trim at the start", NULL},
-      {"end",    'e', 0, G_OPTION_ARG_INT,      &data->end,         "Number of positions to trim at the end",   NULL},
-      {"qual",   'q', 0, G_OPTION_ARG_INT,      &data->qual,        "Minimum quality",                          NULL},
-      {"len",    'l', 0, G_OPTION_ARG_INT,      &data->len,         "Minimum length",                           NULL},
-      {"win",    'w', 0, G_OPTION_ARG_INT,      &data->win,         "Size of the slidding window",              NULL},
-      {"qwin",   'n', 0, G_OPTION_ARG_INT,      &data->qwin,        "Minimum sliding window mean quality",      NULL},
-      {"non",    'N', 0, G_OPTION_ARG_NONE,     &data->non,         "Remove all Ns",                            NULL},
-      {"keep",   'k', 0, G_OPTION_ARG_NONE,     &data->keep,        "Keep an pseudo-entry for too small reads", NULL},
+      {"out",     'o', 0, G_OPTION_ARG_FILENAME, &data->output_path, "Output file",                              NULL},
+      {"start",   's', 0, G_OPTION_ARG_INT,      &data->start,       "Number of positions to trim at the start", NULL},
+      {"end",     'e', 0, G_OPTION_ARG_INT,      &data->end,         "Number of positions to trim at the end",   NULL},
+      {"qual",    'q', 0, G_OPTION_ARG_INT,      &data->qual,        "Minimum quality",                          NULL},
+      {"len",     'l', 0, G_OPTION_ARG_INT,      &data->len,         "Minimum length",                           NULL},
+      {"win",     'w', 0, G_OPTION_ARG_INT,      &data->win,         "Size of the slidding window",              NULL},
+      {"qwin",    'n', 0, G_OPTION_ARG_INT,      &data->qwin,        "Minimum sliding window mean quality",      NULL},
+      {"non",     'N', 0, G_OPTION_ARG_NONE,     &data->non,         "Remove all Ns",                            NULL},
+      {"keep",    'k', 0, G_OPTION_ARG_NONE,     &data->keep,        "Keep an pseudo-entry for too small reads", NULL},
+      {"gzip",    'g', 0, G_OPTION_ARG_NONE,     &data->gzip,        "Compress the output in gzip format",       NULL},
+      {"bgzf",    'z', 0, G_OPTION_ARG_NONE,     &data->bgzf,        "Compress the output in BGZF format",       NULL},
+      {"threads", 't', 0, G_OPTION_ARG_INT,      &data->threads,     "Number of threads",                        NULL},
       {NULL}
     };
   GError         *error = NULL;
   GOptionContext *context;
 
   data->output_path    = "-";
-  data->output_channel = NULL;
-  data->use_stdout     = 1;
+  data->output_writer  = NULL;
   data->start          = 0;
   data->end            = 0;
   data->qual           = 0;
@@ -131,6 +131,9 @@ parse_args (CallbackData      *data,
   data->n_char1        = '\0';
   data->n_char2        = '\0';
   data->keep           = 0;
+  data->gzip           = 0;
+  data->bgzf           = 0;
+  data->threads        = 1;
 
   context = g_option_context_new ("FILE - trims fastq reads");
   g_option_context_add_group (context, get_fastq_option_group ());
@@ -170,41 +173,35 @@ parse_args (CallbackData      *data,
       data->n_char2 = 'n';
     }
 
-  if (data->output_path[0] == '-' && data->output_path[1] == '\0')
-    data->output_channel = g_io_channel_unix_new (STDOUT_FILENO);
-  else
+  data->output_writer = ngs_writer_new_compressed (data->output_path,
+                                                   "w",
+                                                   data->bgzf ? NGS_COMPRESSION_BGZF :
+                                                   data->gzip ? NGS_COMPRESSION_GZIP :
+                                                   NGS_COMPRESSION_NONE,
+                                                   data->threads,
+                                                   &error);
+  if (error)
     {
-      data->use_stdout     = 0;
-      data->output_channel = g_io_channel_new_file (data->output_path, "w", &error);
-      if (error)
-        {
-          g_printerr ("[ERROR] Opening output file failed: %s\n", error->message);
-          exit (1);
-        }
+      g_printerr ("[ERROR] Opening output file failed: %s\n", error->message);
+      exit (1);
     }
 }
 
 static int
 iter_func (FastqSeq     *fastq,
+           GString      *output,
            CallbackData *data)
 {
-  GError *error = NULL;
-  int     start;
-  int     end;
+  int start;
+  int end;
 
   if (fastq->size - data->tot_trim <= data->len)
     {
       if (data->keep)
-        {
-          fastq_write (data->output_channel,
-                       NULL,
-                       fastq->name,
-                       "N",
-                       fastq_qual_min_str,
-                       &error);
-          if (error != NULL)
-            goto error;
-        }
+        fastq_append (output,
+                      fastq->name,
+                      "N",
+                      fastq_qual_min_str);
       return 1;
     }
 
@@ -300,36 +297,18 @@ iter_func (FastqSeq     *fastq,
   if (end <= start || end - start < data->len)
     {
       if (data->keep)
-        {
-          fastq_write (data->output_channel,
-                       NULL,
-                       fastq->name,
-                       "N",
-                       fastq_qual_min_str,
-                       &error);
-          if (error != NULL)
-            goto error;
-        }
+        fastq_append (output,
+                      fastq->name,
+                      "N",
+                      fastq_qual_min_str);
     }
   else
-    {
-      fastq_write_fragment (data->output_channel,
-                            NULL,
-                            fastq->name,
-                            fastq->seq,
-                            fastq->qual,
-                            start, end,
-                            &error);
-      if (error != NULL)
-        goto error;
-    }
+    fastq_append_fragment (output,
+                           fastq->name,
+                           fastq->seq,
+                           fastq->qual,
+                           start, end);
   return 1;
-
-error:
-  g_printerr ("[ERROR] Writing trimmed sequence failed: %s\n",
-              error->message);
-  g_error_free (error);
-  return 0;
 }
 
 /* vim:ft=c:expandtab:sw=4:ts=4:sts=4:cinoptions={.5s^-2n-2(0:
@@ -33,6 +33,9 @@
 #define SEED_SIZE 8
 #define NB_SEEDS  (1 << (SEED_SIZE * BITS_PER_NUC))
 
+/* The counters are shared by all the threads */
+#define COUNTER_INC(counter) __sync_fetch_and_add (&(counter), 1)
+
 
 typedef struct _Adaptor Adaptor;
 
@@ -68,8 +71,7 @@ struct _CallbackData
   char       *adaptors_path;
   char       *reads_path;
   char       *out_path;
-  GIOChannel *out_channel;
-  GString    *buffer;
+  NgsWriter  *out_writer;
 
   Seed      **seeds;
 
@@ -84,11 +86,13 @@ struct _CallbackData
   int         suf;
   int         remove;
   int         verbose;
-
-  int         use_stdout: 1;
+  int         gzip;
+  int         bgzf;
+  int         threads;
 };
 
 static int        iter_func            (FastqSeq       *fastq,
+                                        GString        *output,
                                         CallbackData   *data);
 
 static void       parse_args           (CallbackData   *data,
@@ -143,10 +147,13 @@ main (int    argc,
   init_seeds (&data);
   if (data.verbose)
     g_printerr("Parsing fastq file\n");
-  iter_fastq (data.reads_path,
-              (FastqIterFunc)iter_func,
-              &data,
-              &error);
+  iter_fastq_parallel (data.reads_path,
+                       (FastqParallelFunc)iter_func,
+                       &data,
+                       data.threads,
+                       1,
+                       data.out_writer,
+                       &error);
   if (error)
     {
       g_printerr ("[ERROR] Iterating sequences failed: %s\n", error->message);
@@ -174,20 +181,24 @@ parse_args (CallbackData   *data,
       {"suf",      's', 0, G_OPTION_ARG_INT,      &data->suf,      "Length sufficient to call a full match",     NULL},
       {"remove",   'r', 0, G_OPTION_ARG_NONE,     &data->remove,   "Remove instead of trim reads with adaptors", NULL},
       {"verbose",  'v', 0, G_OPTION_ARG_NONE,     &data->verbose,  "Verbose output",                             NULL},
+      {"gzip",     'g', 0, G_OPTION_ARG_NONE,     &data->gzip,     "Compress the output in gzip format",         NULL},
+      {"bgzf",     'z', 0, G_OPTION_ARG_NONE,     &data->bgzf,     "Compress the output in BGZF format",         NULL},
+      {"threads",  't', 0, G_OPTION_ARG_INT,      &data->threads,  "Number of threads",                          NULL},
       {NULL}
     };
   GError         *error = NULL;
   GOptionContext *context;
 
   data->out_path         = "-";
-  data->out_channel      = NULL;
-  data->buffer           = NULL;
-  data->use_stdout       = 1;
+  data->out_writer       = NULL;
   data->len              = 2 * SEED_SIZE;
   data->mis              = 1;
   data->suf              = G_MAXINT;
   data->remove           = 0;
   data->verbose          = 0;
+  data->gzip             = 0;
+  data->bgzf             = 0;
+  data->threads          = 1;
   data->n_reads          = 0;
   data->reads_found      = 0;
 
@@ -220,36 +231,32 @@ parse_args (CallbackData   *data,
   if (!data->out_path)
         data->out_path = "-";
 
-  if (data->out_path[0] == '-' && data->out_path[1] == '\0')
-    {
-      data->use_stdout  = 1;
-      data->out_channel = g_io_channel_unix_new (STDOUT_FILENO);
-    }
-  else
+  data->out_writer = ngs_writer_new_compressed (data->out_path,
+                                                "w",
+                                                data->bgzf ? NGS_COMPRESSION_BGZF :
+                                                data->gzip ? NGS_COMPRESSION_GZIP :
+                                                NGS_COMPRESSION_NONE,
+                                                data->threads,
+                                                &error);
+  if (error)
     {
-      data->use_stdout  = 0;
-      data->out_channel = g_io_channel_new_file (data->out_path, "w", &error);
-      if (error)
-        {
-          g_printerr ("[ERROR] Opening sequence output file failed: %s\n", error->message);
-          exit (1);
-        }
+      g_printerr ("[ERROR] Opening sequence output file failed: %s\n", error->message);
+      exit (1);
     }
-  data->buffer = g_string_sized_new (512);
 }
 
 static int
 iter_func (FastqSeq     *fastq,
+           GString      *output,
            CallbackData *data)
 {
-  int     i;
-  int     maxi;
-  int     ret   = 1;
-  int     found = 0;
-  char   *mask  = NULL;
-  GError *error = NULL;
+  int   i;
+  int   maxi;
+  int   ret   = 1;
+  int   found = 0;
+  char *mask  = NULL;
 
-  ++data->n_reads;
+  COUNTER_INC (data->n_reads);
   if (fastq->size < data->len)
     return ret;
 
@@ -279,9 +286,9 @@ iter_func (FastqSeq     *fastq,
               if (match)
                 {
                   if (seed->forward)
-                    seed->adaptor->counts_fh++;
+                    COUNTER_INC (seed->adaptor->counts_fh);
                   else
-                    seed->adaptor->counts_rh++;
+                    COUNTER_INC (seed->adaptor->counts_rh);
 
                   if (!data->remove)
                     {
@@ -310,9 +317,9 @@ iter_func (FastqSeq     *fastq,
               if (match)
                 {
                   if (seed->forward)
-                    seed->adaptor->counts_ft++;
+                    COUNTER_INC (seed->adaptor->counts_ft);
                   else
-                    seed->adaptor->counts_rt++;
+                    COUNTER_INC (seed->adaptor->counts_rt);
 
                   if (!data->remove)
                     {
@@ -373,48 +380,25 @@ iter_func (FastqSeq     *fastq,
         }
 
       if (max_start == -1)
-        fastq_write (data->out_channel,
-                     data->buffer,
-                     fastq->name,
-                     "N",
-                     fastq_qual_min_str,
-                   &error);
+        fastq_append (output,
+                      fastq->name,
+                      "N",
+                      fastq_qual_min_str);
       else
-        fastq_write_fragment (data->out_channel,
-                              data->buffer,
-                              fastq->name,
-                              fastq->seq,
-                              fastq->qual,
-                              max_start,
-                              max_start + max_len,
-                              &error);
-      data->reads_found++;
+        fastq_append_fragment (output,
+                               fastq->name,
+                               fastq->seq,
+                               fastq->qual,
+                               max_start,
+                               max_start + max_len);
+      COUNTER_INC (data->reads_found);
       g_free (mask);
-
-      if (error != NULL)
-        {
-          g_printerr ("[ERROR] Writing sequence failed: %s\n",
-                      error->message);
-          g_error_free (error);
-          return 0;
-        }
     }
   else
-    {
-      fastq_write (data->out_channel,
-                   data->buffer,
-                   fastq->name,
-                   fastq->seq,
-                   fastq->qual,
-                   &error);
-      if (error != NULL)
-        {
-          g_printerr ("[ERROR] Writing sequence failed: %s\n",
-                      error->message);
-          g_error_free (error);
-          return 0;
-        }
-    }
+    fastq_append (output,
+                  fastq->name,
+                  fastq->seq,
+                  fastq->qual);
 
   return ret;
 }
@@ -730,21 +714,16 @@ cleanup_data (CallbackData *data)
   if (data->verbose)
     g_printerr ("Cleaning up\n");
 
-  if (data->out_channel)
+  if (data->out_writer)
     {
-      if (!data->use_stdout)
-        {
-          GError *error = NULL;
+      GError *error = NULL;
 
-          g_io_channel_shutdown (data->out_channel, TRUE, &error);
-          if (error)
-            {
-              g_printerr ("[ERROR] Closing sequence output file failed: %s\n", error->message);
-              g_error_free (error);
-              error = NULL;
-            }
+      if (!ngs_writer_close (data->out_writer, &error))
+        {
+          g_printerr ("[ERROR] Closing sequence output file failed: %s\n", error->message);
+          g_error_free (error);
+          error = NULL;
         }
-      g_io_channel_unref (data->out_channel);
     }
 
   if (data->adaptors != NULL)
@@ -780,12 +759,6 @@ cleanup_data (CallbackData *data)
       g_free (data->seeds);
       data->seeds = NULL;
     }
-
-  if (data->buffer != NULL)
-    {
-      g_string_free (data->buffer, TRUE);
-      data->buffer = NULL;
-    }
 }
 
 static int
@@ -31,6 +31,8 @@
 #include "ngs_memalloc.h"
 #include "ngs_utils.h"
 
+#define FASTA_WINDOW_SIZE (4 * 1024 * 1024)
+
 
 typedef struct _CallbackData CallbackData;
 
@@ -46,13 +48,17 @@ struct _CallbackData
 
   KmerHashTable     *htable;
   unsigned char     *tmp_kmer;
+  char              *rc_buffer;
+  unsigned long int  rc_size;
 
   unsigned long int  n_seqs;
   unsigned long int  freq_report;
+  unsigned long int  window_size;
   unsigned int       k;
   unsigned int       k_bytes;
   int                do_revcomp;
   int                is_fastq;
+  int                threads;
   int                bin_out;
   int                verbose;
 };
@@ -63,8 +69,8 @@ static void              parse_args                 (CallbackData        *data,
                                                      int                 *argc,
                                                      char              ***argv);
 
-static int               iter_func_fasta            (FastaSeq            *fasta,
-                                                     CallbackData        *data);
+static void              iter_fasta_windows         (CallbackData        *data,
+                                                     GError             **error);
 
 static int               iter_func_fastq            (FastqSeq            *fasta,
                                                      CallbackData        *data);
@@ -73,12 +79,19 @@ static int               iter_func_char             (char                *seq,
                                                      unsigned long int    size,
                                                      CallbackData        *data);
 
+static int               iter_count_seq             (CallbackData        *data,
+                                                     const char          *seq,
+                                                     unsigned long int    size);
+
 static int               iter_char_seq              (CallbackData        *data,
                                                      const char          *seq,
                                                      unsigned long int    size);
 
 static void              print_results              (CallbackData        *data);
 
+static void              iter_parts                 (CallbackData        *data,
+                                                     GError             **error);
+
 int
 main (int    argc,
       char **argv)
@@ -89,15 +102,9 @@ main (int    argc,
   parse_args (&data, &argc, &argv);
 
   if (data.is_fastq)
-    iter_fastq (data.input_path,
-                (FastqIterFunc)iter_func_fastq,
-                &data,
-                &error);
+    iter_parts (&data, &error);
   else
-    iter_fasta (data.input_path,
-                (FastaIterFunc)iter_func_fasta,
-                &data,
-                &error);
+    iter_fasta_windows (&data, &error);
   if (error)
     {
       g_printerr ("[ERROR] Iterating sequences failed: %s\n", error->message);
@@ -114,6 +121,7 @@ main (int    argc,
     g_free (data.output_path);
   if (data.tmp_kmer)
     g_free (data.tmp_kmer);
+  g_free (data.rc_buffer);
 
   return 0;
 }
@@ -130,6 +138,7 @@ parse_args (CallbackData      *data,
       {"freqrep",  'e', 0, G_OPTION_ARG_INT,      &data->freq_report, "Verbose-report frequency", NULL},
       {"revcomp",  'r', 0, G_OPTION_ARG_NONE,     &data->do_revcomp,  "Also scan the reverse complement", NULL},
       {"fastq",    'q', 0, G_OPTION_ARG_NONE,     &data->is_fastq,    "Input is in fastq format", NULL},
+      {"threads",  't', 0, G_OPTION_ARG_INT,      &data->threads,     "Number of threads (fastq input only)", NULL},
       {"binout",   'b', 0, G_OPTION_ARG_NONE,     &data->bin_out,     "Write output in binary format", NULL},
       {"verbose",  'v', 0, G_OPTION_ARG_NONE,     &data->verbose,     "Verbose output", NULL},
       {NULL}
@@ -140,13 +149,17 @@ parse_args (CallbackData      *data,
   data->k           = 31;
   data->do_revcomp  = 0;
   data->is_fastq    = 0;
+  data->threads     = 1;
   data->bin_out     = 0;
   data->verbose     = 0;
   data->n_seqs      = 0;
   data->freq_report = 1000000;
+  data->window_size = FASTA_WINDOW_SIZE;
   data->output_path = strdup("-");
   data->htable      = NULL;
   data->tmp_kmer    = NULL;
+  data->rc_buffer   = NULL;
+  data->rc_size     = 0;
 
   context = g_option_context_new ("FILE - Count the number of kmers in a fasta/fastq file");
   g_option_context_add_group (context, get_fasta_option_group ());
@@ -177,15 +190,42 @@ parse_args (CallbackData      *data,
   data->htable   = kmer_hash_table_new (data->k);
   data->tmp_kmer = g_malloc0 (MAX (KMER_VAL_BYTES, data->k_bytes));
 
+  /* Only the sequences are used */
+  fastq_set_columns (FASTQ_COLUMN_SEQ);
+
   if (data->verbose)
     g_printerr ("Parsing %s with k = %d\n", data->input_path, data->k);
 }
 
-static int
-iter_func_fasta (FastaSeq     *fasta,
-                 CallbackData *data)
+/**
+ * The fasta sequences are read in windows that overlap by k - 1 bases, so
+ * that memory does not depend on the size of the sequences.
+ */
+static void
+iter_fasta_windows (CallbackData  *data,
+                    GError       **error)
 {
-  return iter_func_char (fasta->seq, fasta->size, data);
+  FastaWindowIter *iter;
+  FastaWindow     *window;
+
+  iter = fasta_window_iter_new (data->input_path,
+                                MAX (data->window_size, 2 * data->k),
+                                data->k - 1,
+                                error);
+  if (iter == NULL)
+    return;
+  while ((window = fasta_window_iter_next (iter, error)) != NULL)
+    {
+      if (iter_count_seq (data, window->seq, window->size) != 1)
+        break;
+      if (window->last)
+        {
+          data->n_seqs++;
+          if (data->verbose && data->n_seqs % data->freq_report == 0)
+            g_printerr ("Parsed %ld sequences\n", data->n_seqs);
+        }
+    }
+  fasta_window_iter_free (iter);
 }
 
 static int
@@ -202,11 +242,9 @@ iter_func_char (char              *seq,
 {
   int            ret;
 
-  ret = iter_char_seq (data, seq, size);
+  ret = iter_count_seq (data, seq, size);
   if (ret != 1)
     return ret;
-  if (data->do_revcomp)
-    ret = iter_char_seq (data, rev_comp_in_place (seq, size), size);
 
   data->n_seqs++;
   if (data->verbose && data->n_seqs % data->freq_report == 0)
@@ -215,6 +253,82 @@ iter_func_char (char              *seq,
   return ret;
 }
 
+/**
+ * The reverse complement goes to a separate buffer, as the end of a fasta
+ * window is reused as the start of the next one.
+ */
+static int
+iter_count_seq (CallbackData      *data,
+                const char        *seq,
+                unsigned long int  size)
+{
+  int ret;
+
+  ret = iter_char_seq (data, seq, size);
+  if (ret != 1)
+    return ret;
+  if (data->do_revcomp)
+    {
+      if (size > data->rc_size)
+        {
+          data->rc_size   = size;
+          data->rc_buffer = g_realloc (data->rc_buffer, size);
+        }
+      ret = iter_char_seq (data, rev_comp (seq, data->rc_buffer, size), size);
+    }
+
+  return ret;
+}
+
+/**
+ * Each thread counts the kmers of its part of the file in its own table,
+ * the tables are then merged into the first one.
+ */
+static void
+iter_parts (CallbackData  *data,
+            GError       **error)
+{
+  CallbackData  *parts;
+  void         **parts_data;
+  int            i;
+
+  if (data->threads < 1)
+    data->threads = 1;
+  parts      = g_new (CallbackData, data->threads);
+  parts_data = g_new (void*, data->threads);
+  for (i = 0; i < data->threads; i++)
+    {
+      parts[i]      = *data;
+      parts_data[i] = parts + i;
+      if (i > 0)
+        {
+          parts[i].htable   = kmer_hash_table_new (data->k);
+          parts[i].tmp_kmer = g_malloc0 (MAX (KMER_VAL_BYTES, data->k_bytes));
+        }
+    }
+
+  iter_fastq_ranges (data->input_path,
+                     (FastqIterFunc)iter_func_fastq,
+                     parts_data,
+                     data->threads,
+                     error);
+
+  data->n_seqs = parts[0].n_seqs;
+  for (i = 1; i < data->threads; i++)
+    {
+      if (!*error)
+        kmer_hash_table_merge (data->htable, parts[i].htable);
+      data->n_seqs += parts[i].n_seqs;
+      kmer_hash_table_destroy (parts[i].htable);
+      g_free (parts[i].tmp_kmer);
+    }
+  for (i = 0; i < data->threads; i++)
+    g_free (parts[i].rc_buffer);
+
+  g_free (parts_data);
+  g_free (parts);
+}
+
 static void
 print_results (CallbackData *data)
 {
@@ -53,6 +53,9 @@ struct _CallbackData
   int           n_coords;
 
   int           verbose;
+  int           gzip;
+  int           threads;
+  int           no_check;
 };
 
 static void             parse_args      (CallbackData   *data,
@@ -111,6 +114,9 @@ parse_args (CallbackData   *data,
       {"output",  'o', 0, G_OPTION_ARG_FILENAME,     &data->output_path, "Output path prefix", NULL},
       {"coords",  'c', 0, G_OPTION_ARG_STRING_ARRAY, &data->coords_str,  "Coordinates for filtering (1-based, inclusive)", "START,END"},
       {"verbose", 'v', 0, G_OPTION_ARG_NONE,         &data->verbose,     "Verbose output", NULL},
+      {"gzip",    'g', 0, G_OPTION_ARG_NONE,         &data->gzip,        "Compress the output in gzip format", NULL},
+      {"threads", 't', 0, G_OPTION_ARG_INT,          &data->threads,     "Number of compression threads per output", NULL},
+      {"nocheck", 'n', 0, G_OPTION_ARG_NONE,         &data->no_check,    "Do not check that the names of mates match", NULL},
       {NULL}
     };
   GError         *error = NULL;
@@ -123,8 +129,11 @@ parse_args (CallbackData   *data,
   data->start_coords   = NULL;
   data->end_coords     = NULL;
   data->verbose        = 0;
+  data->gzip           = 0;
+  data->threads        = 1;
+  data->no_check       = 0;
 
-  context = g_option_context_new ("FILE1 FILE2 - filters out clonal sequences from a pair fastq files");
+  context = g_option_context_new ("FILE1 [FILE2] - filters out clonal sequences from a pair fastq files (or an interleaved file)");
   g_option_context_add_group (context, get_fastq_option_group ());
   g_option_context_add_main_entries (context, entries, NULL);
   if (!g_option_context_parse (context, argc, argv, &error))
@@ -134,20 +143,20 @@ parse_args (CallbackData   *data,
     }
   g_option_context_free (context);
 
-  if (*argc < 3)
+  if (*argc < 2)
     {
       g_printerr ("[ERROR] No input file provided\n");
       exit (1);
     }
   data->input_path1 = (*argv)[1];
-  data->input_path2 = (*argv)[2];
+  data->input_path2 = *argc > 2 ? (*argv)[2] : NULL;
 
   parse_coords (data);
 
   if (data->output_path)
     {
-      data->output_path1 = g_strconcat (data->output_path, ".1", NULL);
-      data->output_path2 = g_strconcat (data->output_path, ".2", NULL);
+      data->output_path1 = g_strconcat (data->output_path, ".1", data->gzip ? ".gz" : NULL, NULL);
+      data->output_path2 = g_strconcat (data->output_path, ".2", data->gzip ? ".gz" : NULL, NULL);
     }
   else
     data->output_path = g_strdup ("-");
@@ -252,8 +261,7 @@ load_sequences  (CallbackData   *data)
   GError        *error = NULL;
   FastqSeq      *seq1;
   FastqSeq      *seq2;
-  FastqIter     *iter1;
-  FastqIter     *iter2;
+  FastqPairIter *iter;
   KmerHashTable *hash_table;
   unsigned char *kmer;
   unsigned int   start;
@@ -271,28 +279,23 @@ load_sequences  (CallbackData   *data)
   hash_table = kmer_hash_table_new (k_bytes * NUCS_PER_BYTE * 2);
   kmer       = g_malloc0 (2 * k_bytes * sizeof (*kmer));
 
-  iter1 = fastq_iter_new (data->input_path1, &error);
+  iter = fastq_pair_iter_new (data->input_path1,
+                              data->input_path2,
+                              !data->no_check,
+                              &error);
   if (error)
     {
-      g_printerr ("[ERROR] Opening %s failed: %s\n", data->input_path1, error->message);
-      exit (1);
-    }
-  iter2 = fastq_iter_new (data->input_path2, &error);
-  if (error)
-    {
-      g_printerr ("[ERROR] Opening %s failed: %s\n", data->input_path2, error->message);
+      g_printerr ("[ERROR] Opening input failed: %s\n", error->message);
       exit (1);
     }
 
-  seq1 = fastq_iter_next (iter1);
-  seq2 = fastq_iter_next (iter2);
-  while (seq1 != NULL && seq2 != NULL)
+  while (fastq_pair_iter_next (iter, &seq1, &seq2, &error))
     {
       KmerHashNode *node;
       FastqPair    *pair;
 
       if (!check_sanity (data, seq1, seq2, start, end))
-        goto iter_next;
+        continue;
 
       /* Build kmer */
       char_to_bin_prealloc (kmer, seq1->seq + start - 1, k);
@@ -303,8 +306,8 @@ load_sequences  (CallbackData   *data)
       if (node->value.ptr == NULL)
         {
           pair            = g_slice_new (FastqPair);
-          pair->seq1      = fastq_seq_copy (seq1);
-          pair->seq2      = fastq_seq_copy (seq2);
+          pair->seq1      = fastq_seq_detach (seq1, NULL);
+          pair->seq2      = fastq_seq_detach (seq2, NULL);
           node->value.ptr = pair;
         }
       /* Compare and replace */
@@ -313,18 +316,17 @@ load_sequences  (CallbackData   *data)
           pair = (FastqPair*) node->value.ptr;
           if (fastq_pair_cmp (data, seq1, seq2, pair->seq1, pair->seq2) > 0)
             {
-              fastq_seq_free (pair->seq1);
-              fastq_seq_free (pair->seq2);
-              pair->seq1 = fastq_seq_copy (seq1);
-              pair->seq2 = fastq_seq_copy (seq2);
+              fastq_seq_detach (seq1, pair->seq1);
+              fastq_seq_detach (seq2, pair->seq2);
             }
         }
-iter_next:
-      seq1 = fastq_iter_next (iter1);
-      seq2 = fastq_iter_next (iter2);
     }
-  fastq_iter_free (iter1);
-  fastq_iter_free (iter2);
+  if (error)
+    {
+      g_printerr ("[ERROR] Reading sequences failed: %s\n", error->message);
+      exit (1);
+    }
+  fastq_pair_iter_free (iter);
   g_free (kmer);
 
   return hash_table;
@@ -444,9 +446,8 @@ write_sequences (CallbackData   *data,
 {
   KmerHashTableIter iter;
   KmerHashNode     *node;
-  GIOChannel       *output_channel1;
-  GIOChannel       *output_channel2;
-  GString          *buffer;
+  NgsWriter        *output_writer1;
+  NgsWriter        *output_writer2;
   GError           *error      = NULL;
   int               use_stdout = 0;
   gulong            written    = 0;
@@ -457,52 +458,53 @@ write_sequences (CallbackData   *data,
   if (data->output_path[0] == '-' && data->output_path[1] == '\0')
     {
       use_stdout     = 1;
-      output_channel1 = g_io_channel_unix_new (STDOUT_FILENO);
-      output_channel2 = output_channel1;
+      output_writer1 = ngs_writer_new_compressed (data->output_path,
+                                                  "w",
+                                                  data->gzip ? NGS_COMPRESSION_GZIP : NGS_COMPRESSION_NONE,
+                                                  data->threads,
+                                                  &error);
+      output_writer2 = output_writer1;
     }
   else
     {
-      output_channel1 = g_io_channel_new_file (data->output_path1,
-                                              "w", &error);
-      if (error)
-        {
-          g_printerr ("[ERROR] Opening sequence output file failed: %s\n",
-                      error->message);
-          exit (1);
-        }
-      output_channel2 = g_io_channel_new_file (data->output_path2,
-                                              "w", &error);
+      output_writer1 = ngs_writer_new_compressed (data->output_path1,
+                                                  "w",
+                                                  data->gzip ? NGS_COMPRESSION_GZIP : NGS_COMPRESSION_NONE,
+                                                  data->threads,
+                                                  &error);
       if (error)
         {
           g_printerr ("[ERROR] Opening sequence output file failed: %s\n",
                       error->message);
           exit (1);
         }
-      g_io_channel_set_encoding (output_channel2, NULL, NULL);
-      g_io_channel_set_buffered (output_channel2, TRUE);
-      g_io_channel_set_buffer_size (output_channel2, 4096 * 128);
+      output_writer2 = ngs_writer_new_compressed (data->output_path2,
+                                                  "w",
+                                                  data->gzip ? NGS_COMPRESSION_GZIP : NGS_COMPRESSION_NONE,
+                                                  data->threads,
+                                                  &error);
+    }
+  if (error)
+    {
+      g_printerr ("[ERROR] Opening sequence output file failed: %s\n",
+                  error->message);
+      exit (1);
     }
-  g_io_channel_set_encoding (output_channel1, NULL, NULL);
-  g_io_channel_set_buffered (output_channel1, TRUE);
-  g_io_channel_set_buffer_size (output_channel1, 4096 * 128);
 
-  buffer = g_string_sized_new (1024);
   kmer_hash_table_iter_init (&iter, hash_table);
   while ((node = kmer_hash_table_iter_next (&iter)) != NULL)
     {
       FastqPair *pair;
 
       pair = (FastqPair*) node->value.ptr;
-      fastq_write (output_channel1,
-                   buffer,
+      fastq_write (output_writer1,
                    pair->seq1->name,
                    pair->seq1->seq,
                    pair->seq1->qual,
                    &error);
       if (error != NULL)
         goto error;
-      fastq_write (output_channel2,
-                   buffer,
+      fastq_write (output_writer2,
                    pair->seq2->name,
                    pair->seq2->seq,
                    pair->seq2->qual,
@@ -523,28 +525,23 @@ error:
     }
 
   /* Cleanup */
-  g_string_free (buffer, TRUE);
+  if (!ngs_writer_close (output_writer1, &error))
+    {
+      g_printerr ("[ERROR] Closing output file failed: %s\n", error->message);
+      g_error_free (error);
+      error = NULL;
+    }
   if (!use_stdout)
     {
-      g_io_channel_shutdown (output_channel1, TRUE, &error);
-      if (error)
-        {
-          g_printerr ("[ERROR] Closing output file failed: %s\n", error->message);
-          g_error_free (error);
-          error = NULL;
-        }
-      g_io_channel_shutdown (output_channel2, TRUE, &error);
-      if (error)
+      if (!ngs_writer_close (output_writer2, &error))
         {
           g_printerr ("[ERROR] Closing output file failed: %s\n", error->message);
           g_error_free (error);
           error = NULL;
         }
-      g_io_channel_unref (output_channel2);
       g_free (data->output_path1);
       g_free (data->output_path2);
     }
-  g_io_channel_unref (output_channel1);
   g_free (data->output_path);
   g_free (data->start_coords);
   g_free (data->end_coords);
@@ -0,0 +1,787 @@
+/* Copyright (C) 2010  Sylvain FORET
+ *
+ * This file is part of libngs.
+ *
+ * libngs is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *                                                                       
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *                                                                       
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ *
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <zlib.h>
+
+#include "ngs_bgzf.h"
+#include "ngs_utils.h"
+
+
+static const unsigned char bgzf_eof_block[28] =
+{
+  0x1f, 0x8b, 0x08, 0x04, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0xff, 0x06, 0x00, 0x42, 0x43, 0x02, 0x00,
+  0x1b, 0x00, 0x03, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00
+};
+
+/**
+ * Gzip output is compressed in blocks as with pigz: each block is primed
+ * with the end of the previous one and ends on a byte boundary, so that the
+ * compressed blocks can simply be concatenated into a single deflate stream.
+ */
+#define GZIP_BLOCK_DATA_SIZE (256 * 1024)
+#define GZIP_DICT_SIZE       32768
+
+static const unsigned char gzip_header[10] =
+{
+  0x1f, 0x8b, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x03
+};
+
+/* Empty final fixed block, ending the deflate stream */
+static const unsigned char gzip_last_block[2] =
+{
+  0x03, 0x00
+};
+
+typedef struct _BgzfJob BgzfJob;
+
+struct _BgzfJob
+{
+  char          *data;
+  gsize          size;
+  unsigned char *out;
+  gsize          out_size;
+
+  /* Gzip only */
+  char          *dict;
+  gsize          dict_size;
+  guint32        crc;
+
+  GMutex         lock;
+  GCond          cond;
+  int            done;
+  int            last;
+};
+
+typedef struct _BgzfChannel BgzfChannel;
+
+struct _BgzfChannel
+{
+  GIOChannel   channel;
+
+  char        *path;
+  int          fd;
+  int          is_stdout;
+  int          closed;
+
+  int          gzip;
+  gsize        block_size;
+  gsize        out_size;
+  /* Of the whole gzip stream, updated by the writer thread */
+  guint32      crc;
+  guint64      total_size;
+
+  GThreadPool *pool;
+  GThread     *writer;
+  GAsyncQueue *ordered_jobs;
+  GAsyncQueue *free_jobs;
+  BgzfJob     *current;
+  int          n_jobs;
+
+  /* Set by the writer thread */
+  GMutex       error_lock;
+  GError      *error;
+};
+
+static GIOChannel*  channel_new               (const char    *path,
+                                               const char    *mode,
+                                               int            n_threads,
+                                               int            gzip,
+                                               GError       **error);
+
+static gboolean     write_all                 (int            fd,
+                                               const void    *buffer,
+                                               gsize          size);
+
+static gsize        gzip_deflate_block        (const char    *data,
+                                               gsize          size,
+                                               const char    *dict,
+                                               gsize          dict_size,
+                                               unsigned char *out,
+                                               gsize          out_size,
+                                               int            level);
+
+static void         deflate_job               (BgzfJob       *job,
+                                               BgzfChannel   *bgzf);
+
+static gpointer     writer_thread             (BgzfChannel   *bgzf);
+
+static void         submit_job                (BgzfChannel   *bgzf);
+
+static gboolean     get_writer_error          (BgzfChannel   *bgzf,
+                                               GError       **error);
+
+static gboolean     finish                    (BgzfChannel   *bgzf,
+                                               GError       **error);
+
+static GIOStatus    bgzf_channel_read         (GIOChannel    *channel,
+                                               gchar         *buffer,
+                                               gsize          count,
+                                               gsize         *bytes_read,
+                                               GError       **error);
+
+static GIOStatus    bgzf_channel_write        (GIOChannel    *channel,
+                                               const gchar   *buffer,
+                                               gsize          count,
+                                               gsize         *bytes_written,
+                                               GError       **error);
+
+static GIOStatus    bgzf_channel_seek         (GIOChannel    *channel,
+                                               gint64         offset,
+                                               GSeekType      type,
+                                               GError       **error);
+
+static GIOStatus    bgzf_channel_close        (GIOChannel    *channel,
+                                               GError       **error);
+
+static GSource*     bgzf_channel_create_watch (GIOChannel    *channel,
+                                               GIOCondition   condition);
+
+static void         bgzf_channel_free         (GIOChannel    *channel);
+
+static GIOStatus    bgzf_channel_set_flags    (GIOChannel    *channel,
+                                               GIOFlags       flags,
+                                               GError       **error);
+
+static GIOFlags     bgzf_channel_get_flags    (GIOChannel    *channel);
+
+static GIOFuncs bgzf_channel_funcs =
+{
+  bgzf_channel_read,
+  bgzf_channel_write,
+  bgzf_channel_seek,
+  bgzf_channel_close,
+  bgzf_channel_create_watch,
+  bgzf_channel_free,
+  bgzf_channel_set_flags,
+  bgzf_channel_get_flags
+};
+
+gsize
+bgzf_block_size (const unsigned char *header,
+                 gsize                size)
+{
+  if (size < BGZF_HEADER_SIZE)
+    return 0;
+  if (header[0] != 0x1f || header[1] != 0x8b || header[2] != 0x08 ||
+      !(header[3] & 0x04))
+    return 0;
+  /* XLEN and the `BC' subfield */
+  if ((header[10] | (header[11] << 8)) < 6 ||
+      header[12] != 'B' || header[13] != 'C' ||
+      header[14] != 2 || header[15] != 0)
+    return 0;
+
+  return (header[16] | (header[17] << 8)) + 1;
+}
+
+gboolean
+bgzf_inflate_block (const unsigned char *block,
+                    gsize                block_size,
+                    char                *out,
+                    gsize               *out_size,
+                    GError             **error)
+{
+  z_stream             strm;
+  const unsigned char *footer;
+  guint32              crc;
+  guint32              isize;
+  int                  ret;
+
+  *out_size = 0;
+  if (block_size < BGZF_HEADER_SIZE + BGZF_FOOTER_SIZE)
+    {
+      g_set_error (error,
+                   NGS_ERROR,
+                   NGS_IO_ERROR,
+                   "Truncated BGZF block");
+      return FALSE;
+    }
+  footer = block + block_size - BGZF_FOOTER_SIZE;
+  crc    = footer[0] | (footer[1] << 8) | (footer[2] << 16) | ((guint32)footer[3] << 24);
+  isize  = footer[4] | (footer[5] << 8) | (footer[6] << 16) | ((guint32)footer[7] << 24);
+  if (isize > BGZF_MAX_BLOCK_SIZE)
+    {
+      g_set_error (error,
+                   NGS_ERROR,
+                   NGS_IO_ERROR,
+                   "Invalid BGZF block size (%u)",
+                   isize);
+      return FALSE;
+    }
+  if (isize == 0)
+    return TRUE;
+
+  memset (&strm, 0, sizeof (strm));
+  inflateInit2 (&strm, -15);
+  strm.next_in   = (Bytef*)block + BGZF_HEADER_SIZE;
+  strm.avail_in  = block_size - BGZF_HEADER_SIZE - BGZF_FOOTER_SIZE;
+  strm.next_out  = (Bytef*)out;
+  strm.avail_out = BGZF_MAX_BLOCK_SIZE;
+  ret            = inflate (&strm, Z_FINISH);
+  *out_size      = BGZF_MAX_BLOCK_SIZE - strm.avail_out;
+  inflateEnd (&strm);
+  if (ret != Z_STREAM_END || *out_size != isize)
+    {
+      g_set_error (error,
+                   NGS_ERROR,
+                   NGS_IO_ERROR,
+                   "Corrupted BGZF block");
+      return FALSE;
+    }
+  if (crc32 (crc32 (0, NULL, 0), (Bytef*)out, *out_size) != crc)
+    {
+      g_set_error (error,
+                   NGS_ERROR,
+                   NGS_IO_ERROR,
+                   "CRC mismatch in BGZF block");
+      return FALSE;
+    }
+
+  return TRUE;
+}
+
+gsize
+bgzf_deflate_block (const char    *data,
+                    gsize          size,
+                    unsigned char *out,
+                    int            level)
+{
+  z_stream strm;
+  guint32  crc;
+  gsize    block_size;
+  int      ret;
+
+  /* Incompressible data is stored, which always fits */
+  do
+    {
+      memset (&strm, 0, sizeof (strm));
+      deflateInit2 (&strm, level, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY);
+      strm.next_in   = (Bytef*)data;
+      strm.avail_in  = size;
+      strm.next_out  = out + BGZF_HEADER_SIZE;
+      strm.avail_out = BGZF_MAX_BLOCK_SIZE - BGZF_HEADER_SIZE - BGZF_FOOTER_SIZE;
+      ret            = deflate (&strm, Z_FINISH);
+      deflateEnd (&strm);
+      if (ret == Z_STREAM_END)
+        break;
+      level = 0;
+    }
+  while (1);
+
+  block_size = BGZF_HEADER_SIZE + strm.total_out + BGZF_FOOTER_SIZE;
+  memcpy (out, bgzf_eof_block, BGZF_HEADER_SIZE);
+  out[16] = (block_size - 1) & 0xff;
+  out[17] = (block_size - 1) >> 8;
+
+  crc     = crc32 (crc32 (0, NULL, 0), (Bytef*)data, size);
+  out    += BGZF_HEADER_SIZE + strm.total_out;
+  out[0]  = crc & 0xff;
+  out[1]  = (crc >> 8) & 0xff;
+  out[2]  = (crc >> 16) & 0xff;
+  out[3]  = (crc >> 24) & 0xff;
+  out[4]  = size & 0xff;
+  out[5]  = (size >> 8) & 0xff;
+  out[6]  = (size >> 16) & 0xff;
+  out[7]  = (size >> 24) & 0xff;
+
+  return block_size;
+}
+
+GIOChannel*
+bgzf_channel_new (const char  *path,
+                  const char  *mode,
+                  int          n_threads,
+                  GError     **error)
+{
+  return channel_new (path, mode, n_threads, 0, error);
+}
+
+GIOChannel*
+gzip_channel_new (const char  *path,
+                  const char  *mode,
+                  int          n_threads,
+                  GError     **error)
+{
+  return channel_new (path, mode, n_threads, 1, error);
+}
+
+static GIOChannel*
+channel_new (const char  *path,
+             const char  *mode,
+             int          n_threads,
+             int          gzip,
+             GError     **error)
+{
+  BgzfChannel *bgzf;
+  int          fd;
+  int          is_stdout = 0;
+  int          i;
+
+  if (path[0] == '-' && path[1] == '\0')
+    {
+      fd        = STDOUT_FILENO;
+      is_stdout = 1;
+    }
+  else if (mode[0] == 'a')
+    fd = open (path, O_WRONLY | O_CREAT | O_APPEND, 0666);
+  else
+    fd = open (path, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+  if (fd < 0)
+    {
+      g_set_error (error,
+                   NGS_ERROR,
+                   NGS_IO_ERROR,
+                   "Could not open output file `%s'",
+                   path);
+      return NULL;
+    }
+  if (n_threads < 1)
+    n_threads = 1;
+
+  bgzf               = g_slice_new0 (BgzfChannel);
+  bgzf->path         = g_strdup (path);
+  bgzf->fd           = fd;
+  bgzf->is_stdout    = is_stdout;
+  bgzf->gzip         = gzip;
+  bgzf->block_size   = gzip ? GZIP_BLOCK_DATA_SIZE : BGZF_BLOCK_DATA_SIZE;
+  bgzf->crc          = crc32 (0, NULL, 0);
+  bgzf->ordered_jobs = g_async_queue_new ();
+  bgzf->free_jobs    = g_async_queue_new ();
+  /* Enough jobs to keep all the threads busy while the writer catches up */
+  bgzf->n_jobs       = 2 * n_threads + 2;
+  /* A sync flush can add a few bytes to the bound of a finished stream */
+  bgzf->out_size     = gzip ? compressBound (GZIP_BLOCK_DATA_SIZE) + 64 : BGZF_MAX_BLOCK_SIZE;
+  for (i = 0; i < bgzf->n_jobs; i++)
+    {
+      BgzfJob *job;
+
+      job       = g_slice_new0 (BgzfJob);
+      job->data = g_malloc (bgzf->block_size);
+      job->out  = g_malloc (bgzf->out_size);
+      if (gzip)
+        job->dict = g_malloc (GZIP_DICT_SIZE);
+      g_mutex_init (&job->lock);
+      g_cond_init (&job->cond);
+      g_async_queue_push (bgzf->free_jobs, job);
+    }
+  g_mutex_init (&bgzf->error_lock);
+  bgzf->current = g_async_queue_pop (bgzf->free_jobs);
+  /* Not exclusive: tools writing many files share idle threads */
+  bgzf->pool    = g_thread_pool_new ((GFunc)deflate_job,
+                                     bgzf,
+                                     n_threads,
+                                     FALSE,
+                                     NULL);
+  bgzf->writer  = g_thread_new (gzip ? "ngs_gzip_writer" : "ngs_bgzf_writer",
+                                (GThreadFunc)writer_thread,
+                                bgzf);
+
+  g_io_channel_init (&bgzf->channel);
+  bgzf->channel.funcs          = &bgzf_channel_funcs;
+  bgzf->channel.is_readable    = FALSE;
+  bgzf->channel.is_writeable   = TRUE;
+  bgzf->channel.is_seekable    = FALSE;
+  bgzf->channel.close_on_unref = TRUE;
+  g_io_channel_set_encoding (&bgzf->channel, NULL, NULL);
+  /* Data is already gathered into blocks */
+  g_io_channel_set_buffered (&bgzf->channel, FALSE);
+
+  return &bgzf->channel;
+}
+
+static gboolean
+write_all (int         fd,
+           const void *buffer,
+           gsize       size)
+{
+  const char *ptr = buffer;
+
+  while (size > 0)
+    {
+      const gssize written = write (fd, ptr, size);
+
+      if (written < 0)
+        {
+          if (errno == EINTR)
+            continue;
+          return FALSE;
+        }
+      ptr  += written;
+      size -= written;
+    }
+
+  return TRUE;
+}
+
+static gsize
+gzip_deflate_block (const char    *data,
+                    gsize          size,
+                    const char    *dict,
+                    gsize          dict_size,
+                    unsigned char *out,
+                    gsize          out_size,
+                    int            level)
+{
+  z_stream strm;
+
+  memset (&strm, 0, sizeof (strm));
+  deflateInit2 (&strm, level, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY);
+  if (dict_size > 0)
+    deflateSetDictionary (&strm, (const Bytef*)dict, dict_size);
+  strm.next_in   = (Bytef*)data;
+  strm.avail_in  = size;
+  strm.next_out  = out;
+  strm.avail_out = out_size;
+  deflate (&strm, Z_SYNC_FLUSH);
+  out_size = strm.total_out;
+  deflateEnd (&strm);
+
+  return out_size;
+}
+
+static void
+deflate_job (BgzfJob     *job,
+             BgzfChannel *bgzf)
+{
+  if (bgzf->gzip)
+    {
+      job->crc      = crc32 (crc32 (0, NULL, 0), (Bytef*)job->data, job->size);
+      job->out_size = gzip_deflate_block (job->data,
+                                          job->size,
+                                          job->dict,
+                                          job->dict_size,
+                                          job->out,
+                                          bgzf->out_size,
+                                          Z_DEFAULT_COMPRESSION);
+    }
+  else
+    job->out_size = bgzf_deflate_block (job->data,
+                                        job->size,
+                                        job->out,
+                                        Z_DEFAULT_COMPRESSION);
+  g_mutex_lock (&job->lock);
+  job->done = 1;
+  g_cond_signal (&job->cond);
+  g_mutex_unlock (&job->lock);
+}
+
+/**
+ * Jobs are queued in submission order, so writing them as they complete
+ * keeps the blocks in order.
+ */
+static gpointer
+writer_thread (BgzfChannel *bgzf)
+{
+  int failed = 0;
+
+  if (bgzf->gzip && !write_all (bgzf->fd, gzip_header, sizeof (gzip_header)))
+    {
+      failed = 1;
+      g_mutex_lock (&bgzf->error_lock);
+      g_set_error (&bgzf->error,
+                   NGS_ERROR,
+                   NGS_IO_ERROR,
+                   "Error while writing `%s': %s",
+                   bgzf->path,
+                   g_strerror (errno));
+      g_mutex_unlock (&bgzf->error_lock);
+    }
+  while (1)
+    {
+      BgzfJob *job;
+
+      job = g_async_queue_pop (bgzf->ordered_jobs);
+      g_mutex_lock (&job->lock);
+      while (!job->done)
+        g_cond_wait (&job->cond, &job->lock);
+      g_mutex_unlock (&job->lock);
+      if (job->last)
+        {
+          g_async_queue_push (bgzf->free_jobs, job);
+          break;
+        }
+      if (bgzf->gzip)
+        {
+          bgzf->crc         = crc32_combine (bgzf->crc, job->crc, job->size);
+          bgzf->total_size += job->size;
+        }
+      if (!failed && !write_all (bgzf->fd, job->out, job->out_size))
+        {
+          failed = 1;
+          g_mutex_lock (&bgzf->error_lock);
+          g_set_error (&bgzf->error,
+                       NGS_ERROR,
+                       NGS_IO_ERROR,
+                       "Error while writing `%s': %s",
+                       bgzf->path,
+                       g_strerror (errno));
+          g_mutex_unlock (&bgzf->error_lock);
+        }
+      g_async_queue_push (bgzf->free_jobs, job);
+    }
+
+  return NULL;
+}
+
+static void
+submit_job (BgzfChannel *bgzf)
+{
+  BgzfJob *job = bgzf->current;
+
+  job->done = 0;
+  job->last = 0;
+  g_async_queue_push (bgzf->ordered_jobs, job);
+  g_thread_pool_push (bgzf->pool, job, NULL);
+  bgzf->current = g_async_queue_pop (bgzf->free_jobs);
+  /* The block being compressed is only read, so it can still be copied */
+  if (bgzf->gzip)
+    {
+      const gsize n = MIN (job->size, GZIP_DICT_SIZE);
+
+      memcpy (bgzf->current->dict, job->data + job->size - n, n);
+      bgzf->current->dict_size = n;
+    }
+  bgzf->current->size = 0;
+}
+
+static gboolean
+get_writer_error (BgzfChannel  *bgzf,
+                  GError      **error)
+{
+  gboolean failed = FALSE;
+
+  g_mutex_lock (&bgzf->error_lock);
+  if (bgzf->error)
+    {
+      if (error)
+        *error = g_error_copy (bgzf->error);
+      failed = TRUE;
+    }
+  g_mutex_unlock (&bgzf->error_lock);
+
+  return failed;
+}
+
+/**
+ * Flushes the last block, waits for the writer and adds the end of file
+ * marker.
+ */
+static gboolean
+finish (BgzfChannel  *bgzf,
+        GError      **error)
+{
+  BgzfJob *job;
+  int      i;
+
+  if (bgzf->closed)
+    return TRUE;
+  bgzf->closed = 1;
+
+  if (bgzf->current->size > 0)
+    submit_job (bgzf);
+  bgzf->current->done = 1;
+  bgzf->current->last = 1;
+  g_async_queue_push (bgzf->ordered_jobs, bgzf->current);
+  bgzf->current = NULL;
+  g_thread_join (bgzf->writer);
+  g_thread_pool_free (bgzf->pool, FALSE, TRUE);
+
+  while ((job = g_async_queue_try_pop (bgzf->free_jobs)) != NULL)
+    {
+      g_mutex_clear (&job->lock);
+      g_cond_clear (&job->cond);
+      g_free (job->data);
+      g_free (job->out);
+      g_free (job->dict);
+      g_slice_free (BgzfJob, job);
+    }
+
+  if (bgzf->gzip)
+    {
+      unsigned char trailer[sizeof (gzip_last_block) + 8];
+
+      memcpy (trailer, gzip_last_block, sizeof (gzip_last_block));
+      for (i = 0; i < 4; i++)
+        {
+          trailer[sizeof (gzip_last_block) + i]     = (bgzf->crc >> (8 * i)) & 0xff;
+          trailer[sizeof (gzip_last_block) + 4 + i] = (bgzf->total_size >> (8 * i)) & 0xff;
+        }
+      if (!bgzf->error &&
+          !write_all (bgzf->fd, trailer, sizeof (trailer)))
+        g_set_error (&bgzf->error,
+                     NGS_ERROR,
+                     NGS_IO_ERROR,
+                     "Error while writing `%s': %s",
+                     bgzf->path,
+                     g_strerror (errno));
+    }
+  else if (!bgzf->error &&
+           !write_all (bgzf->fd, bgzf_eof_block, sizeof (bgzf_eof_block)))
+    g_set_error (&bgzf->error,
+                 NGS_ERROR,
+                 NGS_IO_ERROR,
+                 "Error while writing `%s': %s",
+                 bgzf->path,
+                 g_strerror (errno));
+  if (!bgzf->is_stdout && close (bgzf->fd) != 0 && !bgzf->error)
+    g_set_error (&bgzf->error,
+                 NGS_ERROR,
+                 NGS_IO_ERROR,
+                 "Error while closing `%s': %s",
+                 bgzf->path,
+                 g_strerror (errno));
+
+  return !get_writer_error (bgzf, error);
+}
+
+static GIOStatus
+bgzf_channel_read (GIOChannel  *channel,
+                   gchar       *buffer,
+                   gsize        count,
+                   gsize       *bytes_read,
+                   GError     **error)
+{
+  (void)channel;
+  (void)buffer;
+  (void)count;
+
+  *bytes_read = 0;
+  g_set_error (error,
+               G_IO_CHANNEL_ERROR,
+               G_IO_CHANNEL_ERROR_FAILED,
+               "BGZF channels are write-only");
+
+  return G_IO_STATUS_ERROR;
+}
+
+static GIOStatus
+bgzf_channel_write (GIOChannel   *channel,
+                    const gchar  *buffer,
+                    gsize         count,
+                    gsize        *bytes_written,
+                    GError      **error)
+{
+  BgzfChannel *bgzf = (BgzfChannel*)channel;
+
+  *bytes_written = 0;
+  if (bgzf->closed || get_writer_error (bgzf, error))
+    return G_IO_STATUS_ERROR;
+  while (count > 0)
+    {
+      BgzfJob    *job = bgzf->current;
+      const gsize n   = MIN (count, bgzf->block_size - job->size);
+
+      memcpy (job->data + job->size, buffer, n);
+      job->size      += n;
+      buffer         += n;
+      count          -= n;
+      *bytes_written += n;
+      if (job->size == bgzf->block_size)
+        submit_job (bgzf);
+    }
+
+  return G_IO_STATUS_NORMAL;
+}
+
+static GIOStatus
+bgzf_channel_seek (GIOChannel  *channel,
+                   gint64       offset,
+                   GSeekType    type,
+                   GError     **error)
+{
+  (void)channel;
+  (void)offset;
+  (void)type;
+
+  g_set_error (error,
+               G_IO_CHANNEL_ERROR,
+               G_IO_CHANNEL_ERROR_INVAL,
+               "BGZF channels are not seekable");
+
+  return G_IO_STATUS_ERROR;
+}
+
+static GIOStatus
+bgzf_channel_close (GIOChannel  *channel,
+                    GError     **error)
+{
+  if (!finish ((BgzfChannel*)channel, error))
+    return G_IO_STATUS_ERROR;
+
+  return G_IO_STATUS_NORMAL;
+}
+
+static GSource*
+bgzf_channel_create_watch (GIOChannel   *channel,
+                           GIOCondition  condition)
+{
+  (void)channel;
+  (void)condition;
+
+  return NULL;
+}
+
+static void
+bgzf_channel_free (GIOChannel *channel)
+{
+  BgzfChannel *bgzf = (BgzfChannel*)channel;
+
+  finish (bgzf, NULL);
+  g_async_queue_unref (bgzf->ordered_jobs);
+  g_async_queue_unref (bgzf->free_jobs);
+  g_mutex_clear (&bgzf->error_lock);
+  if (bgzf->error)
+    g_error_free (bgzf->error);
+  g_free (bgzf->path);
+  g_slice_free (BgzfChannel, bgzf);
+}
+
+static GIOStatus
+bgzf_channel_set_flags (GIOChannel  *channel,
+                        GIOFlags     flags,
+                        GError     **error)
+{
+  (void)channel;
+  (void)flags;
+  (void)error;
+
+  return G_IO_STATUS_NORMAL;
+}
+
+static GIOFlags
+bgzf_channel_get_flags (GIOChannel *channel)
+{
+  (void)channel;
+
+  return G_IO_FLAG_IS_WRITEABLE;
+}
+
+/* vim:ft=c:expandtab:sw=4:ts=4:sts=4:cinoptions={.5s^-2n-2(0:
+ */
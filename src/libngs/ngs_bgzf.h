@@ -0,0 +1,89 @@
+/**
+ *
+ */
+
+#ifndef __NGS_BGZF_H__
+#define __NGS_BGZF_H__
+
+#include <glib.h>
+
+/********/
+/* BGZF */
+/********/
+
+/**
+ * Blocked gzip, as used by samtools and tabix: a series of independent gzip
+ * members of at most 64 KB, each of which records its compressed size in a
+ * `BC' extra field.  A BGZF file is a valid gzip file, but its blocks can be
+ * compressed and decompressed in parallel.
+ */
+
+#define BGZF_MAX_BLOCK_SIZE 65536
+#define BGZF_HEADER_SIZE    18
+#define BGZF_FOOTER_SIZE    8
+
+/**
+ * Maximum amount of data per block, chosen so that incompressible data
+ * still fits in a block once stored.
+ */
+#define BGZF_BLOCK_DATA_SIZE 0xff00
+
+/**
+ * Returns the total size of the block starting with header, or 0 if header
+ * is not the start of a BGZF block.
+ */
+
+gsize       bgzf_block_size    (const unsigned char *header,
+                                gsize                size);
+
+/**
+ * Decompresses a whole block into out, which must hold
+ * BGZF_MAX_BLOCK_SIZE bytes, and checks its CRC.
+ */
+
+gboolean    bgzf_inflate_block (const unsigned char *block,
+                                gsize                block_size,
+                                char                *out,
+                                gsize               *out_size,
+                                GError             **error);
+
+/**
+ * Compresses size bytes (at most BGZF_BLOCK_DATA_SIZE) into a block.
+ * out must hold BGZF_MAX_BLOCK_SIZE bytes.  Returns the size of the block.
+ */
+
+gsize       bgzf_deflate_block (const char          *data,
+                                gsize                size,
+                                unsigned char       *out,
+                                int                  level);
+
+/**
+ * A write-only GIOChannel producing BGZF.
+ * The blocks are compressed by n_threads threads and written in order by
+ * another thread.  The end of file marker is written when the channel is
+ * shut down or unreferenced.
+ * mode is "w" or "a", appending blocks to an existing file.
+ * If path is '-', writes to stdout.
+ */
+
+GIOChannel* bgzf_channel_new   (const char          *path,
+                                const char          *mode,
+                                int                  n_threads,
+                                GError             **error);
+
+/**
+ * As bgzf_channel_new, but producing a single gzip member, compressed in
+ * parallel as with pigz.  The compression is slightly better than with BGZF,
+ * but the output cannot be decompressed in parallel without an index (see
+ * ngs_gzindex.h).
+ */
+
+GIOChannel* gzip_channel_new   (const char          *path,
+                                const char          *mode,
+                                int                  n_threads,
+                                GError             **error);
+
+#endif /* __NGS_BGZF_H__ */
+
+/* vim:ft=c:expandtab:sw=4:ts=4:sts=4:cinoptions={.5s^-2n-2(0:
+ */
@@ -27,6 +27,7 @@
 
 #include "ngs_bsq.h"
 #include "ngs_bsq_flex.h"
+#include "ngs_input.h"
 #include "ngs_utils.h"
 
 
@@ -116,30 +117,9 @@ iter_bsq_simple (char         *path,
   gsize       length;
   gsize       endl;
 
-  if (path[0] == '-' && path[1] == '\0')
-    {
-      channel = g_io_channel_unix_new (STDIN_FILENO);
-      if (!channel)
-        {
-          g_set_error (error,
-                       NGS_ERROR,
-                       NGS_IO_ERROR,
-                       "Could not open stdin for reading");
-          return;
-        }
-    }
-  else
-    {
-      channel = g_io_channel_new_file (path, "r", &tmp_err);
-
-      if (tmp_err)
-        {
-          g_propagate_error (error, tmp_err);
-          if (channel)
-            g_io_channel_unref (channel);
-          return;
-        }
-    }
+  channel = ngs_input_channel_new (path, error);
+  if (channel == NULL)
+    return;
 
   while (G_IO_STATUS_NORMAL == g_io_channel_read_line (channel, &line, &length, &endl, &tmp_err))
     {
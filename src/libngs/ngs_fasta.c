@@ -20,18 +20,50 @@
  *
  */
 
+#include <fcntl.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
 
 #include "ngs_fasta.h"
 #include "ngs_fasta_flex.h"
+#include "ngs_input.h"
 #include "ngs_utils.h"
+#include "ngs_writer.h"
 
 
+#define FASTA_READ_SIZE (1024 * 1024)
+
 static char *fasta_parser_name = NULL;
 
-static void iter_load_dict (FastaSeq   *fasta,
-                            GHashTable *dict);
+struct _FastaWindowIter
+{
+  NgsInput          *input;
+  char              *buffer;
+  gsize              buffer_pos;
+  gsize              buffer_len;
+  GString           *name;
+  FastaWindow        window;
+  unsigned long int  window_size;
+  unsigned long int  overlap;
+  int                in_seq;
+  int                done;
+};
+
+static void iter_load_dict           (FastaSeq        *fasta,
+                                      GHashTable      *dict);
+
+static int  window_iter_fill         (FastaWindowIter *iter);
+
+static int  window_iter_skip_blanks  (FastaWindowIter *iter);
+
+static int  window_iter_read_header  (FastaWindowIter *iter);
+
+static void fasta_index_fill_names   (FastaIndex      *index);
+
+static void fasta_index_entry_clear  (FastaIndexEntry *entry);
 
 FastaSeq*
 fasta_seq_new (void)
@@ -185,5 +217,542 @@ fasta_iter_free (FastaIter *iter)
     }
 }
 
+FastaWindowIter*
+fasta_window_iter_new (const char        *path,
+                       unsigned long int  window_size,
+                       unsigned long int  overlap,
+                       GError           **error)
+{
+  FastaWindowIter *iter;
+  NgsInput        *input;
+
+  if (overlap >= window_size)
+    {
+      g_set_error (error,
+                   NGS_ERROR,
+                   NGS_UNKNOWN_ERROR,
+                   "The windows (%lu) must be larger than their overlap (%lu)",
+                   window_size,
+                   overlap);
+      return NULL;
+    }
+  input = ngs_input_open (path, error);
+  if (input == NULL)
+    return NULL;
+
+  iter              = g_slice_new0 (FastaWindowIter);
+  iter->input       = input;
+  iter->buffer      = g_malloc (FASTA_READ_SIZE);
+  iter->name        = g_string_sized_new (64);
+  iter->window_size = window_size;
+  iter->overlap     = overlap;
+  iter->window.seq  = g_malloc (window_size);
+
+  return iter;
+}
+
+FastaWindow*
+fasta_window_iter_next (FastaWindowIter  *iter,
+                        GError          **error)
+{
+  FastaWindow *window = &iter->window;
+
+  if (iter->done)
+    return NULL;
+  if (!iter->in_seq)
+    {
+      if (!window_iter_read_header (iter))
+        {
+          iter->done = 1;
+          ngs_input_get_error (iter->input, error);
+          return NULL;
+        }
+      window->name  = iter->name->str;
+      window->start = 0;
+      window->size  = 0;
+      window->last  = 0;
+      iter->in_seq  = 1;
+    }
+  else
+    {
+      const unsigned long int keep = MIN (iter->overlap, window->size);
+
+      memmove (window->seq, window->seq + window->size - keep, keep);
+      window->start += window->size - keep;
+      window->size   = keep;
+    }
+
+  while (window->size < iter->window_size)
+    {
+      const char *buffer;
+      gsize       end;
+      gsize       i;
+
+      if (!window_iter_fill (iter))
+        break;
+      buffer = iter->buffer;
+      end    = MIN (iter->buffer_len,
+                    iter->buffer_pos + iter->window_size - window->size);
+      for (i = iter->buffer_pos; i < end; i++)
+        {
+          const char c = buffer[i];
+
+          if (c == '>')
+            break;
+          if (c != '\n' && c != ' ' && c != '\t' && c != '\r')
+            window->seq[window->size++] = c;
+        }
+      iter->buffer_pos = i;
+      if (i < end)
+        break;
+    }
+  /* The sequence ends at the next header or at the end of the file */
+  if (window_iter_skip_blanks (iter) != '>' && iter->buffer_pos < iter->buffer_len)
+    return window;
+  window->last = 1;
+  iter->in_seq = 0;
+  if (ngs_input_get_error (iter->input, error))
+    {
+      iter->done = 1;
+      return NULL;
+    }
+
+  return window;
+}
+
+void
+fasta_window_iter_free (FastaWindowIter *iter)
+{
+  if (iter)
+    {
+      ngs_input_close (iter->input);
+      g_free (iter->buffer);
+      g_string_free (iter->name, TRUE);
+      g_free (iter->window.seq);
+      g_slice_free (FastaWindowIter, iter);
+    }
+}
+
+/* Returns 0 at the end of the file */
+static int
+window_iter_fill (FastaWindowIter *iter)
+{
+  gssize n;
+
+  if (iter->buffer_pos < iter->buffer_len)
+    return 1;
+  n = ngs_input_read (iter->input, iter->buffer, FASTA_READ_SIZE);
+  iter->buffer_pos = 0;
+  iter->buffer_len = n > 0 ? n : 0;
+
+  return n > 0;
+}
+
+/* Returns the next character that is not blank, without consuming it */
+static int
+window_iter_skip_blanks (FastaWindowIter *iter)
+{
+  while (window_iter_fill (iter))
+    {
+      const char c = iter->buffer[iter->buffer_pos];
+
+      if (c != '\n' && c != ' ' && c != '\t' && c != '\r')
+        return c;
+      iter->buffer_pos++;
+    }
+  return -1;
+}
+
+/* Reads the name of the next sequence and skips the rest of its header */
+static int
+window_iter_read_header (FastaWindowIter *iter)
+{
+  int c;
+
+  while ((c = window_iter_skip_blanks (iter)) != '>')
+    {
+      if (c < 0)
+        return 0;
+      iter->buffer_pos++;
+    }
+  iter->buffer_pos++;
+  g_string_truncate (iter->name, 0);
+  while (window_iter_fill (iter))
+    {
+      c = iter->buffer[iter->buffer_pos];
+      if (c == '\n')
+        break;
+      iter->buffer_pos++;
+      if (c == ' ' || c == '\t' || c == '\r')
+        {
+          if (iter->name->len > 0)
+            break;
+        }
+      else
+        g_string_append_c (iter->name, c);
+    }
+  while (window_iter_fill (iter))
+    if (iter->buffer[iter->buffer_pos++] == '\n')
+      break;
+
+  return 1;
+}
+
+FastaIndex*
+fasta_index_build (const char  *path,
+                   GError     **error)
+{
+  FastaIndex      *index;
+  FastaIndexEntry  entry;
+  GArray          *entries;
+  struct stat      st;
+  FILE            *file;
+  char            *line      = NULL;
+  size_t           line_alloc = 0;
+  ssize_t          width;
+  guint64          offset    = 0;
+  int              in_entry  = 0;
+  int              last_line = 0;
+
+  file = fopen (path, "r");
+  if (file == NULL)
+    {
+      g_set_error (error,
+                   NGS_ERROR,
+                   NGS_IO_ERROR,
+                   "Could not open input file `%s'",
+                   path);
+      return NULL;
+    }
+  if (fstat (fileno (file), &st) != 0 || !S_ISREG (st.st_mode))
+    {
+      g_set_error (error,
+                   NGS_ERROR,
+                   NGS_IO_ERROR,
+                   "Only regular files can be indexed: `%s'",
+                   path);
+      fclose (file);
+      return NULL;
+    }
+
+  entries = g_array_new (FALSE, FALSE, sizeof (FastaIndexEntry));
+  while ((width = getline (&line, &line_alloc, file)) > 0)
+    {
+      ssize_t bases = width;
+
+      if (offset == 0 && width >= 2 && line[0] == 0x1f && (guchar)line[1] == 0x8b)
+        {
+          g_set_error (error,
+                       NGS_ERROR,
+                       NGS_IO_ERROR,
+                       "Compressed files cannot be indexed: `%s'",
+                       path);
+          goto error;
+        }
+      offset += width;
+      while (bases > 0 && (line[bases - 1] == '\n' || line[bases - 1] == '\r'))
+        --bases;
+      if (line[0] == '>')
+        {
+          char *name = line + 1;
+
+          if (in_entry)
+            g_array_append_val (entries, entry);
+          while (*name == ' ' || *name == '\t')
+            ++name;
+          entry.name       = g_strndup (name, strcspn (name, " \t\r\n"));
+          entry.size       = 0;
+          entry.offset     = offset;
+          entry.line_bases = 0;
+          entry.line_width = 0;
+          in_entry         = 1;
+          last_line        = 0;
+          continue;
+        }
+      if (!in_entry)
+        {
+          if (bases == 0)
+            continue;
+          g_set_error (error,
+                       NGS_ERROR,
+                       NGS_PARSE_ERROR,
+                       "Sequence before the first header in `%s'",
+                       path);
+          goto error;
+        }
+      if (bases == 0)
+        {
+          last_line = 1;
+          continue;
+        }
+      if (entry.line_bases == 0)
+        {
+          entry.line_bases = bases;
+          entry.line_width = width;
+        }
+      else if (last_line ||
+               bases > entry.line_bases ||
+               (bases == entry.line_bases &&
+                width != entry.line_width &&
+                line[width - 1] == '\n'))
+        {
+          g_set_error (error,
+                       NGS_ERROR,
+                       NGS_PARSE_ERROR,
+                       "Different line lengths in sequence `%s' of `%s'",
+                       entry.name,
+                       path);
+          goto error;
+        }
+      if ((guint32)bases < entry.line_bases)
+        last_line = 1;
+      entry.size += bases;
+    }
+  if (in_entry)
+    g_array_append_val (entries, entry);
+  in_entry = 0;
+  if (ferror (file))
+    {
+      g_set_error (error,
+                   NGS_ERROR,
+                   NGS_IO_ERROR,
+                   "Could not read `%s'",
+                   path);
+      goto error;
+    }
+  free (line);
+  fclose (file);
+
+  index            = g_slice_new0 (FastaIndex);
+  index->n_entries = entries->len;
+  index->entries   = (FastaIndexEntry*)g_array_free (entries, FALSE);
+  fasta_index_fill_names (index);
+
+  return index;
+
+error:
+  if (in_entry)
+    fasta_index_entry_clear (&entry);
+  for (offset = 0; offset < entries->len; offset++)
+    fasta_index_entry_clear (&g_array_index (entries, FastaIndexEntry, offset));
+  g_array_free (entries, TRUE);
+  free (line);
+  fclose (file);
+
+  return NULL;
+}
+
+gboolean
+fasta_index_save (FastaIndex  *index,
+                  const char  *path,
+                  GError     **error)
+{
+  NgsWriter *writer;
+  guint      i;
+
+  writer = ngs_writer_new (path, "w", error);
+  if (writer == NULL)
+    return FALSE;
+
+  for (i = 0; i < index->n_entries; i++)
+    {
+      FastaIndexEntry *entry = index->entries + i;
+
+      ngs_writer_printf (writer,
+                         NULL,
+                         "%s\t%" G_GUINT64_FORMAT "\t%" G_GUINT64_FORMAT "\t%u\t%u\n",
+                         entry->name,
+                         entry->size,
+                         entry->offset,
+                         entry->line_bases,
+                         entry->line_width);
+    }
+
+  return ngs_writer_close (writer, error);
+}
+
+FastaIndex*
+fasta_index_load (const char  *path,
+                  GError     **error)
+{
+  FastaIndex  *index;
+  GArray      *entries;
+  char        *contents;
+  char       **lines;
+  char       **line;
+  gsize        length;
+
+  if (!g_file_get_contents (path, &contents, &length, error))
+    return NULL;
+
+  entries = g_array_new (FALSE, FALSE, sizeof (FastaIndexEntry));
+  lines   = g_strsplit (contents, "\n", 0);
+  g_free (contents);
+  for (line = lines; *line; line++)
+    {
+      FastaIndexEntry   entry;
+      char            **fields;
+
+      if (**line == '\0')
+        continue;
+      fields = g_strsplit (*line, "\t", 0);
+      if (g_strv_length (fields) < 5)
+        {
+          g_strfreev (fields);
+          break;
+        }
+      entry.name       = g_strdup (fields[0]);
+      entry.size       = g_ascii_strtoull (fields[1], NULL, 10);
+      entry.offset     = g_ascii_strtoull (fields[2], NULL, 10);
+      entry.line_bases = g_ascii_strtoull (fields[3], NULL, 10);
+      entry.line_width = g_ascii_strtoull (fields[4], NULL, 10);
+      g_strfreev (fields);
+      if (entry.line_bases > entry.line_width ||
+          (entry.size > 0 && entry.line_bases == 0))
+        {
+          fasta_index_entry_clear (&entry);
+          break;
+        }
+      g_array_append_val (entries, entry);
+    }
+
+  index            = g_slice_new0 (FastaIndex);
+  index->n_entries = entries->len;
+  index->entries   = (FastaIndexEntry*)g_array_free (entries, FALSE);
+  fasta_index_fill_names (index);
+  if (*line)
+    {
+      g_set_error (error,
+                   NGS_ERROR,
+                   NGS_PARSE_ERROR,
+                   "Invalid fasta index file `%s'",
+                   path);
+      fasta_index_free (index);
+      index = NULL;
+    }
+  g_strfreev (lines);
+
+  return index;
+}
+
+FastaIndex*
+fasta_index_find (const char *fasta_path)
+{
+  struct stat  st;
+  struct stat  st_index;
+  FastaIndex  *index;
+  char        *path;
+
+  if (stat (fasta_path, &st) != 0 || !S_ISREG (st.st_mode))
+    return NULL;
+  path  = g_strconcat (fasta_path, FASTA_INDEX_SUFFIX, NULL);
+  index = NULL;
+  if (stat (path, &st_index) == 0 &&
+      S_ISREG (st_index.st_mode) &&
+      st_index.st_mtime >= st.st_mtime)
+    index = fasta_index_load (path, NULL);
+  g_free (path);
+
+  return index;
+}
+
+void
+fasta_index_free (FastaIndex *index)
+{
+  if (index)
+    {
+      guint i;
+
+      if (index->names)
+        g_hash_table_destroy (index->names);
+      for (i = 0; i < index->n_entries; i++)
+        fasta_index_entry_clear (index->entries + i);
+      g_free (index->entries);
+      g_slice_free (FastaIndex, index);
+    }
+}
+
+FastaIndexEntry*
+fasta_index_lookup (FastaIndex *index,
+                    const char *name)
+{
+  return g_hash_table_lookup (index->names, name);
+}
+
+gboolean
+fasta_index_read (FastaIndexEntry  *entry,
+                  int               fd,
+                  guint64           from,
+                  guint64           to,
+                  char             *seq,
+                  GError          **error)
+{
+  const guint64  skip = entry->line_width - entry->line_bases;
+  char          *buffer;
+  guint64        n_lines;
+
+  to = MIN (to, entry->size);
+  if (from >= to)
+    return TRUE;
+
+  /* Whole lines, as many as fit in the buffer */
+  n_lines = MAX (FASTA_READ_SIZE / entry->line_width, 1);
+  buffer  = g_malloc (n_lines * entry->line_width);
+  while (from < to)
+    {
+      const guint64  line  = from / entry->line_bases;
+      const guint64  end   = MIN (to, (line + n_lines) * entry->line_bases);
+      const guint64  start = entry->offset +
+                             line * entry->line_width +
+                             from % entry->line_bases;
+      const gsize    size  = entry->offset +
+                             ((end - 1) / entry->line_bases) * entry->line_width +
+                             (end - 1) % entry->line_bases + 1 - start;
+      const char    *cursor;
+
+      if (pread (fd, buffer, size, start) != (ssize_t)size)
+        {
+          g_set_error (error,
+                       NGS_ERROR,
+                       NGS_IO_ERROR,
+                       "Could not read sequence `%s'",
+                       entry->name);
+          g_free (buffer);
+          return FALSE;
+        }
+      for (cursor = buffer; from < end; )
+        {
+          const guint64 n = MIN (entry->line_bases - from % entry->line_bases,
+                                 end - from);
+
+          memcpy (seq, cursor, n);
+          seq    += n;
+          cursor += n + skip;
+          from   += n;
+        }
+    }
+  g_free (buffer);
+
+  return TRUE;
+}
+
+static void
+fasta_index_fill_names (FastaIndex *index)
+{
+  guint i;
+
+  index->names = g_hash_table_new (g_str_hash, g_str_equal);
+  for (i = 0; i < index->n_entries; i++)
+    g_hash_table_insert (index->names,
+                         index->entries[i].name,
+                         index->entries + i);
+}
+
+static void
+fasta_index_entry_clear (FastaIndexEntry *entry)
+{
+  g_free (entry->name);
+}
+
 /* vim:ft=c:expandtab:sw=4:ts=4:sts=4:cinoptions={.5s^-2n-2(0:
  */
@@ -80,6 +80,120 @@ FastaSeq*  fasta_iter_next (FastaIter  *iter);
 
 void       fasta_iter_free (FastaIter  *iter);
 
+/*******************/
+/* FastaWindowIter */
+/*******************/
+
+/**
+ * Iterates over the sequences of a file in windows of at most window_size
+ * bases, so that long sequences are never held in memory at once.
+ * Consecutive windows of a sequence share overlap bases (k - 1 to see
+ * every k-mer once), and start is the position of the first base of the
+ * window in its sequence.  Every sequence has at least one window, which
+ * may be empty, and its last window has last set.
+ * The window, its name and its bases are only valid until the next call.
+ */
+
+typedef struct _FastaWindow FastaWindow;
+
+struct _FastaWindow
+{
+  char              *name;
+  char              *seq;
+  unsigned long int  size;
+  guint64            start;
+  int                last;
+};
+
+typedef struct _FastaWindowIter FastaWindowIter;
+
+FastaWindowIter* fasta_window_iter_new  (const char       *path,
+                                         unsigned long int window_size,
+                                         unsigned long int overlap,
+                                         GError          **error);
+
+/**
+ * Returns NULL at the end of the file, or if there was an error.
+ */
+
+FastaWindow*     fasta_window_iter_next (FastaWindowIter  *iter,
+                                         GError          **error);
+
+void             fasta_window_iter_free (FastaWindowIter  *iter);
+
+/**************/
+/* FastaIndex */
+/**************/
+
+/**
+ * Index of an uncompressed fasta file, in the format of `samtools faidx':
+ * for each sequence, its name, its size, the offset of its first base in the
+ * file, and the number of bases and of bytes in each line.  All the lines of
+ * a sequence must have the same size, except the last one, so that any
+ * region can be read without parsing the file.
+ * The index of `file.fa' is kept in `file.fa' FASTA_INDEX_SUFFIX.
+ */
+
+#define FASTA_INDEX_SUFFIX ".fai"
+
+typedef struct _FastaIndexEntry FastaIndexEntry;
+
+struct _FastaIndexEntry
+{
+  char    *name;
+  guint64  size;
+  guint64  offset;
+  guint32  line_bases;
+  guint32  line_width;
+};
+
+typedef struct _FastaIndex FastaIndex;
+
+struct _FastaIndex
+{
+  FastaIndexEntry *entries;
+  guint            n_entries;
+  GHashTable      *names;
+};
+
+/**
+ * Reads the whole file, which must be an uncompressed regular file.
+ */
+
+FastaIndex*      fasta_index_build  (const char       *path,
+                                     GError          **error);
+
+gboolean         fasta_index_save   (FastaIndex       *index,
+                                     const char       *path,
+                                     GError          **error);
+
+FastaIndex*      fasta_index_load   (const char       *path,
+                                     GError          **error);
+
+/**
+ * Loads the index next to fasta_path.
+ * Returns NULL if there is no index or if it is older than the file.
+ */
+
+FastaIndex*      fasta_index_find   (const char       *fasta_path);
+
+void             fasta_index_free   (FastaIndex       *index);
+
+FastaIndexEntry* fasta_index_lookup (FastaIndex       *index,
+                                     const char       *name);
+
+/**
+ * Reads the bases [from, to) of entry from fd, an open descriptor of the
+ * indexed file, into seq, which must hold to - from characters.
+ */
+
+gboolean         fasta_index_read   (FastaIndexEntry  *entry,
+                                     int               fd,
+                                     guint64           from,
+                                     guint64           to,
+                                     char             *seq,
+                                     GError          **error);
+
 #endif /* __NGS_FASTA_H__ */
 
 /* vim:ft=c:expandtab:sw=4:ts=4:sts=4:cinoptions={.5s^-2n-2(0:
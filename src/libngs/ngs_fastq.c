@@ -24,11 +24,22 @@
 #include <stdio.h>
 #include <string.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include "ngs_fastq.h"
 #include "ngs_fastq_flex.h"
+#include "ngs_input.h"
+#include "ngs_readstore.h"
 #include "ngs_utils.h"
 
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && \
+    (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+#define NGS_SCAN_X86 1
+#include <immintrin.h>
+#endif
+
 
 char  fastq_qual0          = FASTQ_QUAL_0;
 char  fastq_qual_min_str[] = FASTQ_QUAL_MIN_STR;
@@ -36,6 +47,8 @@ char  fastq_qual_min_str[] = FASTQ_QUAL_MIN_STR;
 
 static char*    fastq_parser_name = NULL;
 
+static FastqColumns fastq_columns = FASTQ_COLUMN_ALL;
+
 static void     iter_fastq_simple      (const char     *path,
                                         FastqIterFunc   func,
                                         void           *data,
@@ -46,6 +59,38 @@ static void     iter_fastq_ugly        (const char     *path,
                                         void           *data,
                                         GError        **error);
 
+static void     iter_fastq_mmap        (const char     *path,
+                                        FastqIterFunc   func,
+                                        void           *data,
+                                        GError        **error);
+
+static const char* mmap_read_line      (const char    **cursor,
+                                        const char     *end,
+                                        gsize          *length);
+
+static void     iter_fastq_stream      (const char     *path,
+                                        FastqIterFunc   func,
+                                        void           *data,
+                                        GError        **error);
+
+static void     stream_parse           (NgsInput       *input,
+                                        guint64         start,
+                                        guint64         end,
+                                        guint64        *offset,
+                                        FastqIterFunc   func,
+                                        void           *data,
+                                        GError        **error);
+
+typedef void    (*ScanNewlinesFunc)    (const char     *buffer,
+                                        gsize           size,
+                                        guint64        *bits);
+
+static void     scan_newlines_generic  (const char     *buffer,
+                                        gsize           size,
+                                        guint64        *bits);
+
+static ScanNewlinesFunc get_scan_newlines_func (void);
+
 static gboolean fastq_parse_qual0      (const gchar    *option_name,
                                         const gchar    *value,
                                         gpointer        data,
@@ -53,6 +98,55 @@ static gboolean fastq_parse_qual0      (const gchar    *option_name,
 
 static void     init_char2string_table (char            qual0);
 
+static void     fastq_batch_clear      (FastqBatch     *batch);
+
+static void     fastq_batch_append     (FastqBatch     *batch,
+                                        FastqSeq       *seq);
+
+static void     fastq_batch_seal       (FastqBatch     *batch);
+
+typedef struct  _ParallelData          ParallelData;
+
+typedef struct  _ParallelJob           ParallelJob;
+
+static int      parallel_read          (FastqSeq       *fastq,
+                                        ParallelData   *pd);
+
+static void     parallel_submit        (ParallelData   *pd);
+
+static void     parallel_process       (ParallelJob    *job,
+                                        ParallelData   *pd);
+
+static gpointer parallel_write         (ParallelData   *pd);
+
+typedef struct  _RangeJob              RangeJob;
+
+static gpointer range_thread           (RangeJob       *job);
+
+static void     range_store            (RangeJob       *job);
+
+static int      range_func             (FastqSeq       *fastq,
+                                        RangeJob       *job);
+
+typedef struct  _PairReader            PairReader;
+
+static gboolean pair_reader_init       (PairReader     *reader,
+                                        const char     *path,
+                                        GError        **error);
+
+static void     pair_reader_clear      (PairReader     *reader);
+
+static gpointer pair_reader_thread     (PairReader     *reader);
+
+static FastqSeq* pair_reader_next      (PairReader     *reader);
+
+static void     pair_reader_release    (PairReader     *reader);
+
+static gboolean pair_reader_get_error  (PairReader     *reader,
+                                        GError        **error);
+
+static gsize    pair_name_size         (const char     *name);
+
 FastqSeq*
 fastq_seq_new (void)
 {
@@ -95,18 +189,45 @@ fastq_seq_copy (FastqSeq *fastq)
   return seq;
 }
 
+FastqSeq*
+fastq_seq_detach (FastqSeq *fastq,
+                  FastqSeq *keep)
+{
+  const gsize name_size = strlen (fastq->name) + 1;
+  const gsize seq_size  = strlen (fastq->seq) + 1;
+  const gsize qual_size = strlen (fastq->qual) + 1;
+
+  if (keep == NULL)
+    keep = fastq_seq_new ();
+  keep->name = g_realloc (keep->name, name_size);
+  keep->seq  = g_realloc (keep->seq, seq_size);
+  keep->qual = g_realloc (keep->qual, qual_size);
+  memcpy (keep->name, fastq->name, name_size);
+  memcpy (keep->seq, fastq->seq, seq_size);
+  memcpy (keep->qual, fastq->qual, qual_size);
+  keep->size = fastq->size;
+
+  return keep;
+}
+
 void
 iter_fastq (const char   *path,
             FastqIterFunc func,
             void         *data,
             GError      **error)
 {
-  if (fastq_parser_name == NULL || strcmp (fastq_parser_name, "flex") == 0)
+  if (read_store_check (path))
+    iter_read_store (path, fastq_columns, func, data, error);
+  else if (fastq_parser_name == NULL || strcmp (fastq_parser_name, "flex") == 0)
     iter_fastq_flex (path, func, data, error);
   else if (strcmp (fastq_parser_name, "simple") == 0)
     iter_fastq_simple (path, func, data, error);
   else if (strcmp (fastq_parser_name, "ugly") == 0)
     iter_fastq_ugly (path, func, data, error);
+  else if (strcmp (fastq_parser_name, "mmap") == 0)
+    iter_fastq_mmap (path, func, data, error);
+  else if (strcmp (fastq_parser_name, "stream") == 0)
+    iter_fastq_stream (path, func, data, error);
   else
     {
       g_set_error (error,
@@ -125,88 +246,60 @@ iter_fastq_simple (const char   *path,
 {
   GIOChannel *channel;
   GError     *tmp_err = NULL;
-  FastqSeq   *fastq   = NULL;
-  char       *line    = NULL;
-  gsize       length;
+  FastqSeq    fastq;
+  GString    *name;
+  GString    *seq;
+  GString    *line;
+  GString    *qual;
   gsize       endl;
-  int         ret;
-
-  if (path[0] == '-' && path[1] == '\0')
-    {
-      channel = g_io_channel_unix_new (STDIN_FILENO);
-      if (!channel)
-        {
-          g_set_error (error,
-                       NGS_ERROR,
-                       NGS_IO_ERROR,
-                       "Could not open stdin for reading");
-          return;
-        }
-    }
-  else
-    {
-      channel = g_io_channel_new_file (path, "r", &tmp_err);
 
-      if (tmp_err != NULL)
-        {
-          g_propagate_error (error, tmp_err);
-          if (channel)
-            g_io_channel_unref (channel);
-          return;
-        }
-    }
+  channel = ngs_input_channel_new (path, error);
+  if (channel == NULL)
+    return;
 
-  while (G_IO_STATUS_NORMAL == g_io_channel_read_line (channel, &line, &length, &endl, &tmp_err))
+  /* The lines are read into the same buffers for all the records */
+  name = g_string_sized_new (256);
+  seq  = g_string_sized_new (256);
+  line = g_string_sized_new (256);
+  qual = g_string_sized_new (256);
+  while (G_IO_STATUS_NORMAL == g_io_channel_read_line_string (channel, name, &endl, &tmp_err))
     {
-      if (*line == '@')
+      if (name->str[0] == '@')
         {
           /* Sequence header */
-          line[endl]  = '\0';
-          fastq       = fastq_seq_new ();
-          fastq->name = strdup (line + 1);
-          g_free (line);
+          g_string_truncate (name, endl);
 
           /* Sequence */
-          g_io_channel_read_line (channel, &line, &length, &endl, &tmp_err);
-          if (tmp_err)
-            goto error;
-          line[endl] = '\0';
-          fastq->seq = line;
+          if (g_io_channel_read_line_string (channel, seq, &endl, &tmp_err) != G_IO_STATUS_NORMAL)
+            break;
+          g_string_truncate (seq, endl);
 
           /* Quality header */
-          g_io_channel_read_line (channel, &line, &length, &endl, &tmp_err);
-          if (tmp_err)
-            goto error;
-          g_free (line);
+          if (g_io_channel_read_line_string (channel, line, &endl, &tmp_err) != G_IO_STATUS_NORMAL)
+            break;
 
           /* Quality */
-          g_io_channel_read_line (channel, &line, &length, &endl, &tmp_err);
-          if (tmp_err)
-            goto error;
-          line[endl]  = '\0';
-          fastq->qual = line;
+          if (g_io_channel_read_line_string (channel, qual, &endl, &tmp_err) != G_IO_STATUS_NORMAL)
+            break;
+          g_string_truncate (qual, endl);
 
-          /* Size */
-          fastq->size = MIN (strlen (fastq->seq),
-                             strlen (fastq->qual));
+          fastq.name = name->str + 1;
+          fastq.seq  = seq->str;
+          fastq.qual = qual->str;
+          fastq.size = MIN (seq->len, qual->len);
 
           /* Callback */
-          ret = func (fastq, data);
-          fastq_seq_free (fastq);
-          if (!ret)
+          if (!func (&fastq, data))
             break;
         }
     }
-  goto cleanup;
-
-error:
-  if (line)
-    g_free (line);
-  if (fastq)
-    fastq_seq_free (fastq);
-  g_propagate_error (error, tmp_err);
+  if (tmp_err)
+    g_propagate_error (error, tmp_err);
 
-cleanup:
+  g_string_free (name, TRUE);
+  g_string_free (seq, TRUE);
+  g_string_free (line, TRUE);
+  g_string_free (qual, TRUE);
   g_io_channel_unref (channel);
 }
 
@@ -222,7 +315,7 @@ iter_fastq_ugly  (const char    *path,
   char      name[MAX_STRING_SIZE + 1];
   char      seq[MAX_STRING_SIZE + 1];
   char      qual[MAX_STRING_SIZE + 1];
-  FILE     *file;
+  NgsInput *input;
   FastqSeq  current;
   FastqSeq *fastq    = NULL;
   int       name_idx = 0;
@@ -231,23 +324,13 @@ iter_fastq_ugly  (const char    *path,
   int       status   = 0;
   int       i;
 
-  if (path[0] == '-' && path[1] == '\0')
-    file = stdin;
-  else
-    file = fopen (path, "r");
-  if (file == NULL)
-    {
-      g_set_error (error,
-                   NGS_ERROR,
-                   NGS_IO_ERROR,
-                   "Could not open input file `%s'",
-                   path);
-      return;
-    }
+  input = ngs_input_open (path, error);
+  if (input == NULL)
+    return;
 
   do
     {
-      const size_t bytes_read = fread (buffer, sizeof (char), BUFFER_SIZE, file);
+      const gssize bytes_read = ngs_input_read (input, buffer, BUFFER_SIZE);
 
       for (i = 0; i < bytes_read; i++)
         {
@@ -350,20 +433,13 @@ iter_fastq_ugly  (const char    *path,
                 }
             }
         }
-      if (bytes_read < BUFFER_SIZE)
+      if (bytes_read < 0)
         {
-          if (feof (file))
-            break;
-          if (ferror (file))
-            {
-              g_set_error (error,
-                           NGS_ERROR,
-                           NGS_IO_ERROR,
-                           "Error while reading `%s'",
-                           path);
-              goto cleanup;
-            }
+          ngs_input_get_error (input, error);
+          goto cleanup;
         }
+      if (bytes_read == 0)
+        break;
     }
   while (1);
   if ((status == 0 || status == 5) && fastq)
@@ -373,19 +449,479 @@ iter_fastq_ugly  (const char    *path,
     }
 
 cleanup:
-  fclose (file);
+  ngs_input_close (input);
 
 #undef BUFFER_SIZE
 #undef MAX_NAME_SIZE
 }
 
+/**
+ * Parser for regular files.
+ * The file is mapped read-only and the lines are found in the mapping, each
+ * record being copied into a single buffer reused for all the records, where
+ * its fields are '\0'-terminated.  The mapping is never written to, so its
+ * pages stay in the page cache, and the pages already parsed are released
+ * every MMAP_RELEASE_SIZE bytes so that the memory used does not grow with the
+ * size of the file.
+ * Anything that cannot be mapped (stdin, pipes, ...) or that is compressed
+ * goes to the streaming parser.
+ */
+#define MMAP_RELEASE_SIZE (16 * 1024 * 1024)
+
+static void
+iter_fastq_mmap (const char   *path,
+                 FastqIterFunc func,
+                 void         *data,
+                 GError      **error)
+{
+  struct stat   st;
+  FastqSeq      fastq;
+  unsigned char magic[2];
+  char         *map;
+  const char   *cursor;
+  const char   *end;
+  char         *released;
+  char         *record      = NULL;
+  gsize         record_size = 0;
+  int           fd;
+
+  if (path[0] == '-' && path[1] == '\0')
+    {
+      iter_fastq_stream (path, func, data, error);
+      return;
+    }
+  fd = open (path, O_RDONLY);
+  if (fd < 0)
+    {
+      g_set_error (error,
+                   NGS_ERROR,
+                   NGS_IO_ERROR,
+                   "Could not open input file `%s'",
+                   path);
+      return;
+    }
+  if (fstat (fd, &st) != 0 || !S_ISREG (st.st_mode) ||
+      (pread (fd, magic, 2, 0) == 2 && magic[0] == 0x1f && magic[1] == 0x8b))
+    {
+      close (fd);
+      iter_fastq_stream (path, func, data, error);
+      return;
+    }
+  if (st.st_size == 0)
+    {
+      close (fd);
+      return;
+    }
+  map = mmap (NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  if (map == MAP_FAILED)
+    {
+      close (fd);
+      g_set_error (error,
+                   NGS_ERROR,
+                   NGS_IO_ERROR,
+                   "Could not map input file `%s'",
+                   path);
+      return;
+    }
+  madvise (map, st.st_size, MADV_SEQUENTIAL);
+
+  cursor   = map;
+  end      = map + st.st_size;
+  released = map;
+  while (cursor < end)
+    {
+      const char *name;
+      const char *seq;
+      const char *qual;
+      gsize       name_len;
+      gsize       seq_len;
+      gsize       qual_len;
+      gsize       length;
+
+      /* Skip anything until the next sequence header */
+      if (*cursor != '@')
+        {
+          mmap_read_line (&cursor, end, &length);
+          continue;
+        }
+      ++cursor;
+      name = mmap_read_line (&cursor, end, &name_len);
+      seq  = mmap_read_line (&cursor, end, &seq_len);
+      if (mmap_read_line (&cursor, end, &length) == NULL)
+        break;
+      qual = mmap_read_line (&cursor, end, &qual_len);
+      if (qual == NULL)
+        break;
+
+      if (name_len + seq_len + qual_len + 3 > record_size)
+        {
+          record_size = 2 * (name_len + seq_len + qual_len + 3);
+          record      = g_realloc (record, record_size);
+        }
+      fastq.name = record;
+      fastq.seq  = fastq.name + name_len + 1;
+      fastq.qual = fastq.seq + seq_len + 1;
+      memcpy (fastq.name, name, name_len);
+      memcpy (fastq.seq, seq, seq_len);
+      memcpy (fastq.qual, qual, qual_len);
+      fastq.name[name_len] = '\0';
+      fastq.seq[seq_len]   = '\0';
+      fastq.qual[qual_len] = '\0';
+      fastq.size = MIN (seq_len, qual_len);
+      if (!func (&fastq, data))
+        break;
+
+      /* The mapping is page aligned, and so is MMAP_RELEASE_SIZE */
+      if (cursor - released >= MMAP_RELEASE_SIZE)
+        {
+          madvise (released, MMAP_RELEASE_SIZE, MADV_DONTNEED);
+          released += MMAP_RELEASE_SIZE;
+        }
+    }
+
+  g_free (record);
+  munmap (map, st.st_size);
+  close (fd);
+}
+
+#undef MMAP_RELEASE_SIZE
+
+/**
+ * Returns the line starting at `cursor', of `length' characters without its
+ * end of line, and moves `cursor' to the start of the next line.
+ * A trailing '\r' is not counted in the length.
+ */
+static const char*
+mmap_read_line (const char **cursor,
+                const char  *end,
+                gsize       *length)
+{
+  const char *line = *cursor;
+  const char *eol;
+
+  if (line >= end)
+    {
+      *length = 0;
+      return NULL;
+    }
+  eol = memchr (line, '\n', end - line);
+  if (eol == NULL)
+    eol = end;
+  *length = eol - line;
+  *cursor = MIN (eol + 1, end);
+  if (*length > 0 && line[*length - 1] == '\r')
+    --(*length);
+
+  return line;
+}
+
+/**
+ * Streaming parser for pipes and stdin.
+ * Large blocks are read with read(2), and the positions of all the new lines
+ * in a block are collected at once in a bitmap by a vectorised kernel.  The
+ * records are then cut from the bitmap: a record starts on a line beginning
+ * with '@' and its third line must begin with '+', anything else is skipped
+ * until the next candidate record.  The buffer grows as needed, so there is no
+ * limit on the size of the fields.  Gzip input is inflated by NgsInput.
+ */
+#define STREAM_BLOCK_SIZE (4 * 1024 * 1024)
+#define STREAM_N_LINES    4
+
+static void
+iter_fastq_stream (const char   *path,
+                   FastqIterFunc func,
+                   void         *data,
+                   GError      **error)
+{
+  NgsInput *input;
+
+  input = ngs_input_open (path, error);
+  if (input == NULL)
+    return;
+  stream_parse (input, 0, G_MAXUINT64, NULL, func, data, error);
+  ngs_input_close (input);
+}
+
+void
+iter_fastq_offsets (const char    *path,
+                    FastqIterFunc  func,
+                    void          *data,
+                    guint64       *offset,
+                    GError       **error)
+{
+  NgsInput *input;
+
+  input = ngs_input_open (path, error);
+  if (input == NULL)
+    return;
+  stream_parse (input, 0, G_MAXUINT64, offset, func, data, error);
+  ngs_input_close (input);
+}
+
+/**
+ * Parses the records of input, whose first byte is at offset start in the
+ * file.  If start is not 0, the partial line at the start is skipped and the
+ * parsing starts on the first record.  The records starting after offset end
+ * are left out.  If offset is not NULL, it is set to the offset of each
+ * record before func is called.
+ */
+static void
+stream_parse (NgsInput     *input,
+              guint64       start,
+              guint64       end,
+              guint64      *offset,
+              FastqIterFunc func,
+              void         *data,
+              GError      **error)
+{
+  ScanNewlinesFunc scan;
+  FastqSeq         fastq;
+  char            *buffer;
+  guint64         *bits;
+  gsize            alloc;
+  gsize            length   = 0;
+  gsize            pos      = 0;
+  int              at_eof   = 0;
+  int              synced   = start == 0;
+
+  scan   = get_scan_newlines_func ();
+  alloc  = STREAM_BLOCK_SIZE;
+  /* One spare byte to terminate a last line without new line */
+  buffer = g_malloc (alloc + 1);
+  bits   = g_malloc0 ((alloc / 64 + 1) * sizeof (*bits));
+
+  while (1)
+    {
+      gsize ends[STREAM_N_LINES];
+      gsize line;
+      int   n     = 0;
+
+      /* Find the first record, skipping the end of the current line */
+      if (!synced && length > 0)
+        {
+          const char *eol = memchr (buffer, '\n', length);
+
+          if (eol != NULL)
+            {
+              const gssize first = fastq_find_record_start (eol + 1,
+                                                            length - (eol + 1 - buffer));
+
+              if (first >= 0)
+                {
+                  pos    = eol + 1 - buffer + first;
+                  synced = 1;
+                }
+            }
+        }
+
+      /* Find the ends of the next four lines */
+      line = pos;
+      while (synced && n < STREAM_N_LINES && line < length)
+        {
+          gsize   word = line / 64;
+          guint64 mask = bits[word] & (~G_GUINT64_CONSTANT (0) << (line % 64));
+
+          while (mask == 0 && ++word <= (length - 1) / 64)
+            mask = bits[word];
+          if (mask == 0)
+            break;
+          ends[n] = word * 64 + __builtin_ctzll (mask);
+          if (ends[n] >= length)
+            break;
+          line = ends[n] + 1;
+          /* Resynchronise on the next potential header */
+          if (n == 0 && buffer[pos] != '@')
+            {
+              pos = line;
+              continue;
+            }
+          ++n;
+        }
+
+      if (n < STREAM_N_LINES)
+        {
+          gssize bytes_read;
+
+          if (at_eof)
+            break;
+          /* Keep the incomplete record and refill the buffer */
+          if (pos > 0)
+            {
+              memmove (buffer, buffer + pos, length - pos);
+              length -= pos;
+              start  += pos;
+              pos     = 0;
+            }
+          if (length == alloc)
+            {
+              alloc  *= 2;
+              buffer  = g_realloc (buffer, alloc + 1);
+              bits    = g_realloc (bits, (alloc / 64 + 1) * sizeof (*bits));
+            }
+          bytes_read = ngs_input_read (input, buffer + length, alloc - length);
+          if (bytes_read < 0)
+            {
+              ngs_input_get_error (input, error);
+              break;
+            }
+          if (bytes_read == 0)
+            {
+              at_eof = 1;
+              if (length > 0 && buffer[length - 1] != '\n')
+                buffer[length++] = '\n';
+            }
+          else
+            length += bytes_read;
+          memset (bits, 0, (length / 64 + 1) * sizeof (*bits));
+          scan (buffer, length, bits);
+          continue;
+        }
+
+      if (buffer[ends[1] + 1] != '+')
+        {
+          /* Not a record after all, try again from the next line */
+          pos = ends[0] + 1;
+          continue;
+        }
+      /* The next records belong to the next part of the file */
+      if (start + pos > end)
+        break;
+      if (offset)
+        *offset = start + pos;
+      fastq.name = buffer + pos + 1;
+      fastq.seq  = buffer + ends[0] + 1;
+      fastq.qual = buffer + ends[2] + 1;
+      pos        = ends[3] + 1;
+      for (n = 0; n < STREAM_N_LINES; n++)
+        {
+          buffer[ends[n]] = '\0';
+          if (ends[n] > 0 && buffer[ends[n] - 1] == '\r')
+            buffer[--ends[n]] = '\0';
+        }
+      fastq.size = MIN (buffer + ends[1] - fastq.seq,
+                        buffer + ends[3] - fastq.qual);
+      if (!func (&fastq, data))
+        break;
+    }
+
+  g_free (bits);
+  g_free (buffer);
+}
+
+#undef STREAM_BLOCK_SIZE
+#undef STREAM_N_LINES
+
+/**
+ * Sets the bits corresponding to the '\n' characters of buffer.
+ * The bitmap must be zeroed and large enough for (size / 64 + 1) words.
+ */
+static void
+scan_newlines_generic (const char *buffer,
+                       gsize       size,
+                       guint64    *bits)
+{
+  const char *p   = buffer;
+  const char *end = buffer + size;
+
+  while ((p = memchr (p, '\n', end - p)) != NULL)
+    {
+      const gsize i = p - buffer;
+
+      bits[i / 64] |= G_GUINT64_CONSTANT (1) << (i % 64);
+      ++p;
+    }
+}
+
+#ifdef NGS_SCAN_X86
+
+__attribute__ ((target ("sse2")))
+static void
+scan_newlines_sse2 (const char *buffer,
+                    gsize       size,
+                    guint64    *bits)
+{
+  const __m128i nl   = _mm_set1_epi8 ('\n');
+  const gsize   full = size / 64;
+  gsize         i;
+
+  for (i = 0; i < full; i++)
+    {
+      const char *p = buffer + i * 64;
+      guint64     m0;
+      guint64     m1;
+      guint64     m2;
+      guint64     m3;
+
+      m0 = (guint32)_mm_movemask_epi8 (_mm_cmpeq_epi8 (_mm_loadu_si128 ((const __m128i*)(p +  0)), nl));
+      m1 = (guint32)_mm_movemask_epi8 (_mm_cmpeq_epi8 (_mm_loadu_si128 ((const __m128i*)(p + 16)), nl));
+      m2 = (guint32)_mm_movemask_epi8 (_mm_cmpeq_epi8 (_mm_loadu_si128 ((const __m128i*)(p + 32)), nl));
+      m3 = (guint32)_mm_movemask_epi8 (_mm_cmpeq_epi8 (_mm_loadu_si128 ((const __m128i*)(p + 48)), nl));
+      bits[i] = m0 | (m1 << 16) | (m2 << 32) | (m3 << 48);
+    }
+  scan_newlines_generic (buffer + full * 64, size - full * 64, bits + full);
+}
+
+__attribute__ ((target ("avx2")))
+static void
+scan_newlines_avx2 (const char *buffer,
+                    gsize       size,
+                    guint64    *bits)
+{
+  const __m256i nl   = _mm256_set1_epi8 ('\n');
+  const gsize   full = size / 64;
+  gsize         i;
+
+  for (i = 0; i < full; i++)
+    {
+      const char *p = buffer + i * 64;
+      guint64     lo;
+      guint64     hi;
+
+      lo = (guint32)_mm256_movemask_epi8 (_mm256_cmpeq_epi8 (_mm256_loadu_si256 ((const __m256i*)(p +  0)), nl));
+      hi = (guint32)_mm256_movemask_epi8 (_mm256_cmpeq_epi8 (_mm256_loadu_si256 ((const __m256i*)(p + 32)), nl));
+      bits[i] = lo | (hi << 32);
+    }
+  scan_newlines_generic (buffer + full * 64, size - full * 64, bits + full);
+}
+
+#endif /* NGS_SCAN_X86 */
+
+/**
+ * Picks the best new line scanning kernel supported by the running CPU.
+ */
+static ScanNewlinesFunc
+get_scan_newlines_func (void)
+{
+  static ScanNewlinesFunc scan = NULL;
+
+  if (scan == NULL)
+    {
+      scan = scan_newlines_generic;
+#ifdef NGS_SCAN_X86
+      __builtin_cpu_init ();
+      if (__builtin_cpu_supports ("avx2"))
+        scan = scan_newlines_avx2;
+      else if (__builtin_cpu_supports ("sse2"))
+        scan = scan_newlines_sse2;
+#endif
+    }
+
+  return scan;
+}
+
+void
+fastq_set_columns (FastqColumns columns)
+{
+  fastq_columns = columns | FASTQ_COLUMN_SEQ;
+}
+
 GOptionGroup*
 get_fastq_option_group (void)
 {
   GOptionEntry entries[] =
     {
-      {"fastq_parser_name", 0, 0, G_OPTION_ARG_STRING,   &fastq_parser_name, "Name of the parser",               NULL},
-      {"fastq_qual0"      , 0, 0, G_OPTION_ARG_CALLBACK, &fastq_parse_qual0, "The character encoding quality 0", NULL},
+      {"fastq_parser_name", 0, 0, G_OPTION_ARG_STRING,   &fastq_parser_name, "Name of the parser (flex, simple, ugly, mmap or stream)", NULL},
+      {"fastq_qual0"      , 0, 0, G_OPTION_ARG_CALLBACK, &fastq_parse_qual0, "The character encoding quality 0",                          NULL},
       {NULL}
     };
   GOptionGroup *option_group;
@@ -406,8 +942,23 @@ fastq_iter_new (const char *path,
 {
   FastqIter *iter;
 
-  iter = g_slice_new (FastqIter);
-  iter->private = fastq_iter_new_flex (path, error);
+  iter = g_slice_new0 (FastqIter);
+  if (read_store_check (path))
+    {
+      ReadStore *store;
+
+      store = read_store_open (path, error);
+      if (store)
+        {
+          iter->store      = store;
+          iter->store_iter = read_store_iter_new (store,
+                                                  0,
+                                                  read_store_n_blocks (store),
+                                                  fastq_columns);
+        }
+    }
+  else
+    iter->private = fastq_iter_new_flex (path, error);
 
   return iter;
 }
@@ -415,7 +966,25 @@ fastq_iter_new (const char *path,
 FastqSeq*
 fastq_iter_next (FastqIter *iter)
 {
-  return fastq_iter_next_flex ((FastqIterFlex*)iter->private);
+  if (iter->error)
+    return NULL;
+  if (iter->store_iter)
+    return read_store_iter_next ((ReadStoreIter*)iter->store_iter,
+                                 &iter->error);
+  if (iter->private == NULL)
+    return NULL;
+  return fastq_iter_next_flex ((FastqIterFlex*)iter->private, &iter->error);
+}
+
+gboolean
+fastq_iter_get_error (FastqIter *iter,
+                      GError   **error)
+{
+  if (iter->error == NULL)
+    return FALSE;
+  g_propagate_error (error, g_error_copy (iter->error));
+
+  return TRUE;
 }
 
 void
@@ -425,29 +994,784 @@ fastq_iter_free (FastqIter *iter)
     {
       if (iter->private)
         fastq_iter_free_flex ((FastqIterFlex*)iter->private);
+      if (iter->store_iter)
+        read_store_iter_free ((ReadStoreIter*)iter->store_iter);
+      if (iter->store)
+        read_store_close ((ReadStore*)iter->store);
+      if (iter->error)
+        g_error_free (iter->error);
       g_slice_free (FastqIter, iter);
     }
 }
 
-void
-fastq_write (GIOChannel *channel,
-             GString    *buffer,
-             char       *name,
-             char       *seq,
-             char       *qual,
-             GError    **error)
+FastqBatch*
+fastq_batch_new (void)
+{
+  FastqBatch *batch;
+
+  batch = g_slice_new0 (FastqBatch);
+
+  return batch;
+}
+
+void
+fastq_batch_free (FastqBatch *batch)
+{
+  if (batch)
+    {
+      g_free (batch->seqs);
+      g_free (batch->arena);
+      g_slice_free (FastqBatch, batch);
+    }
+}
+
+gsize
+fastq_iter_next_batch (FastqIter  *iter,
+                       FastqBatch *batch,
+                       gsize       max_records)
+{
+  FastqSeq *seq;
+
+  fastq_batch_clear (batch);
+  while (batch->n_seqs < max_records && (seq = fastq_iter_next (iter)) != NULL)
+    fastq_batch_append (batch, seq);
+  fastq_batch_seal (batch);
+
+  return batch->n_seqs;
+}
+
+static void
+fastq_batch_clear (FastqBatch *batch)
+{
+  batch->n_seqs     = 0;
+  batch->arena_size = 0;
+}
+
+static void
+fastq_batch_append (FastqBatch *batch,
+                    FastqSeq   *seq)
+{
+  const gsize name_size = strlen (seq->name) + 1;
+  const gsize seq_size  = strlen (seq->seq) + 1;
+  const gsize qual_size = strlen (seq->qual) + 1;
+  const gsize size      = name_size + seq_size + qual_size;
+  char       *cursor;
+
+  if (batch->n_seqs == batch->n_alloc)
+    {
+      batch->n_alloc = MAX (2 * batch->n_alloc, 256);
+      batch->seqs    = g_renew (FastqSeq, batch->seqs, batch->n_alloc);
+    }
+  if (batch->arena_size + size > batch->arena_alloc)
+    {
+      batch->arena_alloc = MAX (2 * batch->arena_alloc,
+                                batch->arena_size + size);
+      batch->arena_alloc = MAX (batch->arena_alloc, 1 << 16);
+      batch->arena       = g_realloc (batch->arena, batch->arena_alloc);
+    }
+  cursor = batch->arena + batch->arena_size;
+  memcpy (cursor, seq->name, name_size);
+  cursor += name_size;
+  memcpy (cursor, seq->seq, seq_size);
+  cursor += seq_size;
+  memcpy (cursor, seq->qual, qual_size);
+  batch->arena_size               += size;
+  batch->seqs[batch->n_seqs].size  = seq->size;
+  batch->n_seqs++;
+}
+
+/**
+ * Points the records to their data, once the arena has stopped moving.
+ */
+static void
+fastq_batch_seal (FastqBatch *batch)
+{
+  char  *cursor = batch->arena;
+  gsize  i;
+
+  for (i = 0; i < batch->n_seqs; i++)
+    {
+      FastqSeq *record = batch->seqs + i;
+
+      record->name = cursor;
+      cursor      += strlen (cursor) + 1;
+      record->seq  = cursor;
+      cursor      += strlen (cursor) + 1;
+      record->qual = cursor;
+      cursor      += strlen (cursor) + 1;
+    }
+}
+
+/**
+ * Paired iteration.
+ * Each reader thread fills batches taken from a queue of free batches, and
+ * hands them over to the caller in a queue of full batches.  An empty batch
+ * marks the end of the file, or an error, which the reader stores before
+ * pushing that batch.  The batches used up by the caller are only
+ * given back to the reader at the next call, as the records returned last
+ * may still point into them.
+ */
+#define PAIR_BATCH_SIZE 4096
+#define PAIR_N_BATCHES  4
+
+struct _PairReader
+{
+  char        *path;
+  FastqIter   *iter;
+  GThread     *thread;
+  GAsyncQueue *free_batches;
+  GAsyncQueue *full_batches;
+  FastqBatch  *batch;
+  gsize        next;
+  GSList      *used;
+  int          done;
+  GError      *error;
+};
+
+struct _FastqPairIter
+{
+  PairReader readers[2];
+  int        n_readers;
+  int        check_names;
+};
+
+/* Pushed to the free batches to stop a reader */
+static FastqBatch pair_stop_batch;
+
+FastqPairIter*
+fastq_pair_iter_new (const char *path1,
+                     const char *path2,
+                     int         check_names,
+                     GError    **error)
+{
+  FastqPairIter *iter;
+
+  iter              = g_slice_new0 (FastqPairIter);
+  iter->check_names = check_names;
+  iter->n_readers   = path2 ? 2 : 1;
+  if (!pair_reader_init (&iter->readers[0], path1, error) ||
+      (path2 && !pair_reader_init (&iter->readers[1], path2, error)))
+    {
+      fastq_pair_iter_free (iter);
+      return NULL;
+    }
+
+  return iter;
+}
+
+gboolean
+fastq_pair_iter_next (FastqPairIter *iter,
+                      FastqSeq     **seq1,
+                      FastqSeq     **seq2,
+                      GError       **error)
+{
+  PairReader *reader1 = &iter->readers[0];
+  PairReader *reader2 = &iter->readers[iter->n_readers - 1];
+  gsize       size;
+
+  pair_reader_release (reader1);
+  pair_reader_release (reader2);
+
+  *seq1 = pair_reader_next (reader1);
+  *seq2 = pair_reader_next (reader2);
+  if (pair_reader_get_error (reader1, error) ||
+      pair_reader_get_error (reader2, error))
+    return FALSE;
+  if (*seq1 == NULL && *seq2 == NULL)
+    return FALSE;
+  if (*seq2 == NULL)
+    {
+      if (iter->n_readers == 1)
+        g_set_error (error,
+                     NGS_ERROR,
+                     NGS_PARSE_ERROR,
+                     "Interleaved file `%s' has an odd number of reads",
+                     reader1->path);
+      else
+        g_set_error (error,
+                     NGS_ERROR,
+                     NGS_PARSE_ERROR,
+                     "`%s' has more reads than `%s'",
+                     reader1->path,
+                     reader2->path);
+      return FALSE;
+    }
+  if (*seq1 == NULL)
+    {
+      g_set_error (error,
+                   NGS_ERROR,
+                   NGS_PARSE_ERROR,
+                   "`%s' has more reads than `%s'",
+                   reader2->path,
+                   reader1->path);
+      return FALSE;
+    }
+  if (iter->check_names)
+    {
+      size = pair_name_size ((*seq1)->name);
+      if (size != pair_name_size ((*seq2)->name) ||
+          memcmp ((*seq1)->name, (*seq2)->name, size) != 0)
+        {
+          g_set_error (error,
+                       NGS_ERROR,
+                       NGS_PARSE_ERROR,
+                       "The names of mates `%s' and `%s' do not match",
+                       (*seq1)->name,
+                       (*seq2)->name);
+          return FALSE;
+        }
+    }
+
+  return TRUE;
+}
+
+void
+fastq_pair_iter_free (FastqPairIter *iter)
+{
+  if (iter)
+    {
+      int i;
+
+      for (i = 0; i < iter->n_readers; i++)
+        pair_reader_clear (&iter->readers[i]);
+      g_slice_free (FastqPairIter, iter);
+    }
+}
+
+static gboolean
+pair_reader_init (PairReader *reader,
+                  const char *path,
+                  GError    **error)
+{
+  GError *tmp_error = NULL;
+  int     i;
+
+  reader->path = g_strdup (path);
+  reader->iter = fastq_iter_new (path, &tmp_error);
+  if (tmp_error)
+    {
+      g_propagate_error (error, tmp_error);
+      return FALSE;
+    }
+  reader->free_batches = g_async_queue_new ();
+  reader->full_batches = g_async_queue_new ();
+  for (i = 0; i < PAIR_N_BATCHES; i++)
+    g_async_queue_push (reader->free_batches, fastq_batch_new ());
+  reader->thread = g_thread_new ("fastq_pair_reader",
+                                 (GThreadFunc)pair_reader_thread,
+                                 reader);
+
+  return TRUE;
+}
+
+static void
+pair_reader_clear (PairReader *reader)
+{
+  FastqBatch *batch;
+  GSList     *tmp;
+
+  if (reader->thread)
+    {
+      g_async_queue_push (reader->free_batches, &pair_stop_batch);
+      g_thread_join (reader->thread);
+    }
+  if (reader->free_batches)
+    {
+      while ((batch = g_async_queue_try_pop (reader->free_batches)) != NULL)
+        if (batch != &pair_stop_batch)
+          fastq_batch_free (batch);
+      g_async_queue_unref (reader->free_batches);
+    }
+  if (reader->full_batches)
+    {
+      while ((batch = g_async_queue_try_pop (reader->full_batches)) != NULL)
+        fastq_batch_free (batch);
+      g_async_queue_unref (reader->full_batches);
+    }
+  for (tmp = reader->used; tmp; tmp = tmp->next)
+    fastq_batch_free (tmp->data);
+  g_slist_free (reader->used);
+  fastq_batch_free (reader->batch);
+  fastq_iter_free (reader->iter);
+  if (reader->error)
+    g_error_free (reader->error);
+  g_free (reader->path);
+}
+
+static gpointer
+pair_reader_thread (PairReader *reader)
+{
+  FastqBatch *batch;
+
+  while ((batch = g_async_queue_pop (reader->free_batches)) != &pair_stop_batch)
+    {
+      if (fastq_iter_next_batch (reader->iter, batch, PAIR_BATCH_SIZE) == 0)
+        fastq_iter_get_error (reader->iter, &reader->error);
+      g_async_queue_push (reader->full_batches, batch);
+      if (batch->n_seqs == 0)
+        break;
+    }
+
+  return NULL;
+}
+
+static FastqSeq*
+pair_reader_next (PairReader *reader)
+{
+  while (!reader->done &&
+         (reader->batch == NULL || reader->next == reader->batch->n_seqs))
+    {
+      if (reader->batch)
+        reader->used = g_slist_prepend (reader->used, reader->batch);
+      reader->batch = g_async_queue_pop (reader->full_batches);
+      reader->next  = 0;
+      if (reader->batch->n_seqs == 0)
+        reader->done = 1;
+    }
+  if (reader->done)
+    return NULL;
+
+  return reader->batch->seqs + reader->next++;
+}
+
+static void
+pair_reader_release (PairReader *reader)
+{
+  GSList *tmp;
+
+  for (tmp = reader->used; tmp; tmp = tmp->next)
+    g_async_queue_push (reader->free_batches, tmp->data);
+  g_slist_free (reader->used);
+  reader->used = NULL;
+}
+
+/**
+ * The error is only looked at once the empty batch pushed after it has been
+ * popped.
+ */
+static gboolean
+pair_reader_get_error (PairReader *reader,
+                       GError    **error)
+{
+  if (!reader->done || reader->error == NULL)
+    return FALSE;
+  g_propagate_error (error, g_error_copy (reader->error));
+
+  return TRUE;
+}
+
+/**
+ * The size of the part of a read name which must be the same in both mates
+ */
+static gsize
+pair_name_size (const char *name)
+{
+  gsize size;
+
+  size = strcspn (name, " \t");
+  if (size > 2 && name[size - 2] == '/' &&
+      (name[size - 1] == '1' || name[size - 1] == '2'))
+    size -= 2;
+
+  return size;
+}
+
+/**
+ * Parallel iteration.
+ * The calling thread parses the file into batches, which are processed by a
+ * pool of threads.  A writer thread collects the output of the batches, in
+ * the order in which they were read when the output is ordered, or as soon
+ * as they are done otherwise.  The number of batches in flight is bounded by
+ * the number of jobs.
+ */
+#define PARALLEL_BATCH_SIZE 1024
+#define PARALLEL_N_JOBS     4
+
+struct _ParallelJob
+{
+  FastqBatch *batch;
+  GString    *output;
+  int         done;
+  int         last;
+};
+
+struct _ParallelData
+{
+  FastqParallelFunc func;
+  void             *data;
+  NgsWriter        *writer;
+  GThreadPool      *pool;
+  GAsyncQueue      *free_jobs;
+  GAsyncQueue      *pending_jobs;
+  ParallelJob      *current;
+  GMutex            lock;
+  GCond             cond;
+  GError           *error;
+  int               ordered;
+  int               stopped;
+};
+
+void
+iter_fastq_parallel (const char       *path,
+                     FastqParallelFunc func,
+                     void             *data,
+                     int               n_threads,
+                     int               ordered,
+                     NgsWriter        *writer,
+                     GError          **error)
+{
+  ParallelData pd;
+  ParallelJob  last;
+  ParallelJob *job;
+  GThread     *writer_thread;
+  GError      *tmp_err = NULL;
+  int          n_jobs;
+  int          i;
+
+  if (n_threads < 1)
+    n_threads = 1;
+  n_jobs          = PARALLEL_N_JOBS * n_threads;
+  pd.func         = func;
+  pd.data         = data;
+  pd.writer       = writer;
+  pd.free_jobs    = g_async_queue_new ();
+  pd.pending_jobs = g_async_queue_new ();
+  pd.current      = NULL;
+  pd.error        = NULL;
+  pd.ordered      = ordered;
+  pd.stopped      = 0;
+  g_mutex_init (&pd.lock);
+  g_cond_init (&pd.cond);
+  for (i = 0; i < n_jobs; i++)
+    {
+      job         = g_slice_new0 (ParallelJob);
+      job->batch  = fastq_batch_new ();
+      job->output = g_string_sized_new (PARALLEL_BATCH_SIZE * 256);
+      g_async_queue_push (pd.free_jobs, job);
+    }
+  pd.pool = g_thread_pool_new ((GFunc)parallel_process,
+                               &pd,
+                               n_threads,
+                               TRUE,
+                               NULL);
+  writer_thread = g_thread_new ("fastq_writer", (GThreadFunc)parallel_write, &pd);
+
+  iter_fastq (path, (FastqIterFunc)parallel_read, &pd, &tmp_err);
+  if (pd.current)
+    parallel_submit (&pd);
+
+  /* Waits for all the batches to be processed */
+  g_thread_pool_free (pd.pool, FALSE, TRUE);
+  memset (&last, 0, sizeof (last));
+  last.last = 1;
+  g_async_queue_push (pd.pending_jobs, &last);
+  g_thread_join (writer_thread);
+
+  for (i = 0; i < n_jobs; i++)
+    {
+      job = g_async_queue_pop (pd.free_jobs);
+      fastq_batch_free (job->batch);
+      g_string_free (job->output, TRUE);
+      g_slice_free (ParallelJob, job);
+    }
+  g_async_queue_unref (pd.free_jobs);
+  g_async_queue_unref (pd.pending_jobs);
+  g_mutex_clear (&pd.lock);
+  g_cond_clear (&pd.cond);
+
+  if (tmp_err)
+    {
+      g_propagate_error (error, tmp_err);
+      if (pd.error)
+        g_error_free (pd.error);
+    }
+  else if (pd.error)
+    g_propagate_error (error, pd.error);
+}
+
+static int
+parallel_read (FastqSeq     *fastq,
+               ParallelData *pd)
+{
+  if (g_atomic_int_get (&pd->stopped))
+    return 0;
+  if (pd->current == NULL)
+    {
+      pd->current       = g_async_queue_pop (pd->free_jobs);
+      pd->current->done = 0;
+      fastq_batch_clear (pd->current->batch);
+      g_string_truncate (pd->current->output, 0);
+    }
+  fastq_batch_append (pd->current->batch, fastq);
+  if (pd->current->batch->n_seqs == PARALLEL_BATCH_SIZE)
+    parallel_submit (pd);
+
+  return 1;
+}
+
+static void
+parallel_submit (ParallelData *pd)
 {
-  GError  *tmp_err     = NULL;
-  int      free_buffer = 0;
+  fastq_batch_seal (pd->current->batch);
+  if (pd->ordered)
+    g_async_queue_push (pd->pending_jobs, pd->current);
+  g_thread_pool_push (pd->pool, pd->current, NULL);
+  pd->current = NULL;
+}
 
-  if (buffer == NULL)
+static void
+parallel_process (ParallelJob  *job,
+                  ParallelData *pd)
+{
+  gsize i;
+
+  for (i = 0; i < job->batch->n_seqs; i++)
+    {
+      if (g_atomic_int_get (&pd->stopped))
+        break;
+      if (!pd->func (job->batch->seqs + i, job->output, pd->data))
+        {
+          g_atomic_int_set (&pd->stopped, 1);
+          break;
+        }
+    }
+  if (pd->ordered)
     {
-      buffer = g_string_sized_new (512);
-      free_buffer = 1;
+      g_mutex_lock (&pd->lock);
+      job->done = 1;
+      g_cond_broadcast (&pd->cond);
+      g_mutex_unlock (&pd->lock);
     }
   else
-    g_string_truncate (buffer, 0);
+    {
+      job->done = 1;
+      g_async_queue_push (pd->pending_jobs, job);
+    }
+}
+
+static gpointer
+parallel_write (ParallelData *pd)
+{
+  ParallelJob *job;
+
+  while (!(job = g_async_queue_pop (pd->pending_jobs))->last)
+    {
+      if (pd->ordered)
+        {
+          g_mutex_lock (&pd->lock);
+          while (!job->done)
+            g_cond_wait (&pd->cond, &pd->lock);
+          g_mutex_unlock (&pd->lock);
+        }
+      if (pd->writer && pd->error == NULL && job->output->len > 0)
+        {
+          if (!ngs_writer_write (pd->writer,
+                                 job->output->str,
+                                 job->output->len,
+                                 &pd->error))
+            g_atomic_int_set (&pd->stopped, 1);
+        }
+      g_async_queue_push (pd->free_jobs, job);
+    }
+
+  return NULL;
+}
+
+#undef PARALLEL_BATCH_SIZE
+#undef PARALLEL_N_JOBS
+
+/**
+ * Split iteration.
+ * Each part of the file is parsed by its own thread with the streaming
+ * parser.  A part that does not start the file begins with the first record
+ * found after its start, and every part goes on with the record that
+ * straddles its end, so that each record is parsed exactly once.
+ * For read stores, start and end are block numbers.
+ */
+struct _RangeJob
+{
+  const char    *path;
+  ReadStore     *store;
+  guint64        start;
+  guint64        end;
+  FastqIterFunc  func;
+  void          *data;
+  volatile gint *stopped;
+  GError        *error;
+};
+
+void
+iter_fastq_ranges (const char    *path,
+                   FastqIterFunc  func,
+                   void         **thread_data,
+                   int            n_threads,
+                   GError       **error)
+{
+  RangeJob      *jobs;
+  GThread      **threads;
+  guint64       *offsets = NULL;
+  ReadStore     *store   = NULL;
+  GError        *tmp_err = NULL;
+  volatile gint  stopped = 0;
+  guint          n_parts = 0;
+  guint          i;
+
+  if (n_threads > 1 && read_store_check (path))
+    {
+      guint n_blocks;
+
+      store = read_store_open (path, &tmp_err);
+      if (store)
+        {
+          n_blocks = read_store_n_blocks (store);
+          n_parts  = MIN ((guint)n_threads, n_blocks);
+          offsets  = g_new (guint64, n_parts + 1);
+          for (i = 0; i <= n_parts; i++)
+            offsets[i] = (guint64)n_blocks * i / MAX (n_parts, 1);
+        }
+    }
+  else if (n_threads > 1)
+    n_parts = ngs_input_split (path, n_threads, &offsets, &tmp_err);
+  if (tmp_err)
+    {
+      g_propagate_error (error, tmp_err);
+      return;
+    }
+  if (n_parts < 2)
+    {
+      g_free (offsets);
+      read_store_close (store);
+      iter_fastq (path, func, thread_data[0], error);
+      return;
+    }
+
+  jobs    = g_new0 (RangeJob, n_parts);
+  threads = g_new0 (GThread*, n_parts);
+  for (i = 0; i < n_parts; i++)
+    {
+      jobs[i].path    = path;
+      jobs[i].store   = store;
+      jobs[i].start   = offsets[i];
+      jobs[i].end     = i + 1 < n_parts || store ? offsets[i + 1] : G_MAXUINT64;
+      jobs[i].func    = func;
+      jobs[i].data    = thread_data[i];
+      jobs[i].stopped = &stopped;
+      threads[i]      = g_thread_new ("fastq_range",
+                                      (GThreadFunc)range_thread,
+                                      jobs + i);
+    }
+  for (i = 0; i < n_parts; i++)
+    {
+      g_thread_join (threads[i]);
+      if (jobs[i].error && tmp_err == NULL)
+        tmp_err = jobs[i].error;
+      else if (jobs[i].error)
+        g_error_free (jobs[i].error);
+    }
+  if (tmp_err)
+    g_propagate_error (error, tmp_err);
+
+  g_free (threads);
+  g_free (jobs);
+  g_free (offsets);
+  read_store_close (store);
+}
+
+static gpointer
+range_thread (RangeJob *job)
+{
+  NgsInput *input;
+
+  if (job->store)
+    {
+      range_store (job);
+      return NULL;
+    }
+  input = ngs_input_open_at (job->path, job->start, &job->error);
+  if (input)
+    {
+      stream_parse (input,
+                    job->start,
+                    job->end,
+                    NULL,
+                    (FastqIterFunc)range_func,
+                    job,
+                    &job->error);
+      ngs_input_close (input);
+    }
+  if (job->error)
+    g_atomic_int_set (job->stopped, 1);
+
+  return NULL;
+}
+
+static void
+range_store (RangeJob *job)
+{
+  ReadStoreIter *iter;
+  FastqSeq      *fastq;
+
+  iter = read_store_iter_new (job->store, job->start, job->end, fastq_columns);
+  while ((fastq = read_store_iter_next (iter, &job->error)) != NULL)
+    if (!range_func (fastq, job))
+      break;
+  read_store_iter_free (iter);
+  if (job->error)
+    g_atomic_int_set (job->stopped, 1);
+}
+
+static int
+range_func (FastqSeq *fastq,
+            RangeJob *job)
+{
+  if (g_atomic_int_get (job->stopped))
+    return 0;
+  if (!job->func (fastq, job->data))
+    {
+      g_atomic_int_set (job->stopped, 1);
+      return 0;
+    }
+  return 1;
+}
+
+gssize
+fastq_find_record_start (const char *buffer,
+                         gsize       size)
+{
+  const char *end  = buffer + size;
+  const char *line = buffer;
+
+  while (line < end)
+    {
+      const char *next = memchr (line, '\n', end - line);
+
+      if (next == NULL)
+        break;
+      next++;
+      if (*line == '@')
+        {
+          const char *third = memchr (next, '\n', end - next);
+
+          if (third == NULL)
+            break;
+          third++;
+          if (third >= end)
+            break;
+          if (*third == '+')
+            return line - buffer;
+        }
+      line = next;
+    }
+
+  return -1;
+}
 
+void
+fastq_append (GString *buffer,
+              char    *name,
+              char    *seq,
+              char    *qual)
+{
   buffer = g_string_append_c (buffer, '@');
   buffer = g_string_append (buffer, name);
   buffer = g_string_append_c (buffer, '\n');
@@ -455,40 +1779,16 @@ fastq_write (GIOChannel *channel,
   buffer = g_string_append (buffer, "\n+\n");
   buffer = g_string_append (buffer, qual);
   buffer = g_string_append_c (buffer, '\n');
-
-  g_io_channel_write_chars (channel,
-                            buffer->str,
-                            -1,
-                            NULL,
-                            &tmp_err);
-  if (tmp_err != NULL)
-    g_propagate_error (error, tmp_err);
-
-  if (free_buffer)
-    g_string_free (buffer, TRUE);
 }
 
 void
-fastq_write_fragment (GIOChannel *channel,
-                      GString    *buffer,
-                      char       *name,
-                      char       *seq,
-                      char       *qual,
-                      int         start,
-                      int         end,
-                      GError    **error)
+fastq_append_fragment (GString *buffer,
+                       char    *name,
+                       char    *seq,
+                       char    *qual,
+                       int      start,
+                       int      end)
 {
-  GError  *tmp_err     = NULL;
-  int      free_buffer = 0;
-
-  if (buffer == NULL)
-    {
-      buffer = g_string_sized_new (512);
-      free_buffer = 1;
-    }
-  else
-    g_string_truncate (buffer, 0);
-
   buffer = g_string_append_c (buffer, '@');
   buffer = g_string_append (buffer, name);
   buffer = g_string_append_c (buffer, '\n');
@@ -496,17 +1796,28 @@ fastq_write_fragment (GIOChannel *channel,
   buffer = g_string_append (buffer, "\n+\n");
   buffer = g_string_append_len (buffer, qual + start, end - start);
   buffer = g_string_append_c (buffer, '\n');
+}
 
-  g_io_channel_write_chars (channel,
-                            buffer->str,
-                            -1,
-                            NULL,
-                            &tmp_err);
-  if (tmp_err != NULL)
-    g_propagate_error (error, tmp_err);
+void
+fastq_write (NgsWriter  *writer,
+             char       *name,
+             char       *seq,
+             char       *qual,
+             GError    **error)
+{
+  ngs_writer_append_fastq (writer, name, seq, qual, error);
+}
 
-  if (free_buffer)
-    g_string_free (buffer, TRUE);
+void
+fastq_write_fragment (NgsWriter  *writer,
+                      char       *name,
+                      char       *seq,
+                      char       *qual,
+                      int         start,
+                      int         end,
+                      GError    **error)
+{
+  ngs_writer_append_fastq_fragment (writer, name, seq, qual, start, end, error);
 }
 
 static gboolean
@@ -7,6 +7,8 @@
 
 #include <glib.h>
 
+#include "ngs_writer.h"
+
 /************/
 /* FastqSeq */
 /************/
@@ -35,10 +37,21 @@ void        fastq_seq_free   (FastqSeq *fastq);
 
 FastqSeq*   fastq_seq_copy   (FastqSeq *fastq);
 
+/**
+ * Copies a record borrowed from a parser into keep, reusing the buffers of
+ * keep, or into a new record if keep is NULL.  Returns the copy, which
+ * belongs to the caller.
+ */
+
+FastqSeq*   fastq_seq_detach (FastqSeq *fastq,
+                              FastqSeq *keep);
+
 /**
  * Signature for the functions to be called by iter_fastq.
  * If the function returns 0, the iteration is interupted,
  * otherwise, the iteration continues.
+ * The record is borrowed: it belongs to the parser, which reuses its buffers
+ * for the next record.  Use fastq_seq_detach to keep it.
  */
 
 typedef int (*FastqIterFunc) (FastqSeq *fastq,
@@ -47,6 +60,7 @@ typedef int (*FastqIterFunc) (FastqSeq *fastq,
 /**
  * Iterates over all FastqSeq in a file.
  * If path is '-', reads from stdin.
+ * Read stores (see ngs_readstore.h) are read instead of parsed.
  */
 
 void iter_fastq (const char   *path,
@@ -54,6 +68,87 @@ void iter_fastq (const char   *path,
                  void         *data,
                  GError      **error);
 
+/**
+ * As iter_fastq, but with the streaming parser, which also sets offset to
+ * the position of each record in the (uncompressed) file before calling
+ * func.
+ */
+
+void iter_fastq_offsets (const char    *path,
+                         FastqIterFunc  func,
+                         void          *data,
+                         guint64       *offset,
+                         GError       **error);
+
+/**
+ * Signature for the functions to be called by iter_fastq_parallel.
+ * Anything appended to output is written out after the function returns.
+ * The function is called from several threads at once, so it must not
+ * modify data without synchronisation.  The record can be modified in place.
+ */
+
+typedef int (*FastqParallelFunc) (FastqSeq *fastq,
+                                  GString  *output,
+                                  void     *data);
+
+/**
+ * Iterates over all FastqSeq in a file, calling func from n_threads threads.
+ * The output produced for the records is written to writer (if not NULL),
+ * in the order of the input if ordered is not 0.
+ */
+
+void iter_fastq_parallel (const char       *path,
+                          FastqParallelFunc func,
+                          void             *data,
+                          int               n_threads,
+                          int               ordered,
+                          NgsWriter        *writer,
+                          GError          **error);
+
+/**
+ * Iterates over all FastqSeq in a file with up to n_threads threads, each
+ * parsing a part of the file and calling func with its own data:
+ * thread_data[i] for the i-th part, so that the results of the threads can
+ * be merged afterwards.  The parts are parsed concurrently.
+ * Plain files and gzip files with an index (see ngs_gzindex.h) are split and
+ * parsed with the streaming parser, and the blocks of read stores are shared
+ * among the threads.  Anything else is parsed by iter_fastq with
+ * thread_data[0].
+ */
+
+void iter_fastq_ranges (const char    *path,
+                        FastqIterFunc  func,
+                        void         **thread_data,
+                        int            n_threads,
+                        GError       **error);
+
+/**
+ * Returns the offset of the first record in buffer, which must start at the
+ * beginning of a line, or -1 if there is not enough data to find it.
+ * A quality line can start with '@' too, but only the header of a record is
+ * followed two lines down by a line starting with '+'.
+ */
+
+gssize fastq_find_record_start (const char *buffer,
+                                gsize       size);
+
+/**
+ * The fields of the records that the caller needs.  Parsers of text files
+ * fill in all the fields anyway, but the readers of read stores skip the
+ * columns that are not needed and leave empty strings instead.
+ * The sequence is always read.
+ */
+
+typedef enum
+{
+  FASTQ_COLUMN_NAME = 1 << 0,
+  FASTQ_COLUMN_SEQ  = 1 << 1,
+  FASTQ_COLUMN_QUAL = 1 << 2,
+  FASTQ_COLUMN_ALL  = FASTQ_COLUMN_NAME | FASTQ_COLUMN_SEQ | FASTQ_COLUMN_QUAL
+} FastqColumns;
+
+void fastq_set_columns (FastqColumns columns);
+
 /**
  * Get the option group for the fastq parsing system
  */
@@ -62,18 +157,15 @@ GOptionGroup* get_fastq_option_group (void);
 
 /**
  * Output function
- * Buffer can be NULL and a new buffer will be created and freed at each call
  */
 
-void  fastq_write          (GIOChannel        *channel,
-                            GString           *buffer,
+void  fastq_write          (NgsWriter         *writer,
                             char              *name,
                             char              *seq,
                             char              *qual,
                             GError           **error);
 
-void  fastq_write_fragment (GIOChannel        *channel,
-                            GString           *buffer,
+void  fastq_write_fragment (NgsWriter         *writer,
                             char              *name,
                             char              *seq,
                             char              *qual,
@@ -81,6 +173,23 @@ void  fastq_write_fragment (GIOChannel        *channel,
                             int                end,
                             GError           **error);
 
+/**
+ * Appends a record to buffer, as fastq_write and fastq_write_fragment would
+ * write it
+ */
+
+void  fastq_append          (GString           *buffer,
+                             char              *name,
+                             char              *seq,
+                             char              *qual);
+
+void  fastq_append_fragment (GString           *buffer,
+                             char              *name,
+                             char              *seq,
+                             char              *qual,
+                             int                start,
+                             int                end);
+
 /*************/
 /* FastqIter */
 /*************/
@@ -90,15 +199,106 @@ typedef struct _FastqIter FastqIter;
 struct _FastqIter
 {
   void *private;
+
+  /* When reading a read store */
+  void *store;
+  void *store_iter;
+
+  /* The error that ended the iteration */
+  GError *error;
 };
 
 FastqIter* fastq_iter_new  (const char *path,
                             GError    **error);
 
+/**
+ * The record returned is borrowed, and only valid until the next call.
+ */
+
 FastqSeq*  fastq_iter_next (FastqIter  *iter);
 
+/**
+ * The iteration also ends on errors.  Propagates the error that ended it,
+ * if any.  Returns TRUE if there was an error.
+ */
+
+gboolean   fastq_iter_get_error (FastqIter  *iter,
+                                 GError    **error);
+
 void       fastq_iter_free (FastqIter  *iter);
 
+/**************/
+/* FastqBatch */
+/**************/
+
+/**
+ * A batch of consecutive records.  The names, sequences and qualities of all
+ * the records are stored one after the other in a single buffer, which is
+ * reused from one batch to the next: the records are only valid until the
+ * batch is refilled or freed.
+ */
+
+typedef struct _FastqBatch FastqBatch;
+
+struct _FastqBatch
+{
+  FastqSeq *seqs;
+  gsize     n_seqs;
+
+  /* Storage */
+  gsize     n_alloc;
+  char     *arena;
+  gsize     arena_size;
+  gsize     arena_alloc;
+};
+
+FastqBatch* fastq_batch_new       (void);
+
+void        fastq_batch_free      (FastqBatch *batch);
+
+/**
+ * Reads the next max_records records (or less at the end of the file or on
+ * errors, see fastq_iter_get_error) of iter into batch.  Returns the number
+ * of records read.
+ */
+
+gsize       fastq_iter_next_batch (FastqIter  *iter,
+                                   FastqBatch *batch,
+                                   gsize       max_records);
+
+/*****************/
+/* FastqPairIter */
+/*****************/
+
+/**
+ * Iterates over the mates of paired-end reads in lockstep.  The mates are
+ * either in two files, or one after the other in a single interleaved file
+ * (when path2 is NULL).  Each file is read in batches by a background
+ * thread, a few batches ahead of the caller.
+ * If check_names is set, the names of the mates must be the same up to the
+ * first blank, once a trailing `/1' or `/2' is removed.
+ */
+
+typedef struct _FastqPairIter FastqPairIter;
+
+FastqPairIter* fastq_pair_iter_new  (const char     *path1,
+                                     const char     *path2,
+                                     int             check_names,
+                                     GError        **error);
+
+/**
+ * Returns FALSE at the end of the reads, or on errors (the files do not
+ * have the same number of reads, or the names of the mates do not match).
+ * The records are borrowed, and only valid until the next call.
+ */
+
+gboolean       fastq_pair_iter_next (FastqPairIter  *iter,
+                                     FastqSeq      **seq1,
+                                     FastqSeq      **seq2,
+                                     GError        **error);
+
+void           fastq_pair_iter_free (FastqPairIter  *iter);
+
 
 #endif /* __NGS_FASTQ_H__ */
 
@@ -23,7 +23,8 @@ void            iter_fastq_flex         (const char    *path,
 FastqIterFlex*  fastq_iter_new_flex     (const char    *path,
                                          GError       **error);
 
-FastqSeq*       fastq_iter_next_flex    (FastqIterFlex *iter);
+FastqSeq*       fastq_iter_next_flex    (FastqIterFlex *iter,
+                                         GError       **error);
 
 void            fastq_iter_free_flex    (FastqIterFlex *iter);
 
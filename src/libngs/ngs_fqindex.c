@@ -0,0 +1,727 @@
+/* Copyright (C) 2010  Sylvain FORET
+ *
+ * This file is part of libngs.
+ *
+ * libngs is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *                                                                       
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *                                                                       
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ *
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "ngs_bgzf.h"
+#include "ngs_fqindex.h"
+#include "ngs_gzindex.h"
+#include "ngs_input.h"
+#include "ngs_readstore.h"
+#include "ngs_utils.h"
+
+
+#define FQ_READ_SIZE 4096
+
+static const char fq_index_magic[8] = "NGSFQI01";
+
+struct _FqIndexReader
+{
+  FqIndex       *index;
+  char          *path;
+  int            fd;
+  int            gzip;
+
+  GString       *buffer;
+  unsigned char *compressed;
+  char          *block;
+
+  FastqSeq       fastq;
+};
+
+typedef struct _BuildData BuildData;
+
+struct _BuildData
+{
+  GArray  *entries;
+  guint64  offset;
+};
+
+static int      build_func      (FastqSeq       *fastq,
+                                 BuildData      *data);
+
+static gboolean to_virtual      (FqIndex        *index,
+                                 const char     *path,
+                                 int             fd,
+                                 GError        **error);
+
+static int      entry_cmp       (const void     *a,
+                                 const void     *b);
+
+static gboolean read_record     (FqIndexReader  *reader,
+                                 guint64         offset,
+                                 GError        **error);
+
+static gboolean read_plain      (FqIndexReader  *reader,
+                                 guint64         offset,
+                                 GError        **error);
+
+static gboolean read_bgzf       (FqIndexReader  *reader,
+                                 guint64         offset,
+                                 GError        **error);
+
+static gboolean read_gzip       (FqIndexReader  *reader,
+                                 guint64         offset,
+                                 GError        **error);
+
+static int      count_lines     (const char     *buffer,
+                                 gsize           from,
+                                 gsize           to);
+
+FqIndex*
+fq_index_build (const char  *path,
+                GError     **error)
+{
+  FqIndex      *index;
+  BuildData     data;
+  struct stat   st;
+  unsigned char header[BGZF_HEADER_SIZE];
+  GError       *tmp_err = NULL;
+  int           fd;
+
+  if (read_store_check (path))
+    {
+      g_set_error (error,
+                   NGS_ERROR,
+                   NGS_IO_ERROR,
+                   "Read stores cannot be indexed: `%s'",
+                   path);
+      return NULL;
+    }
+  fd = open (path, O_RDONLY);
+  if (fd < 0)
+    {
+      g_set_error (error,
+                   NGS_ERROR,
+                   NGS_IO_ERROR,
+                   "Could not open input file `%s'",
+                   path);
+      return NULL;
+    }
+  if (fstat (fd, &st) != 0 || !S_ISREG (st.st_mode))
+    {
+      g_set_error (error,
+                   NGS_ERROR,
+                   NGS_IO_ERROR,
+                   "Only regular files can be indexed: `%s'",
+                   path);
+      close (fd);
+      return NULL;
+    }
+
+  index             = g_slice_new0 (FqIndex);
+  index->file_size  = st.st_size;
+  index->file_mtime = st.st_mtime;
+  if (pread (fd, header, BGZF_HEADER_SIZE, 0) == BGZF_HEADER_SIZE &&
+      header[0] == 0x1f && header[1] == 0x8b)
+    {
+      index->bgzf = bgzf_block_size (header, BGZF_HEADER_SIZE) > 0;
+      if (!index->bgzf)
+        {
+          GzIndex *gz_index = gz_index_find (path, fd);
+
+          /* The records could not be read back */
+          if (gz_index == NULL)
+            {
+              g_set_error (error,
+                           NGS_ERROR,
+                           NGS_IO_ERROR,
+                           "No seek-point index for the compressed file `%s' "
+                           "(see fastq_gzindex, or use BGZF compression)",
+                           path);
+              g_slice_free (FqIndex, index);
+              close (fd);
+              return NULL;
+            }
+          gz_index_free (gz_index);
+        }
+    }
+
+  data.entries = g_array_new (FALSE, FALSE, sizeof (FqIndexEntry));
+  data.offset  = 0;
+  iter_fastq_offsets (path,
+                      (FastqIterFunc)build_func,
+                      &data,
+                      &data.offset,
+                      &tmp_err);
+  index->n_entries = data.entries->len;
+  index->entries   = (FqIndexEntry*)g_array_free (data.entries, FALSE);
+
+  if (tmp_err == NULL && index->bgzf)
+    to_virtual (index, path, fd, &tmp_err);
+  close (fd);
+  if (tmp_err)
+    {
+      g_propagate_error (error, tmp_err);
+      fq_index_free (index);
+      return NULL;
+    }
+  qsort (index->entries, index->n_entries, sizeof (FqIndexEntry), entry_cmp);
+
+  return index;
+}
+
+static int
+build_func (FastqSeq  *fastq,
+            BuildData *data)
+{
+  FqIndexEntry entry;
+
+  entry.hash   = fq_index_hash (fastq->name);
+  entry.offset = data->offset;
+  g_array_append_val (data->entries, entry);
+
+  return 1;
+}
+
+/**
+ * Converts the offsets in the uncompressed data, which are still in the
+ * order of the file, to virtual offsets.  The size of the uncompressed data
+ * of each block is in its footer, so the blocks do not need to be inflated.
+ */
+static gboolean
+to_virtual (FqIndex     *index,
+            const char  *path,
+            int          fd,
+            GError     **error)
+{
+  unsigned char header[BGZF_HEADER_SIZE];
+  unsigned char footer[4];
+  guint64       block      = 0;
+  guint64       next_block = 0;
+  guint64       data_start = 0;
+  guint64       data_size  = 0;
+  guint64       i;
+
+  for (i = 0; i < index->n_entries; i++)
+    {
+      FqIndexEntry *entry = index->entries + i;
+
+      while (entry->offset >= data_start + data_size)
+        {
+          gsize size = 0;
+
+          if (pread (fd, header, BGZF_HEADER_SIZE, next_block) != BGZF_HEADER_SIZE ||
+              (size = bgzf_block_size (header, BGZF_HEADER_SIZE)) == 0 ||
+              pread (fd, footer, 4, next_block + size - 4) != 4)
+            {
+              g_set_error (error,
+                           NGS_ERROR,
+                           NGS_IO_ERROR,
+                           "Invalid BGZF block in `%s'",
+                           path);
+              return FALSE;
+            }
+          block       = next_block;
+          next_block += size;
+          data_start += data_size;
+          data_size   = footer[0] |
+                        (footer[1] << 8) |
+                        (footer[2] << 16) |
+                        ((guint64)footer[3] << 24);
+        }
+      entry->offset = (block << 16) | (entry->offset - data_start);
+    }
+
+  return TRUE;
+}
+
+static int
+entry_cmp (const void *a,
+           const void *b)
+{
+  const FqIndexEntry *e1 = a;
+  const FqIndexEntry *e2 = b;
+
+  if (e1->hash != e2->hash)
+    return e1->hash < e2->hash ? -1 : 1;
+  if (e1->offset != e2->offset)
+    return e1->offset < e2->offset ? -1 : 1;
+
+  return 0;
+}
+
+gboolean
+fq_index_save (FqIndex     *index,
+               const char  *path,
+               GError     **error)
+{
+  NgsWriter *writer;
+  guint8     buffer[8];
+  guint64    header[4];
+  guint64    i;
+  int        j;
+  int        k;
+
+  writer = ngs_writer_new (path, "w", error);
+  if (writer == NULL)
+    return FALSE;
+
+  ngs_writer_write (writer, fq_index_magic, sizeof (fq_index_magic), NULL);
+  header[0] = index->file_size;
+  header[1] = index->file_mtime;
+  header[2] = index->bgzf;
+  header[3] = index->n_entries;
+  /* Little endian */
+  for (j = 0; j < 4; j++)
+    {
+      for (k = 0; k < 8; k++)
+        buffer[k] = (header[j] >> (8 * k)) & 0xff;
+      ngs_writer_write (writer, (char*)buffer, 8, NULL);
+    }
+  for (i = 0; i < index->n_entries; i++)
+    {
+      for (k = 0; k < 8; k++)
+        buffer[k] = (index->entries[i].hash >> (8 * k)) & 0xff;
+      ngs_writer_write (writer, (char*)buffer, 8, NULL);
+      for (k = 0; k < 8; k++)
+        buffer[k] = (index->entries[i].offset >> (8 * k)) & 0xff;
+      ngs_writer_write (writer, (char*)buffer, 8, NULL);
+    }
+
+  return ngs_writer_close (writer, error);
+}
+
+FqIndex*
+fq_index_load (const char  *path,
+               GError     **error)
+{
+  FqIndex      *index;
+  char         *contents;
+  const guint8 *cursor;
+  gsize         length;
+  guint64       header[4];
+  guint64       i;
+  int           j;
+  int           k;
+
+  if (!g_file_get_contents (path, &contents, &length, error))
+    return NULL;
+
+  if (length < sizeof (fq_index_magic) + sizeof (header) ||
+      memcmp (contents, fq_index_magic, sizeof (fq_index_magic)) != 0)
+    goto error;
+  cursor = (const guint8*)contents + sizeof (fq_index_magic);
+  for (j = 0; j < 4; j++, cursor += 8)
+    for (header[j] = 0, k = 0; k < 8; k++)
+      header[j] |= (guint64)cursor[k] << (8 * k);
+  if (header[2] > 1 ||
+      header[3] != (length - sizeof (fq_index_magic) - sizeof (header)) / 16 ||
+      (length - sizeof (fq_index_magic) - sizeof (header)) % 16 != 0)
+    goto error;
+
+  index             = g_slice_new0 (FqIndex);
+  index->file_size  = header[0];
+  index->file_mtime = header[1];
+  index->bgzf       = header[2];
+  index->n_entries  = header[3];
+  index->entries    = g_malloc (index->n_entries * sizeof (FqIndexEntry));
+  for (i = 0; i < index->n_entries; i++, cursor += 16)
+    {
+      FqIndexEntry *entry = index->entries + i;
+
+      entry->hash   = 0;
+      entry->offset = 0;
+      for (k = 0; k < 8; k++)
+        {
+          entry->hash   |= (guint64)cursor[k] << (8 * k);
+          entry->offset |= (guint64)cursor[k + 8] << (8 * k);
+        }
+    }
+  g_free (contents);
+
+  return index;
+
+error:
+  g_set_error (error,
+               NGS_ERROR,
+               NGS_PARSE_ERROR,
+               "Invalid fastq index file `%s'",
+               path);
+  g_free (contents);
+
+  return NULL;
+}
+
+FqIndex*
+fq_index_find (const char *fastq_path)
+{
+  struct stat  st;
+  FqIndex     *index;
+  char        *path;
+
+  if (stat (fastq_path, &st) != 0 || !S_ISREG (st.st_mode))
+    return NULL;
+  path  = g_strconcat (fastq_path, FQ_INDEX_SUFFIX, NULL);
+  index = NULL;
+  if (g_file_test (path, G_FILE_TEST_IS_REGULAR))
+    index = fq_index_load (path, NULL);
+  g_free (path);
+  if (index &&
+      (index->file_size != (guint64)st.st_size ||
+       index->file_mtime != (gint64)st.st_mtime))
+    {
+      fq_index_free (index);
+      index = NULL;
+    }
+
+  return index;
+}
+
+void
+fq_index_free (FqIndex *index)
+{
+  if (index)
+    {
+      g_free (index->entries);
+      g_slice_free (FqIndex, index);
+    }
+}
+
+/**
+ * 64 bits FNV-1a
+ */
+guint64
+fq_index_hash (const char *name)
+{
+  guint64 hash = G_GUINT64_CONSTANT (0xcbf29ce484222325);
+
+  for (; *name; name++)
+    {
+      hash ^= (unsigned char)*name;
+      hash *= G_GUINT64_CONSTANT (0x100000001b3);
+    }
+
+  return hash;
+}
+
+FqIndexEntry*
+fq_index_lookup (FqIndex    *index,
+                 const char *name,
+                 guint      *n_entries)
+{
+  const guint64 hash = fq_index_hash (name);
+  guint64       low  = 0;
+  guint64       high = index->n_entries;
+  guint64       end;
+
+  /* First entry with this hash */
+  while (low < high)
+    {
+      const guint64 mid = low + (high - low) / 2;
+
+      if (index->entries[mid].hash < hash)
+        low = mid + 1;
+      else
+        high = mid;
+    }
+  for (end = low; end < index->n_entries && index->entries[end].hash == hash; end++);
+
+  *n_entries = end - low;
+  if (end == low)
+    return NULL;
+
+  return index->entries + low;
+}
+
+FqIndexReader*
+fq_index_reader_new (FqIndex     *index,
+                     const char  *path,
+                     GError     **error)
+{
+  FqIndexReader *reader;
+  unsigned char  magic[2];
+  int            fd;
+
+  fd = open (path, O_RDONLY);
+  if (fd < 0)
+    {
+      g_set_error (error,
+                   NGS_ERROR,
+                   NGS_IO_ERROR,
+                   "Could not open input file `%s'",
+                   path);
+      return NULL;
+    }
+
+  reader         = g_slice_new0 (FqIndexReader);
+  reader->index  = index;
+  reader->path   = g_strdup (path);
+  reader->fd     = fd;
+  reader->buffer = g_string_sized_new (FQ_READ_SIZE);
+  if (index->bgzf)
+    {
+      reader->compressed = g_malloc (BGZF_MAX_BLOCK_SIZE);
+      reader->block      = g_malloc (BGZF_MAX_BLOCK_SIZE);
+    }
+  else
+    reader->gzip = pread (fd, magic, 2, 0) == 2 && magic[0] == 0x1f && magic[1] == 0x8b;
+
+  return reader;
+}
+
+FastqSeq*
+fq_index_reader_fetch (FqIndexReader  *reader,
+                       const char     *name,
+                       GError        **error)
+{
+  FqIndexEntry *entry;
+  guint         n_entries;
+  guint         i;
+
+  /* The entries of a hash are sorted by offset: the last record called
+   * name is looked for first, as parsing the file would keep it */
+  entry = fq_index_lookup (reader->index, name, &n_entries);
+  if (entry)
+    entry += n_entries;
+  for (i = 0; i < n_entries; i++)
+    {
+      char *lines[4];
+      char *end;
+      int   j;
+
+      entry--;
+      if (!read_record (reader, entry->offset, error))
+        return NULL;
+
+      /* Split the four lines of the record */
+      lines[0] = reader->buffer->str;
+      end      = reader->buffer->str + reader->buffer->len;
+      for (j = 0; j < 4; j++)
+        {
+          char *eol = memchr (lines[j], '\n', end - lines[j]);
+
+          if (eol == NULL)
+            eol = end;
+          else if (j < 3)
+            lines[j + 1] = eol + 1;
+          *eol = '\0';
+          if (eol > lines[j] && eol[-1] == '\r')
+            eol[-1] = '\0';
+          if (eol == end && j < 3)
+            break;
+        }
+      if (j < 4 || lines[0][0] != '@' || lines[2][0] != '+')
+        {
+          g_set_error (error,
+                       NGS_ERROR,
+                       NGS_PARSE_ERROR,
+                       "No fastq record at the indexed offset %" G_GUINT64_FORMAT " of `%s'",
+                       entry->offset,
+                       reader->path);
+          return NULL;
+        }
+      if (strcmp (lines[0] + 1, name) != 0)
+        continue;
+
+      reader->fastq.name = lines[0] + 1;
+      reader->fastq.seq  = lines[1];
+      reader->fastq.qual = lines[3];
+      reader->fastq.size = MIN (strlen (lines[1]), strlen (lines[3]));
+
+      return &reader->fastq;
+    }
+
+  return NULL;
+}
+
+void
+fq_index_reader_free (FqIndexReader *reader)
+{
+  if (reader)
+    {
+      close (reader->fd);
+      g_string_free (reader->buffer, TRUE);
+      g_free (reader->compressed);
+      g_free (reader->block);
+      g_free (reader->path);
+      g_slice_free (FqIndexReader, reader);
+    }
+}
+
+/**
+ * Fills the buffer of reader with the data from offset, up to the end of
+ * the fourth line or of the file.
+ */
+static gboolean
+read_record (FqIndexReader  *reader,
+             guint64         offset,
+             GError        **error)
+{
+  g_string_truncate (reader->buffer, 0);
+  if (reader->index->bgzf)
+    return read_bgzf (reader, offset, error);
+  if (reader->gzip)
+    return read_gzip (reader, offset, error);
+
+  return read_plain (reader, offset, error);
+}
+
+static gboolean
+read_plain (FqIndexReader  *reader,
+            guint64         offset,
+            GError        **error)
+{
+  int n_lines = 0;
+
+  while (n_lines < 4)
+    {
+      const gsize len = reader->buffer->len;
+      gssize      bytes_read;
+
+      g_string_set_size (reader->buffer, len + FQ_READ_SIZE);
+      bytes_read = pread (reader->fd, reader->buffer->str + len, FQ_READ_SIZE, offset + len);
+      if (bytes_read < 0)
+        {
+          if (errno == EINTR)
+            {
+              g_string_set_size (reader->buffer, len);
+              continue;
+            }
+          g_set_error (error,
+                       NGS_ERROR,
+                       NGS_IO_ERROR,
+                       "Error while reading `%s': %s",
+                       reader->path,
+                       g_strerror (errno));
+          return FALSE;
+        }
+      g_string_set_size (reader->buffer, len + bytes_read);
+      if (bytes_read == 0)
+        break;
+      n_lines += count_lines (reader->buffer->str, len, len + bytes_read);
+    }
+
+  return TRUE;
+}
+
+static gboolean
+read_bgzf (FqIndexReader  *reader,
+           guint64         offset,
+           GError        **error)
+{
+  guint64 block   = offset >> 16;
+  gsize   skip    = offset & 0xffff;
+  int     n_lines = 0;
+
+  while (n_lines < 4)
+    {
+      const gsize len = reader->buffer->len;
+      gsize       size;
+      gsize       out_size;
+
+      if (pread (reader->fd, reader->compressed, BGZF_HEADER_SIZE, block) != BGZF_HEADER_SIZE)
+        break;
+      size = bgzf_block_size (reader->compressed, BGZF_HEADER_SIZE);
+      if (size == 0 ||
+          pread (reader->fd, reader->compressed, size, block) != (gssize)size)
+        {
+          g_set_error (error,
+                       NGS_ERROR,
+                       NGS_IO_ERROR,
+                       "Invalid BGZF block in `%s'",
+                       reader->path);
+          return FALSE;
+        }
+      if (!bgzf_inflate_block (reader->compressed,
+                               size,
+                               reader->block,
+                               &out_size,
+                               error))
+        return FALSE;
+      if (skip < out_size)
+        {
+          g_string_append_len (reader->buffer, reader->block + skip, out_size - skip);
+          n_lines += count_lines (reader->buffer->str, len, reader->buffer->len);
+        }
+      skip   = 0;
+      block += size;
+    }
+
+  return TRUE;
+}
+
+/**
+ * Decompressed from the closest access point, which is slow: BGZF is better
+ * suited to random access.
+ */
+static gboolean
+read_gzip (FqIndexReader  *reader,
+           guint64         offset,
+           GError        **error)
+{
+  NgsInput *input;
+  char      buffer[FQ_READ_SIZE];
+  int       n_lines = 0;
+  gboolean  ret     = TRUE;
+
+  input = ngs_input_open_at (reader->path, offset, error);
+  if (input == NULL)
+    return FALSE;
+  while (n_lines < 4)
+    {
+      const gsize  len        = reader->buffer->len;
+      const gssize bytes_read = ngs_input_read (input, buffer, sizeof (buffer));
+
+      if (bytes_read < 0)
+        {
+          ngs_input_get_error (input, error);
+          ret = FALSE;
+          break;
+        }
+      if (bytes_read == 0)
+        break;
+      g_string_append_len (reader->buffer, buffer, bytes_read);
+      n_lines += count_lines (reader->buffer->str, len, reader->buffer->len);
+    }
+  ngs_input_close (input);
+
+  return ret;
+}
+
+static int
+count_lines (const char *buffer,
+             gsize       from,
+             gsize       to)
+{
+  int n = 0;
+
+  while (from < to)
+    {
+      const char *eol = memchr (buffer + from, '\n', to - from);
+
+      if (eol == NULL)
+        break;
+      n++;
+      from = eol - buffer + 1;
+    }
+
+  return n;
+}
+
+/* vim:ft=c:expandtab:sw=4:ts=4:sts=4:cinoptions={.5s^-2n-2(0:
+ */
@@ -0,0 +1,115 @@
+/**
+ *
+ */
+
+#ifndef __NGS_FQINDEX_H__
+#define __NGS_FQINDEX_H__
+
+#include <glib.h>
+
+#include "ngs_fastq.h"
+
+/***********/
+/* FqIndex */
+/***********/
+
+/**
+ * Name index of a fastq file: the hashes of the read names, sorted, with
+ * the offsets of the records, so that reads can be fetched without parsing
+ * the whole file.
+ * The offsets are positions in the uncompressed data for plain files and
+ * for gzip files with a seek-point index (see ngs_gzindex.h).  For BGZF
+ * files, they are virtual offsets: the position of the block in the file
+ * shifted left by 16 bits, plus the position of the record in the
+ * uncompressed block, so that only the blocks spanned by a record are
+ * inflated.
+ * The index of `file.fq' is kept in `file.fq' FQ_INDEX_SUFFIX.
+ */
+
+#define FQ_INDEX_SUFFIX ".fqi"
+
+typedef struct _FqIndexEntry FqIndexEntry;
+
+struct _FqIndexEntry
+{
+  guint64 hash;
+  guint64 offset;
+};
+
+typedef struct _FqIndex FqIndex;
+
+struct _FqIndex
+{
+  FqIndexEntry *entries;
+  guint64       n_entries;
+  int           bgzf;
+
+  /* Of the fastq file, to detect stale indices */
+  guint64       file_size;
+  gint64        file_mtime;
+};
+
+/**
+ * Parses the whole file, which must be a regular file.
+ */
+
+FqIndex*       fq_index_build        (const char     *path,
+                                      GError        **error);
+
+gboolean       fq_index_save         (FqIndex        *index,
+                                      const char     *path,
+                                      GError        **error);
+
+FqIndex*       fq_index_load         (const char     *path,
+                                      GError        **error);
+
+/**
+ * Loads the index next to fastq_path.
+ * Returns NULL if there is no index or if it does not match the file.
+ */
+
+FqIndex*       fq_index_find         (const char     *fastq_path);
+
+void           fq_index_free         (FqIndex        *index);
+
+guint64        fq_index_hash         (const char     *name);
+
+/**
+ * Returns the first entry with the hash of name, and sets n_entries to the
+ * number of consecutive entries with that hash, or returns NULL.
+ * Different names can have the same hash: the name of the records must be
+ * checked.
+ */
+
+FqIndexEntry*  fq_index_lookup       (FqIndex        *index,
+                                      const char     *name,
+                                      guint          *n_entries);
+
+/**
+ * Reads the records of an indexed file.
+ */
+
+typedef struct _FqIndexReader FqIndexReader;
+
+FqIndexReader* fq_index_reader_new   (FqIndex        *index,
+                                      const char     *path,
+                                      GError        **error);
+
+/**
+ * Returns the record called name, or NULL if there is none or on errors.
+ * If several records are called name, the last one is returned, as
+ * iterating over the file and keeping the records by name would.
+ * The record is borrowed from the reader, which reuses its buffers for the
+ * next call.  Use fastq_seq_detach to keep it.
+ */
+
+FastqSeq*      fq_index_reader_fetch (FqIndexReader  *reader,
+                                      const char     *name,
+                                      GError        **error);
+
+void           fq_index_reader_free  (FqIndexReader  *reader);
+
+#endif /* __NGS_FQINDEX_H__ */
+
+/* vim:ft=c:expandtab:sw=4:ts=4:sts=4:cinoptions={.5s^-2n-2(0:
+ */
@@ -0,0 +1,597 @@
+/* Copyright (C) 2010  Sylvain FORET
+ *
+ * This file is part of libngs.
+ *
+ * libngs is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *                                                                       
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *                                                                       
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ *
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include <zlib.h>
+
+#include "ngs_gzindex.h"
+#include "ngs_utils.h"
+
+
+#define GZ_IN_SIZE (256 * 1024)
+
+static const char gz_index_magic[8] = "NGSGZI01";
+
+struct _GzIndexReader
+{
+  GzIndex       *index;
+  int            fd;
+  z_stream       strm;
+  unsigned char *in_buffer;
+  guint64        in;
+  gsize          skip;
+  int            raw;
+  int            in_stream;
+  int            eof;
+  int            done;
+};
+
+static void     add_point     (GArray          *points,
+                               guint64          out,
+                               guint64          in,
+                               int              bits,
+                               unsigned char   *window,
+                               gsize            window_pos);
+
+static void     put_uint      (GByteArray      *bytes,
+                               guint64          value,
+                               gsize            size);
+
+static gboolean get_uint      (const char     **cursor,
+                               const char      *end,
+                               guint64         *value,
+                               gsize            size);
+
+static gssize   fill_input    (GzIndexReader   *reader,
+                               GError         **error);
+
+GzIndex*
+gz_index_build (const char  *path,
+                guint64      span,
+                GError     **error)
+{
+  struct stat    st;
+  z_stream       strm;
+  GzIndex       *index;
+  GArray        *points;
+  unsigned char *in_buffer;
+  unsigned char *window;
+  guint64        total_in  = 0;
+  guint64        total_out = 0;
+  guint64        last      = 0;
+  int            in_stream = 1;
+  int            eof       = 0;
+  int            fd;
+
+  fd = open (path, O_RDONLY);
+  if (fd < 0 || fstat (fd, &st) != 0)
+    {
+      g_set_error (error,
+                   NGS_ERROR,
+                   NGS_IO_ERROR,
+                   "Could not open input file `%s'",
+                   path);
+      if (fd >= 0)
+        close (fd);
+      return NULL;
+    }
+
+  in_buffer = g_malloc (GZ_IN_SIZE);
+  window    = g_malloc0 (GZ_INDEX_WINDOW_SIZE);
+  points    = g_array_new (FALSE, FALSE, sizeof (GzIndexPoint));
+  add_point (points, 0, 0, 0, NULL, 0);
+
+  memset (&strm, 0, sizeof (strm));
+  inflateInit2 (&strm, 15 + 32);
+  while (1)
+    {
+      int ret;
+
+      if (strm.avail_in == 0 && !eof)
+        {
+          gssize bytes_read;
+
+          do
+            bytes_read = read (fd, in_buffer, GZ_IN_SIZE);
+          while (bytes_read < 0 && errno == EINTR);
+          if (bytes_read < 0)
+            {
+              g_set_error (error,
+                           NGS_ERROR,
+                           NGS_IO_ERROR,
+                           "Error while reading `%s': %s",
+                           path,
+                           g_strerror (errno));
+              goto error;
+            }
+          if (bytes_read == 0)
+            eof = 1;
+          strm.next_in  = in_buffer;
+          strm.avail_in = bytes_read;
+        }
+      /* Concatenated gzip members */
+      if (!in_stream)
+        {
+          if (strm.avail_in == 0)
+            {
+              if (eof)
+                break;
+              continue;
+            }
+          if (strm.next_in[0] != 0x1f)
+            break;
+          inflateReset (&strm);
+          in_stream = 1;
+        }
+      /* The output cycles through the window */
+      if (strm.avail_out == 0)
+        {
+          strm.next_out  = window;
+          strm.avail_out = GZ_INDEX_WINDOW_SIZE;
+        }
+
+      total_in  += strm.avail_in;
+      total_out += strm.avail_out;
+      ret        = inflate (&strm, Z_BLOCK);
+      total_in  -= strm.avail_in;
+      total_out -= strm.avail_out;
+
+      if (ret == Z_STREAM_END)
+        in_stream = 0;
+      else if (ret == Z_BUF_ERROR)
+        {
+          if (eof && strm.avail_in == 0)
+            {
+              g_set_error (error,
+                           NGS_ERROR,
+                           NGS_IO_ERROR,
+                           "Unexpected end of compressed file `%s'",
+                           path);
+              goto error;
+            }
+        }
+      else if (ret != Z_OK)
+        {
+          g_set_error (error,
+                       NGS_ERROR,
+                       NGS_IO_ERROR,
+                       "Decompression of `%s' failed: %s",
+                       path,
+                       strm.msg ? strm.msg : "unknown error");
+          goto error;
+        }
+
+      /* At the end of a deflate block which is not the last one */
+      if (in_stream &&
+          (strm.data_type & 128) && !(strm.data_type & 64) &&
+          total_out - last >= span)
+        {
+          add_point (points,
+                     total_out,
+                     total_in,
+                     strm.data_type & 7,
+                     window,
+                     GZ_INDEX_WINDOW_SIZE - strm.avail_out);
+          last = total_out;
+        }
+    }
+  inflateEnd (&strm);
+  close (fd);
+  g_free (in_buffer);
+  g_free (window);
+
+  index             = g_slice_new (GzIndex);
+  index->n_points   = points->len;
+  index->points     = (GzIndexPoint*)g_array_free (points, FALSE);
+  index->size       = total_out;
+  index->file_size  = st.st_size;
+  index->file_mtime = st.st_mtime;
+
+  return index;
+
+error:
+  inflateEnd (&strm);
+  close (fd);
+  g_free (in_buffer);
+  g_free (window);
+  while (points->len > 0)
+    {
+      g_free (g_array_index (points, GzIndexPoint, points->len - 1).window);
+      g_array_set_size (points, points->len - 1);
+    }
+  g_array_free (points, TRUE);
+
+  return NULL;
+}
+
+gboolean
+gz_index_save (GzIndex     *index,
+               const char  *path,
+               GError     **error)
+{
+  GByteArray *bytes;
+  gboolean    ret;
+  guint       i;
+
+  bytes = g_byte_array_sized_new (64 + index->n_points * (GZ_INDEX_WINDOW_SIZE + 24));
+  g_byte_array_append (bytes, (const guint8*)gz_index_magic, sizeof (gz_index_magic));
+  put_uint (bytes, index->file_size, 8);
+  put_uint (bytes, index->file_mtime, 8);
+  put_uint (bytes, index->size, 8);
+  put_uint (bytes, index->n_points, 4);
+  for (i = 0; i < index->n_points; i++)
+    {
+      GzIndexPoint *point = index->points + i;
+
+      put_uint (bytes, point->out, 8);
+      put_uint (bytes, point->in, 8);
+      put_uint (bytes, point->bits, 1);
+      put_uint (bytes, point->window != NULL, 1);
+      if (point->window)
+        g_byte_array_append (bytes, point->window, GZ_INDEX_WINDOW_SIZE);
+    }
+  ret = g_file_set_contents (path, (const char*)bytes->data, bytes->len, error);
+  g_byte_array_free (bytes, TRUE);
+
+  return ret;
+}
+
+GzIndex*
+gz_index_load (const char  *path,
+               GError     **error)
+{
+  GzIndex    *index;
+  char       *contents;
+  const char *cursor;
+  const char *end;
+  gsize       length;
+  guint64     value;
+  guint       i;
+
+  if (!g_file_get_contents (path, &contents, &length, error))
+    return NULL;
+
+  index           = g_slice_new0 (GzIndex);
+  cursor          = contents;
+  end             = contents + length;
+  if (length < sizeof (gz_index_magic) ||
+      memcmp (cursor, gz_index_magic, sizeof (gz_index_magic)) != 0)
+    goto error;
+  cursor += sizeof (gz_index_magic);
+  if (!get_uint (&cursor, end, &index->file_size, 8) ||
+      !get_uint (&cursor, end, &value, 8))
+    goto error;
+  index->file_mtime = value;
+  if (!get_uint (&cursor, end, &index->size, 8) ||
+      !get_uint (&cursor, end, &value, 4))
+    goto error;
+  if (value == 0 || value > (gsize)(end - cursor) / 18)
+    goto error;
+  index->points = g_malloc0 (value * sizeof (*index->points));
+  for (i = 0; i < value; i++)
+    {
+      GzIndexPoint *point = index->points + i;
+      guint64       bits;
+      guint64       has_window;
+
+      if (!get_uint (&cursor, end, &point->out, 8) ||
+          !get_uint (&cursor, end, &point->in, 8) ||
+          !get_uint (&cursor, end, &bits, 1) ||
+          !get_uint (&cursor, end, &has_window, 1) ||
+          bits > 7)
+        goto error;
+      point->bits = bits;
+      index->n_points++;
+      if (has_window)
+        {
+          if (end - cursor < GZ_INDEX_WINDOW_SIZE)
+            goto error;
+          point->window = g_memdup (cursor, GZ_INDEX_WINDOW_SIZE);
+          cursor       += GZ_INDEX_WINDOW_SIZE;
+        }
+      else if (i > 0)
+        goto error;
+    }
+  g_free (contents);
+
+  return index;
+
+error:
+  g_set_error (error,
+               NGS_ERROR,
+               NGS_PARSE_ERROR,
+               "Invalid gzip index file `%s'",
+               path);
+  g_free (contents);
+  gz_index_free (index);
+
+  return NULL;
+}
+
+GzIndex*
+gz_index_find (const char *gz_path,
+               int         fd)
+{
+  struct stat  st;
+  GzIndex     *index;
+  char        *path;
+
+  if (fstat (fd, &st) != 0 || !S_ISREG (st.st_mode))
+    return NULL;
+  path  = g_strconcat (gz_path, GZ_INDEX_SUFFIX, NULL);
+  index = NULL;
+  if (g_file_test (path, G_FILE_TEST_IS_REGULAR))
+    index = gz_index_load (path, NULL);
+  g_free (path);
+  if (index &&
+      (index->file_size != (guint64)st.st_size ||
+       index->file_mtime != (gint64)st.st_mtime))
+    {
+      gz_index_free (index);
+      index = NULL;
+    }
+
+  return index;
+}
+
+void
+gz_index_free (GzIndex *index)
+{
+  guint i;
+
+  if (!index)
+    return;
+  for (i = 0; i < index->n_points; i++)
+    g_free (index->points[i].window);
+  g_free (index->points);
+  g_slice_free (GzIndex, index);
+}
+
+GzIndexReader*
+gz_index_reader_new (GzIndex  *index,
+                     int       fd,
+                     guint     point_idx,
+                     GError  **error)
+{
+  GzIndexReader *reader;
+  GzIndexPoint  *point = index->points + point_idx;
+
+  reader            = g_slice_new0 (GzIndexReader);
+  reader->index     = index;
+  reader->fd        = fd;
+  reader->in_buffer = g_malloc (GZ_IN_SIZE);
+  reader->in_stream = 1;
+
+  if (point->window == NULL)
+    {
+      /* Start of a gzip member, header included */
+      inflateInit2 (&reader->strm, 15 + 32);
+      reader->in = point->in;
+    }
+  else
+    {
+      inflateInit2 (&reader->strm, -15);
+      reader->raw = 1;
+      reader->in  = point->in;
+      if (point->bits)
+        {
+          unsigned char byte;
+
+          if (pread (fd, &byte, 1, point->in - 1) != 1)
+            {
+              g_set_error (error,
+                           NGS_ERROR,
+                           NGS_IO_ERROR,
+                           "Could not read from compressed file");
+              gz_index_reader_free (reader);
+              return NULL;
+            }
+          inflatePrime (&reader->strm, point->bits, byte >> (8 - point->bits));
+        }
+      inflateSetDictionary (&reader->strm, point->window, GZ_INDEX_WINDOW_SIZE);
+    }
+
+  return reader;
+}
+
+gssize
+gz_index_reader_read (GzIndexReader  *reader,
+                      char           *buffer,
+                      gsize           size,
+                      GError        **error)
+{
+  z_stream *strm = &reader->strm;
+
+  strm->next_out  = (Bytef*)buffer;
+  strm->avail_out = size;
+  while (strm->avail_out > 0 && !reader->done)
+    {
+      int ret;
+
+      if (strm->avail_in == 0 && !reader->eof && fill_input (reader, error) < 0)
+        return -1;
+      /* Skip the trailer of a member started in raw mode */
+      if (reader->skip > 0)
+        {
+          const gsize n = MIN (reader->skip, strm->avail_in);
+
+          strm->next_in  += n;
+          strm->avail_in -= n;
+          reader->skip   -= n;
+          if (reader->skip > 0 && reader->eof)
+            reader->done = 1;
+          continue;
+        }
+      if (!reader->in_stream)
+        {
+          if (strm->avail_in == 0)
+            {
+              if (reader->eof)
+                reader->done = 1;
+              continue;
+            }
+          if (strm->next_in[0] != 0x1f)
+            {
+              reader->done = 1;
+              continue;
+            }
+          inflateReset2 (strm, 15 + 32);
+          reader->raw       = 0;
+          reader->in_stream = 1;
+        }
+
+      ret = inflate (strm, Z_NO_FLUSH);
+      if (ret == Z_STREAM_END)
+        {
+          reader->in_stream = 0;
+          if (reader->raw)
+            reader->skip = 8;
+        }
+      else if (ret == Z_BUF_ERROR)
+        {
+          if (reader->eof && strm->avail_in == 0)
+            {
+              g_set_error (error,
+                           NGS_ERROR,
+                           NGS_IO_ERROR,
+                           "Unexpected end of compressed file");
+              return -1;
+            }
+        }
+      else if (ret != Z_OK)
+        {
+          g_set_error (error,
+                       NGS_ERROR,
+                       NGS_IO_ERROR,
+                       "Decompression failed: %s",
+                       strm->msg ? strm->msg : "unknown error");
+          return -1;
+        }
+    }
+
+  return size - strm->avail_out;
+}
+
+void
+gz_index_reader_free (GzIndexReader *reader)
+{
+  inflateEnd (&reader->strm);
+  g_free (reader->in_buffer);
+  g_slice_free (GzIndexReader, reader);
+}
+
+static void
+add_point (GArray        *points,
+           guint64        out,
+           guint64        in,
+           int            bits,
+           unsigned char *window,
+           gsize          window_pos)
+{
+  GzIndexPoint point;
+
+  point.out    = out;
+  point.in     = in;
+  point.bits   = bits;
+  point.window = NULL;
+  if (window)
+    {
+      /* Unroll the circular window, oldest data first */
+      point.window = g_malloc (GZ_INDEX_WINDOW_SIZE);
+      memcpy (point.window,
+              window + window_pos,
+              GZ_INDEX_WINDOW_SIZE - window_pos);
+      memcpy (point.window + GZ_INDEX_WINDOW_SIZE - window_pos,
+              window,
+              window_pos);
+    }
+  g_array_append_val (points, point);
+}
+
+static void
+put_uint (GByteArray *bytes,
+          guint64     value,
+          gsize       size)
+{
+  guint8 buffer[8];
+  gsize  i;
+
+  /* Little endian */
+  for (i = 0; i < size; i++)
+    buffer[i] = (value >> (8 * i)) & 0xff;
+  g_byte_array_append (bytes, buffer, size);
+}
+
+static gboolean
+get_uint (const char **cursor,
+          const char  *end,
+          guint64     *value,
+          gsize        size)
+{
+  gsize i;
+
+  if ((gsize)(end - *cursor) < size)
+    return FALSE;
+  *value = 0;
+  for (i = 0; i < size; i++)
+    *value |= (guint64)(unsigned char)(*cursor)[i] << (8 * i);
+  *cursor += size;
+
+  return TRUE;
+}
+
+static gssize
+fill_input (GzIndexReader  *reader,
+            GError        **error)
+{
+  gssize bytes_read;
+
+  do
+    bytes_read = pread (reader->fd, reader->in_buffer, GZ_IN_SIZE, reader->in);
+  while (bytes_read < 0 && errno == EINTR);
+  if (bytes_read < 0)
+    {
+      g_set_error (error,
+                   NGS_ERROR,
+                   NGS_IO_ERROR,
+                   "Error while reading compressed file: %s",
+                   g_strerror (errno));
+      return -1;
+    }
+  if (bytes_read == 0)
+    reader->eof = 1;
+  reader->in            += bytes_read;
+  reader->strm.next_in   = reader->in_buffer;
+  reader->strm.avail_in  = bytes_read;
+
+  return bytes_read;
+}
+
+#undef GZ_IN_SIZE
+
+/* vim:ft=c:expandtab:sw=4:ts=4:sts=4:cinoptions={.5s^-2n-2(0:
+ */
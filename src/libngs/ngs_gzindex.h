@@ -0,0 +1,104 @@
+/**
+ *
+ */
+
+#ifndef __NGS_GZINDEX_H__
+#define __NGS_GZINDEX_H__
+
+#include <glib.h>
+
+/***********/
+/* GzIndex */
+/***********/
+
+/**
+ * Seek-point index for plain gzip files (as in zlib's zran example).
+ * Decompression can be restarted at any access point from the position of
+ * a deflate block in the compressed file and the 32 KB of data preceding it,
+ * so that the parts of a file between access points can be decompressed
+ * independently.
+ * The index of `file.gz' is kept in `file.gz' GZ_INDEX_SUFFIX.
+ */
+
+#define GZ_INDEX_SUFFIX       ".ngzi"
+#define GZ_INDEX_WINDOW_SIZE  32768
+#define GZ_INDEX_DEFAULT_SPAN (4 * 1024 * 1024)
+
+typedef struct _GzIndexPoint GzIndexPoint;
+
+struct _GzIndexPoint
+{
+  guint64        out;
+  guint64        in;
+  int            bits;
+  unsigned char *window;
+};
+
+typedef struct _GzIndex GzIndex;
+
+struct _GzIndex
+{
+  GzIndexPoint *points;
+  guint         n_points;
+  guint64       size;
+
+  /* Of the compressed file, to detect stale indices */
+  guint64       file_size;
+  gint64        file_mtime;
+};
+
+/**
+ * Reads the whole gzip file and adds an access point about every span
+ * bytes of uncompressed data.  The first point is always the start of the
+ * file.
+ */
+
+GzIndex*        gz_index_build       (const char     *path,
+                                      guint64         span,
+                                      GError        **error);
+
+gboolean        gz_index_save        (GzIndex        *index,
+                                      const char     *path,
+                                      GError        **error);
+
+GzIndex*        gz_index_load        (const char     *path,
+                                      GError        **error);
+
+/**
+ * Loads the index next to gz_path, which has been opened as fd.
+ * Returns NULL if there is no index or if it does not match the file.
+ */
+
+GzIndex*        gz_index_find        (const char     *gz_path,
+                                      int             fd);
+
+void            gz_index_free        (GzIndex        *index);
+
+/**
+ * Decompresses from an access point to the end of the file.
+ * Readers only use pread on fd, so that several of them can share it.
+ */
+
+typedef struct _GzIndexReader GzIndexReader;
+
+GzIndexReader*  gz_index_reader_new  (GzIndex        *index,
+                                      int             fd,
+                                      guint           point,
+                                      GError        **error);
+
+/**
+ * Returns the number of bytes read, 0 at the end of the data and -1 on
+ * errors.
+ */
+
+gssize          gz_index_reader_read (GzIndexReader  *reader,
+                                      char           *buffer,
+                                      gsize           size,
+                                      GError        **error);
+
+void            gz_index_reader_free (GzIndexReader  *reader);
+
+#endif /* __NGS_GZINDEX_H__ */
+
+/* vim:ft=c:expandtab:sw=4:ts=4:sts=4:cinoptions={.5s^-2n-2(0:
+ */
@@ -0,0 +1,1105 @@
+/* Copyright (C) 2010  Sylvain FORET
+ *
+ * This file is part of libngs.
+ *
+ * libngs is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *                                                                       
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *                                                                       
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ *
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include <zlib.h>
+
+#include "ngs_bgzf.h"
+#include "ngs_gzindex.h"
+#include "ngs_input.h"
+#include "ngs_utils.h"
+
+
+#define PEEK_SIZE        (64 * 1024)
+#define GZIP_IN_SIZE     (256 * 1024)
+#define BLOCK_SIZE       (1024 * 1024)
+#define N_BLOCKS         4
+#define BGZF_N_BLOCKS    8 /* Per thread */
+
+typedef struct _InputBlock InputBlock;
+
+struct _InputBlock
+{
+  char          *data;
+  gsize          alloc;
+  gsize          size;
+  gsize          pos;
+  GError        *error;
+  int            last;
+
+  /* BGZF blocks and the chunks of indexed gzip files are inflated by a
+   * pool of threads */
+  unsigned char *compressed;
+  gsize          compressed_size;
+  guint          point;
+  GMutex         lock;
+  GCond          cond;
+  int            done;
+};
+
+struct _NgsInput
+{
+  char          *path;
+  int            fd;
+  int            is_stdin;
+  NgsInputFormat format;
+
+  /* Bytes read while looking for the magic number, served first */
+  char          *peek;
+  gsize          peek_size;
+  gsize          peek_pos;
+
+  /* Decompression threads */
+  GThread       *thread;
+  GThreadPool   *pool;
+  GzIndex       *index;
+  GzIndexReader *reader;
+  GAsyncQueue   *full_blocks;
+  GAsyncQueue   *free_blocks;
+  InputBlock    *current;
+  volatile gint  cancelled;
+  int            finished;
+
+  GError        *error;
+};
+
+static gssize   read_fd         (NgsInput    *input,
+                                 char        *buffer,
+                                 gsize        size);
+
+static gssize   read_exact      (NgsInput    *input,
+                                 char        *buffer,
+                                 gsize        size,
+                                 GError     **error);
+
+static int      get_n_threads   (void);
+
+static gpointer gzip_thread     (NgsInput    *input);
+
+static gpointer bgzf_thread     (NgsInput    *input);
+
+static void     inflate_block   (InputBlock  *block,
+                                 NgsInput    *input);
+
+static gpointer indexed_thread  (NgsInput    *input);
+
+static void     inflate_chunk   (InputBlock  *block,
+                                 NgsInput    *input);
+
+static void     block_wait      (InputBlock  *block);
+
+static gssize   read_blocks     (NgsInput    *input,
+                                 char        *buffer,
+                                 gsize        size);
+
+typedef struct _InputChannel InputChannel;
+
+struct _InputChannel
+{
+  GIOChannel  channel;
+  NgsInput   *input;
+};
+
+static GIOStatus    input_channel_read         (GIOChannel   *channel,
+                                                gchar        *buffer,
+                                                gsize         count,
+                                                gsize        *bytes_read,
+                                                GError      **error);
+
+static GIOStatus    input_channel_write        (GIOChannel   *channel,
+                                                const gchar  *buffer,
+                                                gsize         count,
+                                                gsize        *bytes_written,
+                                                GError      **error);
+
+static GIOStatus    input_channel_seek         (GIOChannel   *channel,
+                                                gint64        offset,
+                                                GSeekType     type,
+                                                GError      **error);
+
+static GIOStatus    input_channel_close        (GIOChannel   *channel,
+                                                GError      **error);
+
+static GSource*     input_channel_create_watch (GIOChannel   *channel,
+                                                GIOCondition  condition);
+
+static void         input_channel_free         (GIOChannel   *channel);
+
+static GIOStatus    input_channel_set_flags    (GIOChannel   *channel,
+                                                GIOFlags      flags,
+                                                GError      **error);
+
+static GIOFlags     input_channel_get_flags    (GIOChannel   *channel);
+
+static GIOFuncs input_channel_funcs =
+{
+  input_channel_read,
+  input_channel_write,
+  input_channel_seek,
+  input_channel_close,
+  input_channel_create_watch,
+  input_channel_free,
+  input_channel_set_flags,
+  input_channel_get_flags
+};
+
+NgsInput*
+ngs_input_open (const char  *path,
+                GError     **error)
+{
+  NgsInput *input;
+  int       fd;
+  int       is_stdin = 0;
+
+  if (path[0] == '-' && path[1] == '\0')
+    {
+      fd       = STDIN_FILENO;
+      is_stdin = 1;
+    }
+  else
+    fd = open (path, O_RDONLY);
+  if (fd < 0)
+    {
+      g_set_error (error,
+                   NGS_ERROR,
+                   NGS_IO_ERROR,
+                   "Could not open input file `%s'",
+                   path);
+      return NULL;
+    }
+
+  input            = g_slice_new0 (NgsInput);
+  input->path      = g_strdup (path);
+  input->fd        = fd;
+  input->is_stdin  = is_stdin;
+  input->peek      = g_malloc (PEEK_SIZE);
+  input->format    = NGS_INPUT_PLAIN;
+
+  /* Pipes can return fewer bytes than asked, insist until the magic number
+   * and the BGZF header can be checked */
+  while (input->peek_size < BGZF_HEADER_SIZE)
+    {
+      gssize bytes_read;
+
+      bytes_read = read_fd (input,
+                            input->peek + input->peek_size,
+                            PEEK_SIZE - input->peek_size);
+      if (bytes_read < 0)
+        {
+          g_propagate_error (error, input->error);
+          input->error = NULL;
+          ngs_input_close (input);
+          return NULL;
+        }
+      if (bytes_read == 0)
+        break;
+      input->peek_size += bytes_read;
+    }
+
+  if (input->peek_size >= 2 &&
+      (unsigned char)input->peek[0] == 0x1f &&
+      (unsigned char)input->peek[1] == 0x8b)
+    {
+      GThreadFunc thread_func = (GThreadFunc)gzip_thread;
+      gsize       block_size  = BLOCK_SIZE;
+      int         n_blocks    = N_BLOCKS;
+      int         i;
+
+      input->format = NGS_INPUT_GZIP;
+      if (bgzf_block_size ((unsigned char*)input->peek, input->peek_size) > 0)
+        {
+          const int n_threads = get_n_threads ();
+
+          input->format = NGS_INPUT_BGZF;
+          input->pool   = g_thread_pool_new ((GFunc)inflate_block,
+                                             input,
+                                             n_threads,
+                                             TRUE,
+                                             NULL);
+          thread_func   = (GThreadFunc)bgzf_thread;
+          block_size    = BGZF_MAX_BLOCK_SIZE;
+          n_blocks      = BGZF_N_BLOCKS * n_threads;
+        }
+      else if (!input->is_stdin)
+        input->index = gz_index_find (path, fd);
+      if (input->index && input->index->n_points > 1)
+        {
+          const int n_threads = get_n_threads ();
+
+          input->pool = g_thread_pool_new ((GFunc)inflate_chunk,
+                                           input,
+                                           n_threads,
+                                           TRUE,
+                                           NULL);
+          thread_func = (GThreadFunc)indexed_thread;
+          /* Grown to the size of the chunks between access points */
+          block_size  = 0;
+          n_blocks    = 2 * n_threads;
+        }
+      input->full_blocks = g_async_queue_new ();
+      input->free_blocks = g_async_queue_new ();
+      for (i = 0; i < n_blocks; i++)
+        {
+          InputBlock *block;
+
+          block        = g_slice_new0 (InputBlock);
+          block->data  = g_malloc (block_size);
+          block->alloc = block_size;
+          if (input->format == NGS_INPUT_BGZF)
+            block->compressed = g_malloc (BGZF_MAX_BLOCK_SIZE);
+          g_mutex_init (&block->lock);
+          g_cond_init (&block->cond);
+          g_async_queue_push (input->free_blocks, block);
+        }
+      input->thread = g_thread_new ("ngs_input",
+                                    thread_func,
+                                    input);
+    }
+
+  return input;
+}
+
+NgsInput*
+ngs_input_open_at (const char  *path,
+                   guint64      offset,
+                   GError     **error)
+{
+  NgsInput     *input;
+  unsigned char magic[2];
+  int           fd;
+
+  fd = open (path, O_RDONLY);
+  if (fd < 0)
+    {
+      g_set_error (error,
+                   NGS_ERROR,
+                   NGS_IO_ERROR,
+                   "Could not open input file `%s'",
+                   path);
+      return NULL;
+    }
+
+  input         = g_slice_new0 (NgsInput);
+  input->path   = g_strdup (path);
+  input->fd     = fd;
+  input->format = NGS_INPUT_PLAIN;
+
+  if (pread (fd, magic, 2, 0) == 2 && magic[0] == 0x1f && magic[1] == 0x8b)
+    {
+      guint64 skip;
+      guint   point = 0;
+
+      input->format = NGS_INPUT_GZIP;
+      input->index  = gz_index_find (path, fd);
+      if (input->index == NULL)
+        {
+          g_set_error (error,
+                       NGS_ERROR,
+                       NGS_IO_ERROR,
+                       "No index for the compressed file `%s'",
+                       path);
+          ngs_input_close (input);
+          return NULL;
+        }
+      while (point + 1 < input->index->n_points &&
+             input->index->points[point + 1].out <= offset)
+        point++;
+      input->reader = gz_index_reader_new (input->index, fd, point, error);
+      if (input->reader == NULL)
+        {
+          ngs_input_close (input);
+          return NULL;
+        }
+      /* Only needed if offset is not an access point */
+      for (skip = offset - input->index->points[point].out; skip > 0; )
+        {
+          char         buffer[4096];
+          const gssize bytes_read = ngs_input_read (input,
+                                                    buffer,
+                                                    MIN (skip, sizeof (buffer)));
+
+          if (bytes_read <= 0)
+            {
+              if (!ngs_input_get_error (input, error))
+                g_set_error (error,
+                             NGS_ERROR,
+                             NGS_IO_ERROR,
+                             "Offset beyond the end of `%s'",
+                             path);
+              ngs_input_close (input);
+              return NULL;
+            }
+          skip -= bytes_read;
+        }
+    }
+  else if (lseek (fd, offset, SEEK_SET) != (off_t)offset)
+    {
+      g_set_error (error,
+                   NGS_ERROR,
+                   NGS_IO_ERROR,
+                   "Could not seek in input file `%s': %s",
+                   path,
+                   g_strerror (errno));
+      ngs_input_close (input);
+      return NULL;
+    }
+
+  return input;
+}
+
+guint
+ngs_input_split (const char  *path,
+                 guint        n_parts,
+                 guint64    **offsets,
+                 GError     **error)
+{
+  struct stat   st;
+  unsigned char header[BGZF_HEADER_SIZE];
+  GzIndex      *index = NULL;
+  guint64       size;
+  guint         n     = 0;
+  guint         i;
+  int           fd;
+
+  *offsets = NULL;
+  if (path[0] == '-' && path[1] == '\0')
+    return 0;
+  fd = open (path, O_RDONLY);
+  if (fd < 0)
+    {
+      g_set_error (error,
+                   NGS_ERROR,
+                   NGS_IO_ERROR,
+                   "Could not open input file `%s'",
+                   path);
+      return 0;
+    }
+  if (fstat (fd, &st) != 0 || !S_ISREG (st.st_mode) || st.st_size == 0)
+    {
+      close (fd);
+      return 0;
+    }
+  size = st.st_size;
+  if (pread (fd, header, 2, 0) == 2 && header[0] == 0x1f && header[1] == 0x8b)
+    {
+      /* BGZF is already inflated in parallel, plain gzip needs an index */
+      if (pread (fd, header, BGZF_HEADER_SIZE, 0) == BGZF_HEADER_SIZE &&
+          bgzf_block_size (header, BGZF_HEADER_SIZE) > 0)
+        index = NULL;
+      else
+        index = gz_index_find (path, fd);
+      if (index == NULL || index->n_points < 2)
+        {
+          gz_index_free (index);
+          close (fd);
+          return 0;
+        }
+      size = index->size;
+    }
+  close (fd);
+
+  *offsets = g_new (guint64, n_parts);
+  for (i = 0; i < n_parts; i++)
+    {
+      guint64 offset = size / n_parts * i;
+
+      /* Compressed parts start on access points */
+      if (index)
+        {
+          guint point = 0;
+
+          while (point + 1 < index->n_points &&
+                 index->points[point + 1].out <= offset)
+            point++;
+          offset = index->points[point].out;
+        }
+      if (n == 0 || offset > (*offsets)[n - 1])
+        (*offsets)[n++] = offset;
+    }
+  gz_index_free (index);
+
+  return n;
+}
+
+gssize
+ngs_input_read (NgsInput *input,
+                char     *buffer,
+                gsize     size)
+{
+  if (input->error)
+    return -1;
+  if (input->reader)
+    return gz_index_reader_read (input->reader, buffer, size, &input->error);
+  if (input->thread)
+    return read_blocks (input, buffer, size);
+  if (input->peek_pos < input->peek_size)
+    {
+      const gsize n = MIN (size, input->peek_size - input->peek_pos);
+
+      memcpy (buffer, input->peek + input->peek_pos, n);
+      input->peek_pos += n;
+      return n;
+    }
+  return read_fd (input, buffer, size);
+}
+
+gboolean
+ngs_input_get_error (NgsInput  *input,
+                     GError   **error)
+{
+  if (input->error == NULL)
+    return FALSE;
+  g_propagate_error (error, input->error);
+  input->error = NULL;
+
+  return TRUE;
+}
+
+NgsInputFormat
+ngs_input_get_format (NgsInput *input)
+{
+  return input->format;
+}
+
+void
+ngs_input_close (NgsInput *input)
+{
+  if (!input)
+    return;
+  if (input->thread)
+    {
+      InputBlock *block;
+
+      /* Stop the decompression early and wait for its last block, unless
+       * it is already being read */
+      g_atomic_int_set (&input->cancelled, 1);
+      if (input->current && input->current->last)
+        input->finished = 1;
+      if (!input->finished)
+        {
+          if (input->current)
+            g_async_queue_push (input->free_blocks, input->current);
+          while (1)
+            {
+              block = g_async_queue_pop (input->full_blocks);
+              block_wait (block);
+              if (block->last)
+                break;
+              if (block->error)
+                g_error_free (block->error);
+              block->error = NULL;
+              g_async_queue_push (input->free_blocks, block);
+            }
+          input->current = block;
+        }
+      g_thread_join (input->thread);
+      if (input->pool)
+        g_thread_pool_free (input->pool, FALSE, TRUE);
+      if (input->current->error)
+        g_error_free (input->current->error);
+      g_async_queue_push (input->free_blocks, input->current);
+      while ((block = g_async_queue_try_pop (input->free_blocks)) != NULL)
+        {
+          g_mutex_clear (&block->lock);
+          g_cond_clear (&block->cond);
+          g_free (block->compressed);
+          g_free (block->data);
+          g_slice_free (InputBlock, block);
+        }
+      g_async_queue_unref (input->free_blocks);
+      g_async_queue_unref (input->full_blocks);
+    }
+  if (input->reader)
+    gz_index_reader_free (input->reader);
+  gz_index_free (input->index);
+  if (!input->is_stdin)
+    close (input->fd);
+  if (input->error)
+    g_error_free (input->error);
+  g_free (input->peek);
+  g_free (input->path);
+  g_slice_free (NgsInput, input);
+}
+
+GIOChannel*
+ngs_input_channel_new (const char  *path,
+                       GError     **error)
+{
+  InputChannel *input_channel;
+  NgsInput     *input;
+
+  input = ngs_input_open (path, error);
+  if (input == NULL)
+    return NULL;
+
+  input_channel        = g_slice_new0 (InputChannel);
+  input_channel->input = input;
+  g_io_channel_init (&input_channel->channel);
+  input_channel->channel.funcs          = &input_channel_funcs;
+  input_channel->channel.is_readable    = TRUE;
+  input_channel->channel.is_writeable   = FALSE;
+  input_channel->channel.is_seekable    = FALSE;
+  input_channel->channel.close_on_unref = TRUE;
+  g_io_channel_set_encoding (&input_channel->channel, NULL, NULL);
+
+  return &input_channel->channel;
+}
+
+static gssize
+read_fd (NgsInput *input,
+         char     *buffer,
+         gsize     size)
+{
+  gssize bytes_read;
+
+  do
+    bytes_read = read (input->fd, buffer, size);
+  while (bytes_read < 0 && errno == EINTR);
+  if (bytes_read < 0)
+    g_set_error (&input->error,
+                 NGS_ERROR,
+                 NGS_IO_ERROR,
+                 "Error while reading `%s': %s",
+                 input->path,
+                 g_strerror (errno));
+
+  return bytes_read;
+}
+
+static gssize
+read_blocks (NgsInput *input,
+             char     *buffer,
+             gsize     size)
+{
+  while (1)
+    {
+      InputBlock *block;
+
+      if (input->current == NULL)
+        {
+          input->current = g_async_queue_pop (input->full_blocks);
+          block_wait (input->current);
+        }
+      block = input->current;
+      if (block->pos < block->size)
+        {
+          const gsize n = MIN (size, block->size - block->pos);
+
+          memcpy (buffer, block->data + block->pos, n);
+          block->pos += n;
+          return n;
+        }
+      if (block->last)
+        input->finished = 1;
+      if (block->error)
+        {
+          input->error = block->error;
+          block->error = NULL;
+          return -1;
+        }
+      if (block->last)
+        return 0;
+      g_async_queue_push (input->free_blocks, block);
+      input->current = NULL;
+    }
+}
+
+static GIOStatus
+input_channel_read (GIOChannel  *channel,
+                    gchar       *buffer,
+                    gsize        count,
+                    gsize       *bytes_read,
+                    GError     **error)
+{
+  InputChannel *input_channel = (InputChannel*)channel;
+  gssize        n;
+
+  *bytes_read = 0;
+  if (input_channel->input == NULL)
+    return G_IO_STATUS_EOF;
+  n = ngs_input_read (input_channel->input, buffer, count);
+  if (n < 0)
+    {
+      ngs_input_get_error (input_channel->input, error);
+      return G_IO_STATUS_ERROR;
+    }
+  if (n == 0)
+    return G_IO_STATUS_EOF;
+  *bytes_read = n;
+
+  return G_IO_STATUS_NORMAL;
+}
+
+static GIOStatus
+input_channel_write (GIOChannel   *channel,
+                     const gchar  *buffer,
+                     gsize         count,
+                     gsize        *bytes_written,
+                     GError      **error)
+{
+  (void)channel;
+  (void)buffer;
+  (void)count;
+
+  *bytes_written = 0;
+  g_set_error (error,
+               G_IO_CHANNEL_ERROR,
+               G_IO_CHANNEL_ERROR_FAILED,
+               "Input channels are read-only");
+
+  return G_IO_STATUS_ERROR;
+}
+
+static GIOStatus
+input_channel_seek (GIOChannel  *channel,
+                    gint64       offset,
+                    GSeekType    type,
+                    GError     **error)
+{
+  (void)channel;
+  (void)offset;
+  (void)type;
+
+  g_set_error (error,
+               G_IO_CHANNEL_ERROR,
+               G_IO_CHANNEL_ERROR_INVAL,
+               "Input channels are not seekable");
+
+  return G_IO_STATUS_ERROR;
+}
+
+static GIOStatus
+input_channel_close (GIOChannel  *channel,
+                     GError     **error)
+{
+  InputChannel *input_channel = (InputChannel*)channel;
+
+  (void)error;
+
+  ngs_input_close (input_channel->input);
+  input_channel->input = NULL;
+
+  return G_IO_STATUS_NORMAL;
+}
+
+static GSource*
+input_channel_create_watch (GIOChannel   *channel,
+                            GIOCondition  condition)
+{
+  (void)channel;
+  (void)condition;
+
+  return NULL;
+}
+
+static void
+input_channel_free (GIOChannel *channel)
+{
+  InputChannel *input_channel = (InputChannel*)channel;
+
+  ngs_input_close (input_channel->input);
+  g_slice_free (InputChannel, input_channel);
+}
+
+static GIOStatus
+input_channel_set_flags (GIOChannel  *channel,
+                         GIOFlags     flags,
+                         GError     **error)
+{
+  (void)channel;
+  (void)flags;
+  (void)error;
+
+  return G_IO_STATUS_NORMAL;
+}
+
+static GIOFlags
+input_channel_get_flags (GIOChannel *channel)
+{
+  (void)channel;
+
+  return G_IO_FLAG_IS_READABLE;
+}
+
+/**
+ * Inflates the input into blocks, handed over to the reading thread in
+ * order.  Only N_BLOCKS exist, so the decompression never gets too far
+ * ahead of the parsing.
+ */
+static gpointer
+gzip_thread (NgsInput *input)
+{
+  z_stream    strm;
+  InputBlock *block;
+  GError     *error     = NULL;
+  char       *in_buffer;
+  int         in_stream = 1;
+  int         eof       = 0;
+
+  memset (&strm, 0, sizeof (strm));
+  /* 15 window bits, + 32 for automatic gzip/zlib header detection */
+  if (inflateInit2 (&strm, 15 + 32) != Z_OK)
+    {
+      g_set_error (&error,
+                   NGS_ERROR,
+                   NGS_IO_ERROR,
+                   "Could not initialise the decompression of `%s'",
+                   input->path);
+      block        = g_async_queue_pop (input->free_blocks);
+      block->size  = 0;
+      block->pos   = 0;
+      block->error = error;
+      block->last  = 1;
+      block->done  = 1;
+      g_async_queue_push (input->full_blocks, block);
+      return NULL;
+    }
+  in_buffer     = g_malloc (GZIP_IN_SIZE);
+  strm.next_in  = (Bytef*)input->peek;
+  strm.avail_in = input->peek_size;
+
+  block       = g_async_queue_pop (input->free_blocks);
+  block->size = 0;
+  block->pos  = 0;
+  while (!g_atomic_int_get (&input->cancelled))
+    {
+      int ret;
+
+      if (strm.avail_in == 0 && !eof)
+        {
+          gssize bytes_read;
+
+          do
+            bytes_read = read (input->fd, in_buffer, GZIP_IN_SIZE);
+          while (bytes_read < 0 && errno == EINTR);
+          if (bytes_read < 0)
+            {
+              g_set_error (&error,
+                           NGS_ERROR,
+                           NGS_IO_ERROR,
+                           "Error while reading `%s': %s",
+                           input->path,
+                           g_strerror (errno));
+              break;
+            }
+          if (bytes_read == 0)
+            eof = 1;
+          strm.next_in  = (Bytef*)in_buffer;
+          strm.avail_in = bytes_read;
+        }
+      /* Concatenated gzip members, anything else is trailing garbage */
+      if (!in_stream)
+        {
+          if (strm.avail_in == 0)
+            {
+              if (eof)
+                break;
+              continue;
+            }
+          if (strm.next_in[0] != 0x1f)
+            break;
+          inflateReset (&strm);
+          in_stream = 1;
+        }
+
+      strm.next_out  = (Bytef*)block->data + block->size;
+      strm.avail_out = BLOCK_SIZE - block->size;
+      ret            = inflate (&strm, Z_NO_FLUSH);
+      block->size    = BLOCK_SIZE - strm.avail_out;
+      if (ret == Z_STREAM_END)
+        in_stream = 0;
+      else if (ret == Z_BUF_ERROR)
+        {
+          if (eof && strm.avail_in == 0)
+            {
+              g_set_error (&error,
+                           NGS_ERROR,
+                           NGS_IO_ERROR,
+                           "Unexpected end of compressed file `%s'",
+                           input->path);
+              break;
+            }
+        }
+      else if (ret != Z_OK)
+        {
+          g_set_error (&error,
+                       NGS_ERROR,
+                       NGS_IO_ERROR,
+                       "Decompression of `%s' failed: %s",
+                       input->path,
+                       strm.msg ? strm.msg : "unknown error");
+          break;
+        }
+      if (block->size == BLOCK_SIZE)
+        {
+          block->done = 1;
+          g_async_queue_push (input->full_blocks, block);
+          block       = g_async_queue_pop (input->free_blocks);
+          block->size = 0;
+          block->pos  = 0;
+        }
+    }
+  inflateEnd (&strm);
+  g_free (in_buffer);
+
+  block->error = error;
+  block->last  = 1;
+  block->done  = 1;
+  g_async_queue_push (input->full_blocks, block);
+
+  return NULL;
+}
+
+/**
+ * Reads the BGZF blocks and hands them over to the pool of threads.  They
+ * are queued for the reading thread in the order they were read, and it
+ * waits for each of them to be inflated in turn.
+ */
+static gpointer
+bgzf_thread (NgsInput *input)
+{
+  InputBlock *block;
+  GError     *error = NULL;
+
+  while (1)
+    {
+      gssize bytes_read;
+      gsize  size;
+
+      block       = g_async_queue_pop (input->free_blocks);
+      block->size = 0;
+      block->pos  = 0;
+      block->done = 0;
+      if (g_atomic_int_get (&input->cancelled))
+        break;
+      bytes_read = read_exact (input,
+                               (char*)block->compressed,
+                               BGZF_HEADER_SIZE,
+                               &error);
+      if (bytes_read <= 0)
+        break;
+      size = bgzf_block_size (block->compressed, bytes_read);
+      if (size == 0)
+        {
+          g_set_error (&error,
+                       NGS_ERROR,
+                       NGS_IO_ERROR,
+                       "Invalid BGZF block in `%s'",
+                       input->path);
+          break;
+        }
+      bytes_read = read_exact (input,
+                               (char*)block->compressed + BGZF_HEADER_SIZE,
+                               size - BGZF_HEADER_SIZE,
+                               &error);
+      if (bytes_read < 0)
+        break;
+      if ((gsize)bytes_read < size - BGZF_HEADER_SIZE)
+        {
+          g_set_error (&error,
+                       NGS_ERROR,
+                       NGS_IO_ERROR,
+                       "Unexpected end of compressed file `%s'",
+                       input->path);
+          break;
+        }
+      block->compressed_size = size;
+      g_async_queue_push (input->full_blocks, block);
+      g_thread_pool_push (input->pool, block, NULL);
+    }
+
+  block->error = error;
+  block->last  = 1;
+  block->done  = 1;
+  g_async_queue_push (input->full_blocks, block);
+
+  return NULL;
+}
+
+static void
+inflate_block (InputBlock *block,
+               NgsInput   *input)
+{
+  if (!g_atomic_int_get (&input->cancelled))
+    bgzf_inflate_block (block->compressed,
+                        block->compressed_size,
+                        block->data,
+                        &block->size,
+                        &block->error);
+  g_mutex_lock (&block->lock);
+  block->done = 1;
+  g_cond_signal (&block->cond);
+  g_mutex_unlock (&block->lock);
+}
+
+/**
+ * Queues the chunks between the access points of the index, in order, for
+ * the pool of threads.
+ */
+static gpointer
+indexed_thread (NgsInput *input)
+{
+  InputBlock *block = NULL;
+  guint       i;
+
+  for (i = 0; i <= input->index->n_points; i++)
+    {
+      block       = g_async_queue_pop (input->free_blocks);
+      block->size = 0;
+      block->pos  = 0;
+      block->done = 0;
+      if (i == input->index->n_points || g_atomic_int_get (&input->cancelled))
+        break;
+      block->point = i;
+      g_async_queue_push (input->full_blocks, block);
+      g_thread_pool_push (input->pool, block, NULL);
+    }
+
+  block->last = 1;
+  block->done = 1;
+  g_async_queue_push (input->full_blocks, block);
+
+  return NULL;
+}
+
+static void
+inflate_chunk (InputBlock *block,
+               NgsInput   *input)
+{
+  GzIndex *index = input->index;
+  guint64  end;
+  gsize    size;
+
+  if (block->point + 1 < index->n_points)
+    end = index->points[block->point + 1].out;
+  else
+    end = index->size;
+  size = end - index->points[block->point].out;
+
+  if (!g_atomic_int_get (&input->cancelled))
+    {
+      GzIndexReader *reader;
+
+      if (block->alloc < size)
+        {
+          block->data  = g_realloc (block->data, size);
+          block->alloc = size;
+        }
+      reader = gz_index_reader_new (index, input->fd, block->point, &block->error);
+      while (reader && block->size < size)
+        {
+          const gssize bytes_read = gz_index_reader_read (reader,
+                                                          block->data + block->size,
+                                                          size - block->size,
+                                                          &block->error);
+          if (bytes_read == 0)
+            g_set_error (&block->error,
+                         NGS_ERROR,
+                         NGS_IO_ERROR,
+                         "Unexpected end of compressed file `%s'",
+                         input->path);
+          if (bytes_read <= 0)
+            break;
+          block->size += bytes_read;
+        }
+      if (reader)
+        gz_index_reader_free (reader);
+    }
+  g_mutex_lock (&block->lock);
+  block->done = 1;
+  g_cond_signal (&block->cond);
+  g_mutex_unlock (&block->lock);
+}
+
+static void
+block_wait (InputBlock *block)
+{
+  g_mutex_lock (&block->lock);
+  while (!block->done)
+    g_cond_wait (&block->cond, &block->lock);
+  g_mutex_unlock (&block->lock);
+}
+
+/**
+ * Reads size bytes, first from the peek buffer, and then from the file.
+ * Returns less than size only at the end of the file.
+ */
+static gssize
+read_exact (NgsInput  *input,
+            char      *buffer,
+            gsize      size,
+            GError   **error)
+{
+  gsize total = 0;
+
+  if (input->peek_pos < input->peek_size)
+    {
+      total = MIN (size, input->peek_size - input->peek_pos);
+      memcpy (buffer, input->peek + input->peek_pos, total);
+      input->peek_pos += total;
+    }
+  while (total < size)
+    {
+      gssize bytes_read;
+
+      bytes_read = read (input->fd, buffer + total, size - total);
+      if (bytes_read < 0)
+        {
+          if (errno == EINTR)
+            continue;
+          g_set_error (error,
+                       NGS_ERROR,
+                       NGS_IO_ERROR,
+                       "Error while reading `%s': %s",
+                       input->path,
+                       g_strerror (errno));
+          return -1;
+        }
+      if (bytes_read == 0)
+        break;
+      total += bytes_read;
+    }
+
+  return total;
+}
+
+static int
+get_n_threads (void)
+{
+  const long n = sysconf (_SC_NPROCESSORS_ONLN);
+
+  return n > 0 ? n : 1;
+}
+
+#undef PEEK_SIZE
+#undef GZIP_IN_SIZE
+#undef BLOCK_SIZE
+#undef N_BLOCKS
+#undef BGZF_N_BLOCKS
+
+/* vim:ft=c:expandtab:sw=4:ts=4:sts=4:cinoptions={.5s^-2n-2(0:
+ */
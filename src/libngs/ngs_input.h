@@ -0,0 +1,94 @@
+/**
+ *
+ */
+
+#ifndef __NGS_INPUT_H__
+#define __NGS_INPUT_H__
+
+#include <glib.h>
+
+/************/
+/* NgsInput */
+/************/
+
+/**
+ * A raw byte source for the parsers.
+ * Gzip compressed input (including concatenated gzip members) is detected
+ * from its magic number and inflated in-process on a separate thread, so that
+ * decompression overlaps with parsing.  BGZF blocks, as well as gzip files
+ * with a seek-point index (see ngs_gzindex.h), are inflated in parallel by
+ * one thread per processor.  Other input is read as is.
+ * If path is '-', reads from stdin.
+ */
+
+typedef struct _NgsInput NgsInput;
+
+typedef enum
+{
+  NGS_INPUT_PLAIN = 0,
+  NGS_INPUT_GZIP,
+  NGS_INPUT_BGZF
+}
+NgsInputFormat;
+
+NgsInput*      ngs_input_open       (const char  *path,
+                                     GError     **error);
+
+/**
+ * Opens path to read it from offset in the uncompressed data.
+ * Gzip files need an index (see ngs_gzindex.h), and are inflated by the
+ * reading thread.  BGZF files are not supported.
+ */
+
+NgsInput*      ngs_input_open_at    (const char  *path,
+                                     guint64      offset,
+                                     GError     **error);
+
+/**
+ * Splits path into at most n_parts parts of similar sizes, which can be
+ * read with ngs_input_open_at.  The offsets of the starts of the parts are
+ * returned in offsets, to be freed with g_free.
+ * Returns the number of parts, or 0 if the input cannot be split: stdin,
+ * pipes, gzip files without an index and BGZF files.
+ */
+
+guint          ngs_input_split      (const char  *path,
+                                     guint        n_parts,
+                                     guint64    **offsets,
+                                     GError     **error);
+
+/**
+ * Reads up to size bytes into buffer.
+ * Returns the number of bytes read, 0 at the end of the input, and -1 on
+ * errors, which can then be retrieved with ngs_input_get_error.
+ */
+
+gssize         ngs_input_read       (NgsInput    *input,
+                                     char        *buffer,
+                                     gsize        size);
+
+/**
+ * Propagates the error that interrupted reading, if any.
+ * Returns TRUE if there was an error.
+ */
+
+gboolean       ngs_input_get_error  (NgsInput    *input,
+                                     GError     **error);
+
+NgsInputFormat ngs_input_get_format (NgsInput    *input);
+
+void           ngs_input_close      (NgsInput    *input);
+
+/**
+ * A read-only GIOChannel on top of an NgsInput, for the parsers that
+ * read lines with g_io_channel_read_line.  The channel is binary (no
+ * encoding) and not seekable.
+ */
+
+GIOChannel*    ngs_input_channel_new (const char  *path,
+                                      GError     **error);
+
+#endif /* __NGS_INPUT_H__ */
+
+/* vim:ft=c:expandtab:sw=4:ts=4:sts=4:cinoptions={.5s^-2n-2(0:
+ */
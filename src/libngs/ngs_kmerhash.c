@@ -26,6 +26,7 @@
 #include "ngs_binseq.h"
 #include "ngs_kmerhash.h"
 #include "ngs_utils.h"
+#include "ngs_writer.h"
 
 #define HASH_TABLE_MIN_SHIFT 3  /* 1 << 3 == 8 buckets */
 
@@ -615,6 +616,23 @@ kmer_hash_table_lookup_or_create (KmerHashTable       *hash_table,
   return node;
 }
 
+void
+kmer_hash_table_merge (KmerHashTable *hash_table,
+                       KmerHashTable *other)
+{
+  KmerHashTableIter  iter;
+  KmerHashNode      *hnode;
+
+  kmer_hash_table_iter_init (&iter, other);
+  while ((hnode = kmer_hash_table_iter_next (&iter)) != NULL)
+    {
+      if (other->kmer_bytes > KMER_VAL_BYTES)
+        kmer_hash_table_add_count (hash_table, hnode->kmer.kmer_ptr, hnode->value.count);
+      else
+        kmer_hash_table_add_count (hash_table, hnode->kmer.kmer_val, hnode->value.count);
+    }
+}
+
 /* fast itoa implementarion, does not zero terminate the buffer and only works
  * with positive numbers */
 #define uitoa_no0(i, buf, buf_size, ret, n_chars)   \
@@ -638,28 +656,20 @@ kmer_hash_table_print (KmerHashTable       *hash_table,
 {
   KmerHashTableIter  iter;
   KmerHashNode      *hnode;
-  GIOChannel        *channel;
+  NgsWriter         *writer;
   char              *buffer;
   GError            *tmp_error      = NULL;
   gsize              bin_write_size = 0;
-  int                use_stdout     = 1;
 
   /* Open */
-  if (!path || !*path || (path[0] == '-' && path[1] == '\0'))
-    channel = g_io_channel_unix_new (STDOUT_FILENO);
-  else
+  if (!path || !*path)
+    path = "-";
+  writer = ngs_writer_new (path, "w", &tmp_error);
+  if (tmp_error)
     {
-      use_stdout = 0;
-      channel    = g_io_channel_new_file (path, "w", &tmp_error);
-      if (tmp_error)
-        {
-          g_propagate_error (error, tmp_error);
-          return ;
-        }
+      g_propagate_error (error, tmp_error);
+      return ;
     }
-  g_io_channel_set_encoding (channel, NULL, NULL);
-  g_io_channel_set_buffer_size (channel, CHANNEL_BUFFER_SIZE);
-
 
   /* Write */
   if (binary)
@@ -681,9 +691,7 @@ kmer_hash_table_print (KmerHashTable       *hash_table,
                 buffer[j] = hnode->kmer.kmer_ptr[j];
             }
           *((unsigned long int*)(buffer + j)) = GULONG_TO_BE (hnode->value.count);
-          g_io_channel_write_chars (channel,
-                                    (char*)buffer, bin_write_size,
-                                    NULL, &tmp_error);
+          ngs_writer_write (writer, buffer, bin_write_size, &tmp_error);
         }
       else
         {
@@ -700,9 +708,7 @@ kmer_hash_table_print (KmerHashTable       *hash_table,
             bin_to_char_prealloc (buffer_ptr, hnode->kmer.kmer_val, hash_table->k);
           else
             bin_to_char_prealloc (buffer_ptr, hnode->kmer.kmer_ptr, hash_table->k);
-          g_io_channel_write_chars (channel,
-                                    buffer_ptr, j,
-                                    NULL, &tmp_error);
+          ngs_writer_write (writer, buffer_ptr, j, &tmp_error);
         }
       if (tmp_error)
         {
@@ -713,18 +719,10 @@ kmer_hash_table_print (KmerHashTable       *hash_table,
     }
 
   /* Close */
-  if (!use_stdout)
-    {
-      g_io_channel_shutdown (channel, TRUE, &tmp_error);
-      if (tmp_error)
-        {
-          g_printerr ("[ERROR] Closing output file `%s' failed: %s\n",
-                      path,
-                      tmp_error->message);
-          g_error_free (tmp_error);
-        }
-    }
-  g_io_channel_unref (channel);
+  if (!ngs_writer_close (writer, &tmp_error) && error && !*error)
+    g_propagate_error (error, tmp_error);
+  else if (tmp_error)
+    g_error_free (tmp_error);
 }
 
 
@@ -114,6 +114,12 @@ void           kmer_hash_table_add_count           (KmerHashTable       *hash_ta
 KmerHashNode*  kmer_hash_table_lookup_or_create    (KmerHashTable       *hash_table,
                                                     const unsigned char *kmer);
 
+/**
+ * Adds the counts of other to hash_table.  Both tables must have the same k.
+ */
+void           kmer_hash_table_merge               (KmerHashTable       *hash_table,
+                                                    KmerHashTable       *other);
+
 KmerHashNode*  kmer_hash_table_lookup              (KmerHashTable       *hash_table,
                                                     const unsigned char *kmer);
 
@@ -29,24 +29,33 @@
 RefMethCounts*
 ref_meth_counts_create (SeqDB *ref)
 {
+  GHashTableIter iter;
   RefMethCounts *counts;
+  SeqDBElement  *elem;
   unsigned long  n_cg;
   unsigned long  i;
 
   counts = g_slice_new0 (RefMethCounts);
 
+  /* Only the sequences that have been read are counted */
   n_cg = 0;
-  for (i = 0; i < ref->total_size; i++)
-    if (ref->seqs[i] == 'C' || ref->seqs[i] == 'G')
-      ++n_cg;
+  g_hash_table_iter_init (&iter, ref->index);
+  while (g_hash_table_iter_next (&iter, NULL, (gpointer*)&elem))
+    if (elem->loaded)
+      for (i = elem->offset; i < elem->offset + elem->size; i++)
+        if (ref->seqs[i] == 'C' || ref->seqs[i] == 'G')
+          ++n_cg;
 
   counts->meth_index = g_malloc0 (ref->total_size * sizeof (*counts->meth_index) );
   counts->meth_data  = g_malloc0 (n_cg * sizeof (*counts->meth_data) );
 
   n_cg = 0;
-  for (i = 0; i < ref->total_size; i++)
-    if (ref->seqs[i] == 'C' || ref->seqs[i] == 'G')
-      counts->meth_index[i] = &counts->meth_data[n_cg++];
+  g_hash_table_iter_init (&iter, ref->index);
+  while (g_hash_table_iter_next (&iter, NULL, (gpointer*)&elem))
+    if (elem->loaded)
+      for (i = elem->offset; i < elem->offset + elem->size; i++)
+        if (ref->seqs[i] == 'C' || ref->seqs[i] == 'G')
+          counts->meth_index[i] = &counts->meth_data[n_cg++];
 
   return counts;
 }
@@ -105,6 +114,9 @@ ref_meth_counts_add_path (RefMethCounts *counts,
           elem = g_hash_table_lookup (ref->index, buffer + i + 1);
           if (!elem)
             g_printerr ("[WARNING] Reference `%s' not found\n", buffer + i + 1);
+          /* Not counted */
+          else if (!elem->loaded)
+            elem = NULL;
         }
       else if (elem)
         {
@@ -185,93 +197,71 @@ ref_meth_counts_write (RefMethCounts *counts,
                        GError       **error)
 {
   GHashTableIter iter;
-  GIOChannel    *channel;
+  NgsWriter     *writer;
   SeqDBElement  *elem;
   GError        *tmp_error  = NULL;
-  int            use_stdout = 1;
 
   /* Open */
-  if (!path || !*path || (path[0] == '-' && path[1] == '\0'))
-    channel = g_io_channel_unix_new (STDOUT_FILENO);
-  else
+  if (!path || !*path)
+    path = "-";
+  writer = ngs_writer_new (path, "w", &tmp_error);
+  if (tmp_error)
     {
-      use_stdout = 0;
-      channel = g_io_channel_new_file (path, "w", &tmp_error);
-      if (tmp_error)
-        {
-          g_propagate_error (error, tmp_error);
-          return;
-        }
+      g_propagate_error (error, tmp_error);
+      return;
     }
 
   /* TODO could use ref_meth_counts_write_segment here */
   g_hash_table_iter_init (&iter, ref->index);
   while (g_hash_table_iter_next (&iter, NULL, (gpointer*)&elem))
     {
-      GString      *buffer;
       MethCount   **ref_meth;
       unsigned long i;
 
+      if (!elem->loaded)
+        continue;
       ref_meth = counts->meth_index + elem->offset;
-      buffer   = g_string_new (NULL);
-      g_string_printf (buffer, ">%s\n", elem->name);
+      ngs_writer_printf (writer, NULL, ">%s\n", elem->name);
       for (i = 0; i < elem->size; i++)
         {
         if (ref_meth[i])
           {
             if (print_letter)
-              g_string_append_printf (buffer,
-                                      "%c\t%ld\t%u\t%u\n",
-                                      ref->seqs[elem->offset + i],
-                                      i,
-                                      ref_meth[i]->n_meth,
-                                      ref_meth[i]->n_unmeth);
+              ngs_writer_printf (writer,
+                                 NULL,
+                                 "%c\t%ld\t%u\t%u\n",
+                                 ref->seqs[elem->offset + i],
+                                 i,
+                                 ref_meth[i]->n_meth,
+                                 ref_meth[i]->n_unmeth);
             else
-              g_string_append_printf (buffer,
-                                      "%ld\t%u\t%u\n",
-                                      i,
-                                      ref_meth[i]->n_meth,
-                                      ref_meth[i]->n_unmeth);
+              ngs_writer_printf (writer,
+                                 NULL,
+                                 "%ld\t%u\t%u\n",
+                                 i,
+                                 ref_meth[i]->n_meth,
+                                 ref_meth[i]->n_unmeth);
           }
         else if (print_all)
-          g_string_append_printf (buffer,
-                                  "%c\n",
-                                  ref->seqs[elem->offset + i]);
-        }
-      g_io_channel_write_chars (channel,
-                                buffer->str,
-                                buffer->len,
-                                NULL,
-                                &tmp_error);
-      g_string_free (buffer, TRUE);
-
-      if (tmp_error)
-        {
-          g_propagate_error (error, tmp_error);
-          tmp_error = NULL;
-          break;
+          {
+            ngs_writer_putc (writer, ref->seqs[elem->offset + i], NULL);
+            ngs_writer_putc (writer, '\n', NULL);
+          }
         }
+
+      if (writer->error)
+        break;
     }
 
   /* Close */
-  if (!use_stdout)
-    {
-      g_io_channel_shutdown (channel, TRUE, &tmp_error);
-      if (tmp_error)
-        {
-          g_printerr ("[ERROR] Closing output file `%s' failed: %s\n",
-                      path,
-                      tmp_error->message);
-          g_error_free (tmp_error);
-        }
-    }
-  g_io_channel_unref (channel);
+  if (!ngs_writer_close (writer, &tmp_error))
+    g_propagate_error (error, tmp_error);
 }
 
 void
 ref_meth_counts_write_segment (RefMethCounts *counts,
                                SeqDB         *ref,
-                               GIOChannel    *channel,
+                               NgsWriter     *writer,
                                const char    *name,
                                unsigned long  from,
                                unsigned long  to,
@@ -279,53 +269,46 @@ ref_meth_counts_write_segment (RefMethCounts *counts,
                                int            print_all,
                                GError       **error)
 {
-  GError         *tmp_error = NULL;
   SeqDBElement   *elem;
-  GString        *buffer;
   MethCount     **ref_meth;
   unsigned long   i;
 
   elem = (SeqDBElement*)g_hash_table_lookup (ref->index, name);
-  if (!elem)
+  if (!elem || !elem->loaded)
     return;
   if (from >= elem->size)
     return;
   to       = MIN (to, elem->size);
   ref_meth = counts->meth_index + elem->offset;
-  buffer   = g_string_new (NULL);
-  g_string_printf (buffer, ">%s:%lu-%lu\n", elem->name, from, to);
+  ngs_writer_printf (writer, NULL, ">%s:%lu-%lu\n", elem->name, from, to);
   for (i = from; i < to; i++)
     {
       if (ref_meth[i])
         {
           if (print_letter)
-            g_string_append_printf (buffer,
-                                    "%c\t%ld\t%u\t%u\n",
-                                    ref->seqs[elem->offset + i],
-                                    i,
-                                    ref_meth[i]->n_meth,
-                                    ref_meth[i]->n_unmeth);
+            ngs_writer_printf (writer,
+                               NULL,
+                               "%c\t%ld\t%u\t%u\n",
+                               ref->seqs[elem->offset + i],
+                               i,
+                               ref_meth[i]->n_meth,
+                               ref_meth[i]->n_unmeth);
           else
-            g_string_append_printf (buffer,
-                                    "%ld\t%u\t%u\n",
-                                    i,
-                                    ref_meth[i]->n_meth,
-                                    ref_meth[i]->n_unmeth);
+            ngs_writer_printf (writer,
+                               NULL,
+                               "%ld\t%u\t%u\n",
+                               i,
+                               ref_meth[i]->n_meth,
+                               ref_meth[i]->n_unmeth);
         }
       else if (print_all)
-        g_string_append_printf (buffer,
-                                "%c\n",
-                                ref->seqs[elem->offset + i]);
+        {
+          ngs_writer_putc (writer, ref->seqs[elem->offset + i], NULL);
+          ngs_writer_putc (writer, '\n', NULL);
+        }
     }
-  g_io_channel_write_chars (channel,
-                            buffer->str,
-                            buffer->len,
-                            NULL,
-                            &tmp_error);
-  g_string_free (buffer, TRUE);
 
-  if (tmp_error)
-    g_propagate_error (error, tmp_error);
+  ngs_writer_check (writer, error);
 }
 
 /* vim:ft=c:expandtab:sw=4:ts=4:sts=4:cinoptions={.5s^-2n-2(0:
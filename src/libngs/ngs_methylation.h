@@ -6,6 +6,7 @@
 #define __NGS_METHYLATION_H__
 
 #include "ngs_seq_db.h"
+#include "ngs_writer.h"
 
 
 /*************/
@@ -49,7 +50,7 @@ void           ref_meth_counts_write         (RefMethCounts *counts,
 
 void           ref_meth_counts_write_segment (RefMethCounts *counts,
                                               SeqDB         *ref,
-                                              GIOChannel    *channel,
+                                              NgsWriter     *writer,
                                               const char    *name,
                                               unsigned long  from,
                                               unsigned long  to,
@@ -0,0 +1,225 @@
+/* Copyright (C) 2010  Sylvain FORET
+ *
+ * This file is part of libngs.
+ *
+ * libngs is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *                                                                       
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *                                                                       
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "ngs_mphf.h"
+
+#define MPHF_GAMMA       2
+#define MPHF_MAX_LEVELS  32
+#define MPHF_RANK_WORDS  8
+
+struct _Mphf
+{
+  guint64 *bits;
+  guint64 *ranks;
+  guint64  n_words;
+  guint64  level_starts[MPHF_MAX_LEVELS + 1];
+  guint    n_levels;
+  guint64  n_keys;
+  guint64  n_ranked;
+
+  /* The keys left after the last level, sorted */
+  guint64 *extra_keys;
+  guint64  n_extra;
+};
+
+static guint64 mphf_hash       (guint64     key,
+                                guint       level);
+
+static guint64 mphf_rank       (Mphf       *mphf,
+                                guint64     pos);
+
+static int     compare_keys    (const void *a,
+                                const void *b);
+
+Mphf*
+mphf_new (const guint64 *keys,
+          guint64        n_keys)
+{
+  Mphf    *mphf;
+  guint64 *left;
+  guint64  n_left = n_keys;
+  guint64  i;
+
+  mphf         = g_slice_new0 (Mphf);
+  mphf->n_keys = n_keys;
+  left         = g_new (guint64, MAX (n_keys, 1));
+  memcpy (left, keys, n_keys * sizeof (*keys));
+
+  while (n_left > 0 && mphf->n_levels < MPHF_MAX_LEVELS)
+    {
+      const guint64 n_words = (MPHF_GAMMA * n_left + 63) / 64;
+      const guint64 size    = n_words * 64;
+      guint64      *seen;
+      guint64      *collide;
+      guint64       j;
+
+      seen    = g_new0 (guint64, n_words);
+      collide = g_new0 (guint64, n_words);
+      for (i = 0; i < n_left; i++)
+        {
+          const guint64 pos  = mphf_hash (left[i], mphf->n_levels) % size;
+          const guint64 mask = G_GUINT64_CONSTANT (1) << (pos % 64);
+
+          if (seen[pos / 64] & mask)
+            collide[pos / 64] |= mask;
+          else
+            seen[pos / 64] |= mask;
+        }
+      /* The colliding keys are left for the next level */
+      for (i = 0, j = 0; i < n_left; i++)
+        {
+          const guint64 pos = mphf_hash (left[i], mphf->n_levels) % size;
+
+          if (collide[pos / 64] & (G_GUINT64_CONSTANT (1) << (pos % 64)))
+            left[j++] = left[i];
+        }
+      n_left = j;
+
+      mphf->bits = g_realloc (mphf->bits,
+                              (mphf->n_words + n_words) * sizeof (*mphf->bits));
+      for (i = 0; i < n_words; i++)
+        mphf->bits[mphf->n_words + i] = seen[i] & ~collide[i];
+      mphf->level_starts[mphf->n_levels] = mphf->n_words * 64;
+      mphf->n_words                     += n_words;
+      mphf->n_levels++;
+      mphf->level_starts[mphf->n_levels] = mphf->n_words * 64;
+      g_free (seen);
+      g_free (collide);
+    }
+
+  mphf->ranks = g_new (guint64, mphf->n_words / MPHF_RANK_WORDS + 1);
+  for (i = 0; i < mphf->n_words; i++)
+    {
+      if (i % MPHF_RANK_WORDS == 0)
+        mphf->ranks[i / MPHF_RANK_WORDS] = mphf->n_ranked;
+      mphf->n_ranked += __builtin_popcountll (mphf->bits[i]);
+    }
+
+  mphf->n_extra    = n_left;
+  mphf->extra_keys = g_renew (guint64, left, MAX (n_left, 1));
+  qsort (mphf->extra_keys, n_left, sizeof (*left), compare_keys);
+
+  return mphf;
+}
+
+void
+mphf_free (Mphf *mphf)
+{
+  if (mphf)
+    {
+      g_free (mphf->bits);
+      g_free (mphf->ranks);
+      g_free (mphf->extra_keys);
+      g_slice_free (Mphf, mphf);
+    }
+}
+
+guint64
+mphf_lookup (Mphf    *mphf,
+             guint64  key)
+{
+  guint64 low;
+  guint64 high;
+  guint   level;
+
+  for (level = 0; level < mphf->n_levels; level++)
+    {
+      const guint64 start = mphf->level_starts[level];
+      const guint64 size  = mphf->level_starts[level + 1] - start;
+      const guint64 pos   = start + mphf_hash (key, level) % size;
+
+      if (mphf->bits[pos / 64] & (G_GUINT64_CONSTANT (1) << (pos % 64)))
+        return mphf_rank (mphf, pos);
+    }
+
+  low  = 0;
+  high = mphf->n_extra;
+  while (low < high)
+    {
+      const guint64 mid = low + (high - low) / 2;
+
+      if (mphf->extra_keys[mid] < key)
+        low = mid + 1;
+      else
+        high = mid;
+    }
+  if (low < mphf->n_extra && mphf->extra_keys[low] == key)
+    return mphf->n_ranked + low;
+
+  return mphf->n_keys;
+}
+
+guint64
+mphf_size (Mphf *mphf)
+{
+  return sizeof (*mphf) +
+         mphf->n_words * sizeof (*mphf->bits) +
+         (mphf->n_words / MPHF_RANK_WORDS + 1) * sizeof (*mphf->ranks) +
+         mphf->n_extra * sizeof (*mphf->extra_keys);
+}
+
+/* A different mix of the key for each level */
+static guint64
+mphf_hash (guint64 key,
+           guint   level)
+{
+  key += (level + 1) * G_GUINT64_CONSTANT (0x9e3779b97f4a7c15);
+  key  = (key ^ (key >> 30)) * G_GUINT64_CONSTANT (0xbf58476d1ce4e5b9);
+  key  = (key ^ (key >> 27)) * G_GUINT64_CONSTANT (0x94d049bb133111eb);
+
+  return key ^ (key >> 31);
+}
+
+/* Number of bits set before pos */
+static guint64
+mphf_rank (Mphf    *mphf,
+           guint64  pos)
+{
+  const guint64 word = pos / 64;
+  guint64       rank = mphf->ranks[word / MPHF_RANK_WORDS];
+  guint64       i;
+
+  for (i = word - word % MPHF_RANK_WORDS; i < word; i++)
+    rank += __builtin_popcountll (mphf->bits[i]);
+  if (pos % 64)
+    rank += __builtin_popcountll (mphf->bits[word] << (64 - pos % 64));
+
+  return rank;
+}
+
+static int
+compare_keys (const void *a,
+              const void *b)
+{
+  const guint64 ka = *(const guint64*)a;
+  const guint64 kb = *(const guint64*)b;
+
+  if (ka != kb)
+    return ka < kb ? -1 : 1;
+  return 0;
+}
+
+/* vim:ft=c:expandtab:sw=4:ts=4:sts=4:cinoptions={.5s^-2n-2(0:
+ */
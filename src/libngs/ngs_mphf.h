@@ -0,0 +1,45 @@
+/**
+ *
+ */
+
+#ifndef __NGS_MPHF_H__
+#define __NGS_MPHF_H__
+
+#include <glib.h>
+
+/********/
+/* Mphf */
+/********/
+
+/**
+ * Minimal perfect hash function over a set of distinct 64 bits keys: each
+ * key of the set is mapped to its own value in [0, n_keys).  The keys are
+ * not stored, so any value can be returned for a key that is not in the
+ * set, and the caller must check the keys in some other way.
+ * At each level, the keys are hashed into a bit array twice as large as
+ * their number: the keys which are alone in their position are done, and
+ * the others go to the next level.  The value of a key is the rank of its
+ * bit among all the levels.  This takes about 4 bits per key, and a lookup
+ * takes a couple of cache misses.
+ */
+
+typedef struct _Mphf Mphf;
+
+Mphf*   mphf_new    (const guint64 *keys,
+                     guint64        n_keys);
+
+void    mphf_free   (Mphf          *mphf);
+
+guint64 mphf_lookup (Mphf          *mphf,
+                     guint64        key);
+
+/**
+ * Size of the function, in bytes
+ */
+
+guint64 mphf_size   (Mphf          *mphf);
+
+#endif /* __NGS_MPHF_H__ */
+
+/* vim:ft=c:expandtab:sw=4:ts=4:sts=4:cinoptions={.5s^-2n-2(0:
+ */
@@ -0,0 +1,426 @@
+/* Copyright (C) 2010  Sylvain FORET
+ *
+ * This file is part of libngs.
+ *
+ * libngs is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *                                                                       
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *                                                                       
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ *
+ */
+
+#include <string.h>
+
+#include "ngs_namecodec.h"
+
+
+typedef enum
+{
+  TOKEN_END = 0,
+  TOKEN_MATCH,
+  TOKEN_DELTA,
+  TOKEN_NUM,
+  TOKEN_STR
+}
+TokenType;
+
+#define TOKEN_TYPE_BITS 3
+#define TOKEN_TYPE_MASK ((1 << TOKEN_TYPE_BITS) - 1)
+#define MAX_MATCH_RUN   (0xff >> TOKEN_TYPE_BITS)
+/* Longer numbers, and numbers with leading zeros, are kept as strings */
+#define MAX_NUM_DIGITS  18
+
+struct _NameStore
+{
+  GByteArray *data;
+  GArray     *blocks;
+  guint64     n_names;
+  NameCodec  *encoder;
+  NameCodec  *decoder;
+};
+
+static guint    tokenize         (const char    *name,
+                                  gsize          size,
+                                  NameToken     *tokens);
+
+static int      tokens_equal     (const char    *name1,
+                                  NameToken     *token1,
+                                  const char    *name2,
+                                  NameToken     *token2);
+
+static void     put_varint       (GByteArray    *output,
+                                  guint64        value);
+
+static gboolean get_varint       (const guint8  *data,
+                                  gsize          size,
+                                  gsize         *pos,
+                                  guint64       *value);
+
+/*************/
+/* NameCodec */
+/*************/
+
+NameCodec*
+name_codec_new (void)
+{
+  NameCodec *codec;
+
+  codec           = g_slice_new (NameCodec);
+  codec->prev     = g_string_new (NULL);
+  codec->n_tokens = 0;
+
+  return codec;
+}
+
+void
+name_codec_free (NameCodec *codec)
+{
+  if (codec)
+    {
+      g_string_free (codec->prev, TRUE);
+      g_slice_free (NameCodec, codec);
+    }
+}
+
+void
+name_codec_reset (NameCodec *codec)
+{
+  g_string_truncate (codec->prev, 0);
+  codec->n_tokens = 0;
+}
+
+void
+name_codec_encode (NameCodec  *codec,
+                   const char *name,
+                   GByteArray *output)
+{
+  NameToken tokens[NAME_CODEC_MAX_TOKENS];
+  guint     n_tokens;
+  guint     i = 0;
+
+  n_tokens = tokenize (name, strlen (name), tokens);
+  while (i < n_tokens)
+    {
+      NameToken *token = tokens + i;
+      NameToken *prev  = codec->tokens + i;
+      guint8     type;
+
+      if (i < codec->n_tokens &&
+          tokens_equal (name, token, codec->prev->str, prev))
+        {
+          guint j;
+
+          for (j = i + 1;
+               j < n_tokens && j < codec->n_tokens && j - i < MAX_MATCH_RUN &&
+               tokens_equal (name, tokens + j, codec->prev->str, codec->tokens + j);
+               j++);
+          type = TOKEN_MATCH | ((j - i) << TOKEN_TYPE_BITS);
+          g_byte_array_append (output, &type, 1);
+          i = j;
+          continue;
+        }
+      if (token->is_num && i < codec->n_tokens && prev->is_num &&
+          token->value > prev->value && token->value - prev->value <= 0xff)
+        {
+          guint8 bytes[2];
+
+          bytes[0] = TOKEN_DELTA;
+          bytes[1] = token->value - prev->value;
+          g_byte_array_append (output, bytes, 2);
+        }
+      else if (token->is_num)
+        {
+          type = TOKEN_NUM;
+          g_byte_array_append (output, &type, 1);
+          put_varint (output, token->value);
+        }
+      else
+        {
+          type = TOKEN_STR;
+          g_byte_array_append (output, &type, 1);
+          put_varint (output, token->size);
+          g_byte_array_append (output,
+                               (const guint8*)name + token->start,
+                               token->size);
+        }
+      i++;
+    }
+  {
+    const guint8 type = TOKEN_END;
+
+    g_byte_array_append (output, &type, 1);
+  }
+
+  g_string_assign (codec->prev, name);
+  memcpy (codec->tokens, tokens, n_tokens * sizeof (*tokens));
+  codec->n_tokens = n_tokens;
+}
+
+gssize
+name_codec_decode (NameCodec    *codec,
+                   const guint8 *data,
+                   gsize         size,
+                   GString      *name)
+{
+  gsize pos = 0;
+  guint i   = 0;
+
+  g_string_truncate (name, 0);
+  while (1)
+    {
+      NameToken *prev = codec->tokens + i;
+      guint64    value;
+      guint8     type;
+
+      if (pos >= size)
+        return -1;
+      type = data[pos++];
+      switch (type & TOKEN_TYPE_MASK)
+        {
+          case TOKEN_END:
+              g_string_assign (codec->prev, name->str);
+              codec->n_tokens = tokenize (codec->prev->str,
+                                          codec->prev->len,
+                                          codec->tokens);
+              return pos;
+          case TOKEN_MATCH:
+            {
+              const guint n = type >> TOKEN_TYPE_BITS;
+              NameToken  *last;
+
+              if (n == 0 || i + n > codec->n_tokens)
+                return -1;
+              last = prev + n - 1;
+              g_string_append_len (name,
+                                   codec->prev->str + prev->start,
+                                   last->start + last->size - prev->start);
+              i += n;
+              continue;
+            }
+          case TOKEN_DELTA:
+              if (pos >= size || i >= codec->n_tokens || !prev->is_num)
+                return -1;
+              value = prev->value + data[pos++];
+              g_string_append_printf (name, "%" G_GUINT64_FORMAT, value);
+              break;
+          case TOKEN_NUM:
+              if (!get_varint (data, size, &pos, &value))
+                return -1;
+              g_string_append_printf (name, "%" G_GUINT64_FORMAT, value);
+              break;
+          case TOKEN_STR:
+              if (!get_varint (data, size, &pos, &value) || value > size - pos)
+                return -1;
+              g_string_append_len (name, (const char*)data + pos, value);
+              pos += value;
+              break;
+          default:
+              return -1;
+        }
+      if (++i > NAME_CODEC_MAX_TOKENS)
+        return -1;
+    }
+}
+
+/**
+ * Splits name into runs of digits and runs of other characters.  The last
+ * token takes the rest of the name if there are too many.
+ */
+static guint
+tokenize (const char *name,
+          gsize       size,
+          NameToken  *tokens)
+{
+  gsize pos      = 0;
+  guint n_tokens = 0;
+
+  while (pos < size)
+    {
+      NameToken *token    = tokens + n_tokens++;
+      const int  is_digit = g_ascii_isdigit (name[pos]);
+      gsize      end;
+
+      token->start  = pos;
+      token->is_num = 0;
+      token->value  = 0;
+      if (n_tokens == NAME_CODEC_MAX_TOKENS)
+        end = size;
+      else
+        for (end = pos + 1;
+             end < size && (g_ascii_isdigit (name[end]) != 0) == (is_digit != 0);
+             end++);
+      token->size = end - pos;
+      if (is_digit && n_tokens < NAME_CODEC_MAX_TOKENS &&
+          token->size <= MAX_NUM_DIGITS &&
+          (name[pos] != '0' || token->size == 1))
+        {
+          gsize i;
+
+          token->is_num = 1;
+          for (i = pos; i < end; i++)
+            token->value = token->value * 10 + (name[i] - '0');
+        }
+      pos = end;
+    }
+
+  return n_tokens;
+}
+
+static int
+tokens_equal (const char *name1,
+              NameToken  *token1,
+              const char *name2,
+              NameToken  *token2)
+{
+  return token1->size == token2->size &&
+         memcmp (name1 + token1->start, name2 + token2->start, token1->size) == 0;
+}
+
+static void
+put_varint (GByteArray *output,
+            guint64     value)
+{
+  guint8 bytes[10];
+  guint  n = 0;
+
+  while (value >= 0x80)
+    {
+      bytes[n++] = (value & 0x7f) | 0x80;
+      value    >>= 7;
+    }
+  bytes[n++] = value;
+  g_byte_array_append (output, bytes, n);
+}
+
+static gboolean
+get_varint (const guint8 *data,
+            gsize         size,
+            gsize        *pos,
+            guint64      *value)
+{
+  guint shift = 0;
+
+  *value = 0;
+  while (*pos < size && shift < 64)
+    {
+      const guint8 byte = data[(*pos)++];
+
+      *value |= (guint64)(byte & 0x7f) << shift;
+      if (!(byte & 0x80))
+        return TRUE;
+      shift += 7;
+    }
+
+  return FALSE;
+}
+
+/*************/
+/* NameStore */
+/*************/
+
+NameStore*
+name_store_new (void)
+{
+  NameStore *store;
+
+  store          = g_slice_new (NameStore);
+  store->data    = g_byte_array_new ();
+  store->blocks  = g_array_new (FALSE, FALSE, sizeof (guint64));
+  store->n_names = 0;
+  store->encoder = name_codec_new ();
+  store->decoder = name_codec_new ();
+
+  return store;
+}
+
+void
+name_store_free (NameStore *store)
+{
+  if (store)
+    {
+      g_byte_array_free (store->data, TRUE);
+      g_array_free (store->blocks, TRUE);
+      name_codec_free (store->encoder);
+      name_codec_free (store->decoder);
+      g_slice_free (NameStore, store);
+    }
+}
+
+guint64
+name_store_add (NameStore  *store,
+                const char *name)
+{
+  if (store->n_names % NAME_STORE_BLOCK_SIZE == 0)
+    {
+      const guint64 offset = store->data->len;
+
+      g_array_append_val (store->blocks, offset);
+      name_codec_reset (store->encoder);
+    }
+  name_codec_encode (store->encoder, name, store->data);
+
+  return store->n_names++;
+}
+
+gboolean
+name_store_get (NameStore *store,
+                guint64    id,
+                NameCodec *codec,
+                GString   *name)
+{
+  const guint64 block = id / NAME_STORE_BLOCK_SIZE;
+  guint64       pos;
+  guint64       end;
+  guint         i;
+
+  if (id >= store->n_names)
+    return FALSE;
+  if (codec == NULL)
+    codec = store->decoder;
+
+  pos = g_array_index (store->blocks, guint64, block);
+  if (block + 1 < store->blocks->len)
+    end = g_array_index (store->blocks, guint64, block + 1);
+  else
+    end = store->data->len;
+  name_codec_reset (codec);
+  for (i = 0; i <= id % NAME_STORE_BLOCK_SIZE; i++)
+    {
+      const gssize used = name_codec_decode (codec,
+                                             store->data->data + pos,
+                                             end - pos,
+                                             name);
+
+      if (used < 0)
+        return FALSE;
+      pos += used;
+    }
+
+  return TRUE;
+}
+
+guint64
+name_store_n_names (NameStore *store)
+{
+  return store->n_names;
+}
+
+guint64
+name_store_size (NameStore *store)
+{
+  return store->data->len;
+}
+
+/* vim:ft=c:expandtab:sw=4:ts=4:sts=4:cinoptions={.5s^-2n-2(0:
+ */
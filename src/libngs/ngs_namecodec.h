@@ -0,0 +1,116 @@
+/**
+ *
+ */
+
+#ifndef __NGS_NAMECODEC_H__
+#define __NGS_NAMECODEC_H__
+
+#include <glib.h>
+
+/*************/
+/* NameCodec */
+/*************/
+
+/**
+ * Codec for read names, which mostly differ from the previous read by a few
+ * fields (e.g. the tile, x and y of `@HWI-ST1234:8:1101:1234:5678#0/1').
+ * Names are split into tokens, alternately runs of digits and runs of other
+ * characters, and each token is encoded against the token at the same
+ * position in the previous name: runs of identical tokens take one byte,
+ * numbers that grow by less than 256 take two bytes, and anything else is
+ * stored in full (as a varint for numbers).
+ * Decoding a name needs the previous names since the last reset.
+ */
+
+#define NAME_CODEC_MAX_TOKENS 64
+
+typedef struct _NameToken NameToken;
+
+struct _NameToken
+{
+  guint   start;
+  guint   size;
+  guint64 value;
+  int     is_num;
+};
+
+typedef struct _NameCodec NameCodec;
+
+struct _NameCodec
+{
+  GString   *prev;
+  NameToken  tokens[NAME_CODEC_MAX_TOKENS];
+  guint      n_tokens;
+};
+
+NameCodec* name_codec_new    (void);
+
+void       name_codec_free   (NameCodec     *codec);
+
+/**
+ * Forgets the previous name, so that the next one is encoded in full
+ */
+
+void       name_codec_reset  (NameCodec     *codec);
+
+void       name_codec_encode (NameCodec     *codec,
+                              const char    *name,
+                              GByteArray    *output);
+
+/**
+ * Decodes a name from data into name.  Returns the number of bytes used, or
+ * -1 if data is invalid.
+ */
+
+gssize     name_codec_decode (NameCodec     *codec,
+                              const guint8  *data,
+                              gsize          size,
+                              GString       *name);
+
+/*************/
+/* NameStore */
+/*************/
+
+/**
+ * Encoded names, with the codec reset every NAME_STORE_BLOCK_SIZE names so
+ * that any name can be decoded from the start of its block.
+ */
+
+#define NAME_STORE_BLOCK_SIZE 64
+
+typedef struct _NameStore NameStore;
+
+NameStore* name_store_new     (void);
+
+void       name_store_free    (NameStore     *store);
+
+/**
+ * Returns the number of the name in the store
+ */
+
+guint64    name_store_add     (NameStore     *store,
+                               const char    *name);
+
+/**
+ * Decodes the name with number id into name.  codec is used for decoding,
+ * so that several threads can share the store with a codec each.  If codec
+ * is NULL, the codec of the store is used.
+ */
+
+gboolean   name_store_get     (NameStore     *store,
+                               guint64        id,
+                               NameCodec     *codec,
+                               GString       *name);
+
+guint64    name_store_n_names (NameStore     *store);
+
+/**
+ * Size of the encoded names, in bytes
+ */
+
+guint64    name_store_size    (NameStore     *store);
+
+#endif /* __NGS_NAMECODEC_H__ */
+
+/* vim:ft=c:expandtab:sw=4:ts=4:sts=4:cinoptions={.5s^-2n-2(0:
+ */
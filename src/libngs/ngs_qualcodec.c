@@ -0,0 +1,488 @@
+/* Copyright (C) 2010  Sylvain FORET
+ *
+ * This file is part of libngs.
+ *
+ * libngs is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *                                                                       
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *                                                                       
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ *
+ */
+
+#include <string.h>
+
+#include "ngs_fastq.h"
+#include "ngs_qualcodec.h"
+
+
+/**
+ * rANS (after F. Giesen's coder), with frequencies scaled to TOTAL_FREQ so
+ * that decoding needs no division.  The state is renormalised 16 bits at a
+ * time, so that a symbol needs at most one read.
+ * The stream is cut into N_STATES segments, which start with a string and
+ * are coded with their own state.  They are decoded together, so that the
+ * lookups for one segment overlap those for the others.
+ */
+#define RANS_L        (1U << 15)
+#define SCALE_BITS    12
+#define TOTAL_FREQ    (1U << SCALE_BITS)
+#define N_STATES      4 /* As many as decoders in qual_codec_decode */
+
+#define N_SYMBOLS     128
+
+/* Context: previous quality, clamped, and position bucket */
+#define QUAL_CONTEXTS 64
+#define POS_CONTEXTS  4
+#define POS_SHIFT     5
+#define N_CONTEXTS    (QUAL_CONTEXTS * POS_CONTEXTS)
+
+typedef struct _RansDecoder RansDecoder;
+
+struct _RansDecoder
+{
+  guint32       x;
+  const guint8 *data;
+  const guint8 *end;
+  char         *quals;
+  gsize         size;
+  guint         prev;
+  guint         pos;
+};
+
+struct _QualCodec
+{
+  guint32 counts[N_CONTEXTS][N_SYMBOLS];
+  guint16 freqs[N_CONTEXTS][N_SYMBOLS];
+  guint16 starts[N_CONTEXTS][N_SYMBOLS];
+  guint8  present[N_CONTEXTS];
+
+  /* Symbol of each slot, for decoding */
+  guint8  slots[N_CONTEXTS][TOTAL_FREQ];
+};
+
+static void         normalize_freqs (guint32       *counts,
+                                     guint16       *freqs);
+
+static inline guint context         (guint          prev,
+                                     guint          pos);
+
+static inline int   decode_symbol   (QualCodec     *codec,
+                                     RansDecoder   *dec);
+
+static void         put_size        (GByteArray    *output,
+                                     guint64        size);
+
+static guint64      get_size        (const guint8  *data);
+
+QualCodec*
+qual_codec_new (void)
+{
+  QualCodec *codec;
+
+  codec = g_new0 (QualCodec, 1);
+
+  return codec;
+}
+
+void
+qual_codec_free (QualCodec *codec)
+{
+  g_free (codec);
+}
+
+/**
+ * The frequency tables come first: for each context, the number of symbols
+ * and, for each symbol, the symbol and its frequency (16 bits).  Then, for
+ * each segment, its number of qualities and the size of its rANS data (64
+ * bits each), and the rANS data of the segments.
+ */
+gboolean
+qual_codec_encode (QualCodec  *codec,
+                   const char *quals,
+                   gsize       size,
+                   GByteArray *output)
+{
+  guint8  *contexts;
+  guint8  *buffer;
+  guint8  *end;
+  guint8  *ptr;
+  gsize    bounds[N_STATES + 1];
+  gsize    lengths[N_STATES];
+  gsize    i;
+  guint    prev = 0;
+  guint    pos  = 0;
+  guint    ctx;
+  guint    sym;
+  guint    s;
+
+  for (i = 0; i < size; i++)
+    if ((guchar)quals[i] >= N_SYMBOLS)
+      return FALSE;
+
+  /* Frequencies */
+  memset (codec->counts, 0, sizeof (codec->counts));
+  contexts = g_malloc (size + 1);
+  for (i = 0; i < size; i++)
+    {
+      const guint8 symbol = quals[i];
+
+      contexts[i] = context (prev, pos);
+      codec->counts[contexts[i]][symbol]++;
+      if (symbol == '\0')
+        {
+          prev = 0;
+          pos  = 0;
+        }
+      else
+        {
+          prev = symbol;
+          pos++;
+        }
+    }
+  for (ctx = 0; ctx < N_CONTEXTS; ctx++)
+    {
+      guint8 n_symbols = 0;
+      guint  start     = 0;
+
+      normalize_freqs (codec->counts[ctx], codec->freqs[ctx]);
+      for (sym = 0; sym < N_SYMBOLS; sym++)
+        {
+          codec->starts[ctx][sym] = start;
+          start                  += codec->freqs[ctx][sym];
+          n_symbols              += codec->freqs[ctx][sym] > 0;
+        }
+      g_byte_array_append (output, &n_symbols, 1);
+      for (sym = 0; sym < N_SYMBOLS; sym++)
+        if (codec->freqs[ctx][sym])
+          {
+            guint8 bytes[3];
+
+            bytes[0] = sym;
+            bytes[1] = codec->freqs[ctx][sym] & 0xff;
+            bytes[2] = codec->freqs[ctx][sym] >> 8;
+            g_byte_array_append (output, bytes, 3);
+          }
+    }
+
+  /* Segments of similar sizes, cut after the end of a string */
+  bounds[0]        = 0;
+  bounds[N_STATES] = size;
+  for (s = 1; s < N_STATES; s++)
+    {
+      i = MAX (bounds[s - 1], size / N_STATES * s);
+      while (i > 0 && i < size && quals[i - 1] != '\0')
+        i++;
+      bounds[s] = i;
+    }
+
+  /* Symbols, coded backwards, the last segment first.  A symbol takes at
+   * most 16 bits. */
+  buffer = g_malloc (2 * size + 4 * N_STATES);
+  end    = buffer + 2 * size + 4 * N_STATES;
+  ptr    = end;
+  for (s = N_STATES; s-- > 0;)
+    {
+      guint8 *segment_end = ptr;
+      guint32 x           = RANS_L;
+
+      for (i = bounds[s + 1]; i-- > bounds[s];)
+        {
+          const guint8  symbol = quals[i];
+          const guint32 freq   = codec->freqs[contexts[i]][symbol];
+          const guint32 x_max  = ((RANS_L >> SCALE_BITS) << 16) * freq;
+
+          if (x >= x_max)
+            {
+              ptr   -= 2;
+              ptr[0] = x;
+              ptr[1] = x >> 8;
+              x    >>= 16;
+            }
+          x = ((x / freq) << SCALE_BITS) + (x % freq) + codec->starts[contexts[i]][symbol];
+        }
+      ptr       -= 4;
+      ptr[0]     = x;
+      ptr[1]     = x >> 8;
+      ptr[2]     = x >> 16;
+      ptr[3]     = x >> 24;
+      lengths[s] = segment_end - ptr;
+    }
+  for (s = 0; s < N_STATES; s++)
+    {
+      put_size (output, bounds[s + 1] - bounds[s]);
+      put_size (output, lengths[s]);
+    }
+  g_byte_array_append (output, ptr, end - ptr);
+
+  g_free (buffer);
+  g_free (contexts);
+
+  return TRUE;
+}
+
+gboolean
+qual_codec_decode (QualCodec    *codec,
+                   const guint8 *data,
+                   gsize         data_size,
+                   char         *quals,
+                   gsize         size)
+{
+  const guint8 *end = data + data_size;
+  RansDecoder   decs[N_STATES];
+  RansDecoder   dec0;
+  RansDecoder   dec1;
+  RansDecoder   dec2;
+  RansDecoder   dec3;
+  gsize         n_common;
+  gsize         total;
+  gsize         i;
+  guint         ctx;
+  guint         s;
+
+  /* Frequency tables */
+  memset (codec->freqs, 0, sizeof (codec->freqs));
+  for (ctx = 0; ctx < N_CONTEXTS; ctx++)
+    {
+      guint n_symbols;
+      guint start = 0;
+      guint j;
+
+      if (data >= end)
+        return FALSE;
+      n_symbols = *data++;
+      if (n_symbols > N_SYMBOLS || end - data < 3 * n_symbols)
+        return FALSE;
+      for (j = 0; j < n_symbols; j++, data += 3)
+        {
+          const guint sym  = data[0];
+          const guint freq = data[1] | (data[2] << 8);
+
+          if (sym >= N_SYMBOLS || freq == 0 || start + freq > TOTAL_FREQ)
+            return FALSE;
+          codec->freqs[ctx][sym]  = freq;
+          codec->starts[ctx][sym] = start;
+          memset (codec->slots[ctx] + start, sym, freq);
+          start += freq;
+        }
+      if (n_symbols > 0 && start != TOTAL_FREQ)
+        return FALSE;
+      codec->present[ctx] = n_symbols > 0;
+    }
+
+  /* Segments */
+  if ((gsize)(end - data) < 16 * N_STATES)
+    return FALSE;
+  total    = 0;
+  n_common = size;
+  for (s = 0; s < N_STATES; s++)
+    {
+      const guint64 n_quals = get_size (data + 16 * s);
+      const guint64 length  = get_size (data + 16 * s + 8);
+      const guint8 *start   = s > 0 ? decs[s - 1].end : data + 16 * N_STATES;
+
+      if (n_quals > size - total || length < 4 || length > (guint64)(end - start))
+        return FALSE;
+      decs[s].x     = start[0] | (start[1] << 8) | (start[2] << 16) | ((guint32)start[3] << 24);
+      decs[s].data  = start + 4;
+      decs[s].end   = start + length;
+      decs[s].quals = quals + total;
+      decs[s].size  = n_quals;
+      decs[s].prev  = 0;
+      decs[s].pos   = 0;
+      total        += n_quals;
+      n_common      = MIN (n_common, n_quals);
+    }
+  if (total != size || decs[N_STATES - 1].end != end)
+    return FALSE;
+
+  /* Symbols, from all the segments at once, then from the longer ones.
+   * The decoders are copied to variables of their own, which the compiler
+   * keeps in registers rather than in the array. */
+  dec0 = decs[0];
+  dec1 = decs[1];
+  dec2 = decs[2];
+  dec3 = decs[3];
+  for (i = 0; i < n_common; i++)
+    if (!(decode_symbol (codec, &dec0) &
+          decode_symbol (codec, &dec1) &
+          decode_symbol (codec, &dec2) &
+          decode_symbol (codec, &dec3)))
+      return FALSE;
+  decs[0] = dec0;
+  decs[1] = dec1;
+  decs[2] = dec2;
+  decs[3] = dec3;
+  for (s = 0; s < N_STATES; s++)
+    {
+      for (i = n_common; i < decs[s].size; i++)
+        if (!decode_symbol (codec, decs + s))
+          return FALSE;
+      if (decs[s].x != RANS_L || decs[s].data != decs[s].end)
+        return FALSE;
+    }
+
+  return TRUE;
+}
+
+/**
+ * Decodes the next quality of a segment.  Returns 0 if the data is invalid.
+ */
+static inline int
+decode_symbol (QualCodec   *codec,
+               RansDecoder *dec)
+{
+  const guint ctx = context (dec->prev, dec->pos);
+  guint32     slot;
+  guint8      symbol;
+
+  if (!codec->present[ctx])
+    return 0;
+  slot   = dec->x & (TOTAL_FREQ - 1);
+  symbol = codec->slots[ctx][slot];
+  dec->x = codec->freqs[ctx][symbol] * (dec->x >> SCALE_BITS) + slot - codec->starts[ctx][symbol];
+  if (dec->x < RANS_L)
+    {
+      if (dec->end - dec->data < 2)
+        return 0;
+      dec->x     = (dec->x << 16) | dec->data[0] | (dec->data[1] << 8);
+      dec->data += 2;
+    }
+
+  *dec->quals++ = symbol;
+  if (symbol == '\0')
+    {
+      dec->prev = 0;
+      dec->pos  = 0;
+    }
+  else
+    {
+      dec->prev = symbol;
+      dec->pos++;
+    }
+
+  return 1;
+}
+
+/**
+ * Scales the counts of a context to TOTAL_FREQ, keeping every symbol that
+ * occurs.
+ */
+static void
+normalize_freqs (guint32 *counts,
+                 guint16 *freqs)
+{
+  guint64 total = 0;
+  guint   sum   = 0;
+  guint   i;
+
+  for (i = 0; i < N_SYMBOLS; i++)
+    total += counts[i];
+  for (i = 0; i < N_SYMBOLS; i++)
+    {
+      freqs[i] = 0;
+      if (counts[i])
+        freqs[i] = MAX (1, counts[i] * (guint64)TOTAL_FREQ / total);
+      sum += freqs[i];
+    }
+  /* The rounding errors go to the most frequent symbol */
+  while (total > 0 && sum != TOTAL_FREQ)
+    {
+      guint max = 0;
+
+      for (i = 1; i < N_SYMBOLS; i++)
+        if (freqs[i] > freqs[max])
+          max = i;
+      if (sum < TOTAL_FREQ)
+        {
+          freqs[max] += TOTAL_FREQ - sum;
+          sum         = TOTAL_FREQ;
+        }
+      else
+        {
+          const guint excess = MIN (sum - TOTAL_FREQ, freqs[max] - 1u);
+
+          freqs[max] -= excess;
+          sum        -= excess;
+        }
+    }
+}
+
+static void
+put_size (GByteArray *output,
+          guint64     size)
+{
+  guint8 bytes[8];
+  guint  i;
+
+  for (i = 0; i < 8; i++)
+    bytes[i] = size >> (8 * i);
+  g_byte_array_append (output, bytes, 8);
+}
+
+static guint64
+get_size (const guint8 *data)
+{
+  guint64 size = 0;
+  guint   i;
+
+  for (i = 0; i < 8; i++)
+    size |= (guint64)data[i] << (8 * i);
+
+  return size;
+}
+
+static inline guint
+context (guint prev,
+         guint pos)
+{
+  /* The qualities start at 33 */
+  prev = prev > 32 ? MIN (prev - 32, QUAL_CONTEXTS - 1) : 0;
+  pos  = MIN (pos >> POS_SHIFT, POS_CONTEXTS - 1);
+
+  return prev * POS_CONTEXTS + pos;
+}
+
+void
+qual_bin (char  *qual,
+          gsize  size)
+{
+  gsize i;
+
+  for (i = 0; i < size; i++)
+    {
+      const int q = qual[i] - fastq_qual0;
+      int       bin;
+
+      if (q < 2)
+        continue;
+      else if (q < 10)
+        bin = 6;
+      else if (q < 20)
+        bin = 15;
+      else if (q < 25)
+        bin = 22;
+      else if (q < 30)
+        bin = 27;
+      else if (q < 35)
+        bin = 33;
+      else if (q < 40)
+        bin = 37;
+      else
+        bin = 40;
+      qual[i] = fastq_qual0 + bin;
+    }
+}
+
+/* vim:ft=c:expandtab:sw=4:ts=4:sts=4:cinoptions={.5s^-2n-2(0:
+ */
@@ -0,0 +1,70 @@
+/**
+ *
+ */
+
+#ifndef __NGS_QUALCODEC_H__
+#define __NGS_QUALCODEC_H__
+
+#include <glib.h>
+
+/*************/
+/* QualCodec */
+/*************/
+
+/**
+ * Entropy coder for quality strings: order-1 rANS, with one frequency table
+ * per context made of the previous quality of the read and of the position
+ * in the read.  The tables are computed for each stream and stored at its
+ * start, so that decoding is a table lookup per quality.  The strings are
+ * cut into four segments, coded with states of their own and decoded
+ * together.  Decoding is still slower than inflating, which read stores use
+ * for qualities unless asked otherwise.
+ * A stream is a list of nul-terminated quality strings, as found in the
+ * quality column of a read store.  Only characters below 128 can be
+ * encoded, and a stream can only be decoded as a whole.
+ * A codec holds the tables (about 1.2 MB), and can be reused for any number
+ * of streams, but only by one thread at a time.
+ */
+
+typedef struct _QualCodec QualCodec;
+
+QualCodec* qual_codec_new    (void);
+
+void       qual_codec_free   (QualCodec     *codec);
+
+/**
+ * Encodes the size bytes of quals and appends them to output.  Returns FALSE,
+ * and leaves output unchanged, if quals contains characters that cannot be
+ * encoded.
+ */
+
+gboolean   qual_codec_encode (QualCodec     *codec,
+                              const char    *quals,
+                              gsize          size,
+                              GByteArray    *output);
+
+/**
+ * Decodes size bytes of quality strings from data into quals.  Returns
+ * FALSE if data is invalid.
+ */
+
+gboolean   qual_codec_decode (QualCodec     *codec,
+                              const guint8  *data,
+                              gsize          data_size,
+                              char          *quals,
+                              gsize          size);
+
+/**
+ * Lossy binning of the qualities to the 8 levels used by Illumina: no call
+ * (0 and 1), 2-9, 10-19, 20-24, 25-29, 30-34, 35-39 and 40 and above,
+ * which become 6, 15, 22, 27, 33, 37 and 40.  Qualities are encoded from
+ * fastq_qual0 (see ngs_fastq.h).
+ */
+
+void       qual_bin          (char          *qual,
+                              gsize          size);
+
+#endif /* __NGS_QUALCODEC_H__ */
+
+/* vim:ft=c:expandtab:sw=4:ts=4:sts=4:cinoptions={.5s^-2n-2(0:
+ */
@@ -0,0 +1,936 @@
+/* Copyright (C) 2010  Sylvain FORET
+ *
+ * This file is part of libngs.
+ *
+ * libngs is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *                                                                       
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *                                                                       
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ *
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <zlib.h>
+
+#include "ngs_binseq.h"
+#include "ngs_namecodec.h"
+#include "ngs_qualcodec.h"
+#include "ngs_readstore.h"
+#include "ngs_utils.h"
+#include "ngs_writer.h"
+
+
+static const char read_store_magic[8] = "NGSRS003";
+
+typedef enum
+{
+  COLUMN_SEQ = 0,
+  COLUMN_QUAL,
+  COLUMN_NAME,
+  N_COLUMNS
+}
+Column;
+
+typedef enum
+{
+  CODEC_RAW = 0,
+  CODEC_DEFLATE,
+  CODEC_QUAL
+}
+Codec;
+
+/* Block size, codec, offset, size and raw size of each column */
+#define BLOCK_INFO_SIZE (4 + N_COLUMNS * 25)
+/* Index offset, number of blocks and magic */
+#define TRAILER_SIZE    24
+/* Position, length and character */
+#define EXCEPTION_SIZE  9
+
+typedef struct _ColumnInfo ColumnInfo;
+
+struct _ColumnInfo
+{
+  Codec   codec;
+  guint64 offset;
+  guint64 size;
+  guint64 raw_size;
+};
+
+typedef struct _BlockInfo BlockInfo;
+
+struct _BlockInfo
+{
+  guint      n_reads;
+  ColumnInfo columns[N_COLUMNS];
+};
+
+struct _ReadStoreWriter
+{
+  NgsWriter  *writer;
+  guint64     offset;
+  GArray     *blocks;
+
+  /* Current block */
+  guint       n_reads;
+  guint64     n_bases;
+  GByteArray *lengths;
+  GByteArray *exceptions;
+  guint       n_exceptions;
+  GByteArray *packed;
+  GString    *quals;
+  GByteArray *names;
+  NameCodec  *name_codec;
+  QualCodec  *qual_codec;
+  GByteArray *buffer;
+  GByteArray *encoded;
+  char       *scratch;
+  gsize       scratch_alloc;
+
+  int         use_qual_codec;
+};
+
+struct _ReadStore
+{
+  char      *path;
+  int        fd;
+  BlockInfo *blocks;
+  guint      n_blocks;
+  guint64    n_reads;
+};
+
+struct _ReadStoreIter
+{
+  ReadStore    *store;
+  guint         block;
+  guint         end_block;
+  FastqColumns  columns;
+
+  /* Decoded columns of the current block */
+  char         *data[N_COLUMNS];
+  gsize         alloc[N_COLUMNS];
+  char         *compressed;
+  gsize         compressed_alloc;
+  QualCodec    *qual_codec;
+
+  guint         n_reads;
+  guint         read;
+  const guint8 *lengths;
+  const guint8 *exceptions;
+  guint         n_exceptions;
+  guint         exception;
+  const guint8 *packed;
+  guint64       base;
+  const char   *qual;
+  const char   *name;
+  GString      *names;
+  NameCodec    *name_codec;
+  GString      *name_buffer;
+
+  char         *seq;
+  gsize         seq_alloc;
+  FastqSeq      fastq;
+};
+
+static gboolean flush_block      (ReadStoreWriter  *writer,
+                                  GError          **error);
+
+static gboolean write_column     (ReadStoreWriter  *writer,
+                                  ColumnInfo       *info,
+                                  const char       *data,
+                                  gsize             size,
+                                  Codec             codec,
+                                  GError          **error);
+
+static void     put_uint         (GByteArray       *bytes,
+                                  guint64           value,
+                                  gsize             size);
+
+static guint64  get_uint         (const guint8     *bytes,
+                                  gsize             size);
+
+static gboolean load_block       (ReadStoreIter    *iter,
+                                  GError          **error);
+
+static gboolean load_column      (ReadStoreIter    *iter,
+                                  BlockInfo        *block,
+                                  Column            column,
+                                  GError          **error);
+
+static gboolean read_at          (ReadStore        *store,
+                                  char             *buffer,
+                                  gsize             size,
+                                  guint64           offset,
+                                  GError          **error);
+
+/**********/
+/* Writer */
+/**********/
+
+ReadStoreWriter*
+read_store_writer_new (const char  *path,
+                       GError     **error)
+{
+  ReadStoreWriter *writer;
+  NgsWriter       *output;
+
+  output = ngs_writer_new (path, "w", error);
+  if (output == NULL)
+    return NULL;
+
+  writer             = g_slice_new0 (ReadStoreWriter);
+  writer->writer     = output;
+  writer->blocks     = g_array_new (FALSE, FALSE, sizeof (BlockInfo));
+  writer->lengths    = g_byte_array_new ();
+  writer->exceptions = g_byte_array_new ();
+  writer->packed     = g_byte_array_new ();
+  writer->quals      = g_string_new (NULL);
+  writer->names      = g_byte_array_new ();
+  writer->name_codec = name_codec_new ();
+  writer->qual_codec = qual_codec_new ();
+  writer->buffer     = g_byte_array_new ();
+  writer->encoded    = g_byte_array_new ();
+
+  ngs_writer_write (output, read_store_magic, sizeof (read_store_magic), NULL);
+  writer->offset = sizeof (read_store_magic);
+
+  return writer;
+}
+
+void
+read_store_writer_set_qual_codec (ReadStoreWriter *writer)
+{
+  writer->use_qual_codec = 1;
+}
+
+gboolean
+read_store_writer_add (ReadStoreWriter  *writer,
+                       FastqSeq         *fastq,
+                       GError          **error)
+{
+  const guint size = fastq->size;
+  gsize       packed_size;
+  guint       i;
+
+  if (writer->n_reads == READ_STORE_BLOCK_READS ||
+      (writer->n_reads > 0 && writer->n_bases + size > READ_STORE_BLOCK_BASES))
+    if (!flush_block (writer, error))
+      return FALSE;
+
+  if (writer->scratch_alloc < size)
+    {
+      writer->scratch_alloc = size;
+      writer->scratch       = g_realloc (writer->scratch, size);
+    }
+
+  /* Runs of other characters are kept aside, and packed as A */
+  for (i = 0; i < size; i++)
+    {
+      const char c = fastq->seq[i];
+
+      if (c == 'A' || c == 'C' || c == 'G' || c == 'T')
+        writer->scratch[i] = c;
+      else
+        {
+          guint j;
+
+          for (j = i + 1; j < size && fastq->seq[j] == c; j++);
+          put_uint (writer->exceptions, writer->n_bases + i, 4);
+          put_uint (writer->exceptions, j - i, 4);
+          put_uint (writer->exceptions, (unsigned char)c, 1);
+          writer->n_exceptions++;
+          for (; i < j; i++)
+            writer->scratch[i] = 'A';
+          i--;
+        }
+    }
+  packed_size = (size + NUCS_PER_BYTE - 1) / NUCS_PER_BYTE;
+  g_byte_array_set_size (writer->packed, writer->packed->len + packed_size);
+  char_to_bin_prealloc (writer->packed->data + writer->packed->len - packed_size,
+                        writer->scratch,
+                        size);
+
+  put_uint (writer->lengths, size, 4);
+  g_string_append_len (writer->quals, fastq->qual, size);
+  g_string_append_c (writer->quals, '\0');
+  name_codec_encode (writer->name_codec, fastq->name, writer->names);
+
+  writer->n_reads++;
+  writer->n_bases += size;
+
+  return TRUE;
+}
+
+gboolean
+read_store_writer_close (ReadStoreWriter  *writer,
+                         GError          **error)
+{
+  GError  *tmp_err = NULL;
+  guint64  index_offset;
+  guint    i;
+  int      j;
+
+  if (writer->n_reads > 0)
+    flush_block (writer, &tmp_err);
+
+  /* Index */
+  index_offset = writer->offset;
+  g_byte_array_set_size (writer->buffer, 0);
+  for (i = 0; i < writer->blocks->len; i++)
+    {
+      BlockInfo *block = &g_array_index (writer->blocks, BlockInfo, i);
+
+      put_uint (writer->buffer, block->n_reads, 4);
+      for (j = 0; j < N_COLUMNS; j++)
+        {
+          put_uint (writer->buffer, block->columns[j].codec, 1);
+          put_uint (writer->buffer, block->columns[j].offset, 8);
+          put_uint (writer->buffer, block->columns[j].size, 8);
+          put_uint (writer->buffer, block->columns[j].raw_size, 8);
+        }
+    }
+  put_uint (writer->buffer, index_offset, 8);
+  put_uint (writer->buffer, writer->blocks->len, 8);
+  g_byte_array_append (writer->buffer,
+                       (const guint8*)read_store_magic,
+                       sizeof (read_store_magic));
+  ngs_writer_write (writer->writer,
+                    (const char*)writer->buffer->data,
+                    writer->buffer->len,
+                    NULL);
+
+  if (!ngs_writer_close (writer->writer, tmp_err ? NULL : &tmp_err) && tmp_err == NULL)
+    g_set_error (&tmp_err,
+                 NGS_ERROR,
+                 NGS_IO_ERROR,
+                 "Error while writing the read store");
+
+  g_array_free (writer->blocks, TRUE);
+  g_byte_array_free (writer->lengths, TRUE);
+  g_byte_array_free (writer->exceptions, TRUE);
+  g_byte_array_free (writer->packed, TRUE);
+  g_string_free (writer->quals, TRUE);
+  g_byte_array_free (writer->names, TRUE);
+  name_codec_free (writer->name_codec);
+  qual_codec_free (writer->qual_codec);
+  g_byte_array_free (writer->buffer, TRUE);
+  g_byte_array_free (writer->encoded, TRUE);
+  g_free (writer->scratch);
+  g_slice_free (ReadStoreWriter, writer);
+
+  if (tmp_err)
+    {
+      g_propagate_error (error, tmp_err);
+      return FALSE;
+    }
+
+  return TRUE;
+}
+
+static gboolean
+flush_block (ReadStoreWriter  *writer,
+             GError          **error)
+{
+  BlockInfo block;
+
+  block.n_reads = writer->n_reads;
+
+  /* Sequences */
+  g_byte_array_set_size (writer->buffer, 0);
+  g_byte_array_append (writer->buffer, writer->lengths->data, writer->lengths->len);
+  put_uint (writer->buffer, writer->n_exceptions, 4);
+  g_byte_array_append (writer->buffer, writer->exceptions->data, writer->exceptions->len);
+  g_byte_array_append (writer->buffer, writer->packed->data, writer->packed->len);
+  if (!write_column (writer,
+                     block.columns + COLUMN_SEQ,
+                     (const char*)writer->buffer->data,
+                     writer->buffer->len,
+                     CODEC_DEFLATE,
+                     error) ||
+      !write_column (writer,
+                     block.columns + COLUMN_QUAL,
+                     writer->quals->str,
+                     writer->quals->len,
+                     writer->use_qual_codec ? CODEC_QUAL : CODEC_DEFLATE,
+                     error) ||
+      !write_column (writer,
+                     block.columns + COLUMN_NAME,
+                     (const char*)writer->names->data,
+                     writer->names->len,
+                     CODEC_DEFLATE,
+                     error))
+    return FALSE;
+  g_array_append_val (writer->blocks, block);
+
+  writer->n_reads      = 0;
+  writer->n_bases      = 0;
+  writer->n_exceptions = 0;
+  g_byte_array_set_size (writer->lengths, 0);
+  g_byte_array_set_size (writer->exceptions, 0);
+  g_byte_array_set_size (writer->packed, 0);
+  g_string_truncate (writer->quals, 0);
+  g_byte_array_set_size (writer->names, 0);
+  name_codec_reset (writer->name_codec);
+
+  return TRUE;
+}
+
+/**
+ * Columns are kept raw unless their codec saves at least an eighth of their
+ * size, which spares readers the inflating of packed bases.  Qualities that
+ * the quality codec cannot encode are deflated.
+ */
+static gboolean
+write_column (ReadStoreWriter  *writer,
+              ColumnInfo       *info,
+              const char       *data,
+              gsize             size,
+              Codec             codec,
+              GError          **error)
+{
+  unsigned char *compressed = NULL;
+  uLongf         compressed_size;
+
+  info->offset   = writer->offset;
+  info->raw_size = size;
+  if (codec == CODEC_QUAL)
+    {
+      g_byte_array_set_size (writer->encoded, 0);
+      if (!qual_codec_encode (writer->qual_codec, data, size, writer->encoded))
+        codec = CODEC_DEFLATE;
+      else if (writer->encoded->len < size - size / 8)
+        {
+          data = (const char*)writer->encoded->data;
+          size = writer->encoded->len;
+        }
+      else
+        codec = CODEC_RAW;
+    }
+  info->codec = codec;
+  if (codec == CODEC_DEFLATE)
+    {
+      compressed_size = compressBound (size);
+      compressed      = g_malloc (compressed_size);
+      if (compress2 (compressed,
+                     &compressed_size,
+                     (const Bytef*)data,
+                     size,
+                     Z_DEFAULT_COMPRESSION) != Z_OK)
+        {
+          g_set_error (error,
+                       NGS_ERROR,
+                       NGS_UNKNOWN_ERROR,
+                       "Could not compress a read store column");
+          g_free (compressed);
+          return FALSE;
+        }
+      if (compressed_size < size - size / 8)
+        {
+          data = (const char*)compressed;
+          size = compressed_size;
+        }
+      else
+        info->codec = CODEC_RAW;
+    }
+  info->size      = size;
+  writer->offset += size;
+  ngs_writer_write (writer->writer, data, size, NULL);
+  g_free (compressed);
+
+  return ngs_writer_check (writer->writer, error);
+}
+
+static void
+put_uint (GByteArray *bytes,
+          guint64     value,
+          gsize       size)
+{
+  guint8 buffer[8];
+  gsize  i;
+
+  /* Little endian */
+  for (i = 0; i < size; i++)
+    buffer[i] = (value >> (8 * i)) & 0xff;
+  g_byte_array_append (bytes, buffer, size);
+}
+
+static guint64
+get_uint (const guint8 *bytes,
+          gsize         size)
+{
+  guint64 value = 0;
+  gsize   i;
+
+  for (i = 0; i < size; i++)
+    value |= (guint64)bytes[i] << (8 * i);
+
+  return value;
+}
+
+/**********/
+/* Reader */
+/**********/
+
+gboolean
+read_store_check (const char *path)
+{
+  char magic[sizeof (read_store_magic)];
+  int  fd;
+  int  ret = 0;
+
+  if (path[0] == '-' && path[1] == '\0')
+    return FALSE;
+  fd = open (path, O_RDONLY);
+  if (fd < 0)
+    return FALSE;
+  if (pread (fd, magic, sizeof (magic), 0) == sizeof (magic))
+    ret = memcmp (magic, read_store_magic, sizeof (magic)) == 0;
+  close (fd);
+
+  return ret;
+}
+
+ReadStore*
+read_store_open (const char  *path,
+                 GError     **error)
+{
+  ReadStore *store;
+  guint8     trailer[TRAILER_SIZE];
+  guint8    *index;
+  guint64    file_size;
+  guint64    index_offset;
+  guint64    n_blocks;
+  guint      i;
+  int        j;
+  int        fd;
+
+  fd = open (path, O_RDONLY);
+  if (fd < 0)
+    {
+      g_set_error (error,
+                   NGS_ERROR,
+                   NGS_IO_ERROR,
+                   "Could not open input file `%s'",
+                   path);
+      return NULL;
+    }
+  store       = g_slice_new0 (ReadStore);
+  store->path = g_strdup (path);
+  store->fd   = fd;
+
+  file_size = lseek (fd, 0, SEEK_END);
+  if (file_size < sizeof (read_store_magic) + TRAILER_SIZE ||
+      !read_at (store, (char*)trailer, TRAILER_SIZE, file_size - TRAILER_SIZE, NULL) ||
+      memcmp (trailer + 16, read_store_magic, sizeof (read_store_magic)) != 0)
+    goto error;
+  index_offset = get_uint (trailer, 8);
+  n_blocks     = get_uint (trailer + 8, 8);
+  if (index_offset > file_size - TRAILER_SIZE ||
+      n_blocks != (file_size - TRAILER_SIZE - index_offset) / BLOCK_INFO_SIZE)
+    goto error;
+
+  index         = g_malloc (n_blocks * BLOCK_INFO_SIZE + 1);
+  store->blocks = g_new0 (BlockInfo, n_blocks);
+  if (!read_at (store, (char*)index, n_blocks * BLOCK_INFO_SIZE, index_offset, NULL))
+    {
+      g_free (index);
+      goto error;
+    }
+  for (i = 0; i < n_blocks; i++)
+    {
+      const guint8 *info  = index + i * BLOCK_INFO_SIZE;
+      BlockInfo    *block = store->blocks + i;
+
+      block->n_reads  = get_uint (info, 4);
+      store->n_reads += block->n_reads;
+      for (j = 0; j < N_COLUMNS; j++)
+        {
+          ColumnInfo *column = block->columns + j;
+
+          column->codec    = info[4 + j * 25];
+          column->offset   = get_uint (info + 5 + j * 25, 8);
+          column->size     = get_uint (info + 13 + j * 25, 8);
+          column->raw_size = get_uint (info + 21 + j * 25, 8);
+          if (column->codec > CODEC_QUAL ||
+              column->offset + column->size > index_offset)
+            {
+              g_free (index);
+              goto error;
+            }
+        }
+    }
+  store->n_blocks = n_blocks;
+  g_free (index);
+
+  return store;
+
+error:
+  g_set_error (error,
+               NGS_ERROR,
+               NGS_PARSE_ERROR,
+               "Invalid read store `%s'",
+               path);
+  read_store_close (store);
+
+  return NULL;
+}
+
+guint
+read_store_n_blocks (ReadStore *store)
+{
+  return store->n_blocks;
+}
+
+guint64
+read_store_n_reads (ReadStore *store)
+{
+  return store->n_reads;
+}
+
+void
+read_store_close (ReadStore *store)
+{
+  if (store)
+    {
+      close (store->fd);
+      g_free (store->blocks);
+      g_free (store->path);
+      g_slice_free (ReadStore, store);
+    }
+}
+
+ReadStoreIter*
+read_store_iter_new (ReadStore    *store,
+                     guint         first_block,
+                     guint         end_block,
+                     FastqColumns  columns)
+{
+  ReadStoreIter *iter;
+
+  iter            = g_slice_new0 (ReadStoreIter);
+  iter->store     = store;
+  iter->block     = first_block;
+  iter->end_block = MIN (end_block, store->n_blocks);
+  iter->columns   = columns;
+  if (columns & FASTQ_COLUMN_NAME)
+    {
+      iter->names       = g_string_new (NULL);
+      iter->name_codec  = name_codec_new ();
+      iter->name_buffer = g_string_new (NULL);
+    }
+
+  return iter;
+}
+
+FastqSeq*
+read_store_iter_next (ReadStoreIter  *iter,
+                      GError        **error)
+{
+  guint size;
+
+  while (iter->read == iter->n_reads)
+    {
+      if (iter->block >= iter->end_block)
+        return NULL;
+      if (!load_block (iter, error))
+        {
+          iter->block = iter->end_block;
+          iter->read  = iter->n_reads;
+          return NULL;
+        }
+    }
+
+  if (iter->columns & FASTQ_COLUMN_SEQ)
+    {
+      size = get_uint (iter->lengths + 4 * iter->read, 4);
+      if (iter->seq_alloc < size + 1)
+        {
+          iter->seq_alloc = size + 1;
+          iter->seq       = g_realloc (iter->seq, iter->seq_alloc);
+        }
+      bin_to_char_prealloc (iter->seq, iter->packed, size);
+      iter->seq[size] = '\0';
+      while (iter->exception < iter->n_exceptions)
+        {
+          const guint8 *exception = iter->exceptions + iter->exception * EXCEPTION_SIZE;
+          const guint64 pos       = get_uint (exception, 4);
+
+          if (pos >= iter->base + size)
+            break;
+          memset (iter->seq + pos - iter->base,
+                  exception[8],
+                  get_uint (exception + 4, 4));
+          iter->exception++;
+        }
+      iter->fastq.seq  = iter->seq;
+      iter->packed    += (size + NUCS_PER_BYTE - 1) / NUCS_PER_BYTE;
+      iter->base      += size;
+    }
+  else
+    {
+      size            = strlen (iter->qual);
+      iter->fastq.seq = "";
+    }
+
+  iter->fastq.size = size;
+  iter->fastq.qual = (char*)iter->qual;
+  iter->fastq.name = (char*)iter->name;
+  if (iter->columns & FASTQ_COLUMN_QUAL)
+    iter->qual += size + 1;
+  if (iter->columns & FASTQ_COLUMN_NAME)
+    iter->name += strlen (iter->name) + 1;
+  iter->read++;
+
+  return &iter->fastq;
+}
+
+void
+read_store_iter_free (ReadStoreIter *iter)
+{
+  if (iter)
+    {
+      int i;
+
+      for (i = 0; i < N_COLUMNS; i++)
+        g_free (iter->data[i]);
+      g_free (iter->compressed);
+      qual_codec_free (iter->qual_codec);
+      g_free (iter->seq);
+      if (iter->names)
+        {
+          g_string_free (iter->names, TRUE);
+          g_string_free (iter->name_buffer, TRUE);
+          name_codec_free (iter->name_codec);
+        }
+      g_slice_free (ReadStoreIter, iter);
+    }
+}
+
+void
+iter_read_store (const char    *path,
+                 FastqColumns   columns,
+                 FastqIterFunc  func,
+                 void          *data,
+                 GError       **error)
+{
+  ReadStore     *store;
+  ReadStoreIter *iter;
+  FastqSeq      *fastq;
+
+  store = read_store_open (path, error);
+  if (store == NULL)
+    return;
+  iter = read_store_iter_new (store, 0, store->n_blocks, columns);
+  while ((fastq = read_store_iter_next (iter, error)) != NULL)
+    if (!func (fastq, data))
+      break;
+  read_store_iter_free (iter);
+  read_store_close (store);
+}
+
+static gboolean
+load_block (ReadStoreIter  *iter,
+            GError        **error)
+{
+  BlockInfo    *block = iter->store->blocks + iter->block;
+  const guint8 *end;
+  guint64       size;
+  guint         i;
+
+  if (iter->columns & FASTQ_COLUMN_SEQ)
+    {
+      if (!load_column (iter, block, COLUMN_SEQ, error))
+        return FALSE;
+      size = block->columns[COLUMN_SEQ].raw_size;
+      end  = (guint8*)iter->data[COLUMN_SEQ] + size;
+
+      iter->lengths = (guint8*)iter->data[COLUMN_SEQ];
+      if (size < 4 * (guint64)block->n_reads + 4)
+        goto error;
+      iter->n_exceptions = get_uint (iter->lengths + 4 * block->n_reads, 4);
+      iter->exceptions   = iter->lengths + 4 * block->n_reads + 4;
+      iter->packed       = iter->exceptions + iter->n_exceptions * EXCEPTION_SIZE;
+      if (iter->packed > end)
+        goto error;
+    }
+
+  iter->qual = "";
+  iter->name = "";
+  if (iter->columns & FASTQ_COLUMN_QUAL)
+    {
+      if (!load_column (iter, block, COLUMN_QUAL, error))
+        return FALSE;
+      iter->qual = iter->data[COLUMN_QUAL];
+    }
+  if (iter->columns & FASTQ_COLUMN_NAME)
+    {
+      const guint8 *names;
+      gsize         pos = 0;
+
+      if (!load_column (iter, block, COLUMN_NAME, error))
+        return FALSE;
+      names = (guint8*)iter->data[COLUMN_NAME];
+      size  = block->columns[COLUMN_NAME].raw_size;
+
+      /* Decoded all at once, as nul-terminated strings */
+      g_string_truncate (iter->names, 0);
+      name_codec_reset (iter->name_codec);
+      for (i = 0; i < block->n_reads; i++)
+        {
+          const gssize used = name_codec_decode (iter->name_codec,
+                                                 names + pos,
+                                                 size - pos,
+                                                 iter->name_buffer);
+
+          if (used < 0)
+            goto error;
+          pos += used;
+          g_string_append_len (iter->names,
+                               iter->name_buffer->str,
+                               iter->name_buffer->len + 1);
+        }
+      iter->name = iter->names->str;
+    }
+
+  iter->n_reads   = block->n_reads;
+  iter->read      = 0;
+  iter->exception = 0;
+  iter->base      = 0;
+  iter->block++;
+
+  return TRUE;
+
+error:
+  g_set_error (error,
+               NGS_ERROR,
+               NGS_PARSE_ERROR,
+               "Invalid block in read store `%s'",
+               iter->store->path);
+
+  return FALSE;
+}
+
+/**
+ * The decoded columns are followed by a nul byte, so that the strings of a
+ * truncated column cannot run past the buffer.
+ */
+static gboolean
+load_column (ReadStoreIter  *iter,
+             BlockInfo      *block,
+             Column          column,
+             GError        **error)
+{
+  ColumnInfo *info = block->columns + column;
+  char       *dest;
+
+  if (iter->alloc[column] < info->raw_size + 1)
+    {
+      iter->alloc[column] = info->raw_size + 1;
+      iter->data[column]  = g_realloc (iter->data[column], iter->alloc[column]);
+    }
+  dest                 = iter->data[column];
+  dest[info->raw_size] = '\0';
+
+  if (info->codec == CODEC_RAW)
+    {
+      if (info->size != info->raw_size)
+        goto error;
+      return read_at (iter->store, dest, info->size, info->offset, error);
+    }
+
+  if (iter->compressed_alloc < info->size)
+    {
+      iter->compressed_alloc = info->size;
+      iter->compressed       = g_realloc (iter->compressed, iter->compressed_alloc);
+    }
+  if (!read_at (iter->store, iter->compressed, info->size, info->offset, error))
+    return FALSE;
+  if (info->codec == CODEC_QUAL)
+    {
+      if (iter->qual_codec == NULL)
+        iter->qual_codec = qual_codec_new ();
+      if (!qual_codec_decode (iter->qual_codec,
+                              (const guint8*)iter->compressed,
+                              info->size,
+                              dest,
+                              info->raw_size))
+        goto error;
+    }
+  else
+    {
+      uLongf raw_size = info->raw_size;
+
+      if (uncompress ((Bytef*)dest,
+                      &raw_size,
+                      (const Bytef*)iter->compressed,
+                      info->size) != Z_OK ||
+          raw_size != info->raw_size)
+        goto error;
+    }
+
+  return TRUE;
+
+error:
+  g_set_error (error,
+               NGS_ERROR,
+               NGS_PARSE_ERROR,
+               "Invalid block in read store `%s'",
+               iter->store->path);
+
+  return FALSE;
+}
+
+static gboolean
+read_at (ReadStore  *store,
+         char       *buffer,
+         gsize       size,
+         guint64     offset,
+         GError    **error)
+{
+  while (size > 0)
+    {
+      const gssize bytes_read = pread (store->fd, buffer, size, offset);
+
+      if (bytes_read < 0 && errno == EINTR)
+        continue;
+      if (bytes_read <= 0)
+        {
+          if (bytes_read < 0)
+            g_set_error (error,
+                         NGS_ERROR,
+                         NGS_IO_ERROR,
+                         "Error while reading `%s': %s",
+                         store->path,
+                         g_strerror (errno));
+          else
+            g_set_error (error,
+                         NGS_ERROR,
+                         NGS_IO_ERROR,
+                         "Unexpected end of file `%s'",
+                         store->path);
+          return FALSE;
+        }
+      buffer += bytes_read;
+      size   -= bytes_read;
+      offset += bytes_read;
+    }
+
+  return TRUE;
+}
+
+/* vim:ft=c:expandtab:sw=4:ts=4:sts=4:cinoptions={.5s^-2n-2(0:
+ */
@@ -0,0 +1,119 @@
+/**
+ *
+ */
+
+#ifndef __NGS_READSTORE_H__
+#define __NGS_READSTORE_H__
+
+#include <glib.h>
+
+#include "ngs_fastq.h"
+
+/*************/
+/* ReadStore */
+/*************/
+
+/**
+ * Packed read store: a binary container for reads which are parsed once
+ * and read back many times.
+ * The reads are stored in blocks of at most READ_STORE_BLOCK_READS reads
+ * (and READ_STORE_BLOCK_BASES bases).  The sequences, qualities and names
+ * of a block are stored in separate columns, located by an index at the end
+ * of the file, so that readers only read and decode the columns they need:
+ *  - sequences: the lengths of the reads, the runs of characters other than
+ *    `A', `C', `G' and `T' (N, ambiguity codes, lower case letters), and the
+ *    bases packed as in BinSeq, each read starting on a byte boundary.
+ *  - qualities: nul-terminated, deflated, or encoded with a QualCodec (see
+ *    ngs_qualcodec.h), which is smaller but slower to decode.
+ *  - names: encoded with a NameCodec (see ngs_namecodec.h), deflated.
+ * Stores are recognised by iter_fastq, iter_fastq_ranges and FastqIter,
+ * which read them instead of parsing a fastq file.
+ */
+
+#define READ_STORE_SUFFIX      ".nrs"
+#define READ_STORE_BLOCK_READS 65536
+#define READ_STORE_BLOCK_BASES (64 * 1024 * 1024)
+
+/**
+ * Writing
+ */
+
+typedef struct _ReadStoreWriter ReadStoreWriter;
+
+ReadStoreWriter* read_store_writer_new   (const char       *path,
+                                          GError          **error);
+
+/**
+ * Encodes the qualities with a QualCodec instead of deflating them.
+ */
+
+void             read_store_writer_set_qual_codec
+                                         (ReadStoreWriter  *writer);
+
+gboolean         read_store_writer_add   (ReadStoreWriter  *writer,
+                                          FastqSeq         *fastq,
+                                          GError          **error);
+
+/**
+ * Writes the last block and the index, and frees the writer.
+ */
+
+gboolean         read_store_writer_close (ReadStoreWriter  *writer,
+                                          GError          **error);
+
+/**
+ * Reading
+ */
+
+typedef struct _ReadStore ReadStore;
+
+/**
+ * Returns TRUE if path is a read store.
+ */
+
+gboolean         read_store_check        (const char       *path);
+
+ReadStore*       read_store_open         (const char       *path,
+                                          GError          **error);
+
+guint            read_store_n_blocks     (ReadStore        *store);
+
+guint64          read_store_n_reads      (ReadStore        *store);
+
+void             read_store_close        (ReadStore        *store);
+
+/**
+ * Iterates over the reads of blocks [first_block, end_block).  Only the
+ * columns in columns are read, the fields of the others are empty strings
+ * (the size is then taken from the qualities, or is 0).
+ * The iterators of a store only use pread, and can be used by different
+ * threads.
+ */
+
+typedef struct _ReadStoreIter ReadStoreIter;
+
+ReadStoreIter*   read_store_iter_new     (ReadStore        *store,
+                                          guint             first_block,
+                                          guint             end_block,
+                                          FastqColumns      columns);
+
+/**
+ * Returns NULL at the end of the blocks, or on errors.
+ * The record is borrowed, and only valid until the next call.
+ */
+
+FastqSeq*        read_store_iter_next    (ReadStoreIter    *iter,
+                                          GError          **error);
+
+void             read_store_iter_free    (ReadStoreIter    *iter);
+
+void             iter_read_store         (const char       *path,
+                                          FastqColumns      columns,
+                                          FastqIterFunc     func,
+                                          void             *data,
+                                          GError          **error);
+
+#endif /* __NGS_READSTORE_H__ */
+
+/* vim:ft=c:expandtab:sw=4:ts=4:sts=4:cinoptions={.5s^-2n-2(0:
+ */
@@ -20,20 +20,125 @@
  *
  */
 
+#include <fcntl.h>
+#include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
+#include "ngs_binseq.h"
 #include "ngs_fasta.h"
 #include "ngs_fastq.h"
+#include "ngs_fqindex.h"
+#include "ngs_mphf.h"
 #include "ngs_seq_db.h"
 #include "ngs_utils.h"
+#include "ngs_writer.h"
 
+#define SEQ_DB_HEADER_SIZE 40
+#define SEQ_DB_ELEM_SIZE   24
+#define SEQ_DB_ALIGNMENT   4096
+
+#define SEQ_DB_READS_MIN   (1024 * 1024)
+#define SEQ_DB_WINDOW_SIZE (4 * 1024 * 1024)
+
+static const char seq_db_magic[8] = "NGSSDB01";
+
+static const guchar seq_db_qual_levels[16] =
+{
+  0, 2, 5, 8, 10, 12, 15, 18, 20, 22, 25, 28, 30, 33, 35, 40
+};
+
+/* The reads of a part of a fastq file, loaded by one thread */
+typedef struct _SeqDBPart SeqDBPart;
+
+struct _SeqDBPart
+{
+  SeqDB   *db;
+  GString *names;
+};
+
+typedef struct _SeqDBFileJob SeqDBFileJob;
+
+struct _SeqDBFileJob
+{
+  const char *path;
+  SeqDBPart  *parts;
+  int         n_parts;
+  int         done;
+  GError     *error;
+};
+
+typedef struct _SeqDBLoader SeqDBLoader;
+
+struct _SeqDBLoader
+{
+  SeqDB         *db;
+  SeqDBFileJob  *jobs;
+  int            n_jobs;
+  volatile gint  next_job;
+
+  /* The files are appended to db in order, as soon as they are loaded */
+  GMutex         lock;
+  int            next_append;
+  int            failed;
+};
 
 static int  iter_load_db_fastq (FastqSeq *fastq,
                                 SeqDB    *db);
 
-static int  iter_load_db_fasta (FastaSeq *fasta,
-                                SeqDB    *db);
+static int  iter_load_part     (FastqSeq  *fastq,
+                                SeqDBPart *part);
+
+static void load_read          (SeqDB    *db,
+                                FastqSeq *fastq);
+
+static void reserve_reads      (SeqDB    *db,
+                                guint64   size);
+
+static void load_file_parts    (SeqDB    *db,
+                                char    **paths,
+                                int       n_threads,
+                                GError  **error);
+
+static gpointer load_files_thread (SeqDBLoader *loader);
+
+static void append_loaded_files (SeqDBLoader *loader);
+
+static void append_part        (SeqDB     *db,
+                                SeqDBPart *part);
 
+static void trim_reads         (SeqDB    *db);
+
+static void load_db_window     (SeqDB         *db,
+                                FastaWindow   *window,
+                                SeqDBElement **elem);
+
+static void pack_read          (SeqDB    *db,
+                                FastqSeq *fastq,
+                                guint64   offset);
+
+static guint32 read_fingerprint (const char *name);
+
+static int  compare_hashes     (const void *a,
+                                const void *b);
+
+static int  compare_offsets    (const void *a,
+                                const void *b);
+
+static void write_uint64       (NgsWriter  *writer,
+                                guint64     value);
+
+static guint64 read_uint64     (const char *data);
+
+static int  check_not_mapped   (SeqDB      *db,
+                                const char *path,
+                                GError    **error);
+
+static int  check_not_indexed  (SeqDB      *db,
+                                const char *path,
+                                GError    **error);
 SeqDBElement*
 seq_db_element_new (void)
 {
@@ -61,17 +166,34 @@ seq_db_new (void)
 {
   SeqDB *db;
 
-  db             = g_slice_new (SeqDB);
-  db->index      = g_hash_table_new_full (g_str_hash,
-                                          g_str_equal,
-                                          NULL,
-                                          (GDestroyNotify)seq_db_element_free);
-  db->seqs       = NULL;
-  db->quals      = NULL;
-  db->alloc_size = 0;
-  db->total_size = 0;
-  db->alloc_inc  = DEFAULT_ALLOC_INC;
-  db->n_seqs     = 0;
+  db              = g_slice_new (SeqDB);
+  db->index       = g_hash_table_new_full (g_str_hash,
+                                           g_str_equal,
+                                           NULL,
+                                           (GDestroyNotify)seq_db_element_free);
+  db->reads       = g_array_new (FALSE, FALSE, sizeof (SeqDBElement));
+  db->read_hashes = g_array_new (FALSE, FALSE, sizeof (SeqDBHash));
+  db->names       = name_store_new ();
+  db->name_buffer = g_string_new (NULL);
+  db->read_mphf   = NULL;
+  db->read_ids    = NULL;
+  db->read_fingerprints = NULL;
+  db->n_read_keys = 0;
+  db->fasta_index = NULL;
+  db->fasta_fd    = -1;
+  db->map         = NULL;
+  db->map_size    = 0;
+  db->elems       = NULL;
+  db->seqs        = NULL;
+  db->quals       = NULL;
+  db->packed      = 0;
+  db->packed_seqs = NULL;
+  db->packed_quals = NULL;
+  db->runs        = NULL;
+  db->alloc_size  = 0;
+  db->total_size  = 0;
+  db->alloc_inc   = DEFAULT_ALLOC_INC;
+  db->n_seqs      = 0;
 
   return db;
 }
@@ -84,10 +206,27 @@ seq_db_free (SeqDB *db)
     {
       if (db->index)
         g_hash_table_destroy (db->index);
-      if (db->seqs)
+      g_array_free (db->reads, TRUE);
+      g_array_free (db->read_hashes, TRUE);
+      name_store_free (db->names);
+      g_string_free (db->name_buffer, TRUE);
+      mphf_free (db->read_mphf);
+      g_free (db->read_ids);
+      g_free (db->read_fingerprints);
+      fasta_index_free (db->fasta_index);
+      if (db->fasta_fd >= 0)
+        close (db->fasta_fd);
+      if (db->map)
+        munmap (db->map, db->map_size);
+      else if (db->seqs)
         g_free (db->seqs);
+      g_free (db->elems);
       if (db->quals)
         g_free (db->quals);
+      g_free (db->packed_seqs);
+      g_free (db->packed_quals);
+      if (db->runs)
+        g_array_free (db->runs, TRUE);
       g_slice_free (SeqDB, db);
     }
 }
@@ -97,10 +236,20 @@ seq_db_load_fasta (SeqDB       *db,
                    const char  *path,
                    GError     **error)
 {
-  iter_fasta (path,
-              (FastaIterFunc)iter_load_db_fasta,
-              db,
-              error);
+  FastaWindowIter *iter;
+  FastaWindow     *window;
+  SeqDBElement    *elem = NULL;
+
+  if (!check_not_mapped (db, path, error))
+    return;
+  /* The sequences are copied window by window into seqs, so that long
+   * sequences are not held twice in memory */
+  iter = fasta_window_iter_new (path, SEQ_DB_WINDOW_SIZE, 0, error);
+  if (iter == NULL)
+    return;
+  while ((window = fasta_window_iter_next (iter, error)) != NULL)
+    load_db_window (db, window, &elem);
+  fasta_window_iter_free (iter);
 }
 
 void
@@ -108,70 +257,1119 @@ seq_db_load_fastq (SeqDB       *db,
                    const char  *path,
                    GError     **error)
 {
+  if (!check_not_mapped (db, path, error) ||
+      !check_not_indexed (db, path, error))
+    return;
   iter_fastq (path,
               (FastqIterFunc)iter_load_db_fastq,
               db,
               error);
+  qsort (db->read_hashes->data,
+         db->read_hashes->len,
+         sizeof (SeqDBHash),
+         compare_hashes);
+}
+
+void
+seq_db_set_packed (SeqDB *db)
+{
+  int i;
+  int code;
+
+  if (db->packed)
+    return;
+  db->packed = 1;
+  db->runs   = g_array_new (FALSE, FALSE, sizeof (SeqDBRun));
+  for (i = 0, code = 0; i < 128; i++)
+    {
+      while (code < 15 && i - fastq_qual0 >= seq_db_qual_levels[code + 1])
+        code++;
+      db->qual_codes[i] = code;
+    }
+  for (code = 0; code < 16; code++)
+    db->qual_letters[code] = fastq_qual0 + seq_db_qual_levels[code];
+}
+
+void
+seq_db_get_window (SeqDB        *db,
+                   SeqDBElement *elem,
+                   guint64       start,
+                   guint64       size,
+                   char         *seq,
+                   char         *qual)
+{
+  const guint64 from = elem->offset + start;
+  const guint64 to   = from + size;
+  guint64       pos;
+  guint         low;
+  guint         high;
+
+  if (!db->packed || elem->name)
+    {
+      memcpy (seq, db->seqs + from, size);
+      if (qual && db->quals)
+        memcpy (qual, db->quals + from, size);
+      return;
+    }
+
+  /* Bases */
+  for (pos = from; pos < to && pos % NUCS_PER_BYTE; pos++)
+    *seq++ = bin_to_char_table[(db->packed_seqs[pos / NUCS_PER_BYTE] >> (pos % NUCS_PER_BYTE) * BITS_PER_NUC) & 3];
+  if (pos < to)
+    bin_to_char_prealloc (seq, db->packed_seqs + pos / NUCS_PER_BYTE, to - pos);
+  seq -= pos - from;
+
+  /* Runs overlapping the window: the first run ending after from is
+   * found by binary search */
+  low  = 0;
+  high = db->runs->len;
+  while (low < high)
+    {
+      const guint     mid = (low + high) / 2;
+      const SeqDBRun *run = &g_array_index (db->runs, SeqDBRun, mid);
+
+      if (run->start + run->size <= from)
+        low = mid + 1;
+      else
+        high = mid;
+    }
+  for (; low < db->runs->len; low++)
+    {
+      const SeqDBRun *run = &g_array_index (db->runs, SeqDBRun, low);
+      const guint64   a   = MAX (run->start, from);
+      const guint64   b   = MIN (run->start + run->size, to);
+
+      if (run->start >= to)
+        break;
+      memset (seq + (a - from), run->letter, b - a);
+    }
+
+  /* Qualities */
+  if (qual)
+    for (pos = from; pos < to; pos++)
+      *qual++ = db->qual_letters[(db->packed_quals[pos / 2] >> (pos % 2) * 4) & 15];
+}
+
+void
+seq_db_load_fastq_files (SeqDB        *db,
+                         char        **paths,
+                         int           n_threads,
+                         GError      **error)
+{
+  GError *tmp_error = NULL;
+  int     i;
+
+  if (!check_not_mapped (db, paths[0], error) ||
+      !check_not_indexed (db, paths[0], error))
+    return;
+  /* A single thread loads the files straight into db */
+  if (n_threads <= 1)
+    for (i = 0; paths[i] && tmp_error == NULL; i++)
+      iter_fastq (paths[i],
+                  (FastqIterFunc)iter_load_db_fastq,
+                  db,
+                  &tmp_error);
+  else
+    load_file_parts (db, paths, n_threads, &tmp_error);
+  trim_reads (db);
+  qsort (db->read_hashes->data,
+         db->read_hashes->len,
+         sizeof (SeqDBHash),
+         compare_hashes);
+  if (tmp_error)
+    g_propagate_error (error, tmp_error);
+}
+
+void
+seq_db_open_fasta (SeqDB       *db,
+                   const char  *path,
+                   GError     **error)
+{
+  FastaIndex *index;
+  guint       i;
+
+  if (!check_not_mapped (db, path, error))
+    return;
+  if (db->fasta_index)
+    {
+      g_set_error (error,
+                   NGS_ERROR,
+                   NGS_UNKNOWN_ERROR,
+                   "Only one fasta file can be opened in a SeqDB: `%s'",
+                   path);
+      return;
+    }
+  index = fasta_index_find (path);
+  if (index == NULL)
+    {
+      index = fasta_index_build (path, NULL);
+      if (index == NULL)
+        {
+          seq_db_load_fasta (db, path, error);
+          return;
+        }
+      else
+        {
+          char *index_path = g_strconcat (path, FASTA_INDEX_SUFFIX, NULL);
+
+          /* The directory may not be writable */
+          fasta_index_save (index, index_path, NULL);
+          g_free (index_path);
+        }
+    }
+  db->fasta_fd = open (path, O_RDONLY);
+  if (db->fasta_fd < 0)
+    {
+      g_set_error (error,
+                   NGS_ERROR,
+                   NGS_IO_ERROR,
+                   "Could not open input file `%s'",
+                   path);
+      fasta_index_free (index);
+      return;
+    }
+  db->fasta_index = index;
+
+  for (i = 0; i < index->n_entries; i++)
+    {
+      SeqDBElement *elem;
+
+      db->n_seqs++;
+      elem            = seq_db_element_new ();
+      elem->name      = g_strdup (index->entries[i].name);
+      elem->offset    = db->total_size;
+      elem->size      = index->entries[i].size;
+      elem->loaded    = 0;
+      db->total_size += elem->size;
+      g_hash_table_insert (db->index,
+                           elem->name,
+                           elem);
+    }
+  /* The pages of the sequences that are not read are never touched */
+  if (db->total_size >= db->alloc_size)
+    {
+      db->alloc_size = ((db->total_size + db->alloc_inc) / db->alloc_inc) * db->alloc_inc;
+      db->seqs       = g_realloc (db->seqs,
+                                  db->alloc_size * sizeof (*db->seqs));
+      if (db->quals)
+        db->quals    = g_realloc (db->quals,
+                                  db->alloc_size * sizeof (*db->quals));
+    }
+}
+
+void
+seq_db_load_elem (SeqDB        *db,
+                  SeqDBElement *elem,
+                  GError      **error)
+{
+  FastaIndexEntry *entry;
+
+  if (elem->loaded)
+    return;
+  /* The pages of mapped sequences are read on access */
+  if (db->map)
+    {
+      elem->loaded = 1;
+      return;
+    }
+  entry = db->fasta_index ? fasta_index_lookup (db->fasta_index, elem->name) : NULL;
+  if (entry == NULL)
+    {
+      g_set_error (error,
+                   NGS_ERROR,
+                   NGS_UNKNOWN_ERROR,
+                   "Sequence `%s' was not opened",
+                   elem->name);
+      return;
+    }
+  if (fasta_index_read (entry,
+                        db->fasta_fd,
+                        0,
+                        entry->size,
+                        db->seqs + elem->offset,
+                        error))
+    elem->loaded = 1;
+}
+
+void
+seq_db_load_all (SeqDB       *db,
+                 GError     **error)
+{
+  GHashTableIter iter;
+  SeqDBElement  *elem;
+  GError        *tmp_error = NULL;
+
+  g_hash_table_iter_init (&iter, db->index);
+  while (g_hash_table_iter_next (&iter, NULL, (gpointer*)&elem))
+    {
+      seq_db_load_elem (db, elem, &tmp_error);
+      if (tmp_error)
+        {
+          g_propagate_error (error, tmp_error);
+          return;
+        }
+    }
+}
+
+SeqDBElement*
+seq_db_lookup (SeqDB      *db,
+               const char *name)
+{
+  SeqDBElement *elem;
+  GError       *error  = NULL;
+  gint64        id;
+
+  if (db->reads->len > 0)
+    {
+      id = seq_db_lookup_read (db, name);
+      if (id >= 0)
+        return &g_array_index (db->reads, SeqDBElement, id);
+    }
+
+  elem = g_hash_table_lookup (db->index, name);
+  if (elem && !elem->loaded)
+    {
+      seq_db_load_elem (db, elem, &error);
+      if (error)
+        {
+          g_printerr ("[ERROR] Reading sequence failed: %s\n", error->message);
+          g_error_free (error);
+          return NULL;
+        }
+    }
+
+  return elem;
+}
+
+gint64
+seq_db_lookup_read (SeqDB      *db,
+                    const char *name)
+{
+  SeqDBHash *hashes = (SeqDBHash*)db->read_hashes->data;
+  guint64    hash;
+  guint      low    = 0;
+  guint      high   = db->read_hashes->len;
+
+  hash = fq_index_hash (name);
+  if (db->read_mphf)
+    {
+      const guint64 key = mphf_lookup (db->read_mphf, hash);
+
+      if (key < db->n_read_keys &&
+          db->read_fingerprints[key] == read_fingerprint (name))
+        return db->read_ids[key];
+      return -1;
+    }
+
+  while (low < high)
+    {
+      const guint mid = low + (high - low) / 2;
+
+      if (hashes[mid].hash < hash)
+        low = mid + 1;
+      else
+        high = mid;
+    }
+  /* Different names can have the same hash */
+  for (; low < db->read_hashes->len && hashes[low].hash == hash; low++)
+    if (name_store_get (db->names, hashes[low].id, NULL, db->name_buffer) &&
+        strcmp (db->name_buffer->str, name) == 0)
+      return hashes[low].id;
+
+  return -1;
+}
+
+void
+seq_db_index_reads (SeqDB *db)
+{
+  SeqDBHash *hashes = (SeqDBHash*)db->read_hashes->data;
+  guint64   *keys;
+  guint64    n_keys = 0;
+  guint64    i;
+
+  if (db->read_mphf)
+    return;
+
+  /* The hashes are sorted: only the first read of a hash is kept */
+  keys = g_new (guint64, MAX (db->read_hashes->len, 1));
+  for (i = 0; i < db->read_hashes->len; i++)
+    if (n_keys == 0 || keys[n_keys - 1] != hashes[i].hash)
+      keys[n_keys++] = hashes[i].hash;
+  /* The perfect hash returns a key for any name, which the fingerprints
+   * must reject: they are not derived from the hashes it is built on, which
+   * would make a name that hits a key more likely to match its fingerprint */
+  db->read_mphf         = mphf_new (keys, n_keys);
+  db->n_read_keys       = n_keys;
+  db->read_ids          = g_new (guint32, MAX (n_keys, 1));
+  db->read_fingerprints = g_new (guint32, MAX (n_keys, 1));
+  g_free (keys);
+
+  for (i = 0; i < db->read_hashes->len; i++)
+    if (i == 0 || hashes[i - 1].hash != hashes[i].hash)
+      {
+        const guint64 key = mphf_lookup (db->read_mphf, hashes[i].hash);
+
+        db->read_ids[key]          = hashes[i].id;
+        db->read_fingerprints[key] = hashes[i].fingerprint;
+      }
+  g_array_free (db->read_hashes, TRUE);
+  db->read_hashes = g_array_new (FALSE, FALSE, sizeof (SeqDBHash));
+}
+
+gboolean
+seq_db_save (SeqDB       *db,
+             const char  *path,
+             GError     **error)
+{
+  GHashTableIter  iter;
+  NgsWriter      *writer;
+  SeqDBElement  **elems;
+  SeqDBElement   *elem;
+  GError         *tmp_error  = NULL;
+  guint64         names_size = 0;
+  guint64         total_size = 0;
+  guint64         seqs_start;
+  guint64         position;
+  guint           n_elems;
+  guint           i;
+
+  seq_db_load_all (db, &tmp_error);
+  if (tmp_error)
+    {
+      g_propagate_error (error, tmp_error);
+      return FALSE;
+    }
+
+  /* In the order of the sequences */
+  n_elems = g_hash_table_size (db->index);
+  elems   = g_new (SeqDBElement*, n_elems);
+  i       = 0;
+  g_hash_table_iter_init (&iter, db->index);
+  while (g_hash_table_iter_next (&iter, NULL, (gpointer*)&elem))
+    {
+      elems[i++]  = elem;
+      names_size += strlen (elem->name) + 1;
+      total_size += elem->size;
+    }
+  qsort (elems, n_elems, sizeof (*elems), compare_offsets);
+
+  writer = ngs_writer_new (path, "w", error);
+  if (writer == NULL)
+    {
+      g_free (elems);
+      return FALSE;
+    }
+  seqs_start = SEQ_DB_HEADER_SIZE + n_elems * SEQ_DB_ELEM_SIZE + names_size;
+  seqs_start = (seqs_start + SEQ_DB_ALIGNMENT - 1) / SEQ_DB_ALIGNMENT * SEQ_DB_ALIGNMENT;
+  ngs_writer_write (writer, seq_db_magic, sizeof (seq_db_magic), NULL);
+  write_uint64 (writer, n_elems);
+  write_uint64 (writer, names_size);
+  write_uint64 (writer, total_size);
+  write_uint64 (writer, seqs_start);
+  for (i = 0, position = 0, total_size = 0; i < n_elems; i++)
+    {
+      write_uint64 (writer, position);
+      write_uint64 (writer, total_size);
+      write_uint64 (writer, elems[i]->size);
+      position   += strlen (elems[i]->name) + 1;
+      total_size += elems[i]->size;
+    }
+  for (i = 0; i < n_elems; i++)
+    ngs_writer_write (writer, elems[i]->name, strlen (elems[i]->name) + 1, NULL);
+  for (position = SEQ_DB_HEADER_SIZE + n_elems * SEQ_DB_ELEM_SIZE + names_size;
+       position < seqs_start;
+       position++)
+    ngs_writer_putc (writer, '\0', NULL);
+  for (i = 0; i < n_elems; i++)
+    ngs_writer_write (writer,
+                      db->seqs + elems[i]->offset,
+                      elems[i]->size,
+                      NULL);
+  g_free (elems);
+
+  return ngs_writer_close (writer, error);
+}
+
+gboolean
+seq_db_check (const char *path)
+{
+  char magic[sizeof (seq_db_magic)];
+  int  fd;
+  int  ret;
+
+  fd = open (path, O_RDONLY);
+  if (fd < 0)
+    return FALSE;
+  ret = read (fd, magic, sizeof (magic)) == sizeof (magic) &&
+        memcmp (magic, seq_db_magic, sizeof (magic)) == 0;
+  close (fd);
+
+  return ret;
+}
+
+SeqDB*
+seq_db_open_mapped (const char  *path,
+                    GError     **error)
+{
+  SeqDB       *db;
+  struct stat  st;
+  char        *map;
+  const char  *names;
+  guint64      n_elems;
+  guint64      names_size;
+  guint64      total_size;
+  guint64      seqs_start;
+  guint64      i;
+  int          fd;
+
+  fd = open (path, O_RDONLY);
+  if (fd < 0)
+    {
+      g_set_error (error,
+                   NGS_ERROR,
+                   NGS_IO_ERROR,
+                   "Could not open input file `%s'",
+                   path);
+      return NULL;
+    }
+  if (fstat (fd, &st) != 0 || st.st_size < SEQ_DB_HEADER_SIZE)
+    {
+      close (fd);
+      goto invalid;
+    }
+  map = mmap (NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close (fd);
+  if (map == MAP_FAILED)
+    {
+      g_set_error (error,
+                   NGS_ERROR,
+                   NGS_IO_ERROR,
+                   "Could not map `%s'",
+                   path);
+      return NULL;
+    }
+
+  n_elems    = read_uint64 (map + 8);
+  names_size = read_uint64 (map + 16);
+  total_size = read_uint64 (map + 24);
+  seqs_start = read_uint64 (map + 32);
+  names      = map + SEQ_DB_HEADER_SIZE + n_elems * SEQ_DB_ELEM_SIZE;
+  if (memcmp (map, seq_db_magic, sizeof (seq_db_magic)) != 0 ||
+      n_elems > (guint64)st.st_size / SEQ_DB_ELEM_SIZE ||
+      names_size > (guint64)st.st_size ||
+      SEQ_DB_HEADER_SIZE + n_elems * SEQ_DB_ELEM_SIZE + names_size > seqs_start ||
+      seqs_start > (guint64)st.st_size ||
+      total_size > (guint64)st.st_size - seqs_start ||
+      (names_size > 0 && names[names_size - 1] != '\0'))
+    {
+      munmap (map, st.st_size);
+      goto invalid;
+    }
+
+  db = seq_db_new ();
+  /* The elements and their names are in the image */
+  g_hash_table_destroy (db->index);
+  db->index      = g_hash_table_new (g_str_hash, g_str_equal);
+  db->map        = map;
+  db->map_size   = st.st_size;
+  db->elems      = g_new (SeqDBElement, n_elems);
+  db->seqs       = map + seqs_start;
+  db->total_size = total_size;
+  db->alloc_size = total_size;
+  db->n_seqs     = n_elems;
+  for (i = 0; i < n_elems; i++)
+    {
+      const char   *cursor = map + SEQ_DB_HEADER_SIZE + i * SEQ_DB_ELEM_SIZE;
+      const guint64 name   = read_uint64 (cursor);
+      const guint64 offset = read_uint64 (cursor + 8);
+      const guint64 size   = read_uint64 (cursor + 16);
+
+      if (name >= names_size ||
+          size > G_MAXUINT32 ||
+          offset > total_size ||
+          size > total_size - offset)
+        {
+          seq_db_free (db);
+          goto invalid;
+        }
+      db->elems[i].name   = (char*)names + name;
+      db->elems[i].offset = offset;
+      db->elems[i].size   = size;
+      db->elems[i].loaded = 0;
+      g_hash_table_insert (db->index, db->elems[i].name, db->elems + i);
+    }
+
+  return db;
+
+invalid:
+  g_set_error (error,
+               NGS_ERROR,
+               NGS_PARSE_ERROR,
+               "Invalid SeqDB image `%s'",
+               path);
+
+  return NULL;
+}
+
+SeqDB*
+seq_db_open_reference (const char  *path,
+                       GError     **error)
+{
+  struct stat  st;
+  struct stat  st_image;
+  SeqDB       *db;
+  GError      *tmp_error = NULL;
+  char        *image_path;
+
+  if (seq_db_check (path))
+    return seq_db_open_mapped (path, error);
+
+  image_path = g_strconcat (path, SEQ_DB_SUFFIX, NULL);
+  db         = NULL;
+  if (stat (path, &st) == 0 &&
+      stat (image_path, &st_image) == 0 &&
+      st_image.st_mtime >= st.st_mtime)
+    db = seq_db_open_mapped (image_path, NULL);
+  g_free (image_path);
+  if (db)
+    return db;
+
+  db = seq_db_new ();
+  seq_db_open_fasta (db, path, &tmp_error);
+  if (tmp_error)
+    {
+      g_propagate_error (error, tmp_error);
+      seq_db_free (db);
+      return NULL;
+    }
+
+  return db;
 }
 
 static int
 iter_load_db_fastq (FastqSeq *fastq,
                     SeqDB    *db)
 {
-  SeqDBElement *elem;
+  SeqDBHash hash;
+
+  load_read (db, fastq);
+  hash.hash        = fq_index_hash (fastq->name);
+  hash.id          = name_store_add (db->names, fastq->name);
+  hash.fingerprint = read_fingerprint (fastq->name);
+  g_array_append_val (db->read_hashes, hash);
+
+  return 1;
+}
+
+/* The names are encoded when the parts are appended, in the order of the
+ * reads */
+static int
+iter_load_part (FastqSeq  *fastq,
+                SeqDBPart *part)
+{
+  SeqDBHash hash;
+
+  load_read (part->db, fastq);
+  hash.hash        = fq_index_hash (fastq->name);
+  hash.id          = part->db->reads->len - 1;
+  hash.fingerprint = read_fingerprint (fastq->name);
+  g_array_append_val (part->db->read_hashes, hash);
+  g_string_append_len (part->names, fastq->name, strlen (fastq->name) + 1);
+
+  return 1;
+}
+
+/**
+ * The files are loaded in parts by several threads, and the parts appended
+ * to db in the order of the files, as soon as they are loaded.
+ */
+static void
+load_file_parts (SeqDB   *db,
+                 char   **paths,
+                 int      n_threads,
+                 GError **error)
+{
+  SeqDBLoader  loader;
+  GThread    **threads;
+  int          n_files;
+  int          n_workers;
+  int          i;
+  int          j;
+
+  n_files   = g_strv_length (paths);
+  n_workers = MIN (n_threads, n_files);
+
+  loader.db          = db;
+  loader.jobs        = g_new0 (SeqDBFileJob, n_files);
+  loader.n_jobs      = n_files;
+  loader.next_job    = 0;
+  loader.next_append = 0;
+  loader.failed      = 0;
+  g_mutex_init (&loader.lock);
+  for (i = 0; i < n_files; i++)
+    {
+      SeqDBFileJob *job = loader.jobs + i;
+      struct stat   st;
+      guint64       part_size = 0;
+
+      /* The threads left over by the files are used to split them */
+      job->path    = paths[i];
+      job->n_parts = MAX (1, n_threads / n_files);
+      job->parts   = g_new0 (SeqDBPart, job->n_parts);
+      if (stat (paths[i], &st) == 0 && S_ISREG (st.st_mode))
+        part_size = st.st_size / job->n_parts;
+      for (j = 0; j < job->n_parts; j++)
+        {
+          job->parts[j].db    = seq_db_new ();
+          job->parts[j].names = g_string_new (NULL);
+          if (db->packed)
+            seq_db_set_packed (job->parts[j].db);
+          /* Roughly half of the bytes of a fastq file are bases */
+          reserve_reads (job->parts[j].db, part_size / 2);
+        }
+    }
+  threads = g_new0 (GThread*, n_workers);
+  for (i = 0; i < n_workers; i++)
+    threads[i] = g_thread_new ("seq_db_load",
+                               (GThreadFunc)load_files_thread,
+                               &loader);
+  for (i = 0; i < n_workers; i++)
+    g_thread_join (threads[i]);
+  g_free (threads);
+  g_mutex_clear (&loader.lock);
+
+  for (i = 0; i < n_files; i++)
+    {
+      SeqDBFileJob *job = loader.jobs + i;
+
+      if (job->error && *error == NULL)
+        *error = job->error;
+      else if (job->error)
+        g_error_free (job->error);
+    }
+  g_free (loader.jobs);
+}
+
+/* Each thread loads the next file that nobody has taken yet */
+static gpointer
+load_files_thread (SeqDBLoader *loader)
+{
+  gint i;
+
+  while ((i = g_atomic_int_add (&loader->next_job, 1)) < loader->n_jobs)
+    {
+      SeqDBFileJob *job = loader->jobs + i;
+      void        **thread_data;
+      int           j;
+
+      thread_data = g_new (void*, job->n_parts);
+      for (j = 0; j < job->n_parts; j++)
+        thread_data[j] = job->parts + j;
+      iter_fastq_ranges (job->path,
+                         (FastqIterFunc)iter_load_part,
+                         thread_data,
+                         job->n_parts,
+                         &job->error);
+      g_free (thread_data);
+
+      g_mutex_lock (&loader->lock);
+      job->done = 1;
+      append_loaded_files (loader);
+      g_mutex_unlock (&loader->lock);
+    }
+
+  return NULL;
+}
+
+/**
+ * Appends the files loaded that follow the last file appended, and frees
+ * their parts, so that at most the files loaded out of order are held twice.
+ * Nothing is appended after a file that failed.
+ */
+static void
+append_loaded_files (SeqDBLoader *loader)
+{
+  while (loader->next_append < loader->n_jobs &&
+         loader->jobs[loader->next_append].done)
+    {
+      SeqDBFileJob *job = loader->jobs + loader->next_append;
+      int           j;
+
+      if (job->error)
+        loader->failed = 1;
+      for (j = 0; j < job->n_parts; j++)
+        {
+          if (!loader->failed)
+            append_part (loader->db, job->parts + j);
+          seq_db_free (job->parts[j].db);
+          g_string_free (job->parts[j].names, TRUE);
+        }
+      g_free (job->parts);
+      job->parts = NULL;
+      loader->next_append++;
+    }
+}
+
+static void
+append_part (SeqDB     *db,
+             SeqDBPart *part)
+{
+  const char *name = part->names->str;
+  guint64     base;
+  guint64     size;
+  guint       first_id;
+  guint       i;
+
+  if (part->db->reads->len == 0)
+    return;
+  /* The first part takes over the buffers of an empty db */
+  if (db->total_size == 0)
+    {
+      unsigned long alloc_size;
+      guchar       *packed_seqs;
+      guchar       *packed_quals;
+      GArray       *runs;
+      char         *seqs;
+      char         *quals;
+
+      base                   = 0;
+      alloc_size             = db->alloc_size;
+      packed_seqs            = db->packed_seqs;
+      packed_quals           = db->packed_quals;
+      runs                   = db->runs;
+      seqs                   = db->seqs;
+      quals                  = db->quals;
+      db->alloc_size         = part->db->alloc_size;
+      db->packed_seqs        = part->db->packed_seqs;
+      db->packed_quals       = part->db->packed_quals;
+      db->runs               = part->db->runs;
+      db->seqs               = part->db->seqs;
+      db->quals              = part->db->quals;
+      part->db->alloc_size   = alloc_size;
+      part->db->packed_seqs  = packed_seqs;
+      part->db->packed_quals = packed_quals;
+      part->db->runs         = runs;
+      part->db->seqs         = seqs;
+      part->db->quals        = quals;
+    }
+  else if (db->packed)
+    {
+      base = ((db->total_size + NUCS_PER_BYTE - 1) / NUCS_PER_BYTE) * NUCS_PER_BYTE;
+      size = ((part->db->total_size + NUCS_PER_BYTE - 1) / NUCS_PER_BYTE) * NUCS_PER_BYTE;
+      reserve_reads (db, base + size);
+      memcpy (db->packed_seqs + base / NUCS_PER_BYTE,
+              part->db->packed_seqs,
+              size / NUCS_PER_BYTE);
+      memcpy (db->packed_quals + base / 2,
+              part->db->packed_quals,
+              size / 2);
+      for (i = 0; i < part->db->runs->len; i++)
+        {
+          SeqDBRun run = g_array_index (part->db->runs, SeqDBRun, i);
+
+          run.start += base;
+          g_array_append_val (db->runs, run);
+        }
+    }
+  else
+    {
+      base = db->total_size;
+      size = part->db->total_size;
+      reserve_reads (db, base + size);
+      memcpy (db->seqs + base, part->db->seqs, size);
+      memcpy (db->quals + base, part->db->quals, size);
+    }
+  db->total_size = base + part->db->total_size;
+  db->n_seqs    += part->db->n_seqs;
+
+  first_id = db->reads->len;
+  for (i = 0; i < part->db->reads->len; i++)
+    {
+      SeqDBElement elem = g_array_index (part->db->reads, SeqDBElement, i);
+
+      elem.offset += base;
+      g_array_append_val (db->reads, elem);
+    }
+  for (i = 0; i < part->db->read_hashes->len; i++)
+    {
+      SeqDBHash hash = g_array_index (part->db->read_hashes, SeqDBHash, i);
+
+      hash.id += first_id;
+      g_array_append_val (db->read_hashes, hash);
+      name_store_add (db->names, name);
+      name += strlen (name) + 1;
+    }
+}
+
+static void
+load_read (SeqDB    *db,
+           FastqSeq *fastq)
+{
+  SeqDBElement elem;
 
   db->n_seqs++;
-  if (db->total_size >= db->alloc_size)
+  elem.name   = NULL;
+  elem.size   = fastq->size;
+  elem.loaded = 1;
+  if (db->packed)
+    {
+      elem.offset = ((db->total_size + NUCS_PER_BYTE - 1) / NUCS_PER_BYTE) * NUCS_PER_BYTE;
+      reserve_reads (db, elem.offset + elem.size);
+      pack_read (db, fastq, elem.offset);
+    }
+  else
+    {
+      elem.offset = db->total_size;
+      reserve_reads (db, elem.offset + elem.size);
+      memcpy (db->seqs + db->total_size,
+              fastq->seq,
+              fastq->size * sizeof (*fastq->seq));
+      memcpy (db->quals + db->total_size,
+              fastq->qual,
+              fastq->size * sizeof (*fastq->seq));
+    }
+  db->total_size = elem.offset + elem.size;
+  g_array_append_val (db->reads, elem);
+}
+
+/* The buffers of the reads grow geometrically: alloc_size is counted in
+ * bases */
+static void
+reserve_reads (SeqDB   *db,
+               guint64  size)
+{
+  guint64 new_size;
+
+  if (size <= db->alloc_size)
+    return;
+  new_size = MAX (db->alloc_size * 2, SEQ_DB_READS_MIN);
+  while (new_size < size)
+    new_size *= 2;
+  db->alloc_size = new_size;
+  if (db->packed)
+    {
+      db->packed_seqs  = g_realloc (db->packed_seqs,
+                                    new_size / NUCS_PER_BYTE);
+      db->packed_quals = g_realloc (db->packed_quals,
+                                    new_size / 2);
+    }
+  else
+    {
+      db->seqs         = g_realloc (db->seqs,
+                                    new_size * sizeof (*db->seqs));
+      db->quals        = g_realloc (db->quals,
+                                    new_size * sizeof (*db->quals));
+    }
+}
+
+/* Gives back the room left by the geometric growth */
+static void
+trim_reads (SeqDB *db)
+{
+  const guint64 size = ((db->total_size + NUCS_PER_BYTE - 1) / NUCS_PER_BYTE) * NUCS_PER_BYTE;
+
+  if (size == 0 || size >= db->alloc_size)
+    return;
+  db->alloc_size = size;
+  if (db->packed)
+    {
+      db->packed_seqs  = g_realloc (db->packed_seqs,
+                                    size / NUCS_PER_BYTE);
+      db->packed_quals = g_realloc (db->packed_quals,
+                                    size / 2);
+    }
+  else
+    {
+      db->seqs         = g_realloc (db->seqs,
+                                    size * sizeof (*db->seqs));
+      db->quals        = g_realloc (db->quals,
+                                    size * sizeof (*db->quals));
+    }
+}
+
+static void
+pack_read (SeqDB    *db,
+           FastqSeq *fastq,
+           guint64   offset)
+{
+  const unsigned char *qual = (const unsigned char *)fastq->qual;
+  const unsigned int   size = fastq->size;
+  guchar              *dest;
+  unsigned int         i;
+
+  char_to_bin_prealloc (db->packed_seqs + offset / NUCS_PER_BYTE,
+                        fastq->seq,
+                        size);
+
+  /* Letters that do not survive the round trip */
+  for (i = 0; i < size; i++)
+    {
+      const unsigned char c = fastq->seq[i] & 127;
+
+      if (bin_to_char_table[char_to_bin_table[c]] != c)
+        {
+          SeqDBRun *last = NULL;
+
+          if (db->runs->len > 0)
+            last = &g_array_index (db->runs, SeqDBRun, db->runs->len - 1);
+          if (last &&
+              last->letter == (char)c &&
+              last->start + last->size == offset + i)
+            last->size++;
+          else
+            {
+              SeqDBRun run;
+
+              run.start  = offset + i;
+              run.size   = 1;
+              run.letter = c;
+              g_array_append_val (db->runs, run);
+            }
+        }
+    }
+
+  dest = db->packed_quals + offset / 2;
+  for (i = 0; i + 1 < size; i += 2)
+    *dest++ = db->qual_codes[qual[i] & 127] | db->qual_codes[qual[i + 1] & 127] << 4;
+  if (i < size)
+    *dest = db->qual_codes[qual[i] & 127];
+}
+
+static void
+load_db_window (SeqDB         *db,
+                FastaWindow   *window,
+                SeqDBElement **elem)
+{
+  if (window->start == 0)
+    {
+      db->n_seqs++;
+      *elem            = seq_db_element_new ();
+      (*elem)->name    = strdup (window->name);
+      (*elem)->offset  = db->total_size;
+      (*elem)->size    = 0;
+      (*elem)->loaded  = 1;
+      g_hash_table_insert (db->index,
+                           (*elem)->name,
+                           *elem);
+    }
+  if (db->total_size + window->size >= db->alloc_size)
     {
-      db->alloc_size  = ((db->alloc_size + fastq->size + db->alloc_inc - 1) / db->alloc_inc) * db->alloc_inc;
+      db->alloc_size  = ((db->alloc_size + window->size + db->alloc_inc - 1) / db->alloc_inc) * db->alloc_inc;
       db->seqs        = g_realloc (db->seqs,
                                    db->alloc_size * sizeof (*db->seqs));
-      db->quals       = g_realloc (db->quals,
-                                   db->alloc_size * sizeof (*db->quals));
     }
-  elem            = seq_db_element_new ();
-  elem->name      = strdup (fastq->name);
-  elem->offset    = db->total_size;
-  elem->size      = fastq->size;
   memcpy (db->seqs + db->total_size,
-          fastq->seq,
-          fastq->size * sizeof (*fastq->seq));
-  memcpy (db->quals + db->total_size,
-          fastq->qual,
-          fastq->size * sizeof (*fastq->seq));
-  db->total_size += elem->size;
-  g_hash_table_insert (db->index,
-                       elem->name,
-                       elem);
+          window->seq,
+          window->size * sizeof (*window->seq));
+  db->total_size += window->size;
+  (*elem)->size  += window->size;
+}
 
-  return 1;
+/**
+ * FNV-1a on 32 bits, unlike fq_index_hash, mixed by the finaliser of
+ * MurmurHash3
+ */
+static guint32
+read_fingerprint (const char *name)
+{
+  guint32 hash = 0x811c9dc5;
+
+  for (; *name; name++)
+    {
+      hash ^= (unsigned char)*name;
+      hash *= 0x01000193;
+    }
+  hash ^= hash >> 16;
+  hash *= 0x85ebca6b;
+  hash ^= hash >> 13;
+  hash *= 0xc2b2ae35;
+  hash ^= hash >> 16;
+
+  return hash;
 }
 
 static int
-iter_load_db_fasta (FastaSeq *fasta,
-                    SeqDB    *db)
+compare_hashes (const void *a,
+                const void *b)
 {
-  SeqDBElement *elem;
+  const SeqDBHash *ha = a;
+  const SeqDBHash *hb = b;
 
-  db->n_seqs++;
-  if (db->total_size + fasta->size >= db->alloc_size)
+  if (ha->hash != hb->hash)
+    return ha->hash < hb->hash ? -1 : 1;
+  if (ha->id != hb->id)
+    return ha->id < hb->id ? -1 : 1;
+  return 0;
+}
+
+static int
+compare_offsets (const void *a,
+                 const void *b)
+{
+  const SeqDBElement *ea = *(SeqDBElement* const*)a;
+  const SeqDBElement *eb = *(SeqDBElement* const*)b;
+
+  if (ea->offset != eb->offset)
+    return ea->offset < eb->offset ? -1 : 1;
+  return 0;
+}
+
+/* Little endian */
+static void
+write_uint64 (NgsWriter *writer,
+              guint64    value)
+{
+  char buffer[8];
+  int  k;
+
+  for (k = 0; k < 8; k++)
+    buffer[k] = (value >> (8 * k)) & 0xff;
+  ngs_writer_write (writer, buffer, 8, NULL);
+}
+
+static guint64
+read_uint64 (const char *data)
+{
+  guint64 value = 0;
+  int     k;
+
+  for (k = 0; k < 8; k++)
+    value |= (guint64)(guchar)data[k] << (8 * k);
+
+  return value;
+}
+
+static int
+check_not_mapped (SeqDB       *db,
+                  const char  *path,
+                  GError     **error)
+{
+  if (db->map)
     {
-      db->alloc_size  = ((db->alloc_size + fasta->size + db->alloc_inc - 1) / db->alloc_inc) * db->alloc_inc;
-      db->seqs        = g_realloc (db->seqs,
-                                   db->alloc_size * sizeof (*db->seqs));
+      g_set_error (error,
+                   NGS_ERROR,
+                   NGS_UNKNOWN_ERROR,
+                   "Cannot load `%s' into a mapped SeqDB",
+                   path);
+      return 0;
     }
-  elem            = seq_db_element_new ();
-  elem->name      = strdup (fasta->name);
-  elem->offset    = db->total_size;
-  elem->size      = fasta->size;
-  memcpy (db->seqs + db->total_size,
-          fasta->seq,
-          fasta->size * sizeof (*fasta->seq));
-  db->total_size += elem->size;
-  g_hash_table_insert (db->index,
-                       elem->name,
-                       elem);
+  return 1;
+}
 
+static int
+check_not_indexed (SeqDB       *db,
+                   const char  *path,
+                   GError     **error)
+{
+  if (db->read_mphf)
+    {
+      g_set_error (error,
+                   NGS_ERROR,
+                   NGS_UNKNOWN_ERROR,
+                   "Cannot load `%s' into a SeqDB whose reads are indexed",
+                   path);
+      return 0;
+    }
   return 1;
 }
 
@@ -7,6 +7,9 @@
 
 #include <glib.h>
 
+#include "ngs_fasta.h"
+#include "ngs_mphf.h"
+#include "ngs_namecodec.h"
 
 /****************/
 /* SeqDBElement */
@@ -19,6 +22,7 @@ struct _SeqDBElement
   char    *name;
   guint64  offset;
   guint32  size;
+  guint32  loaded;
 };
 
 SeqDBElement *seq_dbelement_new  (void);
@@ -28,15 +32,84 @@ void          seq_dbelement_free (SeqDBElement *elem);
 /* SeqDB */
 /*********/
 
+/**
+ * Sequences loaded from fasta files are indexed by name in index.  The
+ * sequences of a file opened with seq_db_open_fasta are only read when they
+ * are first needed: until then, they have an element in index, but their
+ * part of seqs is undefined and loaded is 0.
+ * Reads loaded from fastq files are kept in reads, without their name: the
+ * names are encoded in names, and found through the sorted hashes in
+ * read_hashes.  Use seq_db_lookup to find either.
+ * Once all the reads are loaded, seq_db_index_reads can replace read_hashes
+ * by a minimal perfect hash of the names (read_mphf), which gives the
+ * position of the id of the read in read_ids, and of a fingerprint of its
+ * name in read_fingerprints.  The fingerprint is a second hash of the name,
+ * computed differently from hash, the key of the perfect hash.
+ */
+
+typedef struct _SeqDBHash SeqDBHash;
+
+struct _SeqDBHash
+{
+  guint64 hash;
+  guint32 id;
+  guint32 fingerprint;
+};
+
+/**
+ * In a packed SeqDB, the reads take two bits per base in packed_seqs (as in
+ * ngs_binseq) and four bits per quality in packed_quals, and start at
+ * offsets that are multiples of four.  The letters other than ACGT are kept
+ * in runs, sorted by start.  The qualities are binned to 16 levels, each
+ * quality being rounded down to the closest level, so that the usual
+ * thresholds (10, 20, 30 ...) give the same results on packed qualities.
+ * Use seq_db_get_window to unpack the reads.
+ */
+
+typedef struct _SeqDBRun SeqDBRun;
+
+struct _SeqDBRun
+{
+  guint64 start;
+  guint32 size;
+  char    letter;
+};
+
 typedef struct _SeqDB SeqDB;
 
 struct _SeqDB
 {
   GHashTable   *index;
 
+  GArray       *reads;
+  GArray       *read_hashes;
+  NameStore    *names;
+  GString      *name_buffer;
+
+  Mphf         *read_mphf;
+  guint32      *read_ids;
+  guint32      *read_fingerprints;
+  guint64       n_read_keys;
+
+  FastaIndex   *fasta_index;
+  int           fasta_fd;
+
+  /* Mapped image */
+  char         *map;
+  gsize         map_size;
+  SeqDBElement *elems;
+
   gchar        *seqs;
   gchar        *quals;
 
+  /* Packed reads */
+  int           packed;
+  guchar       *packed_seqs;
+  guchar       *packed_quals;
+  GArray       *runs;
+  guchar        qual_codes[128];
+  char          qual_letters[16];
+
   unsigned long alloc_size;
   unsigned long alloc_inc;
   unsigned long total_size;
@@ -53,6 +126,129 @@ void   seq_db_load_fastq (SeqDB       *db,
                           const char  *path,
                           GError     **error);
 
+/**
+ * Loads the reads of the NULL terminated paths with n_threads threads.
+ * Several files are parsed at once, and the threads left over are used to
+ * split the files that can be split (see iter_fastq_ranges).  Each part is
+ * loaded on its own, and the parts of a file are appended to db as soon as
+ * it and the files before it are loaded, in the order of paths, as if they
+ * had been loaded by seq_db_load_fastq.  With a single thread, the files are
+ * loaded straight into db.
+ */
+
+void   seq_db_load_fastq_files (SeqDB        *db,
+                                char        **paths,
+                                int           n_threads,
+                                GError      **error);
+
+/**
+ * Packs the reads that are loaded afterwards into db.  The sequences of
+ * fasta files are not packed.
+ */
+
+void   seq_db_set_packed (SeqDB       *db);
+
+/**
+ * Copies size bases (and qualities, if qual is not NULL and elem is a read)
+ * of elem from start into seq and qual, unpacking them if needed.  The
+ * copies are not '\0' terminated.
+ */
+
+void   seq_db_get_window (SeqDB        *db,
+                          SeqDBElement *elem,
+                          guint64       start,
+                          guint64       size,
+                          char         *seq,
+                          char         *qual);
+
+/**
+ * Opens an uncompressed fasta file through its index, which is built (and
+ * saved next to the file, when possible) if there is none.  Files that
+ * cannot be indexed are loaded as by seq_db_load_fasta.
+ * Only one file can be opened this way in a SeqDB.
+ */
+
+void   seq_db_open_fasta (SeqDB       *db,
+                          const char  *path,
+                          GError     **error);
+
+/**
+ * Reads the sequence of elem, or all the sequences, if they have not been
+ * read yet.
+ */
+
+void   seq_db_load_elem  (SeqDB        *db,
+                          SeqDBElement *elem,
+                          GError      **error);
+
+void   seq_db_load_all   (SeqDB       *db,
+                          GError     **error);
+
+/**
+ * Returns the sequence or read called name, or NULL.  The name of the
+ * elements of reads is NULL.
+ * Sequences which have not been read yet are read first (or NULL is
+ * returned if they cannot be read), so lookups must not be made by several
+ * threads at once.
+ */
+
+SeqDBElement* seq_db_lookup (SeqDB      *db,
+                             const char *name);
+
+/**
+ * Returns the id of the read called name, which is its position in reads
+ * (the reads are numbered in the order they were loaded), or -1.
+ */
+
+gint64 seq_db_lookup_read (SeqDB      *db,
+                           const char *name);
+
+/**
+ * Builds the perfect hash of the read names, and frees read_hashes: lookups
+ * then take constant time, and about 9 bytes per read instead of 16.  The
+ * names are no longer compared, but their 32 bits fingerprints are.  They
+ * do not depend on the keys of the perfect hash, so that a name that is not
+ * in db is found with a probability of 2^-32.  When
+ * several reads have the same name, the first one is found.
+ * No reads can be loaded into db afterwards.
+ */
+
+void   seq_db_index_reads (SeqDB      *db);
+
+/**
+ * Binary image of the sequences of index (the reads are not saved): the
+ * elements, their names and the sequences, one after the other.  Mapping an
+ * image takes no parsing, and the processes which map the same image share
+ * its pages.  The sequences of a mapped SeqDB are read-only, and nothing
+ * can be loaded into it.  As with seq_db_open_fasta, they are only marked
+ * as loaded by seq_db_lookup and seq_db_load_all.
+ * The image of `genome.fa' is looked for in `genome.fa' SEQ_DB_SUFFIX.
+ */
+
+#define SEQ_DB_SUFFIX ".sdb"
+
+gboolean seq_db_save           (SeqDB       *db,
+                                const char  *path,
+                                GError     **error);
+
+/**
+ * Returns TRUE if path is a SeqDB image.
+ */
+
+gboolean seq_db_check          (const char  *path);
+
+SeqDB*   seq_db_open_mapped    (const char  *path,
+                                GError     **error);
+
+/**
+ * Opens a reference: path is mapped if it is an image, and so is the image
+ * next to it if it is not older than path.  Otherwise, path is opened with
+ * seq_db_open_fasta.
+ */
+
+SeqDB*   seq_db_open_reference (const char  *path,
+                                GError     **error);
+
 #endif /* __NGS_SEQ_DB_H__ */
 
 /* vim:ft=c:expandtab:sw=4:ts=4:sts=4:cinoptions={.5s^-2n-2(0:
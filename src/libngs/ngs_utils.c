@@ -48,6 +48,18 @@ rev_comp_in_place (char         *seq,
   return seq;
 }
 
+char*
+rev_comp (const char   *seq,
+          char         *dest,
+          unsigned long size)
+{
+  unsigned long i;
+
+  for (i = 0; i < size; i++)
+    dest[i] = rev_table[(int)seq[size - i - 1]];
+  return dest;
+}
+
 char*
 rev_in_place (char         *seq,
               unsigned long size)
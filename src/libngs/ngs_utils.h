@@ -8,9 +8,17 @@
 #include <glib.h>
 
 
+/* Complement of the upper case bases and N, 0 for the other letters */
+extern char rev_table[128];
+
 char* rev_comp_in_place (char         *seq,
                          unsigned long size);
 
+/* Writes the reverse complement of seq into dest, which must not overlap it */
+char* rev_comp          (const char   *seq,
+                         char         *dest,
+                         unsigned long size);
+
 /* Just reverses, does not complement, used for e.g. for qualities */
 char* rev_in_place      (char         *seq,
                          unsigned long size);
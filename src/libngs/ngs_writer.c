@@ -0,0 +1,525 @@
+/* Copyright (C) 2010  Sylvain FORET
+ *
+ * This file is part of libngs.
+ *
+ * libngs is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *                                                                       
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *                                                                       
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ *
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/uio.h>
+
+#include "ngs_bgzf.h"
+#include "ngs_utils.h"
+#include "ngs_writer.h"
+
+
+static NgsWriter* writer_new       (const char   *path);
+
+static gboolean   flush_data       (NgsWriter    *writer,
+                                    const char   *data,
+                                    gsize         size,
+                                    GError      **error);
+
+static gboolean   writev_all       (int           fd,
+                                    struct iovec *iov,
+                                    int           n_iov);
+
+static gboolean   append_fastq_len (NgsWriter    *writer,
+                                    const char   *name,
+                                    gsize         name_size,
+                                    const char   *seq,
+                                    const char   *qual,
+                                    gsize         size,
+                                    GError      **error);
+
+NgsWriter*
+ngs_writer_new (const char  *path,
+                const char  *mode,
+                GError     **error)
+{
+  NgsWriter *writer;
+  int        fd;
+  int        is_stdout = 0;
+
+  if (path[0] == '-' && path[1] == '\0')
+    {
+      fd        = STDOUT_FILENO;
+      is_stdout = 1;
+    }
+  else if (mode[0] == 'a')
+    fd = open (path, O_WRONLY | O_CREAT | O_APPEND, 0666);
+  else
+    fd = open (path, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+  if (fd < 0)
+    {
+      g_set_error (error,
+                   NGS_ERROR,
+                   NGS_IO_ERROR,
+                   "Could not open output file `%s'",
+                   path);
+      return NULL;
+    }
+
+  writer            = writer_new (path);
+  writer->fd        = fd;
+  writer->is_stdout = is_stdout;
+
+  return writer;
+}
+
+NgsWriter*
+ngs_writer_new_compressed (const char     *path,
+                           const char     *mode,
+                           NgsCompression  compression,
+                           int             n_threads,
+                           GError        **error)
+{
+  GIOChannel *channel;
+
+  switch (compression)
+    {
+      case NGS_COMPRESSION_GZIP:
+          channel = gzip_channel_new (path, mode, n_threads, error);
+          break;
+      case NGS_COMPRESSION_BGZF:
+          channel = bgzf_channel_new (path, mode, n_threads, error);
+          break;
+      default:
+          return ngs_writer_new (path, mode, error);
+    }
+  if (!channel)
+    return NULL;
+
+  return ngs_writer_new_channel (channel, path);
+}
+
+NgsWriter*
+ngs_writer_new_channel (GIOChannel *channel,
+                        const char *path)
+{
+  NgsWriter *writer;
+
+  writer            = writer_new (path);
+  writer->channel   = channel;
+  writer->is_stdout = (path[0] == '-' && path[1] == '\0');
+
+  return writer;
+}
+
+static NgsWriter*
+writer_new (const char *path)
+{
+  NgsWriter *writer;
+  void      *buffer;
+
+  if (posix_memalign (&buffer, NGS_WRITER_ALIGNMENT, NGS_WRITER_BUFFER_SIZE) != 0)
+    g_error ("Could not allocate the output buffer");
+
+  writer          = g_slice_new0 (NgsWriter);
+  writer->buffer  = buffer;
+  writer->alloc   = NGS_WRITER_BUFFER_SIZE;
+  writer->path    = g_strdup (path);
+  writer->fd      = -1;
+
+  return writer;
+}
+
+gboolean
+ngs_writer_close (NgsWriter  *writer,
+                  GError    **error)
+{
+  gboolean ret;
+
+  ngs_writer_flush (writer, NULL);
+  if (writer->channel)
+    {
+      GError *tmp_err = NULL;
+
+      /* Even on stdout, which the channel leaves open, so that the end of
+       * the compressed stream is written and its errors are reported */
+      g_io_channel_shutdown (writer->channel, TRUE, &tmp_err);
+      if (tmp_err && !writer->error)
+        writer->error = tmp_err;
+      else if (tmp_err)
+        g_error_free (tmp_err);
+      g_io_channel_unref (writer->channel);
+    }
+  else if (!writer->is_stdout && close (writer->fd) != 0 && !writer->error)
+    g_set_error (&writer->error,
+                 NGS_ERROR,
+                 NGS_IO_ERROR,
+                 "Could not close output file `%s'",
+                 writer->path);
+
+  ret = ngs_writer_check (writer, error);
+  if (writer->error)
+    g_error_free (writer->error);
+  free (writer->buffer);
+  g_free (writer->path);
+  g_slice_free (NgsWriter, writer);
+
+  return ret;
+}
+
+gboolean
+ngs_writer_flush (NgsWriter  *writer,
+                  GError    **error)
+{
+  return flush_data (writer, NULL, 0, error);
+}
+
+gboolean
+ngs_writer_check (NgsWriter  *writer,
+                  GError    **error)
+{
+  if (writer->error == NULL)
+    return TRUE;
+  if (error)
+    g_propagate_error (error, g_error_copy (writer->error));
+
+  return FALSE;
+}
+
+gboolean
+ngs_writer_write (NgsWriter  *writer,
+                  const char *data,
+                  gssize      size,
+                  GError    **error)
+{
+  if (writer->error)
+    return ngs_writer_check (writer, error);
+  if (size < 0)
+    size = strlen (data);
+  if (writer->size + size > writer->alloc)
+    {
+      /* Large writes go out together with the buffer */
+      if ((gsize)size > writer->alloc / 2)
+        return flush_data (writer, data, size, error);
+      if (!flush_data (writer, NULL, 0, error))
+        return FALSE;
+    }
+  memcpy (writer->buffer + writer->size, data, size);
+  writer->size += size;
+
+  return TRUE;
+}
+
+gboolean
+ngs_writer_putc (NgsWriter *writer,
+                 char       c,
+                 GError   **error)
+{
+  if (writer->error)
+    return ngs_writer_check (writer, error);
+  if (writer->size == writer->alloc && !flush_data (writer, NULL, 0, error))
+    return FALSE;
+  writer->buffer[writer->size++] = c;
+
+  return TRUE;
+}
+
+gboolean
+ngs_writer_printf (NgsWriter  *writer,
+                   GError    **error,
+                   const char *format,
+                   ...)
+{
+  va_list  args;
+  gsize    left;
+  int      n;
+  gboolean ret = TRUE;
+
+  if (writer->error)
+    return ngs_writer_check (writer, error);
+
+  va_start (args, format);
+  left = writer->alloc - writer->size;
+  n    = g_vsnprintf (writer->buffer + writer->size, left, format, args);
+  va_end (args);
+  if (n < 0)
+    return TRUE;
+  if ((gsize)n < left)
+    {
+      writer->size += n;
+      return TRUE;
+    }
+
+  /* Did not fit: start again in an empty buffer */
+  if (!flush_data (writer, NULL, 0, error))
+    return FALSE;
+  va_start (args, format);
+  if ((gsize)n < writer->alloc)
+    writer->size = g_vsnprintf (writer->buffer, writer->alloc, format, args);
+  else
+    {
+      char *str;
+
+      str = g_strdup_vprintf (format, args);
+      ret = flush_data (writer, str, n, error);
+      g_free (str);
+    }
+  va_end (args);
+
+  return ret;
+}
+
+gboolean
+ngs_writer_append_fastq (NgsWriter  *writer,
+                         const char *name,
+                         const char *seq,
+                         const char *qual,
+                         GError    **error)
+{
+  return append_fastq_len (writer,
+                           name, strlen (name),
+                           seq, qual, strlen (seq),
+                           error);
+}
+
+gboolean
+ngs_writer_append_fastq_fragment (NgsWriter  *writer,
+                                  const char *name,
+                                  const char *seq,
+                                  const char *qual,
+                                  int         start,
+                                  int         end,
+                                  GError    **error)
+{
+  return append_fastq_len (writer,
+                           name, strlen (name),
+                           seq + start, qual + start, end - start,
+                           error);
+}
+
+static gboolean
+append_fastq_len (NgsWriter  *writer,
+                  const char *name,
+                  gsize       name_size,
+                  const char *seq,
+                  const char *qual,
+                  gsize       size,
+                  GError    **error)
+{
+  const gsize total = name_size + 2 * size + 5;
+  char       *ptr;
+
+  if (writer->error)
+    return ngs_writer_check (writer, error);
+  if (total > writer->alloc)
+    return (ngs_writer_putc (writer, '@', error) &&
+            ngs_writer_write (writer, name, name_size, error) &&
+            ngs_writer_putc (writer, '\n', error) &&
+            ngs_writer_write (writer, seq, size, error) &&
+            ngs_writer_write (writer, "\n+\n", 3, error) &&
+            ngs_writer_write (writer, qual, size, error) &&
+            ngs_writer_putc (writer, '\n', error));
+  if (writer->size + total > writer->alloc &&
+      !flush_data (writer, NULL, 0, error))
+    return FALSE;
+
+  ptr    = writer->buffer + writer->size;
+  *ptr++ = '@';
+  memcpy (ptr, name, name_size);
+  ptr   += name_size;
+  *ptr++ = '\n';
+  memcpy (ptr, seq, size);
+  ptr   += size;
+  *ptr++ = '\n';
+  *ptr++ = '+';
+  *ptr++ = '\n';
+  memcpy (ptr, qual, size);
+  ptr   += size;
+  *ptr++ = '\n';
+  writer->size = ptr - writer->buffer;
+
+  return TRUE;
+}
+
+gboolean
+ngs_writer_append_fasta (NgsWriter    *writer,
+                         const char   *name,
+                         const char   *seq,
+                         gssize        size,
+                         unsigned int  line_size,
+                         GError      **error)
+{
+  gsize name_size;
+  gsize n_lines;
+  gsize total;
+  gsize i;
+  char *ptr;
+
+  if (writer->error)
+    return ngs_writer_check (writer, error);
+  if (size < 0)
+    size = strlen (seq);
+  if (line_size == 0 || line_size > size)
+    line_size = MAX (size, 1);
+  name_size = strlen (name);
+  n_lines   = size == 0 ? 1 : (size + line_size - 1) / line_size;
+  total     = name_size + 2 + size + n_lines;
+
+  if (total > writer->alloc)
+    {
+      if (!ngs_writer_putc (writer, '>', error) ||
+          !ngs_writer_write (writer, name, name_size, error) ||
+          !ngs_writer_putc (writer, '\n', error))
+        return FALSE;
+      for (i = 0; i < (gsize)size; i += line_size)
+        if (!ngs_writer_write (writer, seq + i, MIN (line_size, size - i), error) ||
+            !ngs_writer_putc (writer, '\n', error))
+          return FALSE;
+      return size > 0 || ngs_writer_putc (writer, '\n', error);
+    }
+  if (writer->size + total > writer->alloc &&
+      !flush_data (writer, NULL, 0, error))
+    return FALSE;
+
+  ptr    = writer->buffer + writer->size;
+  *ptr++ = '>';
+  memcpy (ptr, name, name_size);
+  ptr   += name_size;
+  *ptr++ = '\n';
+  for (i = 0; i < (gsize)size; i += line_size)
+    {
+      const gsize n = MIN (line_size, size - i);
+
+      memcpy (ptr, seq + i, n);
+      ptr   += n;
+      *ptr++ = '\n';
+    }
+  if (size == 0)
+    *ptr++ = '\n';
+  writer->size = ptr - writer->buffer;
+
+  return TRUE;
+}
+
+gboolean
+ngs_writer_append_tsv (NgsWriter  *writer,
+                       GError    **error,
+                       ...)
+{
+  va_list     args;
+  const char *field;
+  const char *next;
+  gboolean    ret = TRUE;
+
+  va_start (args, error);
+  field = va_arg (args, const char*);
+  while (ret && field != NULL)
+    {
+      next = va_arg (args, const char*);
+      ret  = (ngs_writer_write (writer, field, -1, error) &&
+              ngs_writer_putc (writer, next ? '\t' : '\n', error));
+      field = next;
+    }
+  va_end (args);
+
+  return ret;
+}
+
+/**
+ * Writes the buffer followed by size bytes of data, and empties the buffer
+ */
+static gboolean
+flush_data (NgsWriter  *writer,
+            const char *data,
+            gsize       size,
+            GError    **error)
+{
+  if (writer->error)
+    return ngs_writer_check (writer, error);
+  if (writer->size + size == 0)
+    return TRUE;
+
+  if (writer->channel)
+    {
+      if (writer->size > 0)
+        g_io_channel_write_chars (writer->channel,
+                                  writer->buffer,
+                                  writer->size,
+                                  NULL,
+                                  &writer->error);
+      if (size > 0 && !writer->error)
+        g_io_channel_write_chars (writer->channel,
+                                  data,
+                                  size,
+                                  NULL,
+                                  &writer->error);
+    }
+  else
+    {
+      struct iovec iov[2];
+
+      iov[0].iov_base = writer->buffer;
+      iov[0].iov_len  = writer->size;
+      iov[1].iov_base = (void*)data;
+      iov[1].iov_len  = size;
+      if (!writev_all (writer->fd, iov, size > 0 ? 2 : 1))
+        g_set_error (&writer->error,
+                     NGS_ERROR,
+                     NGS_IO_ERROR,
+                     "Could not write to `%s': %s",
+                     writer->path,
+                     g_strerror (errno));
+    }
+  writer->size = 0;
+
+  return ngs_writer_check (writer, error);
+}
+
+static gboolean
+writev_all (int           fd,
+            struct iovec *iov,
+            int           n_iov)
+{
+  while (n_iov > 0)
+    {
+      gssize written;
+
+      written = writev (fd, iov, n_iov);
+      if (written < 0)
+        {
+          if (errno == EINTR)
+            continue;
+          return FALSE;
+        }
+      while (n_iov > 0 && (gsize)written >= iov->iov_len)
+        {
+          written -= iov->iov_len;
+          iov++;
+          n_iov--;
+        }
+      if (n_iov > 0)
+        {
+          iov->iov_base  = (char*)iov->iov_base + written;
+          iov->iov_len  -= written;
+        }
+    }
+
+  return TRUE;
+}
+
+/* vim:ft=c:expandtab:sw=4:ts=4:sts=4:cinoptions={.5s^-2n-2(0:
+ */
@@ -0,0 +1,165 @@
+/**
+ *
+ */
+
+#ifndef __NGS_WRITER_H__
+#define __NGS_WRITER_H__
+
+#include <glib.h>
+
+/*************/
+/* NgsWriter */
+/*************/
+
+/**
+ * Buffered output for the tools.
+ * Records are formatted directly into a large page-aligned buffer, which is
+ * written with write(2) when it is full.  Data that does not fit in the
+ * buffer is written together with it in a single writev(2).
+ * A writer can also wrap a GIOChannel (e.g. a BGZF channel), in which case
+ * the buffer is handed to the channel when it is full.
+ *
+ * The first error is kept by the writer: later calls fail straight away
+ * and ngs_writer_close reports it again, so that callers which do not check
+ * every record still see it.
+ */
+
+#define NGS_WRITER_BUFFER_SIZE (1024 * 1024)
+#define NGS_WRITER_ALIGNMENT   4096
+
+typedef struct _NgsWriter NgsWriter;
+
+struct _NgsWriter
+{
+  char       *buffer;
+  gsize       size;
+  gsize       alloc;
+
+  char       *path;
+  int         fd;
+  int         is_stdout;
+  GIOChannel *channel;
+
+  GError     *error;
+};
+
+/**
+ * Opens path for writing.  mode is "w" or "a".  If path is '-', writes to
+ * stdout.
+ */
+
+NgsWriter* ngs_writer_new                   (const char   *path,
+                                             const char   *mode,
+                                             GError      **error);
+
+/**
+ * Output compression.  It is always chosen by the caller, never from the
+ * name of the file.
+ */
+
+typedef enum
+{
+  NGS_COMPRESSION_NONE,
+  NGS_COMPRESSION_GZIP,
+  NGS_COMPRESSION_BGZF
+} NgsCompression;
+
+/**
+ * As ngs_writer_new, but compresses the output with n_threads threads (see
+ * ngs_bgzf.h), while the caller keeps formatting records.
+ */
+
+NgsWriter* ngs_writer_new_compressed        (const char    *path,
+                                             const char    *mode,
+                                             NgsCompression compression,
+                                             int            n_threads,
+                                             GError       **error);
+
+/**
+ * Writes to channel, which is shut down and unreferenced by
+ * ngs_writer_close.  A channel writing to stdout must leave it open when it
+ * is shut down, as BGZF channels do.
+ */
+
+NgsWriter* ngs_writer_new_channel           (GIOChannel   *channel,
+                                             const char   *path);
+
+/**
+ * Flushes the buffer, closes the output and frees the writer.
+ * Returns FALSE if any write failed.
+ */
+
+gboolean   ngs_writer_close                 (NgsWriter    *writer,
+                                             GError      **error);
+
+gboolean   ngs_writer_flush                 (NgsWriter    *writer,
+                                             GError      **error);
+
+/**
+ * Returns FALSE, and sets error, if any write has failed so far
+ */
+
+gboolean   ngs_writer_check                 (NgsWriter    *writer,
+                                             GError      **error);
+
+/**
+ * If size is negative, data is a nul-terminated string.
+ */
+
+gboolean   ngs_writer_write                 (NgsWriter    *writer,
+                                             const char   *data,
+                                             gssize        size,
+                                             GError      **error);
+
+gboolean   ngs_writer_putc                  (NgsWriter    *writer,
+                                             char          c,
+                                             GError      **error);
+
+gboolean   ngs_writer_printf                (NgsWriter    *writer,
+                                             GError      **error,
+                                             const char   *format,
+                                             ...) G_GNUC_PRINTF (3, 4);
+
+/**
+ * Appends a fastq record, or the part of it in [start, end)
+ */
+
+gboolean   ngs_writer_append_fastq          (NgsWriter    *writer,
+                                             const char   *name,
+                                             const char   *seq,
+                                             const char   *qual,
+                                             GError      **error);
+
+gboolean   ngs_writer_append_fastq_fragment (NgsWriter    *writer,
+                                             const char   *name,
+                                             const char   *seq,
+                                             const char   *qual,
+                                             int           start,
+                                             int           end,
+                                             GError      **error);
+
+/**
+ * Appends a fasta record, with line_size characters per line, or on a
+ * single line if line_size is 0.  If size is negative, seq is a
+ * nul-terminated string.
+ */
+
+gboolean   ngs_writer_append_fasta          (NgsWriter    *writer,
+                                             const char   *name,
+                                             const char   *seq,
+                                             gssize        size,
+                                             unsigned int  line_size,
+                                             GError      **error);
+
+/**
+ * Appends the NULL-terminated list of strings as a tab-separated line
+ */
+
+gboolean   ngs_writer_append_tsv            (NgsWriter    *writer,
+                                             GError      **error,
+                                             ...) G_GNUC_NULL_TERMINATED;
+
+#endif /* __NGS_WRITER_H__ */
+
+/* vim:ft=c:expandtab:sw=4:ts=4:sts=4:cinoptions={.5s^-2n-2(0:
+ */
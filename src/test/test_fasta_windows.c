@@ -0,0 +1,170 @@
+/* Copyright (C) 2010  Sylvain FORET
+ *
+ * This file is part of libngs.
+ *
+ * libngs is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *                                                                       
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *                                                                       
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/**
+ * Checks that the kmers counted by kmers_count on both strands of the windows
+ * of a fasta file are the same as those it counts on whole records, for
+ * windows smaller than the records.  The code of kmers_count is included
+ * here, so that its own counting functions are tested.
+ */
+
+#define main kmers_count_main
+#include "../bin/kmers_count.c"
+#undef main
+
+static int  iter_func          (FastaSeq          *fasta,
+                                CallbackData      *data);
+
+static void count_data_init    (CallbackData      *data,
+                                char              *path,
+                                unsigned int       k,
+                                unsigned long int  window_size);
+
+static void count_data_clear   (CallbackData      *data);
+
+static int  compare_counts     (KmerHashTable     *expected,
+                                KmerHashTable     *counts);
+
+int
+main (int    argc,
+      char **argv)
+{
+  const unsigned long int window_sizes[] = {0, 1000, 4099, 65536};
+  CallbackData            whole;
+  GError                 *error = NULL;
+  unsigned int            k     = 31;
+  unsigned int            i;
+  int                     ret   = 0;
+
+  if (argc < 2)
+    {
+      g_printerr ("Usage: %s FILE [K]\n", argv[0]);
+      exit (1);
+    }
+  if (argc > 2)
+    k = atoi (argv[2]);
+  if (k < 1)
+    {
+      g_printerr ("[ERROR] The kmer size must be larger than 0\n");
+      exit (1);
+    }
+
+  count_data_init (&whole, argv[1], k, 0);
+  iter_fasta (argv[1],
+              (FastaIterFunc)iter_func,
+              &whole,
+              &error);
+  if (error)
+    {
+      g_printerr ("[ERROR] Reading `%s' failed: %s\n", argv[1], error->message);
+      g_error_free (error);
+      exit (1);
+    }
+
+  for (i = 0; i < G_N_ELEMENTS (window_sizes); i++)
+    {
+      CallbackData      windows;
+      unsigned long int window_size;
+
+      window_size = MAX (window_sizes[i], 2 * k);
+      count_data_init (&windows, argv[1], k, window_size);
+      iter_fasta_windows (&windows, &error);
+      if (error)
+        {
+          g_printerr ("[ERROR] Reading `%s' failed: %s\n",
+                      argv[1], error->message);
+          g_error_free (error);
+          exit (1);
+        }
+      if (compare_counts (whole.htable, windows.htable))
+        g_print ("windows of %lu: %ld kmers, ok\n",
+                 window_size, windows.htable->nnodes);
+      else
+        {
+          g_print ("windows of %lu: counts differ\n", window_size);
+          ret = 1;
+        }
+      count_data_clear (&windows);
+    }
+  count_data_clear (&whole);
+
+  return ret;
+}
+
+static int
+iter_func (FastaSeq     *fasta,
+           CallbackData *data)
+{
+  return iter_count_seq (data, fasta->seq, fasta->size);
+}
+
+static void
+count_data_init (CallbackData      *data,
+                 char              *path,
+                 unsigned int       k,
+                 unsigned long int  window_size)
+{
+  memset (data, 0, sizeof (*data));
+  data->input_path  = path;
+  data->k           = k;
+  data->k_bytes     = (k + NUCS_PER_BYTE - 1) / NUCS_PER_BYTE;
+  data->do_revcomp  = 1;
+  data->freq_report = 1000000;
+  data->window_size = window_size;
+  data->htable      = kmer_hash_table_new (k);
+  data->tmp_kmer    = g_malloc0 (MAX (KMER_VAL_BYTES, data->k_bytes));
+}
+
+static void
+count_data_clear (CallbackData *data)
+{
+  kmer_hash_table_destroy (data->htable);
+  g_free (data->tmp_kmer);
+  g_free (data->rc_buffer);
+}
+
+static int
+compare_counts (KmerHashTable *expected,
+                KmerHashTable *counts)
+{
+  KmerHashTableIter  iter;
+  KmerHashNode      *node;
+
+  if (expected->nnodes != counts->nnodes)
+    return 0;
+  kmer_hash_table_iter_init (&iter, expected);
+  while ((node = kmer_hash_table_iter_next (&iter)) != NULL)
+    {
+      const unsigned char *kmer;
+      KmerHashNode        *other;
+
+      if (expected->kmer_bytes > KMER_VAL_BYTES)
+        kmer = node->kmer.kmer_ptr;
+      else
+        kmer = node->kmer.kmer_val;
+      other = kmer_hash_table_lookup (counts, kmer);
+      if (other == NULL || other->value.count != node->value.count)
+        return 0;
+    }
+
+  return 1;
+}
+
+/* vim:ft=c:expandtab:sw=4:ts=4:sts=4:cinoptions={.5s^-2n-2(0:
+ */
@@ -30,12 +30,15 @@ struct _TestFastqData
 {
   char *input_path;
   int   width;
+  int   batch_size;
 };
 
 static void parse_args (TestFastqData    *data,
                         int               *argc,
                         char            ***argv);
 
+static void print_seq  (FastqSeq         *seq);
+
 int
 main (int    argc,
       char **argv)
@@ -54,15 +57,27 @@ main (int    argc,
                   error->message);
       exit (1);
     }
-  for (seq = fastq_iter_next (iter) ; seq != NULL; seq = fastq_iter_next (iter))
-    g_print ("@%s\n"
-             "%s\n"
-             "+%s\n"
-             "%s\n",
-             seq->name,
-             seq->seq,
-             seq->name,
-             seq->qual);
+  if (data.batch_size > 0)
+    {
+      FastqBatch *batch;
+      gsize       i;
+
+      batch = fastq_batch_new ();
+      while (fastq_iter_next_batch (iter, batch, data.batch_size) > 0)
+        for (i = 0; i < batch->n_seqs; i++)
+          print_seq (batch->seqs + i);
+      fastq_batch_free (batch);
+    }
+  else
+    for (seq = fastq_iter_next (iter) ; seq != NULL; seq = fastq_iter_next (iter))
+      print_seq (seq);
+  if (fastq_iter_get_error (iter, &error))
+    {
+      g_printerr ("[ERROR] Failed to read input file `%s': %s\n",
+                  data.input_path,
+                  error->message);
+      exit (1);
+    }
   fastq_iter_free (iter);
 
   return 0;
@@ -76,12 +91,14 @@ parse_args (TestFastqData    *data,
   GOptionEntry entries[] =
     {
       /* {"width", 'w', 0, G_OPTION_ARG_INT, &data->width, "Line width", NULL}, */
+      {"batch", 'b', 0, G_OPTION_ARG_INT, &data->batch_size, "Read the records in batches of this size", NULL},
       {NULL}
     };
   GError         *error = NULL;
   GOptionContext *context;
 
-  data->width = 50;
+  data->width      = 50;
+  data->batch_size = 0;
 
   context = g_option_context_new ("FILE - Reads a fastq file and spits it back out");
   g_option_context_add_group (context, get_fastq_option_group ());
@@ -101,5 +118,18 @@ parse_args (TestFastqData    *data,
   data->input_path = (*argv)[1];
 }
 
+static void
+print_seq (FastqSeq *seq)
+{
+  g_print ("@%s\n"
+           "%s\n"
+           "+%s\n"
+           "%s\n",
+           seq->name,
+           seq->seq,
+           seq->name,
+           seq->qual);
+}
+
 /* vim:ft=c:expandtab:sw=4:ts=4:sts=4:cinoptions={.5s^-2n-2(0:
  */
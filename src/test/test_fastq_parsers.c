@@ -0,0 +1,130 @@
+/* Copyright (C) 2010  Sylvain FORET
+ *
+ * This file is part of libngs.
+ *
+ * libngs is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *                                                                       
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *                                                                       
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * Benchmarks the fastq parsers against each other.
+ * The input must be a regular file, as it is read once per parser.
+ */
+
+#include <stdlib.h>
+
+#include "ngs_fastq.h"
+
+typedef struct _BenchData BenchData;
+
+struct _BenchData
+{
+  unsigned long n_seqs;
+  unsigned long n_bases;
+};
+
+static void set_parser (char     *prog,
+                        char     *parser);
+
+static int  iter_func  (FastqSeq  *fastq,
+                        BenchData *data);
+
+int
+main (int    argc,
+      char **argv)
+{
+  char *default_parsers[] = {"flex", "simple", "ugly", "mmap", "stream", NULL};
+  char **parsers          = default_parsers;
+  int    i;
+
+  if (argc < 2)
+    {
+      g_printerr ("Usage: %s FILE [PARSER ...]\n", argv[0]);
+      exit (1);
+    }
+  if (argc > 2)
+    parsers = argv + 2;
+
+  g_print ("parser\tseconds\tseqs\tbases\tMbases/s\n");
+  for (i = 0; parsers[i] != NULL; i++)
+    {
+      BenchData  data  = {0, 0};
+      GError    *error = NULL;
+      GTimer    *timer;
+      double     elapsed;
+
+      set_parser (argv[0], parsers[i]);
+      timer = g_timer_new ();
+      iter_fastq (argv[1],
+                  (FastqIterFunc)iter_func,
+                  &data,
+                  &error);
+      g_timer_stop (timer);
+      elapsed = g_timer_elapsed (timer, NULL);
+      g_timer_destroy (timer);
+      if (error)
+        {
+          g_printerr ("[ERROR] Parser `%s' failed: %s\n",
+                      parsers[i],
+                      error->message);
+          g_error_free (error);
+          continue;
+        }
+      g_print ("%s\t%.3f\t%lu\t%lu\t%.1f\n",
+               parsers[i],
+               elapsed,
+               data.n_seqs,
+               data.n_bases,
+               elapsed > 0 ? data.n_bases / elapsed / 1e6 : 0);
+    }
+
+  return 0;
+}
+
+static void
+set_parser (char *prog,
+            char *parser)
+{
+  GOptionContext *context;
+  GError         *error = NULL;
+  char           *args[3];
+  char          **argv  = args;
+  int             argc  = 2;
+
+  args[0] = prog;
+  args[1] = g_strdup_printf ("--fastq_parser_name=%s", parser);
+  args[2] = NULL;
+
+  context = g_option_context_new (NULL);
+  g_option_context_add_group (context, get_fastq_option_group ());
+  if (!g_option_context_parse (context, &argc, &argv, &error))
+    {
+      g_printerr ("[ERROR] Option parsing failed: %s\n", error->message);
+      exit (1);
+    }
+  g_option_context_free (context);
+  g_free (args[1]);
+}
+
+static int
+iter_func (FastqSeq  *fastq,
+           BenchData *data)
+{
+  data->n_seqs++;
+  data->n_bases += fastq->size;
+
+  return 1;
+}
+
+/* vim:ft=c:expandtab:sw=4:ts=4:sts=4:cinoptions={.5s^-2n-2(0:
+ */
@@ -0,0 +1,210 @@
+/* Copyright (C) 2010  Sylvain FORET
+ *
+ * This file is part of libngs.
+ *
+ * libngs is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *                                                                       
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *                                                                       
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * Writes plain and BGZF fastq files in which some names are repeated,
+ * indexes them, and checks that fetching a read through the index returns
+ * the same record as parsing the file and keeping the reads by name, that
+ * is the last one.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <glib/gstdio.h>
+
+#include "ngs_fastq.h"
+#include "ngs_fqindex.h"
+#include "ngs_writer.h"
+
+#define N_READS 1000
+
+typedef struct _ParseData ParseData;
+
+struct _ParseData
+{
+  const char *name;
+  char       *seq;
+};
+
+static char* write_fastq (const char     *dir,
+                          const char     *name,
+                          NgsCompression  compression);
+
+static int   check_read  (const char     *path,
+                          FqIndexReader  *reader,
+                          const char     *name);
+
+static int   iter_func   (FastqSeq       *fastq,
+                          ParseData      *data);
+
+int
+main (int    argc,
+      char **argv)
+{
+  const char *names[] = {"read0", "read1", "read500", "read999", "dup", "missing"};
+  GError     *error   = NULL;
+  char       *dir;
+  int         ret     = 0;
+  int         bgzf;
+
+  (void)argc;
+  (void)argv;
+
+  dir = g_dir_make_tmp ("test_fq_index_XXXXXX", &error);
+  if (dir == NULL)
+    {
+      g_printerr ("[ERROR] Creating a temporary directory failed: %s\n",
+                  error->message);
+      g_error_free (error);
+      exit (1);
+    }
+  for (bgzf = 0; bgzf < 2; bgzf++)
+    {
+      FqIndex       *index;
+      FqIndexReader *reader = NULL;
+      char          *path;
+      unsigned int   i;
+
+      path  = write_fastq (dir,
+                           bgzf ? "reads.fq.gz" : "reads.fq",
+                           bgzf ? NGS_COMPRESSION_BGZF : NGS_COMPRESSION_NONE);
+      index = fq_index_build (path, &error);
+      if (index)
+        reader = fq_index_reader_new (index, path, &error);
+      if (reader == NULL)
+        {
+          g_printerr ("[ERROR] Indexing `%s' failed: %s\n", path, error->message);
+          g_error_free (error);
+          exit (1);
+        }
+      for (i = 0; i < G_N_ELEMENTS (names); i++)
+        if (!check_read (path, reader, names[i]))
+          ret = 1;
+      if (ret == 0)
+        g_print ("%s: ok\n", bgzf ? "BGZF" : "plain");
+      fq_index_reader_free (reader);
+      fq_index_free (index);
+      g_unlink (path);
+      g_free (path);
+    }
+  g_rmdir (dir);
+  g_free (dir);
+
+  return ret;
+}
+
+/**
+ * Every hundredth read is also called `dup', with a sequence of its own.
+ */
+static char*
+write_fastq (const char     *dir,
+             const char     *name,
+             NgsCompression  compression)
+{
+  NgsWriter    *writer;
+  GError       *error = NULL;
+  char         *path;
+  unsigned int  i;
+
+  path   = g_build_filename (dir, name, NULL);
+  writer = ngs_writer_new_compressed (path, "w", compression, 1, &error);
+  if (writer == NULL)
+    {
+      g_printerr ("[ERROR] Opening `%s' failed: %s\n", path, error->message);
+      exit (1);
+    }
+  for (i = 0; i < N_READS; i++)
+    {
+      ngs_writer_printf (writer,
+                         NULL,
+                         "@read%u\nACGT%uACGT\n+\nIIII%uIIII\n",
+                         i, i, i);
+      if (i % 100 == 0)
+        ngs_writer_printf (writer,
+                           NULL,
+                           "@dup\nTTTT%uTTTT\n+\nHHHH%uHHHH\n",
+                           i, i);
+    }
+  if (!ngs_writer_close (writer, &error))
+    {
+      g_printerr ("[ERROR] Writing `%s' failed: %s\n", path, error->message);
+      exit (1);
+    }
+
+  return path;
+}
+
+static int
+check_read (const char    *path,
+            FqIndexReader *reader,
+            const char    *name)
+{
+  ParseData  data;
+  FastqSeq  *fastq;
+  GError    *error = NULL;
+  int        ret   = 1;
+
+  data.name = name;
+  data.seq  = NULL;
+  iter_fastq (path, (FastqIterFunc)iter_func, &data, &error);
+  if (error)
+    {
+      g_printerr ("[ERROR] Parsing `%s' failed: %s\n", path, error->message);
+      g_error_free (error);
+      exit (1);
+    }
+
+  fastq = fq_index_reader_fetch (reader, name, &error);
+  if (error)
+    {
+      g_printerr ("[ERROR] Fetching `%s' from `%s' failed: %s\n",
+                  name, path, error->message);
+      g_error_free (error);
+      ret = 0;
+    }
+  else if ((fastq == NULL) != (data.seq == NULL) ||
+           (fastq && strcmp (fastq->seq, data.seq) != 0))
+    {
+      g_printerr ("[ERROR] `%s' is %s in `%s', but %s through the index\n",
+                  name,
+                  data.seq ? data.seq : "missing",
+                  path,
+                  fastq ? fastq->seq : "missing");
+      ret = 0;
+    }
+  g_free (data.seq);
+
+  return ret;
+}
+
+static int
+iter_func (FastqSeq  *fastq,
+           ParseData *data)
+{
+  if (strcmp (fastq->name, data->name) == 0)
+    {
+      g_free (data->seq);
+      data->seq = g_strdup (fastq->seq);
+    }
+
+  return 1;
+}
+
+/* vim:ft=c:expandtab:sw=4:ts=4:sts=4:cinoptions={.5s^-2n-2(0:
+ */
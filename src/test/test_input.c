@@ -0,0 +1,188 @@
+/* Copyright (C) 2010  Sylvain FORET
+ *
+ * This file is part of libngs.
+ *
+ * libngs is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *                                                                       
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *                                                                       
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * Writes gzip compressed fastq files smaller and larger than the blocks
+ * inflated by NgsInput, reads them back, and closes them after their first
+ * record, after one byte, before any byte, one byte before their end, and
+ * at their end.  Closing must not wait for blocks that will never come, so
+ * the test hangs if it does.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <glib/gstdio.h>
+#include <zlib.h>
+
+#include "ngs_input.h"
+
+#define RECORD "@read%u\nACGTACGTNNACGTACGTACGTTTGCAGCA\n+\nIIIIIIIIII##IIIIIIIIIIIII5555\n"
+
+static char* write_gzip (const char   *dir,
+                         const char   *name,
+                         unsigned int  n_records,
+                         gsize        *size);
+
+static int   check_read (const char   *path,
+                         gsize         max_lines,
+                         gsize         max_bytes);
+
+int
+main (int    argc,
+      char **argv)
+{
+  const unsigned int sizes[] = {1, 100, 200000};
+  GError            *error   = NULL;
+  char              *dir;
+  unsigned int       i;
+  int                ret     = 0;
+
+  (void)argc;
+  (void)argv;
+
+  dir = g_dir_make_tmp ("test_input_XXXXXX", &error);
+  if (dir == NULL)
+    {
+      g_printerr ("[ERROR] Creating a temporary directory failed: %s\n",
+                  error->message);
+      g_error_free (error);
+      exit (1);
+    }
+  for (i = 0; i < G_N_ELEMENTS (sizes); i++)
+    {
+      char  *name;
+      char  *path;
+      gsize  size;
+
+      name = g_strdup_printf ("reads%u.fq.gz", sizes[i]);
+      path = write_gzip (dir, name, sizes[i], &size);
+      if (!check_read (path, 4, G_MAXSIZE) ||
+          !check_read (path, G_MAXSIZE, 1) ||
+          !check_read (path, G_MAXSIZE, 0) ||
+          !check_read (path, G_MAXSIZE, size - 1) ||
+          !check_read (path, G_MAXSIZE, G_MAXSIZE))
+        ret = 1;
+      else
+        g_print ("%u records: ok\n", sizes[i]);
+      g_unlink (path);
+      g_free (path);
+      g_free (name);
+    }
+  g_rmdir (dir);
+  g_free (dir);
+
+  return ret;
+}
+
+static char*
+write_gzip (const char   *dir,
+            const char   *name,
+            unsigned int  n_records,
+            gsize        *size)
+{
+  gzFile        file;
+  char         *path;
+  unsigned int  i;
+
+  path = g_build_filename (dir, name, NULL);
+  file = gzopen (path, "wb");
+  if (file == NULL)
+    {
+      g_printerr ("[ERROR] Opening `%s' failed\n", path);
+      exit (1);
+    }
+  *size = 0;
+  for (i = 0; i < n_records; i++)
+    *size += gzprintf (file, RECORD, i);
+  if (gzclose (file) != Z_OK)
+    {
+      g_printerr ("[ERROR] Writing `%s' failed\n", path);
+      exit (1);
+    }
+
+  return path;
+}
+
+/**
+ * Reads path until max_lines lines or max_bytes bytes are read, and
+ * closes it.  The first record must be read as it was written.
+ */
+static int
+check_read (const char *path,
+            gsize       max_lines,
+            gsize       max_bytes)
+{
+  NgsInput *input;
+  GString  *first;
+  GError   *error   = NULL;
+  char     *record;
+  gsize     n_bytes = 0;
+  gsize     n_lines = 0;
+  int       ret     = 1;
+
+  input = ngs_input_open (path, &error);
+  if (input == NULL)
+    {
+      g_printerr ("[ERROR] Opening `%s' failed: %s\n", path, error->message);
+      g_error_free (error);
+      return 0;
+    }
+  if (ngs_input_get_format (input) != NGS_INPUT_GZIP)
+    {
+      g_printerr ("[ERROR] `%s' is not read as gzip\n", path);
+      ret = 0;
+    }
+  first = g_string_new (NULL);
+  while (n_lines < max_lines && n_bytes < max_bytes)
+    {
+      char   c;
+      gssize bytes_read;
+
+      bytes_read = ngs_input_read (input, &c, 1);
+      if (bytes_read <= 0)
+        break;
+      n_bytes++;
+      if (n_lines < 4)
+        g_string_append_c (first, c);
+      if (c == '\n')
+        n_lines++;
+    }
+  if (ngs_input_get_error (input, &error))
+    {
+      g_printerr ("[ERROR] Reading `%s' failed: %s\n", path, error->message);
+      g_error_free (error);
+      ret = 0;
+    }
+  ngs_input_close (input);
+
+  record = g_strdup_printf (RECORD, 0);
+  if (strncmp (first->str, record, first->len) != 0 ||
+      (n_lines >= 4 && first->len != strlen (record)))
+    {
+      g_printerr ("[ERROR] The first record of `%s' is wrong\n", path);
+      ret = 0;
+    }
+  g_free (record);
+  g_string_free (first, TRUE);
+
+  return ret;
+}
+
+/* vim:ft=c:expandtab:sw=4:ts=4:sts=4:cinoptions={.5s^-2n-2(0:
+ */
@@ -0,0 +1,147 @@
+/* Copyright (C) 2010  Sylvain FORET
+ *
+ * This file is part of libngs.
+ *
+ * libngs is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *                                                                       
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *                                                                       
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * Benchmarks the quality codec on the qualities of a fastq file, in blocks
+ * as in read stores, and checks that they are decoded unchanged.
+ * With a second argument `bin', the qualities are binned first.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "ngs_fastq.h"
+#include "ngs_qualcodec.h"
+
+#define BLOCK_SIZE (4 * 1024 * 1024)
+
+typedef struct _BenchData BenchData;
+
+struct _BenchData
+{
+  GString *quals;
+  int      bin;
+};
+
+static int iter_func (FastqSeq  *fastq,
+                      BenchData *data);
+
+int
+main (int    argc,
+      char **argv)
+{
+  BenchData   data;
+  QualCodec  *codec;
+  GByteArray *encoded;
+  GArray     *ends;
+  GError     *error = NULL;
+  GTimer     *timer;
+  char       *decoded;
+  double      encode_time;
+  double      decode_time;
+  gsize       start;
+  guint       i;
+
+  if (argc < 2)
+    {
+      g_printerr ("Usage: %s FILE [bin]\n", argv[0]);
+      exit (1);
+    }
+  data.quals = g_string_new (NULL);
+  data.bin   = argc > 2 && strcmp (argv[2], "bin") == 0;
+
+  iter_fastq (argv[1],
+              (FastqIterFunc)iter_func,
+              &data,
+              &error);
+  if (error)
+    {
+      g_printerr ("[ERROR] Iterating sequences failed: %s\n", error->message);
+      g_error_free (error);
+      exit (1);
+    }
+
+  codec   = qual_codec_new ();
+  encoded = g_byte_array_new ();
+  ends    = g_array_new (FALSE, FALSE, sizeof (guint));
+  timer   = g_timer_new ();
+  for (start = 0; start < data.quals->len; start += BLOCK_SIZE)
+    {
+      const gsize size = MIN (BLOCK_SIZE, data.quals->len - start);
+
+      if (!qual_codec_encode (codec, data.quals->str + start, size, encoded))
+        {
+          g_printerr ("[ERROR] Qualities cannot be encoded\n");
+          exit (1);
+        }
+      g_array_append_val (ends, encoded->len);
+    }
+  encode_time = g_timer_elapsed (timer, NULL);
+
+  decoded = g_malloc (BLOCK_SIZE);
+  g_timer_start (timer);
+  for (i = 0, start = 0; start < data.quals->len; i++, start += BLOCK_SIZE)
+    {
+      const gsize size  = MIN (BLOCK_SIZE, data.quals->len - start);
+      const guint begin = i > 0 ? g_array_index (ends, guint, i - 1) : 0;
+
+      if (!qual_codec_decode (codec,
+                              encoded->data + begin,
+                              g_array_index (ends, guint, i) - begin,
+                              decoded,
+                              size) ||
+          memcmp (decoded, data.quals->str + start, size) != 0)
+        {
+          g_printerr ("[ERROR] Block %u was not decoded correctly\n", i);
+          exit (1);
+        }
+    }
+  decode_time = g_timer_elapsed (timer, NULL);
+
+  g_print ("bytes\tencoded\tbits/qual\tencode GB/s\tdecode GB/s\n");
+  g_print ("%lu\t%u\t%.3f\t%.3f\t%.3f\n",
+           (unsigned long)data.quals->len,
+           encoded->len,
+           data.quals->len ? 8.0 * encoded->len / data.quals->len : 0,
+           encode_time > 0 ? data.quals->len / encode_time / 1e9 : 0,
+           decode_time > 0 ? data.quals->len / decode_time / 1e9 : 0);
+
+  g_timer_destroy (timer);
+  g_free (decoded);
+  g_array_free (ends, TRUE);
+  g_byte_array_free (encoded, TRUE);
+  qual_codec_free (codec);
+  g_string_free (data.quals, TRUE);
+
+  return 0;
+}
+
+static int
+iter_func (FastqSeq  *fastq,
+           BenchData *data)
+{
+  if (data->bin)
+    qual_bin (fastq->qual, fastq->size);
+  g_string_append_len (data->quals, fastq->qual, fastq->size);
+  g_string_append_c (data->quals, '\0');
+
+  return 1;
+}
+
+/* vim:ft=c:expandtab:sw=4:ts=4:sts=4:cinoptions={.5s^-2n-2(0:
+ */
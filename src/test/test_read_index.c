@@ -0,0 +1,116 @@
+/* Copyright (C) 2010  Sylvain FORET
+ *
+ * This file is part of libngs.
+ *
+ * libngs is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *                                                                       
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *                                                                       
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * Benchmarks the lookups of the reads of a fastq file in a SeqDB, through
+ * the sorted hashes of their names and through their perfect hash, and
+ * checks that both give the same reads.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "ngs_fastq.h"
+#include "ngs_seq_db.h"
+
+static int iter_func (FastqSeq  *fastq,
+                      GPtrArray *names);
+
+int
+main (int    argc,
+      char **argv)
+{
+  SeqDB     *db;
+  GPtrArray *names;
+  GError    *error = NULL;
+  GTimer    *timer;
+  gint64    *ids;
+  double     sorted_time;
+  double     mphf_time;
+  guint64    sorted_size;
+  guint64    index_size;
+  guint      i;
+
+  if (argc < 2)
+    {
+      g_printerr ("Usage: %s FILE\n", argv[0]);
+      exit (1);
+    }
+  db    = seq_db_new ();
+  names = g_ptr_array_new_with_free_func (g_free);
+  seq_db_load_fastq (db, argv[1], &error);
+  if (!error)
+    iter_fastq (argv[1],
+                (FastqIterFunc)iter_func,
+                names,
+                &error);
+  if (error)
+    {
+      g_printerr ("[ERROR] Loading reads failed: %s\n", error->message);
+      g_error_free (error);
+      exit (1);
+    }
+
+  ids   = g_new (gint64, names->len);
+  timer = g_timer_new ();
+  for (i = 0; i < names->len; i++)
+    ids[i] = seq_db_lookup_read (db, g_ptr_array_index (names, i));
+  sorted_time = g_timer_elapsed (timer, NULL);
+  sorted_size = db->read_hashes->len * sizeof (SeqDBHash);
+
+  seq_db_index_reads (db);
+  index_size = mphf_size (db->read_mphf) +
+               db->n_read_keys * (sizeof (*db->read_ids) + sizeof (*db->read_fingerprints));
+  g_timer_start (timer);
+  for (i = 0; i < names->len; i++)
+    if (seq_db_lookup_read (db, g_ptr_array_index (names, i)) != ids[i] ||
+        ids[i] < 0)
+      {
+        g_printerr ("[ERROR] Read `%s' was not found\n",
+                    (char*)g_ptr_array_index (names, i));
+        exit (1);
+      }
+  mphf_time = g_timer_elapsed (timer, NULL);
+
+  g_print ("reads\tsorted bytes\tindex bytes\tsorted lookups/s\tmphf lookups/s\n");
+  g_print ("%u\t%lu\t%lu\t%.0f\t%.0f\n",
+           names->len,
+           (unsigned long)sorted_size,
+           (unsigned long)index_size,
+           sorted_time > 0 ? names->len / sorted_time : 0,
+           mphf_time > 0 ? names->len / mphf_time : 0);
+
+  g_timer_destroy (timer);
+  g_free (ids);
+  g_ptr_array_free (names, TRUE);
+  seq_db_free (db);
+
+  return 0;
+}
+
+static int
+iter_func (FastqSeq  *fastq,
+           GPtrArray *names)
+{
+  g_ptr_array_add (names, g_strdup (fastq->name));
+
+  return 1;
+}
+
+/* vim:ft=c:expandtab:sw=4:ts=4:sts=4:cinoptions={.5s^-2n-2(0:
+ */